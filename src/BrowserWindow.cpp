@@ -25,9 +25,7 @@
 
 #include <wx/filedlg.h>
 #include <wx/filename.h>
-#include <wx/stdpaths.h>
 
-#include "Imported/crc.h"
 #include "BrowserWindow.h"
 
 #include "AboutBox.h"
@@ -37,6 +35,7 @@
 #include "ProgressStatusBar.h"
 #include "PreviewPanel.h"
 
+#include "Tasks/PreviewTask.h"
 #include "Tasks/ReadIndexTask.h"
 #include "Tasks/ScanDatTask.h"
 #include "Tasks/WriteIndexTask.h"
@@ -47,8 +46,10 @@ namespace gw2b
 BrowserWindow::BrowserWindow(const wxString& p_title)
     : wxFrame(nullptr, wxID_ANY, p_title, wxDefaultPosition, wxSize(800, 512))
     , m_index(std::make_shared<DatIndex>())
+    , m_indexLoader(m_datFile, m_index)
     , m_progress(nullptr)
-    , m_currentTask(nullptr)
+    , m_indexTask(nullptr)
+    , m_previewTask(nullptr)
     , m_splitter(nullptr)
     , m_catTree(nullptr)
     , m_previewPanel(nullptr)
@@ -92,43 +93,49 @@ BrowserWindow::BrowserWindow(const wxString& p_title)
     this->Connect(wxID_EXIT, wxEVT_COMMAND_MENU_SELECTED, wxCommandEventHandler(BrowserWindow::onExitEvt));
     this->Connect(wxID_ABOUT, wxEVT_COMMAND_MENU_SELECTED, wxCommandEventHandler(BrowserWindow::onAboutEvt));
     this->Connect(wxEVT_CLOSE_WINDOW, wxCloseEventHandler(BrowserWindow::onCloseEvt));
+    this->Connect(wxEVT_IDLE, wxIdleEventHandler(BrowserWindow::onPerformTaskEvt));
+    m_progressTimer.SetOwner(this);
+    this->Connect(wxEVT_TIMER, wxTimerEventHandler(BrowserWindow::onProgressTimerEvt));
 }
 
 //============================================================================/
 
 BrowserWindow::~BrowserWindow()
 {
-    deletePointer(m_currentTask);
+    // They read from our .dat
+    this->abortExtractions();
 }
 
 //============================================================================/
 
-bool BrowserWindow::performTask(Task* p_task)
+bool BrowserWindow::performTask(Task* p_task, TaskScheduler::Priority p_priority)
 {
     Ensure::notNull(p_task);
 
-    // Already have a task running?
-    if (m_currentTask) {
-        if (m_currentTask->canAbort()) {
-            m_currentTask->abort();
-            deletePointer(m_currentTask);
-            this->Disconnect(wxEVT_IDLE, wxIdleEventHandler(BrowserWindow::onPerformTaskEvt));
-            m_progress->hideProgressBar();
-        } else {
+    // Tasks working on the index can't run side by side
+    if (m_indexTask && m_scheduler.isScheduled(m_indexTask)) {
+        if (!m_scheduler.abort(m_indexTask)) {
             deletePointer(p_task);
             return false;
         }
     }
 
+    // Forget the task once it's gone, so a later task allocated at the same
+    // address is never mistaken for it
+    auto forgetTask = [this, p_task]() {
+        if (m_indexTask == p_task) { m_indexTask = nullptr; }
+    };
+    p_task->addOnCompleteHandler(forgetTask);
+    p_task->addOnAbortHandler(forgetTask);
+
     // Initialize succeeded?
-    m_currentTask = p_task;
-    if (!m_currentTask->init()) {
-        deletePointer(m_currentTask);
+    m_indexTask = nullptr;
+    if (!m_scheduler.schedule(p_task, p_priority)) {
         return false;
     }
 
-    this->Connect(wxEVT_IDLE, wxIdleEventHandler(BrowserWindow::onPerformTaskEvt));
-    m_progress->setMaxValue(m_currentTask->maxProgress());
+    m_indexTask = p_task;
+    m_progress->setMaxValue(p_task->maxProgress());
     m_progress->showProgressBar();
     return true;
 }
@@ -137,23 +144,30 @@ bool BrowserWindow::performTask(Task* p_task)
 
 void BrowserWindow::openFile(const wxString& p_path)
 {
+    // Everything still reading the .dat or its index has to stop before they
+    // are replaced. Tasks that can't be aborted, like writing the index, are
+    // left to finish first.
+    this->abortExtractions();
+    if (!m_scheduler.abortAll()) {
+        m_scheduler.foremostTask()->addOnCompleteHandler([this, p_path]() { this->openFile(p_path); });
+        return;
+    }
+
     // Try to open the file
-    if (!m_datFile.open(p_path)) {
+    if (!m_datFile.open(p_path, DatFile::OM_Mapped, DatFile::TM_Lazy)) {
         wxMessageBox(wxString::Format(wxT("Failed to open file: %s"), p_path), 
             wxMessageBoxCaptionStr, wxOK | wxCENTER | wxICON_ERROR);
         return;
     }
-    m_datPath = p_path;
 
     // Open the index file
-    uint64 datTimeStamp = wxFileModificationTime(p_path);
-    auto indexFile      = this->findDatIndex();
-    auto readIndexTask  = new ReadIndexTask(m_index, indexFile.GetFullPath(), datTimeStamp);
+    m_indexLoader.reset(p_path);
+    auto readIndexTask = m_indexLoader.createReadTask();
 
     // Start reading the index
-    readIndexTask->addOnCompleteHandler([this]() { this->onReadIndexComplete(); });
+    readIndexTask->addOnCompleteHandler([this, readIndexTask]() { this->onReadIndexComplete(readIndexTask->wasOutdated()); });
     if (!this->performTask(readIndexTask)) {
-        this->reIndexDat();
+        this->indexDat(m_indexLoader.createRebuildTask());
     }
 }
 
@@ -161,41 +175,64 @@ void BrowserWindow::openFile(const wxString& p_path)
 
 void BrowserWindow::viewEntry(const DatIndexEntry& p_entry)
 {
-    if (m_previewPanel->previewFile(m_datFile, p_entry)) {
-        m_previewPanel->Show();
-        // Split it!
-        m_splitter->SetMinimumPaneSize(100);
-        m_splitter->SplitVertically(m_catTree, m_previewPanel, m_splitter->GetClientSize().x / 4);
+    // Only the latest selection is worth loading
+    this->cancelPreview();
+
+    auto previewTask = new PreviewTask(m_datFile, p_entry.mftEntry(), p_entry.fileType());
+    previewTask->addOnCompleteHandler([this, previewTask]() {
+        m_previewTask = nullptr;
+        if (m_previewPanel->previewFile(m_datFile, previewTask->takeReader())) {
+            m_previewPanel->Show();
+            // Split it!
+            m_splitter->SetMinimumPaneSize(100);
+            m_splitter->SplitVertically(m_catTree, m_previewPanel, m_splitter->GetClientSize().x / 4);
+        }
+    });
+    previewTask->addOnAbortHandler([this, previewTask]() {
+        if (m_previewTask == previewTask) { m_previewTask = nullptr; }
+    });
+
+    if (m_scheduler.schedule(previewTask, TaskScheduler::TP_High)) {
+        m_previewTask = previewTask;
+    }
+}
+
+void BrowserWindow::cancelPreview()
+{
+    // Waits for the worker to notice, which it does between blocks
+    if (m_previewTask && m_scheduler.isScheduled(m_previewTask)) {
+        m_scheduler.abort(m_previewTask);
     }
+    m_previewTask = nullptr;
 }
 
 //============================================================================/
 
-wxFileName BrowserWindow::findDatIndex()
+void BrowserWindow::extractFiles(const Array<const DatIndexEntry*>& p_entries, const wxString& p_path, FileExtractor::ExtractionMode p_mode)
 {
-    auto configPath    = wxStandardPaths().GetUserDataDir();
-    auto datPathCrc    = ::compute_crc(INITIAL_CRC, m_datPath.char_str(), m_datPath.Length());
-    auto indexFileName = wxString::Format(wxT("%x.idx"), (uint)datPathCrc);
-    
-    return wxFileName(configPath, indexFileName);
+    auto window = new ExtractFilesWindow(p_entries, m_datFile, p_path, p_mode);
+    window->Connect(wxEVT_DESTROY, wxWindowDestroyEventHandler(BrowserWindow::onExtractWindowDestroyEvt), nullptr, this);
+    m_extractWindows.push_back(window);
 }
 
 //============================================================================/
 
-void BrowserWindow::reIndexDat()
+void BrowserWindow::abortExtractions()
 {
-    m_index->clear();
-    m_index->setDatTimestamp(wxFileModificationTime(m_datPath));
-    this->indexDat();
+    for (auto iter = m_extractWindows.begin(); iter != m_extractWindows.end(); iter++) {
+        auto window = *iter;
+        window->Disconnect(wxEVT_DESTROY, wxWindowDestroyEventHandler(BrowserWindow::onExtractWindowDestroyEvt), nullptr, this);
+        window->stop();
+    }
+    m_extractWindows.clear();
 }
 
 //============================================================================/
 
-void BrowserWindow::indexDat()
+void BrowserWindow::indexDat(ScanDatTask* p_scanTask)
 {
-    auto scanTask = new ScanDatTask(m_index, m_datFile);
-    scanTask->addOnCompleteHandler([this]() { this->onScanTaskComplete(); });
-    this->performTask(scanTask);
+    p_scanTask->addOnCompleteHandler([this]() { this->onScanTaskComplete(); });
+    this->performTask(p_scanTask);
 }
 
 //============================================================================/
@@ -235,23 +272,17 @@ void BrowserWindow::onCloseEvt(wxCloseEvent& p_event)
         return;
     }
 
-    // Cancel current task if possible.
-    if (m_currentTask) {
-        if (m_currentTask->canAbort()) {
-            m_currentTask->abort();
-            deletePointer(m_currentTask);
-            this->Disconnect(wxEVT_IDLE, wxIdleEventHandler(BrowserWindow::onPerformTaskEvt));
-        } else {
-            this->Disable();
-            m_currentTask->addOnCompleteHandler([this]() { this->tryClose(); });
-            p_event.Veto();
-            return;
-        }
+    // Cancel running tasks if possible. Try again once the others are done.
+    if (!m_scheduler.abortAll()) {
+        this->Disable();
+        m_scheduler.foremostTask()->addOnCompleteHandler([this]() { this->tryClose(); });
+        p_event.Veto();
+        return;
     }
 
     // Add a write task if the index is dirty
-    if (!m_currentTask && m_index->isDirty()) {
-        auto indexPath = this->findDatIndex();
+    if (m_index->isDirty()) {
+        auto indexPath = m_indexLoader.indexPath();
         if (!indexPath.DirExists()) { indexPath.Mkdir(511, wxPATH_MKDIR_FULL); }
 
         auto writeTask = new WriteIndexTask(m_index, indexPath.GetFullPath());
@@ -270,38 +301,62 @@ void BrowserWindow::onCloseEvt(wxCloseEvent& p_event)
 
 void BrowserWindow::onPerformTaskEvt(wxIdleEvent& p_event)
 {
-    Ensure::notNull(m_currentTask);
-    m_currentTask->perform();
+    if (m_scheduler.isIdle()) { return; }
+    bool needsPumping = m_scheduler.pump();
 
-    if (!m_currentTask->isDone()) {
-        m_progress->update(m_currentTask->currentProgress(), m_currentTask->text());
-        p_event.RequestMore();
+    auto task = m_scheduler.foremostTask();
+    if (task) {
+        if (m_progress->maxValue() != task->maxProgress()) {
+            m_progress->setMaxValue(task->maxProgress());
+        }
+        m_progress->update(task->currentProgress(), task->text());
+        // Workers wake us up once they're done, until then only the progress
+        // needs refreshing every now and then
+        if (needsPumping) {
+            p_event.RequestMore();
+        } else if (!m_progressTimer.IsRunning()) {
+            m_progressTimer.Start(PROGRESS_INTERVAL, wxTIMER_ONE_SHOT);
+        }
     } else {
-        this->Disconnect(wxEVT_IDLE, wxIdleEventHandler(BrowserWindow::onPerformTaskEvt));
         m_progress->SetStatusText(wxEmptyString);
         m_progress->hideProgressBar();
-
-        auto oldTask = m_currentTask;
-        m_currentTask = nullptr;
-        oldTask->invokeOnCompleteHandler();
-        deletePointer(oldTask);
     }
 }
 
 //============================================================================/
 
-void BrowserWindow::onReadIndexComplete()
+void BrowserWindow::onProgressTimerEvt(wxTimerEvent& WXUNUSED(p_event))
+{
+    ::wxWakeUpIdle();
+}
+
+//============================================================================/
+
+void BrowserWindow::onExtractWindowDestroyEvt(wxWindowDestroyEvent& p_event)
+{
+    m_extractWindows.remove(static_cast<ExtractFilesWindow*>(p_event.GetEventObject()));
+    p_event.Skip();
+}
+
+//============================================================================/
+
+void BrowserWindow::onReadIndexComplete(bool p_wasOutdated)
 {
-    // If it failed, it was cleared.
-    if (m_index->datTimestamp() == 0 || m_index->numEntries() == 0) {
-        this->reIndexDat();
+    auto scanTask = m_indexLoader.createScanTask(p_wasOutdated);
+    if (scanTask) {
+        this->indexDat(scanTask);
+        return;
+    }
+
+    // Dropping the stale entries of an outdated index still changed it
+    if (m_index->isDirty()) {
+        this->onScanTaskComplete();
         return;
     }
 
-    // Was it complete?
-    auto isComplete = (m_index->highestMftEntry() == m_datFile.numFiles());
-    if (!isComplete) {
-        this->indexDat();
+    // Indexes written before snapshots existed need one for the next patch
+    if (!m_indexLoader.snapshotPath().FileExists()) {
+        m_indexLoader.writeMftSnapshot();
     }
 }
 
@@ -309,14 +364,23 @@ void BrowserWindow::onReadIndexComplete()
 
 void BrowserWindow::onScanTaskComplete()
 {
-    auto writeTask = new WriteIndexTask(m_index, this->findDatIndex().GetFullPath());
+    auto writeTask = new WriteIndexTask(m_index, m_indexLoader.indexPath().GetFullPath());
+    writeTask->addOnCompleteHandler([this]() { this->onWriteIndexComplete(); });
     this->performTask(writeTask);
 }
 
 //============================================================================/
 
+void BrowserWindow::onWriteIndexComplete()
+{
+    m_indexLoader.writeMftSnapshot();
+}
+
+//============================================================================/
+
 void BrowserWindow::onWriteTaskCloseCompleted()
 {
+    m_indexLoader.writeMftSnapshot();
     // Forcing this here causes the OnCloseEvt to not try to write the index
     // again. In case it failed the first time, it's likely to fail again and
     // we don't want to get stuck in an infinite loop.
@@ -392,7 +456,7 @@ void BrowserWindow::onTreeExtractRaw(CategoryTree& p_tree)
         else {
             wxDirDialog dialog(this, wxT("Select output folder"));
             if (dialog.ShowModal() == wxID_OK) {
-                new ExtractFilesWindow(entries, m_datFile, dialog.GetPath(), ExtractFilesWindow::EM_Raw);
+                this->extractFiles(entries, dialog.GetPath(), FileExtractor::EM_Raw);
             }
         }
     }
@@ -451,7 +515,7 @@ void BrowserWindow::onTreeExtractConverted(CategoryTree& p_tree)
         else {
             wxDirDialog dialog(this, wxT("Select output folder"));
             if (dialog.ShowModal() == wxID_OK) {
-                new ExtractFilesWindow(entries, m_datFile, dialog.GetPath(), ExtractFilesWindow::EM_Converted);
+                this->extractFiles(entries, dialog.GetPath(), FileExtractor::EM_Converted);
             }
         }
     }
@@ -26,30 +26,41 @@
 #ifndef BROWSERWINDOW_H_INCLUDED
 #define BROWSERWINDOW_H_INCLUDED
 
+#include <list>
 #include <wx/filename.h>
 #include <wx/splitter.h>
+#include <wx/timer.h>
 
 #include "CategoryTree.h"
 #include "DatFile.h"
+#include "DatIndexLoader.h"
+#include "FileExtractor.h"
+#include "TaskScheduler.h"
 
 namespace gw2b
 {
 class DatIndex;
+class ExtractFilesWindow;
 class PreviewPanel;
 class ProgressStatusBar;
-class Task;
+class ScanDatTask;
 
 /** Represents the browser's main window. */
 class BrowserWindow : public wxFrame, public ICategoryTreeListener
 {
-    wxString                    m_datPath;
+    enum { PROGRESS_INTERVAL = 100 };
     DatFile                     m_datFile;
     std::shared_ptr<DatIndex>   m_index;
+    DatIndexLoader              m_indexLoader;
     ProgressStatusBar*          m_progress;
-    Task*                       m_currentTask;
+    TaskScheduler               m_scheduler;
+    Task*                       m_indexTask;
+    Task*                       m_previewTask;
+    wxTimer                     m_progressTimer;
     wxSplitterWindow*           m_splitter;
     CategoryTree*               m_catTree;
     PreviewPanel*               m_previewPanel;
+    std::list<ExtractFilesWindow*>  m_extractWindows;
 public:
     /** Constructs the frame with the given title.
      *  \param[in]  p_title  Title of window. */
@@ -62,23 +73,34 @@ public:
     /** Tries to close this window, but does not force it (same as calling 
      *  Close(false)). */
     void tryClose();
-    /** Opens the preview pane with the given entry's contents in it.
+    /** Opens the preview pane with the given entry's contents in it. The
+     *  entry is loaded in the background, and a preview still loading is
+     *  cancelled.
      *  \param[in]  p_entry  entry to view. */
     void viewEntry(const DatIndexEntry& p_entry);
 private:
-    /** Performs the given task periodically, until it is done.
-     *  \param[in]  p_task   Task to perform. Ownership is taken. 
+    /** Cancels the preview that is still loading, if any. */
+    void cancelPreview();
+    /** Starts extracting the given entries from the loaded .dat file in a
+     *  window of its own.
+     *  \param[in]  p_entries    Entries to extract.
+     *  \param[in]  p_path       Folder to extract them to.
+     *  \param[in]  p_mode       Whether to convert the files or not. */
+    void extractFiles(const Array<const DatIndexEntry*>& p_entries, const wxString& p_path, FileExtractor::ExtractionMode p_mode);
+    /** Aborts all extractions still running. Waits for the files they are
+     *  reading, so the .dat and the index can be replaced afterwards. */
+    void abortExtractions();
+    /** Schedules the given task operating on the index. Only one such task
+     *  runs at a time, so any previous one is aborted if possible.
+     *  \param[in]  p_task       Task to perform. Ownership is taken. 
+     *  \param[in]  p_priority   Priority of the task.
      *  \return bool    true if the task's init succeeded, false if not. */
-    bool performTask(Task* p_task);
+    bool performTask(Task* p_task, TaskScheduler::Priority p_priority = TaskScheduler::TP_Normal);
 
-    /** Hashes the internally stored .dat file path and determines where its 
-    *   index file should be located. 
-    *   \return wxFileName containing the path to the index file. */
-    wxFileName findDatIndex();
-    /** Resumes indexing the loaded .dat file. */
-    void indexDat();
-    /** Re-indexes the loaded .dat file. */
-    void reIndexDat();
+    /** Indexes the loaded .dat file with the given task.
+     *  \param[in]  p_scanTask   Task scanning the files to index. Ownership
+     *                          is taken. */
+    void indexDat(ScanDatTask* p_scanTask);
 
     /** Executed when the user clicks <em>File -> Open</em> in the menu. 
      *  \param[in]  p_event  Unused event object handed to us by wxWidgets. */
@@ -92,14 +114,24 @@ private:
     /** Executed when the window is closing.
      *  \param[in]  p_event  Unused event object handed to us by wxWidgets. */
     void onCloseEvt(wxCloseEvent& p_event);
-    /** Performs the currently active task repeatedly until it is complete.
+    /** Pumps the scheduled tasks and shows the progress of the foremost one.
      *  \param[in]  p_event  Idle event object used to request more idle events. */
     void onPerformTaskEvt(wxIdleEvent& p_event);
-
-    /** Raised when the index has been read. */
-    void onReadIndexComplete();
+    /** Refreshes the progress of worker tasks, which don't need pumping.
+     *  \param[in]  p_event  Unused event object handed to us by wxWidgets. */
+    void onProgressTimerEvt(wxTimerEvent& p_event);
+    /** Executed when an extraction window is destroyed, to stop tracking it.
+     *  \param[in]  p_event  Event object telling which window it was. */
+    void onExtractWindowDestroyEvt(wxWindowDestroyEvent& p_event);
+
+    /** Raised when the index has been read.
+     *  \param[in]  p_wasOutdated    true if the index was written for an
+     *                              older version of the .dat. */
+    void onReadIndexComplete(bool p_wasOutdated);
     /** Raised when the .dat has finished indexing. */
     void onScanTaskComplete();
+    /** Raised when the index has been written, unless invoked from onCloseEvt. */
+    void onWriteIndexComplete();
     /** Raised when the write task has finished, if invoked from onCloseEvt. */
     void onWriteTaskCloseCompleted();
 
@@ -22,6 +22,7 @@
 */
 
 #include "stdafx.h"
+#include <vector>
 #include "CategoryTree.h"
 
 #include "Data.h"
@@ -104,6 +105,61 @@ void CategoryTree::addEntry(const DatIndexEntry& p_entry)
 
 //============================================================================/
 
+void CategoryTree::addEntries(uint p_first, uint p_end)
+{
+    if (!m_index || p_first >= p_end) { return; }
+
+    // Count the new entries per category
+    uint numCategories = m_index->numCategories();
+    std::vector<uint> counts(numCategories, 0);
+    for (uint i = p_first; i < p_end; i++) {
+        counts[m_index->entry(i)->category()->index()]++;
+    }
+
+    this->Freeze();
+
+    // Find the expanded category nodes, and flag the rest as dirty so they
+    // get their entries when expanded
+    std::vector<wxTreeItemId> nodes(numCategories);
+    for (uint i = 0; i < numCategories; i++) {
+        if (!counts[i]) { continue; }
+        auto node = this->ensureHasCategory(*m_index->category(i));
+        if (!node.IsOk()) { continue; }
+
+        if (this->IsExpanded(node)) {
+            nodes[i] = node;
+        } else {
+            auto itemData = static_cast<CategoryTreeItem*>(this->GetItemData(node));
+            if (itemData->dataType() == CategoryTreeItem::DT_Category) { itemData->setDirty(true); }
+        }
+    }
+
+    // Add the entries of expanded categories. Few entries are put in their
+    // spot right away, many are appended and sorted afterwards.
+    for (uint i = p_first; i < p_end; i++) {
+        auto entry    = m_index->entry(i);
+        uint category = entry->category()->index();
+        if (!nodes[category].IsOk()) { continue; }
+
+        wxTreeItemId node;
+        if (counts[category] > MAX_SORTED_INSERTS) {
+            node = this->AppendItem(nodes[category], entry->name(), this->getImageForEntry(*entry));
+        } else {
+            node = this->addEntry(nodes[category], *entry);
+        }
+        this->SetItemData(node, new CategoryTreeItem(CategoryTreeItem::DT_Entry, entry));
+    }
+    for (uint i = 0; i < numCategories; i++) {
+        if (nodes[i].IsOk() && counts[i] > MAX_SORTED_INSERTS) {
+            this->SortChildren(nodes[i]);
+        }
+    }
+
+    this->Thaw();
+}
+
+//============================================================================/
+
 wxTreeItemId CategoryTree::ensureHasCategory(const DatIndexCategory& p_category, bool p_force) 
 {
     wxTreeItemId parent;
@@ -149,9 +205,15 @@ wxTreeItemId CategoryTree::ensureHasCategory(const DatIndexCategory& p_category,
 
 wxTreeItemId CategoryTree::addEntry(const wxTreeItemId& p_parent, const DatIndexEntry& p_entry)
 {
-    if (p_entry.name().IsNumber()) {
+    // Default names are the base ID, no need to parse those
+    if (!p_entry.hasCustomName() && p_entry.baseId()) {
+        return this->addNumberEntry(p_parent, p_entry, p_entry.baseId());
+    }
+
+    auto name = p_entry.name();
+    if (name.IsNumber()) {
         ulong number;
-        p_entry.name().ToULong(&number);
+        name.ToULong(&number);
         return this->addNumberEntry(p_parent, p_entry, number);
     }
 
@@ -329,10 +391,7 @@ void CategoryTree::setDatIndex(const std::shared_ptr<DatIndex>& p_index)
 
     if (m_index) {
         m_index->addListener(this);
-
-        for (uint i = 0; i < m_index->numEntries(); i++) {
-            this->addEntry(*m_index->entry(i));
-        }
+        this->addEntries(0, m_index->numEntries());
     }
 }
 
@@ -529,10 +588,10 @@ void CategoryTree::onExtractConvertedFiles(wxCommandEvent& p_event)
 
 //============================================================================/
 
-void CategoryTree::onIndexFileAdded(DatIndex& p_index, const DatIndexEntry& p_entry)
+void CategoryTree::onIndexEntriesAdded(DatIndex& p_index, uint p_first, uint p_end)
 {
-    Ensure::notNull(&p_entry);
-    this->addEntry(p_entry);
+    Assert(&p_index == m_index.get());
+    this->addEntries(p_first, p_end);
 }
 
 //============================================================================/
@@ -123,6 +123,7 @@ public:
 class CategoryTree : public wxTreeCtrl, public IDatIndexListener
 {
     typedef std::set<ICategoryTreeListener*>    ListenerSet;
+    enum { MAX_SORTED_INSERTS = 0x10 };
 private:
     std::shared_ptr<DatIndex>   m_index;
     ListenerSet                 m_listeners;
@@ -138,6 +139,12 @@ public:
     /** Adds an index entry to this tree.
      *  \param[in]  p_entry  Entry to add. */
     void addEntry(const DatIndexEntry& p_entry);
+    /** Adds a range of index entries to this tree. Each affected category is
+     *  only looked up once, and categories that are not expanded are just
+     *  flagged for a refresh.
+     *  \param[in]  p_first  Index of the first entry to add.
+     *  \param[in]  p_end    Index following the last entry to add. */
+    void addEntries(uint p_first, uint p_end);
     /** Ensures that the given category is part of the tree. Note that the
      *  category is \e not added if a parent category is collapsed. If it
      *  already exists, its id is returned and no category is added.
@@ -164,10 +171,11 @@ public:
      *  \param  p_listener   Pointer to the listener to remove. */
     void removeListener(ICategoryTreeListener* p_listener);
 
-    /** Called by the .dat index when an entry is added.
-     *  \param[in]  p_index  Reference to the index that had a file added to it.
-     *  \param[in]  p_entry  Reference to the newly added entry. */
-    virtual void onIndexFileAdded(DatIndex& p_index, const DatIndexEntry& p_entry) override;
+    /** Called by the .dat index when entries are added.
+     *  \param[in]  p_index  Reference to the index that had files added to it.
+     *  \param[in]  p_first  Index of the first added entry.
+     *  \param[in]  p_end    Index following the last added entry. */
+    virtual void onIndexEntriesAdded(DatIndex& p_index, uint p_first, uint p_end) override;
     /** Called by the .dat index when it is cleared.
      *  \param[in]  p_index  Reference to the index being cleared. */
     virtual void onIndexCleared(DatIndex& p_index) override;
@@ -0,0 +1,529 @@
+/** \file       Gw2BrowserCli.cpp
+ *  \brief      Contains definition of the command line application class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include "Gw2BrowserCli.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <wx/crt.h>
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/stopwatch.h>
+
+#ifdef __WXMSW__
+#  include <fcntl.h>
+#  include <io.h>
+#endif
+
+#include "DatIndex.h"
+#include "DatIndexLoader.h"
+#include "TaskScheduler.h"
+
+#include "Tasks/ReadIndexTask.h"
+#include "Tasks/ScanDatTask.h"
+#include "Tasks/WriteIndexTask.h"
+
+#include "Util/Profiler.h"
+#include "Util/WorkPool.h"
+
+namespace gw2b
+{
+
+wxIMPLEMENT_APP_CONSOLE(Gw2BrowserCli);
+
+//============================================================================/
+
+namespace
+{
+
+    enum { EXTRACT_FILES_PER_STEP = 0x40 };
+    enum { PROGRESS_INTERVAL = 250 };
+
+    const wxCmdLineEntryDesc g_cmdLineDesc[] = 
+    {
+        { wxCMD_LINE_SWITCH, "h",  "help",     "show this help", wxCMD_LINE_VAL_NONE, wxCMD_LINE_OPTION_HELP },
+        { wxCMD_LINE_OPTION, NULL, "index",    "index file to use instead of the browser's", wxCMD_LINE_VAL_STRING, 0 },
+        { wxCMD_LINE_OPTION, NULL, "category", "only include files in this category, e.g. \"Textures/ATEX\"", wxCMD_LINE_VAL_STRING, 0 },
+        { wxCMD_LINE_OPTION, NULL, "profile",  "write a trace of where time was spent to this file", wxCMD_LINE_VAL_STRING, 0 },
+        { wxCMD_LINE_SWITCH, "c",  "convert",  "convert files to a common format where possible", wxCMD_LINE_VAL_NONE, 0 },
+        { wxCMD_LINE_SWITCH, NULL, "rebuild",  "index the .dat from scratch, ignoring any existing index", wxCMD_LINE_VAL_NONE, 0 },
+        { wxCMD_LINE_PARAM,  NULL, NULL,       "command", wxCMD_LINE_VAL_STRING, 0 },
+        { wxCMD_LINE_PARAM,  NULL, NULL,       "dat", wxCMD_LINE_VAL_STRING, 0 },
+        { wxCMD_LINE_PARAM,  NULL, NULL,       "args", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL | wxCMD_LINE_PARAM_MULTIPLE },
+        { wxCMD_LINE_NONE,   NULL, NULL,       NULL, wxCMD_LINE_VAL_NONE, 0 }
+    };
+
+    const wxChar* g_usageText = 
+        wxT("\nCommands:\n")
+        wxT("  index <dat>                       Index the .dat, or bring its index up to date.\n")
+        wxT("  list <dat>                        List the indexed files.\n")
+        wxT("  stat <dat> [<id>...]              Show totals for the .dat, or details of the given files.\n")
+        wxT("  cat <dat> <id>                    Write the contents of a file to stdout.\n")
+        wxT("  extract <dat> <dir>               Extract the indexed files into a directory.\n")
+        wxT("  convert <dat> <input> [<output>]  Convert a raw file on disk to a common format.\n")
+        wxT("\nFiles are given by file ID, or by base ID (the name shown by list).");
+
+}; // anon namespace
+
+//============================================================================/
+
+Gw2BrowserCli::Gw2BrowserCli()
+    : m_index(std::make_shared<DatIndex>())
+    , m_indexLoader(m_datFile, m_index)
+    , m_convert(false)
+    , m_rebuild(false)
+{
+}
+
+//============================================================================/
+
+void Gw2BrowserCli::OnInitCmdLine(wxCmdLineParser& p_parser)
+{
+    p_parser.SetDesc(g_cmdLineDesc);
+    p_parser.AddUsageText(g_usageText);
+    p_parser.SetSwitchChars(wxT("-"));
+}
+
+//============================================================================/
+
+bool Gw2BrowserCli::OnCmdLineParsed(wxCmdLineParser& p_parser)
+{
+    m_command = p_parser.GetParam(0);
+    m_datPath = p_parser.GetParam(1);
+    for (uint i = 2; i < p_parser.GetParamCount(); i++) {
+        m_args.Add(p_parser.GetParam(i));
+    }
+
+    p_parser.Found(wxT("index"), &m_indexPath);
+    p_parser.Found(wxT("category"), &m_category);
+    p_parser.Found(wxT("profile"), &m_profilePath);
+    m_convert = p_parser.Found(wxT("convert"));
+    m_rebuild = p_parser.Found(wxT("rebuild"));
+
+    // Leading and trailing slashes would keep the category from matching
+    m_category.Replace(wxT("\\"), wxT("/"));
+    while (m_category.StartsWith(wxT("/"))) { m_category.Remove(0, 1); }
+    while (m_category.EndsWith(wxT("/"))) { m_category.RemoveLast(); }
+
+    return true;
+}
+
+//============================================================================/
+
+bool Gw2BrowserCli::OnInit()
+{
+    // Share the index files with the browser
+    this->SetAppName(wxT("Gw2Browser"));
+    if (!wxAppConsole::OnInit()) { return false; }
+
+    wxLog::DisableTimestamp();
+    ::wxInitAllImageHandlers();
+
+    // Profiling is only worth its overhead when asked for
+    if (!m_profilePath.IsEmpty()) {
+        Profiler::reset();
+        Profiler::setEnabled(true);
+    }
+
+    return true;
+}
+
+//============================================================================/
+
+int Gw2BrowserCli::OnRun()
+{
+    if (m_command == wxT("index"))   { return this->runIndex(); }
+    if (m_command == wxT("list"))    { return this->runList(); }
+    if (m_command == wxT("stat"))    { return this->runStat(); }
+    if (m_command == wxT("cat"))     { return this->runCat(); }
+    if (m_command == wxT("extract")) { return this->runExtract(); }
+    if (m_command == wxT("convert")) { return this->runConvert(); }
+
+    wxLogError(wxT("Unknown command: %s"), m_command);
+    return EXIT_FAILURE;
+}
+
+//============================================================================/
+
+int Gw2BrowserCli::OnExit()
+{
+    // Its workers must be joined before wxWidgets shuts down
+    WorkPool::destroyShared();
+
+    // The trace goes where asked, with the totals next to it
+    if (!m_profilePath.IsEmpty()) {
+        Profiler::setEnabled(false);
+        wxFileName summaryPath(m_profilePath);
+        summaryPath.SetName(summaryPath.GetName() + wxT(".summary"));
+        summaryPath.SetExt(wxT("json"));
+
+        Profiler::writeTrace(m_profilePath);
+        Profiler::writeSummary(summaryPath.GetFullPath());
+    }
+
+    return wxAppConsole::OnExit();
+}
+
+//============================================================================/
+
+int Gw2BrowserCli::runIndex()
+{
+    if (!this->openDat() || !this->loadIndex()) { return EXIT_FAILURE; }
+
+    wxLogMessage(wxT("%u files indexed in %u categories: %s"), m_index->numEntries(), m_index->numCategories(), m_indexLoader.indexPath().GetFullPath());
+    return EXIT_SUCCESS;
+}
+
+//============================================================================/
+
+int Gw2BrowserCli::runList()
+{
+    if (!this->openDat() || !this->loadIndex()) { return EXIT_FAILURE; }
+
+    for (uint i = 0; i < m_index->numEntries(); i++) {
+        auto entry = m_index->entry(i);
+        if (!this->isEntryIncluded(*entry)) { continue; }
+
+        wxPrintf(wxT("%u\t%u\t%u\t%u\t%s/%s\n"), entry->fileId(), entry->baseId(), entry->mftEntry(),
+            m_datFile.fileSize(entry->mftEntry()), categoryPath(*entry->category()), entry->name());
+    }
+
+    return EXIT_SUCCESS;
+}
+
+//============================================================================/
+
+int Gw2BrowserCli::runStat()
+{
+    if (!this->openDat()) { return EXIT_FAILURE; }
+
+    // Without any files given, show what's in the .dat as a whole
+    if (!m_args.GetCount()) {
+        uint64 totalSize     = 0;
+        uint   numCompressed = 0;
+        for (uint i = 0; i < m_datFile.numFiles(); i++) {
+            ANetMftEntry record;
+            if (!m_datFile.fileRecord(i, record)) { continue; }
+            totalSize += record.size;
+            if (record.compressionFlag) { numCompressed++; }
+        }
+
+        wxPrintf(wxT("path\t%s\n"), m_datPath);
+        wxPrintf(wxT("files\t%u\n"), m_datFile.numFiles());
+        wxPrintf(wxT("compressed\t%u\n"), numCompressed);
+        wxPrintf(wxT("recordSize\t%llu\n"), totalSize);
+        wxPrintf(wxT("timestamp\t%lld\n"), (long long)wxFileModificationTime(m_datPath));
+        wxPrintf(wxT("index\t%s\n"), m_indexLoader.indexPath().GetFullPath());
+        return EXIT_SUCCESS;
+    }
+
+    int result = EXIT_SUCCESS;
+    for (uint i = 0; i < m_args.GetCount(); i++) {
+        auto fileNum = this->findFileNum(m_args[i]);
+        ANetMftEntry record;
+        if (fileNum == std::numeric_limits<uint>::max() || !m_datFile.fileRecord(fileNum, record)) {
+            wxLogError(wxT("No such file: %s"), m_args[i]);
+            result = EXIT_FAILURE;
+            continue;
+        }
+
+        auto contents = m_datFile.readFile(fileNum);
+        auto fileType = ANFT_Unknown;
+        m_datFile.identifyFileType(contents.GetPointer(), contents.GetSize(), fileType);
+        uint32 fourcc = contents.GetSize() >= 4 ? *reinterpret_cast<const uint32*>(contents.GetPointer()) : 0;
+
+        wxPrintf(wxT("fileId\t%u\n"), m_datFile.fileIdFromFileNum(fileNum));
+        wxPrintf(wxT("baseId\t%u\n"), m_datFile.baseIdFromFileNum(fileNum));
+        wxPrintf(wxT("mftEntry\t%u\n"), fileNum);
+        wxPrintf(wxT("offset\t%llu\n"), record.offset);
+        wxPrintf(wxT("recordSize\t%u\n"), record.size);
+        wxPrintf(wxT("size\t%u\n"), contents.GetSize());
+        wxPrintf(wxT("compressed\t%s\n"), record.compressionFlag ? wxT("yes") : wxT("no"));
+        wxPrintf(wxT("fourcc\t%08x\n"), fourcc);
+        wxPrintf(wxT("type\t%d\n\n"), (int)fileType);
+    }
+
+    return result;
+}
+
+//============================================================================/
+
+int Gw2BrowserCli::runCat()
+{
+    if (m_args.GetCount() != 1) {
+        wxLogError(wxT("Usage: cat <dat> <id>"));
+        return EXIT_FAILURE;
+    }
+    if (!this->openDat()) { return EXIT_FAILURE; }
+
+    auto fileNum = this->findFileNum(m_args[0]);
+    if (fileNum == std::numeric_limits<uint>::max()) {
+        wxLogError(wxT("No such file: %s"), m_args[0]);
+        return EXIT_FAILURE;
+    }
+
+    auto contents = m_datFile.readFile(fileNum);
+    if (!contents.GetSize()) {
+        wxLogError(wxT("Failed to read file: %s"), m_args[0]);
+        return EXIT_FAILURE;
+    }
+    if (m_convert) {
+        FileExtractor::convertFile(m_datFile, contents);
+    }
+
+    return writeToStdout(contents) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//============================================================================/
+
+int Gw2BrowserCli::runExtract()
+{
+    if (m_args.GetCount() != 1) {
+        wxLogError(wxT("Usage: extract <dat> <dir> [--category=<path>] [--convert]"));
+        return EXIT_FAILURE;
+    }
+    if (!this->openDat() || !this->loadIndex()) { return EXIT_FAILURE; }
+
+    // Gather the files to extract
+    Array<const DatIndexEntry*> entries(m_index->numEntries());
+    uint numEntries = 0;
+    for (uint i = 0; i < m_index->numEntries(); i++) {
+        auto entry = m_index->entry(i);
+        if (this->isEntryIncluded(*entry)) { entries[numEntries++] = entry; }
+    }
+    entries.SetSize(numEntries);
+
+    if (!numEntries) {
+        wxLogError(wxT("No files to extract."));
+        return EXIT_FAILURE;
+    }
+
+    // Extract them, reporting progress along the way
+    auto mode = m_convert ? FileExtractor::EM_Converted : FileExtractor::EM_Raw;
+    FileExtractor extractor(entries, m_datFile, m_args[0], mode);
+    wxStopWatch stopWatch;
+
+    while (!extractor.isDone()) {
+        extractor.extract(EXTRACT_FILES_PER_STEP, PROGRESS_INTERVAL);
+        if (stopWatch.Time() >= PROGRESS_INTERVAL || extractor.isDone()) {
+            wxFprintf(stderr, wxT("\rExtracting files: %u/%u"), extractor.numProcessed(), extractor.numFiles());
+            stopWatch.Start();
+        }
+    }
+    wxFprintf(stderr, wxT("\n"));
+
+    if (extractor.numFailed()) {
+        wxLogError(wxT("Failed to extract %u of %u files."), extractor.numFailed(), extractor.numFiles());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+//============================================================================/
+
+int Gw2BrowserCli::runConvert()
+{
+    if (m_args.GetCount() < 1 || m_args.GetCount() > 2) {
+        wxLogError(wxT("Usage: convert <dat> <input> [<output>]"));
+        return EXIT_FAILURE;
+    }
+    if (!this->openDat()) { return EXIT_FAILURE; }
+
+    // Read the raw file
+    wxFile input(m_args[0]);
+    if (!input.IsOpened()) {
+        wxLogError(wxT("Failed to open file: %s"), m_args[0]);
+        return EXIT_FAILURE;
+    }
+
+    Array<byte> contents((uint)input.Length());
+    if (input.Read(contents.GetPointer(), contents.GetSize()) != (ssize_t)contents.GetSize()) {
+        wxLogError(wxT("Failed to read file: %s"), m_args[0]);
+        return EXIT_FAILURE;
+    }
+    input.Close();
+
+    auto extension = FileExtractor::convertFile(m_datFile, contents);
+    if (extension.IsEmpty()) {
+        wxLogError(wxT("Unable to convert file: %s"), m_args[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Unless told where to put it, it goes next to the input
+    wxFileName outputPath(m_args.GetCount() > 1 ? m_args[1] : m_args[0]);
+    if (m_args.GetCount() == 1) {
+        outputPath.SetExt(extension);
+    }
+
+    wxFile output(outputPath.GetFullPath(), wxFile::write);
+    if (!output.IsOpened() || output.Write(contents.GetPointer(), contents.GetSize()) != contents.GetSize()) {
+        wxLogError(wxT("Failed to write file: %s"), outputPath.GetFullPath());
+        return EXIT_FAILURE;
+    }
+
+    wxLogMessage(wxT("Converted to %s"), outputPath.GetFullPath());
+    return EXIT_SUCCESS;
+}
+
+//============================================================================/
+
+bool Gw2BrowserCli::openDat()
+{
+    if (!m_datFile.open(m_datPath, DatFile::OM_Mapped, DatFile::TM_Lazy)) {
+        wxLogError(wxT("Failed to open file: %s"), m_datPath);
+        return false;
+    }
+    m_indexLoader.reset(m_datPath, wxFileName(m_indexPath));
+    return true;
+}
+
+//============================================================================/
+
+bool Gw2BrowserCli::loadIndex()
+{
+    TaskScheduler scheduler;
+    auto indexFile = m_indexLoader.indexPath();
+
+    // Read the existing index the same way the browser does, so only what
+    // changed since it was written needs scanning
+    ScanDatTask* scanTask = nullptr;
+    if (m_rebuild) {
+        scanTask = m_indexLoader.createRebuildTask();
+    } else {
+        bool wasOutdated   = false;
+        auto readIndexTask = m_indexLoader.createReadTask();
+        readIndexTask->addOnCompleteHandler([&wasOutdated, readIndexTask]() { wasOutdated = readIndexTask->wasOutdated(); });
+        this->performTask(scheduler, readIndexTask);
+        scanTask = m_indexLoader.createScanTask(wasOutdated);
+    }
+
+    if (scanTask && !this->performTask(scheduler, scanTask)) {
+        wxLogError(wxT("Failed to index file: %s"), m_datPath);
+        return false;
+    }
+
+    // Write it back if anything changed, along with the snapshot telling
+    // what to re-scan after the next patch
+    bool hasSnapshot = m_indexLoader.snapshotPath().FileExists();
+    if (m_index->isDirty()) {
+        if (!this->performTask(scheduler, new WriteIndexTask(m_index, indexFile))) {
+            wxLogWarning(wxT("Failed to write index: %s"), indexFile.GetFullPath());
+            return true;
+        }
+        hasSnapshot = false;
+    }
+
+    if (!hasSnapshot) {
+        m_indexLoader.writeMftSnapshot();
+    }
+
+    return true;
+}
+
+//============================================================================/
+
+bool Gw2BrowserCli::performTask(TaskScheduler& p_scheduler, Task* p_task)
+{
+    bool isComplete = false;
+    p_task->addOnCompleteHandler([&isComplete]() { isComplete = true; });
+    if (!p_scheduler.schedule(p_task)) { return false; }
+
+    // Nothing else to do, so just pump until it's done. Worker tasks don't
+    // need the pumping, so don't spin on those.
+    wxStopWatch stopWatch;
+    bool hasShownProgress = false;
+    while (!p_scheduler.isIdle()) {
+        bool needsPumping = p_scheduler.pump();
+
+        auto task = p_scheduler.foremostTask();
+        if (!task) { break; }
+        if (stopWatch.Time() >= PROGRESS_INTERVAL) {
+            wxFprintf(stderr, wxT("\r%s"), task->text());
+            hasShownProgress = true;
+            stopWatch.Start();
+        }
+        if (!needsPumping) {
+            ::wxMilliSleep(1);
+        }
+    }
+
+    if (hasShownProgress) {
+        wxFprintf(stderr, wxT("\n"));
+    }
+    return isComplete;
+}
+
+//============================================================================/
+
+uint Gw2BrowserCli::findFileNum(const wxString& p_fileId) const
+{
+    unsigned long id;
+    if (!p_fileId.ToULong(&id)) { return std::numeric_limits<uint>::max(); }
+
+    // File IDs first, base IDs are what the files are named after
+    auto entryNum = m_datFile.entryNumFromFileId(id);
+    if (entryNum == std::numeric_limits<uint>::max()) {
+        entryNum = m_datFile.entryNumFromBaseId(id);
+    }
+    if (entryNum == std::numeric_limits<uint>::max() || entryNum < m_datFile.mftFileOffset()) {
+        return std::numeric_limits<uint>::max();
+    }
+    return entryNum - m_datFile.mftFileOffset();
+}
+
+//============================================================================/
+
+bool Gw2BrowserCli::isEntryIncluded(const DatIndexEntry& p_entry) const
+{
+    if (m_category.IsEmpty()) { return true; }
+
+    auto path = categoryPath(*p_entry.category());
+    return path == m_category || path.StartsWith(m_category + wxT("/"));
+}
+
+//============================================================================/
+
+wxString Gw2BrowserCli::categoryPath(const DatIndexCategory& p_category)
+{
+    auto parent = p_category.parent();
+    if (!parent) { return p_category.name(); }
+    return categoryPath(*parent) + wxT("/") + p_category.name();
+}
+
+//============================================================================/
+
+bool Gw2BrowserCli::writeToStdout(const Array<byte>& p_data)
+{
+#ifdef __WXMSW__
+    // Don't let the CRT mangle line endings in binary data
+    ::_setmode(::_fileno(stdout), _O_BINARY);
+#endif
+    auto written = ::fwrite(p_data.GetPointer(), 1, p_data.GetSize(), stdout);
+    ::fflush(stdout);
+    return (written == p_data.GetSize());
+}
+
+//============================================================================/
+
+}; // namespace gw2b
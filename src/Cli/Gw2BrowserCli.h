@@ -0,0 +1,102 @@
+/** \file       Gw2BrowserCli.h
+ *  \brief      Contains declaration of the command line application class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef CLI_GW2BROWSERCLI_H_INCLUDED
+#define CLI_GW2BROWSERCLI_H_INCLUDED
+
+#include <wx/cmdline.h>
+
+#include "DatFile.h"
+#include "DatIndexLoader.h"
+#include "FileExtractor.h"
+
+namespace gw2b
+{
+class DatIndex;
+class DatIndexCategory;
+class DatIndexEntry;
+class Task;
+class TaskScheduler;
+
+/** Represents the headless Gw2Browser application. Opens the .dat and its
+ *  index the same way the browser does, but is driven entirely by its
+ *  command line so jobs can be run unattended. */
+class Gw2BrowserCli : public wxAppConsole
+{
+    DatFile                     m_datFile;
+    std::shared_ptr<DatIndex>   m_index;
+    DatIndexLoader              m_indexLoader;
+    wxString                    m_command;
+    wxString                    m_datPath;
+    wxArrayString               m_args;
+    wxString                    m_indexPath;
+    wxString                    m_category;
+    wxString                    m_profilePath;
+    bool                        m_convert;
+    bool                        m_rebuild;
+public:
+    /** Constructor. */
+    Gw2BrowserCli();
+
+    /** Describes the accepted command line to the given parser.
+     *  \param[in]  p_parser     Parser to describe the command line to. */
+    virtual void OnInitCmdLine(wxCmdLineParser& p_parser) override;
+    /** Takes the options out of the parsed command line.
+     *  \param[in]  p_parser     Parser holding the command line.
+     *  \return bool    true if the command line was valid, false if not. */
+    virtual bool OnCmdLineParsed(wxCmdLineParser& p_parser) override;
+    /** Initializes the application.
+     *  \return bool    True if initialization was successful, false if not. */
+    virtual bool OnInit() override;
+    /** Runs the command given on the command line.
+     *  \return int     Exit code of the application. */
+    virtual int OnRun() override;
+    /** Cleans up the application before it exits.
+     *  \return int     Exit code of the application. */
+    virtual int OnExit() override;
+private:
+    // Commands
+    int runIndex();
+    int runList();
+    int runStat();
+    int runCat();
+    int runExtract();
+    int runConvert();
+
+    // Index
+    bool openDat();
+    bool loadIndex();
+    bool performTask(TaskScheduler& p_scheduler, Task* p_task);
+
+    // Helpers
+    uint findFileNum(const wxString& p_fileId) const;
+    bool isEntryIncluded(const DatIndexEntry& p_entry) const;
+    static wxString categoryPath(const DatIndexCategory& p_category);
+    static bool writeToStdout(const Array<byte>& p_data);
+}; // class Gw2BrowserCli
+
+}; // namespace gw2b
+
+#endif // CLI_GW2BROWSERCLI_H_INCLUDED
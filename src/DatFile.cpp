@@ -22,8 +22,14 @@
 */
 
 #include "stdafx.h"
+#include <algorithm>
+#include <vector>
+#include <wx/thread.h>
+
 #include "DatFile.h"
+#include "DatInflater.h"
 #include "FileReader.h"
+#include "Util/Profiler.h"
 
 namespace gw2b
 {
@@ -63,18 +69,26 @@ enum FourCC
 };
 
 DatFile::DatFile()
-    : m_lastReadEntry(-1)
+    : m_hasIdTables(false)
+    , m_isIdTableValid(false)
+    , m_cache(CACHE_DEFAULT_BUDGET)
+    , m_readPool(nullptr)
+    , m_asyncReader(nullptr)
 {
     ::memset(&m_datHead, 0, sizeof(m_datHead));
     ::memset(&m_mftHead, 0, sizeof(m_mftHead));
 }
 
-DatFile::DatFile(const wxString& p_filename)
-    : m_lastReadEntry(-1)
+DatFile::DatFile(const wxString& p_filename, OpenMode p_mode, TableMode p_tableMode)
+    : m_hasIdTables(false)
+    , m_isIdTableValid(false)
+    , m_cache(CACHE_DEFAULT_BUDGET)
+    , m_readPool(nullptr)
+    , m_asyncReader(nullptr)
 {
     ::memset(&m_datHead, 0, sizeof(m_datHead));
     ::memset(&m_mftHead, 0, sizeof(m_mftHead));
-    this->open(p_filename);
+    this->open(p_filename, p_mode, p_tableMode);
 }
 
 DatFile::~DatFile()
@@ -82,40 +96,156 @@ DatFile::~DatFile()
     this->close();
 }
 
-bool DatFile::open(const wxString& p_filename)
+bool DatFile::open(const wxString& p_filename, OpenMode p_mode, TableMode p_tableMode)
 {
     this->close();
 
     while (true) {
         // Open file
-        m_file.Open(p_filename);
-        if (!m_file.IsOpened()) { break; }
+        if (!m_file.open(p_filename)) { break; }
+        auto fileSize = m_file.length();
+
+        // Map the file if asked to. Failing to do so is not fatal, since
+        // entries can still be read through m_file.
+        if (p_mode == OM_Mapped) {
+            m_mapping.open(p_filename);
+            if (m_mapping.size() != fileSize) { m_mapping.close(); }
+        }
 
         // Read header
-        if (m_file.Length() < sizeof(m_datHead)) { break; }
-        m_file.Read(&m_datHead, sizeof(m_datHead));
+        if (fileSize < sizeof(m_datHead)) { break; }
+        m_file.readAt(0, &m_datHead, sizeof(m_datHead));
 
         // Read MFT Header
-        if (static_cast<uint64>(m_file.Length()) < m_datHead.mftOffset + m_datHead.mftSize) { break; }
-        m_file.Seek(m_datHead.mftOffset, wxFromStart);
-        m_file.Read(&m_mftHead, sizeof(m_mftHead));
+        if (fileSize < m_datHead.mftOffset + m_datHead.mftSize) { break; }
+        m_file.readAt(m_datHead.mftOffset, &m_mftHead, sizeof(m_mftHead));
 
-        // Read all of the MFT
+        // Read all of the MFT, unless it's to be loaded as it's used
         if (m_datHead.mftSize != m_mftHead.numEntries * sizeof(ANetMftEntry)) { break; }
         if (m_datHead.mftSize % sizeof(ANetMftEntry)) { break; }
+        if (m_mftHead.numEntries < MFT_FILE_OFFSET) { break; }
+
+        // No uncompressed sizes are known yet. When lazy, they are filled in
+        // along with each page of the MFT, so that untouched pages are never
+        // written to.
+        m_mftEntries.SetSize(m_mftHead.numEntries);
+        m_mftPagesLoaded.SetSize((m_mftHead.numEntries + MFT_PAGE_ENTRIES - 1) / MFT_PAGE_ENTRIES);
+        m_entrySizes.SetSize(m_mftHead.numEntries);
+
+        if (p_tableMode == TM_Eager) {
+            if (m_file.readAt(m_datHead.mftOffset, m_mftEntries.GetPointer(), m_datHead.mftSize) != m_datHead.mftSize) { break; }
+            ::memset(m_mftPagesLoaded.GetPointer(), 1, m_mftPagesLoaded.GetByteSize());
+            ::memset(m_entrySizes.GetPointer(), 0xff, m_entrySizes.GetByteSize());
+        } else {
+            ::memset(m_mftPagesLoaded.GetPointer(), 0, m_mftPagesLoaded.GetByteSize());
+        }
+
+        // The ID tables need all of the file ID table, so when lazy they wait
+        // until someone looks up an ID
+        m_hasIdTables    = false;
+        m_isIdTableValid = false;
+        if (p_tableMode == TM_Eager && !this->buildIdTables(false)) { break; }
+
+        // Success!
+        return true;
+    }
+
+    this->close();
+    return false;
+}
+
+bool DatFile::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+void DatFile::close()
+{
+    // Pending reads need the file, so get rid of them first
+    this->cancelAsyncReads();
+    this->waitForAsyncReads();
+    deletePointer(m_asyncReader);
+    deletePointer(m_readPool);
+
+    // Clear input buffer and lookup tables
+    m_inputBuffer.Clear();
+    m_cache.clear();
+    m_entryToId.Clear();
+    m_entrySizes.Clear();
+    m_fileIdToEntry.clear();
+    m_baseIdToEntry.clear();
+    m_hasIdTables = false;
+
+    // Clear PODs
+    ::memset(&m_datHead, 0, sizeof(m_datHead));
+    ::memset(&m_mftHead, 0, sizeof(m_mftHead));
+
+    // Remove MFT entries and close the file
+    m_mftEntries.Clear();
+    m_mftPagesLoaded.Clear();
+    m_mapping.close();
+    m_file.close();
+}
+
+const ANetMftEntry& DatFile::mftEntry(uint p_entryNum) const
+{
+    uint page = p_entryNum / MFT_PAGE_ENTRIES;
+    if (!loadAcquire(m_mftPagesLoaded[page])) {
+        this->loadMftPage(page);
+    }
+    return m_mftEntries[p_entryNum];
+}
 
-        m_mftEntries.SetSize(m_datHead.mftSize / sizeof(ANetMftEntry));
-        m_file.Seek(m_datHead.mftOffset, wxFromStart);
-        m_file.Read(m_mftEntries.GetPointer(), m_datHead.mftSize);
+void DatFile::loadMftPage(uint p_page) const
+{
+    wxCriticalSectionLocker locker(m_mftLock);
+    if (m_mftPagesLoaded[p_page]) { return; }
+
+    uint   firstEntry = p_page * MFT_PAGE_ENTRIES;
+    uint   numEntries = wxMin(static_cast<uint>(MFT_PAGE_ENTRIES), m_mftHead.numEntries - firstEntry);
+    uint64 offset     = m_datHead.mftOffset + static_cast<uint64>(firstEntry) * sizeof(ANetMftEntry);
+    uint   size       = numEntries * sizeof(ANetMftEntry);
+    auto   entries    = m_mftEntries.GetPointer() + firstEntry;
+
+    // Entries that can't be read are left unused, so they are never read from
+    if (this->isMapped()) {
+        ::memcpy(entries, m_mapping.data() + offset, size);
+    } else if (m_file.readAt(offset, entries, size) != size) {
+        ::memset(entries, 0, size);
+    }
+    ::memset(m_entrySizes.GetPointer() + firstEntry, 0xff, numEntries * sizeof(uint32));
 
+    // Readers check the flag without taking the lock, so the entries have
+    // to be in place before it is seen
+    storeRelease(m_mftPagesLoaded[p_page], static_cast<byte>(1));
+}
+
+bool DatFile::buildIdTables(bool p_isLazy) const
+{
+    wxCriticalSectionLocker locker(m_idTableLock);
+    if (m_hasIdTables) { return m_isIdTableValid; }
+
+    // Whether it works out or not, there's no point in trying again
+    bool success = false;
+    auto& tableEntry = this->mftEntry(2);
+
+    while (true) {
         // Read the file id entry table
-        if (static_cast<uint64>(m_file.Length()) < m_mftEntries[2].offset + m_mftEntries[2].size) { break; }
-        if (m_mftEntries[2].size % sizeof(ANetFileIdEntry)) { break; }
+        if (m_file.length() < tableEntry.offset + tableEntry.size) { break; }
+        if (tableEntry.size % sizeof(ANetFileIdEntry)) { break; }
 
-        uint numFileIdEntries = m_mftEntries[2].size / sizeof(ANetFileIdEntry);
-        Array<ANetFileIdEntry> fileIdTable(numFileIdEntries);
-        m_file.Seek(m_mftEntries[2].offset, wxFromStart);
-        m_file.Read(fileIdTable.GetPointer(), m_mftEntries[2].size);
+        // A mapped table can be used right where it is
+        uint numFileIdEntries = tableEntry.size / sizeof(ANetFileIdEntry);
+        Array<ANetFileIdEntry> readTable;
+        const ANetFileIdEntry* fileIdTable;
+
+        if (this->isMapped()) {
+            fileIdTable = reinterpret_cast<const ANetFileIdEntry*>(m_mapping.data() + tableEntry.offset);
+        } else {
+            readTable.SetSize(numFileIdEntries);
+            if (m_file.readAt(tableEntry.offset, readTable.GetPointer(), tableEntry.size) != tableEntry.size) { break; }
+            fileIdTable = readTable.GetPointer();
+        }
 
         // Extract the entry -> base/file ID tables
         m_entryToId.SetSize(m_mftEntries.GetSize());
@@ -127,6 +257,7 @@ bool DatFile::open(const wxString& p_filename)
             }
 
             uint entryIndex = fileIdTable[i].mftEntryIndex;
+            if (entryIndex >= m_entryToId.GetSize()) { continue; }
             auto& entry     = m_entryToId[entryIndex];
 
             if (entry.baseId == 0) {
@@ -142,71 +273,100 @@ bool DatFile::open(const wxString& p_filename)
             }
         }
 
-        // Success!
-        return true;
-    }
-
-    this->close();
-    return false;
-}
+        // Build the reverse lookup tables. Entries are added in order, so
+        // that the lowest entry number wins if an ID occurs more than once.
+        m_fileIdToEntry.reset(m_entryToId.GetSize());
+        m_baseIdToEntry.reset(m_entryToId.GetSize());
 
-bool DatFile::isOpen() const
-{
-    return m_file.IsOpened();
-}
+        for (uint i = 0; i < m_entryToId.GetSize(); i++) {
+            auto& entry = m_entryToId[i];
+            m_fileIdToEntry.insert(entry.fileId == 0 ? entry.baseId : entry.fileId, i);
+            m_baseIdToEntry.insert(entry.baseId, i);
+        }
 
-void DatFile::close()
-{
-    // Clear input buffer and lookup tables
-    m_inputBuffer.Clear();
-    m_entryToId.Clear();
+        success = true;
+        break;
+    }
 
-    // Clear PODs
-    ::memset(&m_datHead, 0, sizeof(m_datHead));
-    ::memset(&m_mftHead, 0, sizeof(m_mftHead));
+    // Eager failures fail the open. Lazy ones happen behind the back of
+    // whoever looked up an ID, so let the user know why lookups fail.
+    if (!success && p_isLazy) {
+        wxLogWarning(wxT("Failed to read the file ID table. Files cannot be looked up by ID."));
+    }
 
-    // Remove MFT entries and close the file
-    m_mftEntries.Clear();
-    m_file.Close();
+    m_isIdTableValid = success;
+    storeRelease(m_hasIdTables, true);
+    return success;
 }
 
-uint DatFile::entrySize(uint p_entryNum)
+uint DatFile::entrySize(uint p_entryNum) const
 {
     if (!isOpen()) { return std::numeric_limits<uint>::max(); }
     if (p_entryNum >= m_mftEntries.GetSize()) { return std::numeric_limits<uint>::max(); }
     
-    auto& entry = m_mftEntries[p_entryNum];
+    auto& entry = this->mftEntry(p_entryNum);
 
-    // If the entry is compressed we need to read the uncompressed size from the .dat
+    // If the entry is compressed we need to read the uncompressed size from the .dat,
+    // unless it is already known
     if (entry.compressionFlag & ANCF_Compressed) {
-        uint32 uncompressedSize = 0;
-        m_file.Seek(entry.offset + 4, wxFromStart);
-        m_file.Read(&uncompressedSize, sizeof(uncompressedSize));
+        // Other threads may be filling in sizes at the same time
+        uint32 uncompressedSize = loadAcquire(m_entrySizes[p_entryNum]);
+        if (uncompressedSize != std::numeric_limits<uint32>::max()) {
+            return uncompressedSize;
+        }
+
+        if (this->isMapped()) {
+            if (m_mapping.size() < entry.offset + 8) { return std::numeric_limits<uint>::max(); }
+            ::memcpy(&uncompressedSize, m_mapping.data() + entry.offset + 4, sizeof(uncompressedSize));
+        } else if (m_file.readAt(entry.offset + 4, &uncompressedSize, sizeof(uncompressedSize)) < sizeof(uncompressedSize)) {
+            return std::numeric_limits<uint>::max();
+        }
+
+        storeRelease(m_entrySizes[p_entryNum], uncompressedSize);
         return uncompressedSize;
     } 
         
     return entry.size;
 }
 
-uint DatFile::fileSize(uint p_fileNum) {
+uint DatFile::fileSize(uint p_fileNum) const
+{
     return this->entrySize(p_fileNum + MFT_FILE_OFFSET);
 }
 
+uint64 DatFile::entryOffset(uint p_entryNum) const
+{
+    if (p_entryNum >= m_mftEntries.GetSize()) { return std::numeric_limits<uint64>::max(); }
+    return this->mftEntry(p_entryNum).offset;
+}
+
+bool DatFile::entryRecord(uint p_entryNum, ANetMftEntry& po_record) const
+{
+    if (p_entryNum >= m_mftEntries.GetSize()) { return false; }
+    po_record = this->mftEntry(p_entryNum);
+    return true;
+}
+
+void DatFile::setEntrySize(uint p_entryNum, uint p_size)
+{
+    if (p_entryNum >= m_entrySizes.GetSize()) { return; }
+
+    // Loading the entry's page later on would wipe the size out
+    this->mftEntry(p_entryNum);
+
+    // Readers on other threads look at the sizes without taking a lock
+    storeRelease(m_entrySizes[p_entryNum], static_cast<uint32>(p_size));
+}
+
 uint DatFile::entryNumFromFileId(uint p_fileId) const
 {
-    if (!isOpen()) { return std::numeric_limits<uint>::max(); }
-    for (uint i = 0; i < m_entryToId.GetSize(); i++) {
-        uint fileId = (m_entryToId[i].fileId == 0 ? m_entryToId[i].baseId : m_entryToId[i].fileId);
-        if (fileId == p_fileId) {
-            return i;
-        }
-    }
-    return std::numeric_limits<uint>::max();
+    if (!isOpen() || !this->ensureIdTables()) { return std::numeric_limits<uint>::max(); }
+    return m_fileIdToEntry.find(p_fileId);
 }
 
 uint DatFile::fileIdFromEntryNum(uint p_entryNum) const
 {
-    if (!isOpen()) { return std::numeric_limits<uint>::max(); }
+    if (!isOpen() || !this->ensureIdTables()) { return std::numeric_limits<uint>::max(); }
     if (p_entryNum >= m_entryToId.GetSize()) { return std::numeric_limits<uint>::max(); }
     return (m_entryToId[p_entryNum].fileId == 0 ? m_entryToId[p_entryNum].baseId : m_entryToId[p_entryNum].fileId);
 }
@@ -218,18 +378,13 @@ uint DatFile::fileIdFromFileNum(uint p_fileNum) const
 
 uint DatFile::entryNumFromBaseId(uint p_baseId) const
 {
-    if (!isOpen()) { return std::numeric_limits<uint>::max(); }
-    for (uint i = 0; i < m_entryToId.GetSize(); i++) {
-        if (m_entryToId[i].baseId == p_baseId) {
-            return i;
-        }
-    }
-    return std::numeric_limits<uint>::max();
+    if (!isOpen() || !this->ensureIdTables()) { return std::numeric_limits<uint>::max(); }
+    return m_baseIdToEntry.find(p_baseId);
 }
 
 uint DatFile::baseIdFromEntryNum(uint p_entryNum) const
 {
-    if (!isOpen()) { return std::numeric_limits<uint>::max(); }
+    if (!isOpen() || !this->ensureIdTables()) { return std::numeric_limits<uint>::max(); }
     if (p_entryNum >= m_entryToId.GetSize()) { return std::numeric_limits<uint>::max(); }
     return m_entryToId[p_entryNum].baseId;
 }
@@ -239,6 +394,82 @@ uint DatFile::baseIdFromFileNum(uint p_fileNum) const
     return this->baseIdFromEntryNum(p_fileNum + MFT_FILE_OFFSET);
 }
 
+bool DatFile::viewFile(uint p_fileNum, EntryView& po_view) const
+{
+    return this->viewEntry(p_fileNum + MFT_FILE_OFFSET, po_view);
+}
+
+bool DatFile::viewEntry(uint p_entryNum, EntryView& po_view) const
+{
+    if (!this->isMapped()) { return false; }
+    if (!this->isEntryReadable(p_entryNum)) { return false; }
+
+    auto& entry = this->mftEntry(p_entryNum);
+    po_view.data         = m_mapping.data() + entry.offset;
+    po_view.size         = entry.size;
+    po_view.isCompressed = (entry.compressionFlag != 0);
+    return true;
+}
+
+bool DatFile::isEntryReadable(uint p_entryNum) const
+{
+    auto entryIsInRange = m_mftHead.numEntries > (uint)p_entryNum;
+    if (!entryIsInRange) { return false; }
+
+    auto& entry            = this->mftEntry(p_entryNum);
+    auto entryIsInUse      = (entry.entryFlags & ANMEF_InUse);
+    auto fileIsLargeEnough = m_file.length() >= entry.offset + entry.size;
+    return entryIsInUse && fileIsLargeEnough;
+}
+
+bool DatFile::readEntryInput(uint p_entryNum, uint p_offset, uint p_size, Array<byte>& p_scratch) const
+{
+    auto& entry = this->mftEntry(p_entryNum);
+
+    // Make sure we can re-use the scratch buffer. Growing it keeps whatever
+    // was read before p_offset.
+    if (p_scratch.GetSize() < p_offset + p_size) {
+        p_scratch.SetSize(p_offset + p_size);
+    }
+
+    ScopedTimer timer("DatFile::read");
+    Profiler::addCount("DatFile.bytesRead", p_size);
+    return m_file.readAt(entry.offset + p_offset, p_scratch.GetPointer() + p_offset, p_size) == p_size;
+}
+
+uint DatFile::inflateEntryInput(uint p_entryNum, const byte* p_input, uint p_inputSize, uint p_peekSize, byte* po_buffer, const CancellationToken& p_cancellation) const
+{
+    auto& entry = this->mftEntry(p_entryNum);
+
+    // If the file is compressed we need to uncompress it
+    if (entry.compressionFlag) {
+        ScopedTimer timer("DatFile::inflate");
+
+        // The uncompressed size is stored right after the first dword, so
+        // remember it while we have the data at hand
+        uint uncompressedSize = DatInflater::uncompressedSize(p_input, p_inputSize);
+        if (uncompressedSize != std::numeric_limits<uint>::max()) {
+            storeRelease(m_entrySizes[p_entryNum], uncompressedSize);
+        }
+
+        // Peeks and streamed reads may only pass the start of the entry
+        bool isPartial  = p_inputSize < entry.size;
+        uint outputSize = p_peekSize;
+
+        DatInflater inflater;
+        auto result = inflater.inflate(p_input, p_inputSize, isPartial, po_buffer, outputSize, p_cancellation);
+
+        if (result != DatInflater::IR_Success) { return 0; }
+        Profiler::addCount("DatFile.bytesInflated", outputSize);
+        Profiler::addSample("DatFile.inflatedSize", outputSize);
+        return outputSize;
+    } else {
+        uint size = wxMin(p_peekSize, p_inputSize);
+        ::memcpy(po_buffer, p_input, size);
+        return size;
+    }
+}
+
 uint DatFile::peekFile(uint p_fileNum, uint p_peekSize, byte* po_Buffer)
 {
     return this->peekEntry(p_fileNum + MFT_FILE_OFFSET, p_peekSize, po_Buffer);
@@ -246,53 +477,74 @@ uint DatFile::peekFile(uint p_fileNum, uint p_peekSize, byte* po_Buffer)
 
 uint DatFile::peekEntry(uint p_entryNum, uint p_peekSize, byte* po_Buffer)
 {
-    Ensure::notNull(po_Buffer);
-    uint inputSize;
+    return this->peekEntry(p_entryNum, p_peekSize, po_Buffer, m_inputBuffer);
+}
+
+uint DatFile::peekFile(uint p_fileNum, uint p_peekSize, byte* po_buffer, Array<byte>& p_scratch) const
+{
+    return this->peekEntry(p_fileNum + MFT_FILE_OFFSET, p_peekSize, po_buffer, p_scratch);
+}
+
+uint DatFile::peekEntry(uint p_entryNum, uint p_peekSize, byte* po_buffer, Array<byte>& p_scratch) const
+{
+    Ensure::notNull(po_buffer);
 
     // Return instantly if size is 0, or if the file isn't open
     if (p_peekSize == 0 || !this->isOpen()) {
         return 0;
     }
 
-    // If this was the last entry we read, there's no need to re-read it. The
-    // input buffer should already contain the full file.
-    if (m_lastReadEntry != p_entryNum) {
-        // Perform some checks
-        auto entryIsInRange = m_mftHead.numEntries > (uint)p_entryNum;
-        if (!entryIsInRange) { return 0; }
-
-        auto entryIsInUse      = (m_mftEntries[p_entryNum].entryFlags & ANMEF_InUse);
-        auto fileIsLargeEnough = (uint64)m_file.Length() >= m_mftEntries[p_entryNum].offset + m_mftEntries[p_entryNum].size;
-        if (!entryIsInUse || !fileIsLargeEnough) { return 0; }
-
-        // Make sure we can re-use the input buffer
-        inputSize = m_mftEntries[p_entryNum].size;
-        if (m_inputBuffer.GetSize() < inputSize) {
-            m_inputBuffer.SetSize(inputSize);
-        }
+    // Recently read entries need no reading or inflating
+    uint cachedSize = m_cache.peek(p_entryNum, p_peekSize, po_buffer);
+    if (cachedSize) { return cachedSize; }
 
-        // Read the file data
-        m_file.Seek(m_mftEntries[p_entryNum].offset, wxFromStart);
-        m_file.Read(m_inputBuffer.GetPointer(), inputSize);
-        m_lastReadEntry = p_entryNum;
-    } else {
-        inputSize = m_mftEntries[p_entryNum].size;
+    return this->peekEntryUncached(p_entryNum, p_peekSize, po_buffer, p_scratch);
+}
+
+uint DatFile::peekEntryUncached(uint p_entryNum, uint p_peekSize, byte* po_buffer, Array<byte>& p_scratch, const CancellationToken& p_cancellation) const
+{
+    if (!this->isEntryReadable(p_entryNum)) { return 0; }
+    if (p_cancellation.isCancelled()) { return 0; }
+    auto& entry = this->mftEntry(p_entryNum);
+
+    // Mapped files need no reading at all, and only the pages the inflater
+    // touches are ever loaded
+    if (this->isMapped()) {
+        return this->inflateEntryInput(p_entryNum, m_mapping.data() + entry.offset, entry.size, p_peekSize, po_buffer, p_cancellation);
     }
 
-    // If the file is compressed we need to uncompress it
-    if (m_mftEntries[p_entryNum].compressionFlag) {
-        uint32 outputSize = p_peekSize;
-        try {
-            gw2dt::compression::inflateDatFileBuffer(inputSize, m_inputBuffer.GetPointer(), outputSize, po_Buffer);
-            return outputSize;
-        } catch (std::exception&) {
-            return 0;
-        }
-    } else {
-        uint size = wxMin(p_peekSize, inputSize);
-        ::memcpy(po_Buffer, m_inputBuffer.GetPointer(), size);
-        return size;
+    // Uncompressed entries can be read straight into the output
+    if (!entry.compressionFlag) {
+        uint size = wxMin(p_peekSize, entry.size);
+        ScopedTimer timer("DatFile::read");
+        Profiler::addCount("DatFile.bytesRead", size);
+        return m_file.readAt(entry.offset, po_buffer, size);
+    }
+
+    // If the whole entry is wanted, there's no point in reading it piece by
+    // piece
+    uint chunkSize = PEEK_CHUNK_SIZE;
+    if (loadAcquire(m_entrySizes[p_entryNum]) <= p_peekSize) {
+        chunkSize = entry.size;
+    }
+
+    // Read the compressed data in growing chunks, until there is enough of it
+    // to inflate the requested amount of bytes
+    uint inputSize = 0;
+    while (inputSize < entry.size) {
+        if (p_cancellation.isCancelled()) { return 0; }
+
+        uint readSize = wxMin(chunkSize, entry.size - inputSize);
+        if (!this->readEntryInput(p_entryNum, inputSize, readSize, p_scratch)) { return 0; }
+        inputSize += readSize;
+
+        uint outputSize = this->inflateEntryInput(p_entryNum, p_scratch.GetPointer(), inputSize, p_peekSize, po_buffer, p_cancellation);
+        if (outputSize) { return outputSize; }
+
+        chunkSize = inputSize;
     }
+
+    return 0;
 }
 
 Array<byte> DatFile::peekFile(uint p_fileNum, uint p_peekSize)
@@ -335,14 +587,33 @@ Array<byte> DatFile::readFile(uint p_fileNum)
 
 Array<byte> DatFile::readEntry(uint p_entryNum)
 {
-    uint size = this->entrySize(p_entryNum);
+    return this->readEntry(p_entryNum, m_inputBuffer);
+}
+
+Array<byte> DatFile::readFile(uint p_fileNum, Array<byte>& p_scratch, const CancellationToken& p_cancellation) const
+{
+    return this->readEntry(p_fileNum + MFT_FILE_OFFSET, p_scratch, p_cancellation);
+}
+
+Array<byte> DatFile::readEntry(uint p_entryNum, Array<byte>& p_scratch, const CancellationToken& p_cancellation) const
+{
     Array<byte> output;
+    if (!this->isOpen()) { return output; }
 
-    if (size != std::numeric_limits<uint>::max()) {
+    // Recently read entries need no reading or inflating
+    if (m_cache.get(p_entryNum, output)) {
+        Profiler::addCount("DatFile.cacheHits");
+        return output;
+    }
+    Profiler::addCount("DatFile.cacheMisses");
+
+    uint size = this->entrySize(p_entryNum);
+    if (size != std::numeric_limits<uint>::max() && size > 0) {
         output.SetSize(size);
-        uint readBytes = this->peekEntry(p_entryNum, size, output.GetPointer());
+        uint readBytes = this->peekEntryUncached(p_entryNum, size, output.GetPointer(), p_scratch, p_cancellation);
 
         if (readBytes > 0) {
+            m_cache.add(p_entryNum, output);
             return output;
         }
     }
@@ -350,7 +621,224 @@ Array<byte> DatFile::readEntry(uint p_entryNum)
     return Array<byte>();
 }
 
-DatFile::IdentificationResult DatFile::identifyFileType(const byte* p_data, uint p_size, ANetFileType& po_fileType)
+bool DatFile::readRawEntry(uint p_entryNum, uint p_maxSize, Array<byte>& po_data) const
+{
+    if (!this->isOpen() || !this->isEntryReadable(p_entryNum)) { return false; }
+    auto& entry = this->mftEntry(p_entryNum);
+
+    uint size = entry.size;
+    if (p_maxSize) { size = wxMin(size, p_maxSize); }
+    po_data.SetSize(size);
+
+    ScopedTimer timer("DatFile::read");
+    Profiler::addCount("DatFile.bytesRead", size);
+    if (this->isMapped()) {
+        ::memcpy(po_data.GetPointer(), m_mapping.data() + entry.offset, size);
+        return true;
+    }
+    return m_file.readAt(entry.offset, po_data.GetPointer(), size) == size;
+}
+
+void DatFile::readRawEntries(const uint* p_entryNums, uint p_count, uint p_maxSize, Array<byte>* po_data, Array<byte>& p_scratch) const
+{
+    // Mapped files have nothing to gain from batching
+    if (this->isMapped()) {
+        for (uint i = 0; i < p_count; i++) {
+            if (!this->readRawEntry(p_entryNums[i], p_maxSize, po_data[i])) {
+                po_data[i] = Array<byte>();
+            }
+        }
+        return;
+    }
+
+    // Go through the entries in the order they are stored, so that
+    // neighbours end up in the same run. Unreadable entries are just left
+    // empty.
+    std::vector<uint> order;
+    order.reserve(p_count);
+    for (uint i = 0; i < p_count; i++) {
+        po_data[i] = Array<byte>();
+        if (this->isOpen() && this->isEntryReadable(p_entryNums[i])) {
+            order.push_back(i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [this, p_entryNums](uint p_a, uint p_b) {
+        return this->mftEntry(p_entryNums[p_a]).offset < this->mftEntry(p_entryNums[p_b]).offset;
+    });
+
+    uint first = 0;
+    while (first < order.size()) {
+        // Grow the run for as long as the next entry is close enough to the
+        // end of the previous one, and the run isn't too large
+        auto& start     = this->mftEntry(p_entryNums[order[first]]);
+        uint64 runStart = start.offset;
+        uint64 runEnd   = runStart + (p_maxSize ? wxMin(start.size, p_maxSize) : start.size);
+        uint last       = first + 1;
+
+        while (last < order.size()) {
+            auto& next = this->mftEntry(p_entryNums[order[last]]);
+            uint size  = (p_maxSize ? wxMin(next.size, p_maxSize) : next.size);
+            if (next.offset > runEnd + BATCH_MAX_GAP) { break; }
+            if (next.offset + size - runStart > BATCH_MAX_SIZE) { break; }
+            runEnd = wxMax(runEnd, next.offset + size);
+            last++;
+        }
+
+        // Fetch the whole run at once
+        uint runSize = static_cast<uint>(runEnd - runStart);
+        if (p_scratch.GetSize() < runSize) {
+            p_scratch.SetSize(runSize);
+        }
+
+        bool isRead;
+        {
+            ScopedTimer timer("DatFile::read");
+            Profiler::addCount("DatFile.bytesRead", runSize);
+            isRead = (m_file.readAt(runStart, p_scratch.GetPointer(), runSize) == runSize);
+        }
+
+        // Hand out each entry's part of it
+        for (uint i = first; isRead && i < last; i++) {
+            auto& entry = this->mftEntry(p_entryNums[order[i]]);
+            uint size   = (p_maxSize ? wxMin(entry.size, p_maxSize) : entry.size);
+            auto& data  = po_data[order[i]];
+            data = Array<byte>(size);
+            ::memcpy(data.GetPointer(), p_scratch.GetPointer() + (entry.offset - runStart), size);
+        }
+        first = last;
+    }
+}
+
+Array<byte> DatFile::inflateRawEntry(uint p_entryNum, const Array<byte>& p_input, uint p_peekSize, const CancellationToken& p_cancellation) const
+{
+    Array<byte> output;
+    if (!this->isOpen() || p_entryNum >= m_mftEntries.GetSize()) { return output; }
+    auto& entry = this->mftEntry(p_entryNum);
+
+    // Figure out how much there is to inflate
+    uint size = p_input.GetSize();
+    if (entry.compressionFlag) {
+        if (p_input.GetSize() < 8) { return output; }
+        ::memcpy(&size, p_input.GetPointer() + 4, sizeof(size));
+    }
+    if (p_peekSize) { size = wxMin(size, p_peekSize); }
+    if (!size) { return output; }
+
+    output.SetSize(size);
+    size = this->inflateEntryInput(p_entryNum, p_input.GetPointer(), p_input.GetSize(), size, output.GetPointer(), p_cancellation);
+    if (!size) { return Array<byte>(); }
+
+    output.SetSize(size);
+    return output;
+}
+
+void DatFile::readFileAsync(uint p_fileNum, const ReadCompleteHandler& p_handler) const
+{
+    this->readEntryAsync(p_fileNum + MFT_FILE_OFFSET, [p_handler](uint p_entryNum, const Array<byte>& p_data) {
+        p_handler(p_entryNum - MFT_FILE_OFFSET, p_data);
+    });
+}
+
+void DatFile::readEntryAsync(uint p_entryNum, const ReadCompleteHandler& p_handler) const
+{
+    // The pool and reader are only started once they're needed
+    AsyncFileReader* reader;
+    {
+        wxCriticalSectionLocker lock(m_readPoolLock);
+        if (!m_readPool) {
+            m_readPool = new ThreadPool(ASYNC_READ_THREADS);
+        }
+        if (!m_asyncReader && !this->isMapped()) {
+            m_asyncReader = new AsyncFileReader(m_file, ASYNC_READ_DEPTH);
+        }
+        reader = m_asyncReader;
+    }
+
+    // Mapped files have no I/O to overlap, so those are read on the pool
+    // along with everything the reader can't handle
+    if (!reader || !reader->isAvailable() || !this->isOpen() || !this->isEntryReadable(p_entryNum) || !this->mftEntry(p_entryNum).size) {
+        m_readPool->post([this, p_entryNum, p_handler]() {
+            Array<byte> scratch;
+            auto data = this->readEntry(p_entryNum, scratch);
+            p_handler(p_entryNum, data);
+        });
+        return;
+    }
+
+    // Array's reference count is not thread safe, so the buffers passed
+    // between threads are held through shared_ptr instead
+    auto cached = std::make_shared<Array<byte>>();
+    if (m_cache.get(p_entryNum, *cached)) {
+        Profiler::addCount("DatFile.cacheHits");
+        m_readPool->post([p_entryNum, p_handler, cached]() {
+            p_handler(p_entryNum, *cached);
+        });
+        return;
+    }
+    Profiler::addCount("DatFile.cacheMisses");
+
+    auto& entry = this->mftEntry(p_entryNum);
+    Profiler::addCount("DatFile.bytesRead", entry.size);
+
+    // Uncompressed entries are done as soon as they are read, but inflating
+    // is left to the pool, as the reader only has a single thread to
+    // complete reads on
+    uint size         = entry.size;
+    bool isCompressed = (entry.compressionFlag != 0);
+    reader->read(entry.offset, size, [this, p_entryNum, p_handler, size, isCompressed](byte* p_data, uint p_bytesRead) {
+        auto input = std::make_shared<Array<byte>>();
+        input->Wrap(p_data, p_bytesRead);
+
+        if (p_bytesRead == size && !isCompressed) {
+            m_cache.add(p_entryNum, *input);
+            p_handler(p_entryNum, *input);
+            return;
+        }
+
+        m_readPool->post([this, p_entryNum, p_handler, size, input]() {
+            Array<byte> data;
+            if (input->GetSize() == size) {
+                data = this->inflateRawEntry(p_entryNum, *input, 0);
+                if (data.GetSize()) { m_cache.add(p_entryNum, data); }
+            } else {
+                // Failed reads get a second chance the regular way
+                Array<byte> scratch;
+                data = this->readEntry(p_entryNum, scratch);
+            }
+            p_handler(p_entryNum, data);
+        });
+    });
+}
+
+void DatFile::waitForAsyncReads() const
+{
+    // Don't hold the lock while waiting, since handlers may queue more reads
+    ThreadPool* pool;
+    AsyncFileReader* reader;
+    {
+        wxCriticalSectionLocker lock(m_readPoolLock);
+        pool   = m_readPool;
+        reader = m_asyncReader;
+    }
+
+    // Completed reads are passed on to the pool, whose handlers may in turn
+    // queue more reads, so keep going until both are idle
+    do {
+        if (reader) { reader->wait(); }
+        if (pool) { pool->wait(); }
+    } while (reader && !reader->isIdle());
+}
+
+uint DatFile::cancelAsyncReads() const
+{
+    wxCriticalSectionLocker lock(m_readPoolLock);
+    uint numDropped = 0;
+    if (m_asyncReader) { numDropped += m_asyncReader->cancelPending(); }
+    if (m_readPool) { numDropped += m_readPool->cancelPending(); }
+    return numDropped;
+}
+
+DatFile::IdentificationResult DatFile::identifyFileType(const byte* p_data, uint p_size, ANetFileType& po_fileType) const
 {
     if (p_size < 4) { po_fileType = ANFT_Unknown; return IR_Failure; }
 
@@ -26,8 +26,16 @@
 #ifndef DATFILE_H_INCLUDED
 #define DATFILE_H_INCLUDED
 
-#include <wx/file.h>
+#include <functional>
+
 #include "ANetStructs.h"
+#include "EntryCache.h"
+#include "Util/AsyncFileReader.h"
+#include "Util/CancellationToken.h"
+#include "Util/FileMapping.h"
+#include "Util/IdTable.h"
+#include "Util/RandomAccessFile.h"
+#include "Util/ThreadPool.h"
 
 namespace gw2b
 {
@@ -45,16 +53,36 @@ private:
     typedef Array<ANetMftEntry> EntryArray;
     typedef Array<IdEntry>      EntryToIdArray;
     typedef Array<byte>         InputBufferArray;
+    typedef Array<uint32>       EntrySizeArray;
+    typedef Array<byte>         PageFlagArray;
 private:
-    wxFile              m_file;
+    RandomAccessFile    m_file;
+    FileMapping         m_mapping;
     ANetDatHeader       m_datHead;
     ANetMftHeader       m_mftHead;
-    EntryArray          m_mftEntries;
-    EntryToIdArray      m_entryToId;
+    mutable EntryArray  m_mftEntries;
+    mutable PageFlagArray   m_mftPagesLoaded;
+    mutable wxCriticalSection   m_mftLock;
+    mutable EntryToIdArray  m_entryToId;
+    mutable IdTable     m_fileIdToEntry;
+    mutable IdTable     m_baseIdToEntry;
+    mutable volatile bool   m_hasIdTables;
+    mutable bool        m_isIdTableValid;
+    mutable wxCriticalSection   m_idTableLock;
     InputBufferArray    m_inputBuffer;
-    uint                m_lastReadEntry;
+    mutable EntrySizeArray  m_entrySizes;
+    mutable EntryCache  m_cache;
+    mutable ThreadPool* m_readPool;
+    mutable AsyncFileReader*    m_asyncReader;
+    mutable wxCriticalSection   m_readPoolLock;
 private:
     enum { MFT_FILE_OFFSET = 16 };
+    enum { PEEK_CHUNK_SIZE = 0x1000 };
+    enum { MFT_PAGE_ENTRIES = 0x400 };
+    enum { CACHE_DEFAULT_BUDGET = 0x4000000 };
+    enum { ASYNC_READ_THREADS = 8 };
+    enum { ASYNC_READ_DEPTH = 64 };
+    enum { BATCH_MAX_GAP = 0x10000, BATCH_MAX_SIZE = 0x800000 };
 public:
     enum IdentificationResult 
     {
@@ -62,22 +90,54 @@ public:
         IR_NotEnoughData,
         IR_Failure,
     };
+    /** Determines how entry data is read from the .dat file. */
+    enum OpenMode
+    {
+        OM_Stream,          /**< Entries are read into an internal buffer. */
+        OM_Mapped,          /**< The .dat is memory mapped, falling back to OM_Stream if mapping fails. */
+    };
+    /** Determines when the MFT and file ID tables are loaded. */
+    enum TableMode
+    {
+        TM_Eager,           /**< Both tables are loaded in full when opening. */
+        TM_Lazy,            /**< MFT entries are loaded a page at a time as they are first used, and
+                                 the ID lookup tables are built the first time an ID is looked up. */
+    };
+    /** Read-only view of the raw bytes of an MFT entry, as stored in the .dat. */
+    struct EntryView
+    {
+        const byte* data;           /**< Pointer to the first byte of the entry. */
+        uint        size;           /**< Size of the stored entry, in bytes. */
+        bool        isCompressed;   /**< Whether the data needs to be inflated. */
+    };
+    /** Handler invoked when an asynchronous read completes. Gets the entry
+     *  number it was given and the entry's contents, which is empty if the
+     *  entry could not be read. Called on one of the reader threads. */
+    typedef std::function<void(uint p_entryNum, const Array<byte>& p_data)> ReadCompleteHandler;
 public:
     /** Default constructor. Initializes internals. */
     DatFile();
     /** Constructor. Initializes internals and opens the given .dat file.
-     *  \param[in]  p_filename   Name of the .dat file to open. */
-    DatFile(const wxString& p_filename);
+     *  \param[in]  p_filename   Name of the .dat file to open.
+     *  \param[in]  p_mode       How to read entry data from the file.
+     *  \param[in]  p_tableMode  When to load the MFT and file ID tables. */
+    DatFile(const wxString& p_filename, OpenMode p_mode = OM_Stream, TableMode p_tableMode = TM_Eager);
     /** Destructor. Makes sure to clear out any unfreed data. */
     ~DatFile();
 
     /** Opens the given .dat file for reading.
      *  \param[in]  p_filename   Name of the .dat file to open.
+     *  \param[in]  p_mode       How to read entry data from the file.
+     *  \param[in]  p_tableMode  When to load the MFT and file ID tables. With
+     *                          TM_Lazy, opening only reads the headers.
      *  \return bool    true if opening succeeded, false if not. */
-    bool open(const wxString& p_filename);
+    bool open(const wxString& p_filename, OpenMode p_mode = OM_Stream, TableMode p_tableMode = TM_Eager);
     /** Checks whether or not this object currently has a .dat file open.
      *  \return bool    true if a .dat file is open, false if not. */
     bool isOpen() const;
+    /** Checks whether the open .dat file is memory mapped.
+     *  \return bool    true if entries are read from a mapping, false if not. */
+    bool isMapped() const                       { return m_mapping.isOpen(); }
     /** Closes the open .dat file, if any. */
     void close();
 
@@ -107,14 +167,24 @@ public:
      *  \return uint    The base id if it was found, UINT_MAX if not. */
     uint baseIdFromFileNum(uint p_entryNum) const;
 
-    /** Gets the total uncompressed size of the given entry.
+    /** Gets the total uncompressed size of the given entry. Sizes are cached
+     *  once known, so only the first call for an entry may hit the disk.
      *  \param[in]  p_entryNum   Entry number to check the size for.
      *  \return uint    Uncompressed size of the entry. */
-    uint entrySize(uint p_entryNum);
+    uint entrySize(uint p_entryNum) const;
     /** Gets the total uncompressed size of the given file.
      *  \param[in]  p_fileNum   File entry number to check the size for.
      *  \return uint    Uncompressed size of the file. */
-    uint fileSize(uint p_fileNum);
+    uint fileSize(uint p_fileNum) const;
+    /** Tells the .dat the uncompressed size of the given entry, for instance
+     *  as stored in the index, so it doesn't have to be read from disk.
+     *  \param[in]  p_entryNum   Entry number to set the size for.
+     *  \param[in]  p_size       Uncompressed size of the entry. */
+    void setEntrySize(uint p_entryNum, uint p_size);
+    /** Tells the .dat the uncompressed size of the given file. See setEntrySize.
+     *  \param[in]  p_fileNum    File entry number to set the size for.
+     *  \param[in]  p_size       Uncompressed size of the file. */
+    void setFileSize(uint p_fileNum, uint p_size)   { this->setEntrySize(p_fileNum + MFT_FILE_OFFSET, p_size); }
     /** Gets the amount of total MFT entries in the .dat file. 
      *  \return uint    Amount of entries in the .dat file, UINT_MAX if file not open. */
     uint numEntries() const                     { if (!this->isOpen()) { return UINT_MAX; } return m_mftHead.numEntries; }
@@ -125,6 +195,48 @@ public:
     *   .dat file.
      *  \return uint    Index of the first file entry in the MFT. */
     uint mftFileOffset() const                  { return MFT_FILE_OFFSET; }
+    /** Gets the offset in the .dat at which the given entry is stored. Useful
+     *  for ordering reads.
+     *  \param[in]  p_entryNum   Entry number to get the offset for.
+     *  \return uint64  Offset of the entry, UINT64_MAX if out of range. */
+    uint64 entryOffset(uint p_entryNum) const;
+    /** Gets the offset in the .dat at which the given file is stored.
+     *  \param[in]  p_fileNum    File entry number to get the offset for.
+     *  \return uint64  Offset of the file, UINT64_MAX if out of range. */
+    uint64 fileOffset(uint p_fileNum) const     { return this->entryOffset(p_fileNum + MFT_FILE_OFFSET); }
+    /** Gets the MFT record of the given entry, as stored in the .dat. Useful
+     *  for telling whether an entry changed between two versions of the file.
+     *  \param[in]  p_entryNum   Entry number to get the record for.
+     *  \param[out] po_record    Receives the entry's MFT record.
+     *  \return bool    true if the entry exists, false if not. */
+    bool entryRecord(uint p_entryNum, ANetMftEntry& po_record) const;
+    /** Gets the MFT record of the given file. See entryRecord.
+     *  \param[in]  p_fileNum    File entry number to get the record for.
+     *  \param[out] po_record    Receives the file's MFT record.
+     *  \return bool    true if the file exists, false if not. */
+    bool fileRecord(uint p_fileNum, ANetMftEntry& po_record) const  { return this->entryRecord(p_fileNum + MFT_FILE_OFFSET, po_record); }
+
+    /** Sets the max amount of decompressed data to keep cached. Read entries
+     *  are cached, so that reading them again costs neither I/O nor
+     *  inflating. A budget of 0 disables the cache.
+     *  \param[in]  p_budget     Max amount of bytes to keep cached. */
+    void setCacheBudget(uint64 p_budget)        { m_cache.setBudget(p_budget); }
+    /** Gets the hit/miss statistics of the entry cache.
+     *  \return EntryCache::Stats   Current statistics. */
+    EntryCache::Stats cacheStats() const        { return m_cache.stats(); }
+
+    /** Gets a view of the raw bytes of the given MFT entry, straight from the
+     *  file mapping. No data is copied, and the view stays valid until the
+     *  file is closed. Only available if the file is mapped.
+     *  \param[in]  p_entryNum   MFT entry number to get the view for.
+     *  \param[out] po_view      View of the entry's data.
+     *  \return bool    true if the view is valid, false if not. */
+    bool viewEntry(uint p_entryNum, EntryView& po_view) const;
+    /** Gets a view of the raw bytes of the given MFT file entry. See viewEntry.
+     *  \param[in]  p_fileNum    MFT file entry number to get the view for.
+     *  \param[out] po_view      View of the file's data.
+     *  \return bool    true if the view is valid, false if not. */
+    bool viewFile(uint p_fileNum, EntryView& po_view) const;
 
     /** Peeks at the contents of the given MFT entry and returns the results.
      *  \param[in]  p_entryNum   MFT entry number to get contents for.
@@ -150,6 +262,25 @@ public:
      *  \param[in]  p_peekSize   Amount of bytes to peek at.
      *  \return Array<byte>  Object used to handle the peeked data. */
     Array<byte> peekFile(uint p_fileNum, uint p_peekSize);
+    /** Peeks at the contents of the given MFT entry, using the given scratch
+     *  buffer instead of the internal one. Any number of threads may call this
+     *  concurrently, as long as they use separate scratch buffers.
+     *  \param[in]  p_entryNum   MFT entry number to get contents for.
+     *  \param[in]  p_peekSize   Amount of bytes to peek at.
+     *  \param[in,out]  po_buffer    Buffer to store results in. Must be *at least*
+     *                  pPeekSize in length.
+     *  \param[in,out]  p_scratch    Buffer used to hold the compressed entry.
+     *                  Grown as needed, and can be re-used between calls.
+     *  \return uint    Size of poBuffer. */
+    uint peekEntry(uint p_entryNum, uint p_peekSize, byte* po_buffer, Array<byte>& p_scratch) const;
+    /** Peeks at the contents of the given MFT file entry. See the reentrant
+     *  peekEntry overload.
+     *  \param[in]  p_fileNum    MFT file entry number to get contents for.
+     *  \param[in]  p_peekSize   Amount of bytes to peek at.
+     *  \param[in,out]  po_buffer    Buffer to store results in.
+     *  \param[in,out]  p_scratch    Buffer used to hold the compressed entry.
+     *  \return uint    Size of poBuffer. */
+    uint peekFile(uint p_fileNum, uint p_peekSize, byte* po_buffer, Array<byte>& p_scratch) const;
 
     /** Reads the contents of the given MFT entry and returns the results.
      *  \param[in]  p_entryNum   MFT entry number to get contents for.
@@ -171,9 +302,105 @@ public:
      *  \param[in]  p_fileNum    MFT file entry number to read.
      *  \return Array<byte>  Object used to handle the read file. */
     Array<byte> readFile(uint p_fileNum);
+    /** Reads the data contained at the given MFT entry. Thread safe, as long
+     *  as each thread uses its own scratch buffer.
+     *  \param[in]  p_entryNum   MFT entry number to read.
+     *  \param[in,out]  p_scratch    Buffer used to hold the compressed entry.
+     *  \param[in]  p_cancellation   Token that stops the read early. Optional.
+     *  \return Array<byte>  Object used to handle the read data. Empty if
+     *                       the read failed or was cancelled. */
+    Array<byte> readEntry(uint p_entryNum, Array<byte>& p_scratch, const CancellationToken& p_cancellation = CancellationToken()) const;
+    /** Reads the file contained at the given MFT entry. Thread safe, as long
+     *  as each thread uses its own scratch buffer.
+     *  \param[in]  p_fileNum    MFT file entry number to read.
+     *  \param[in,out]  p_scratch    Buffer used to hold the compressed entry.
+     *  \param[in]  p_cancellation   Token that stops the read early. Optional.
+     *  \return Array<byte>  Object used to handle the read file. Empty if
+     *                       the read failed or was cancelled. */
+    Array<byte> readFile(uint p_fileNum, Array<byte>& p_scratch, const CancellationToken& p_cancellation = CancellationToken()) const;
 
-    IdentificationResult identifyFileType(const byte* p_data, uint p_size, ANetFileType& p_fileType);
+    /** Reads the raw, possibly compressed, bytes of the given MFT entry
+     *  without inflating them. Thread safe.
+     *  \param[in]  p_entryNum   MFT entry number to read.
+     *  \param[in]  p_maxSize    Max amount of bytes to read. 0 reads all of it.
+     *  \param[out] po_data      Receives the raw data.
+     *  \return bool    true if successful, false if not. */
+    bool readRawEntry(uint p_entryNum, uint p_maxSize, Array<byte>& po_data) const;
+    /** Reads the raw bytes of a batch of MFT entries. The entries are read in
+     *  the order they are stored in the .dat, whatever order they are given
+     *  in, and runs of entries stored close together are fetched with a
+     *  single read each. A run ends at the first entry that is too far past
+     *  the previous one, or would make the read too large. Thread safe, as
+     *  long as each thread uses its own scratch buffer.
+     *  \param[in]  p_entryNums  MFT entry numbers to read.
+     *  \param[in]  p_count      Amount of entry numbers given.
+     *  \param[in]  p_maxSize    Max amount of bytes to read per entry. 0 reads
+     *                          entire entries.
+     *  \param[out] po_data      Receives the raw data of each entry, in the
+     *                          order the entries were given. Left empty for
+     *                          entries that could not be read.
+     *  \param[in,out]  p_scratch    Buffer used to hold a run. */
+    void readRawEntries(const uint* p_entryNums, uint p_count, uint p_maxSize, Array<byte>* po_data, Array<byte>& p_scratch) const;
+    /** Inflates raw entry data read by readRawEntry. Thread safe.
+     *  \param[in]  p_entryNum   MFT entry number the data belongs to.
+     *  \param[in]  p_input      Raw data of the entry, or the start of it.
+     *  \param[in]  p_peekSize   Max amount of bytes to inflate. 0 inflates all of it.
+     *  \param[in]  p_cancellation   Token that stops the inflate early. Optional.
+     *  \return Array<byte>  Inflated data. Empty if there was not enough input,
+     *                       the data was invalid, or it was cancelled. */
+    Array<byte> inflateRawEntry(uint p_entryNum, const Array<byte>& p_input, uint p_peekSize, const CancellationToken& p_cancellation = CancellationToken()) const;
+
+    /** Queues a read of the given MFT entry and returns right away. Where
+     *  io_uring is available, streamed entries are read by the kernel with
+     *  several reads in flight at once, and inflated on a pool of reader
+     *  threads. Everywhere else the pool performs the whole read. The
+     *  handler is called on whichever reader thread finished the entry, and
+     *  completion order is not defined.
+     *  \param[in]  p_entryNum   MFT entry number to read.
+     *  \param[in]  p_handler    Handler to invoke once the read completes. */
+    void readEntryAsync(uint p_entryNum, const ReadCompleteHandler& p_handler) const;
+    /** Queues a read of the given MFT file entry. See readEntryAsync. The
+     *  handler is given the file entry number.
+     *  \param[in]  p_fileNum    MFT file entry number to read.
+     *  \param[in]  p_handler    Handler to invoke once the read completes. */
+    void readFileAsync(uint p_fileNum, const ReadCompleteHandler& p_handler) const;
+    /** Blocks until all queued asynchronous reads have completed. */
+    void waitForAsyncReads() const;
+    /** Drops all queued asynchronous reads that have not started yet. Their
+     *  handlers are never called.
+     *  \return uint    Amount of reads dropped. */
+    uint cancelAsyncReads() const;
+
+    /** Identifies the type of a file from its first bytes. Only looks at the
+     *  given data, so it is safe to call from any thread.
+     *  \param[in]  p_data       Start of the file's contents.
+     *  \param[in]  p_size       Amount of bytes available.
+     *  \param[out] p_fileType   Receives the file type.
+     *  \return IdentificationResult    IR_NotEnoughData if more of the file is
+     *                  needed to tell its type. */
+    IdentificationResult identifyFileType(const byte* p_data, uint p_size, ANetFileType& p_fileType) const;
     static uint fileIdFromFileReference(const ANetFileReference& p_fileRef);
+private:
+    /** Gets the given MFT entry, loading its page of the MFT if needed. */
+    const ANetMftEntry& mftEntry(uint p_entryNum) const;
+    /** Loads the given page of MFT entries, if not already loaded. */
+    void loadMftPage(uint p_page) const;
+    /** Builds the entry <-> ID lookup tables if they aren't built yet.
+     *  \return bool    true if the tables could be built, false if not. */
+    bool ensureIdTables() const                 { return loadAcquire(m_hasIdTables) ? m_isIdTableValid : this->buildIdTables(true); }
+    /** Reads the file ID table and builds the lookup tables from it. Failures
+     *  are logged when p_isLazy is set, since no caller is told of them. */
+    bool buildIdTables(bool p_isLazy) const;
+    /** Checks that the entry is in use and lies within the file. */
+    bool isEntryReadable(uint p_entryNum) const;
+    /** Peeks at the given entry without looking in the cache. */
+    uint peekEntryUncached(uint p_entryNum, uint p_peekSize, byte* po_buffer, Array<byte>& p_scratch, const CancellationToken& p_cancellation = CancellationToken()) const;
+    /** Reads p_size raw bytes of the given entry, starting p_offset bytes into
+     *  it, to the same offset in p_scratch. Returns false on failure. */
+    bool readEntryInput(uint p_entryNum, uint p_offset, uint p_size, Array<byte>& p_scratch) const;
+    /** Inflates (or copies) up to p_peekSize bytes of the given raw entry,
+     *  of which the first p_inputSize bytes are available. */
+    uint inflateEntryInput(uint p_entryNum, const byte* p_input, uint p_inputSize, uint p_peekSize, byte* po_buffer, const CancellationToken& p_cancellation = CancellationToken()) const;
 
 }; // class DatFile
 
@@ -22,8 +22,10 @@
 */
 
 #include "stdafx.h"
+#include <algorithm>
 #include <wx/file.h>
 #include <new>
+#include <vector>
 
 #include "DatIndex.h"
 
@@ -34,20 +36,61 @@ namespace gw2b
 //      DatIndexEntry
 //----------------------------------------------------------------------------
 
-DatIndexEntry::DatIndexEntry(DatIndex& p_owner)
+DatIndexEntry::DatIndexEntry(DatIndex& p_owner, uint p_index)
     : m_owner(&p_owner)
-    , m_fileId(0)
-    , m_baseId(0)
-    , m_mftEntry(0)
-    , m_fileType(ANFT_Unknown)
-    , m_category(nullptr)
+    , m_index(p_index)
 {
     Ensure::notNull(&p_owner);
 }
 
+wxString DatIndexEntry::name() const
+{
+    if (this->hasCustomName()) {
+        auto pool = m_owner->m_namePool.GetPointer();
+        return wxString::FromUTF8Unchecked(pool + m_owner->m_nameOffsets[m_index], m_owner->m_nameLengths[m_index]);
+    }
+    return defaultName(this->baseId(), this->mftEntry());
+}
+
+wxString DatIndexEntry::defaultName(uint32 p_baseId, uint32 p_mftEntry)
+{
+    // Found a file with no baseId...
+    if (!p_baseId) {
+        return wxString::Format(wxT("ID-less_%d"), p_mftEntry);
+    }
+    return wxString::Format(wxT("%d"), p_baseId);
+}
+
+DatIndexEntry& DatIndexEntry::setName(const wxString& p_name)
+{
+    // Default names are not worth storing
+    m_owner->m_nameLengths[m_index] = 0;
+    if (p_name.IsEmpty() || p_name == defaultName(this->baseId(), this->mftEntry())) {
+        return *this;
+    }
+
+    auto utf8   = p_name.ToUTF8();
+    uint length = utf8.length();
+
+    // Names are appended to the pool, growing it by doubling
+    auto& pool     = m_owner->m_namePool;
+    auto& poolSize = m_owner->m_namePoolSize;
+    if (poolSize + length > pool.GetSize()) {
+        uint capacity = std::max<uint>(pool.GetSize() * 2, 0x10000);
+        while (poolSize + length > capacity) { capacity *= 2; }
+        pool.SetSize(capacity);
+    }
+    ::memcpy(pool.GetPointer() + poolSize, utf8.data(), length);
+
+    m_owner->m_nameOffsets[m_index] = poolSize;
+    m_owner->m_nameLengths[m_index] = length;
+    poolSize += length;
+    return *this;
+}
+
 void DatIndexEntry::onAddedToCategory(DatIndexCategory* p_category)
 {
-    m_category = p_category;
+    m_owner->m_entryCategories[m_index] = p_category->index();
 }
 
 void DatIndexEntry::finalizeAdd()
@@ -70,12 +113,8 @@ DatIndexCategory::DatIndexCategory(DatIndex& p_owner, const wxString& p_name, in
 
 DatIndexCategory* DatIndexCategory::findSubCategory(const wxString& p_name)
 {
-    for (uint i = 0; i < m_subCategories.GetSize(); i++) {
-        if (m_subCategories[i]->name() == p_name) {
-            return m_subCategories[i];
-        }
-    }
-    return nullptr;
+    auto it = m_subCategoryLookup.find(p_name);
+    return (it != m_subCategoryLookup.end()) ? it->second : nullptr;
 }
 
 DatIndexCategory* DatIndexCategory::findOrAddSubCategory(const wxString& p_name)
@@ -116,22 +155,80 @@ void DatIndexCategory::addSubCategory(DatIndexCategory* p_subCategory)
     p_subCategory->onAddedToCategory(this);
 }
 
+void DatIndexCategory::setName(const wxString& p_name)
+{
+    // Re-key the lookup this category is found through
+    auto& lookup = this->siblingLookup();
+    auto it = lookup.find(m_name);
+    if (it != lookup.end() && it->second == this) { lookup.erase(it); }
+    m_name = p_name;
+    lookup.insert(std::make_pair(m_name, this));
+}
+
 void DatIndexCategory::onAddedToCategory(DatIndexCategory* p_parent)
 {
     Ensure::isNull(m_parent);
+
+    // No longer a root category. Like the lookups, the first category with
+    // a given name is the one that is found.
+    auto& roots = m_owner->m_rootCategoryLookup;
+    auto it = roots.find(m_name);
+    if (it != roots.end() && it->second == this) { roots.erase(it); }
+
     m_parent = p_parent;
+    m_parent->m_subCategoryLookup.insert(std::make_pair(m_name, this));
+}
+
+DatIndexCategoryMap& DatIndexCategory::siblingLookup()
+{
+    return m_parent ? m_parent->m_subCategoryLookup : m_owner->m_rootCategoryLookup;
 }
 
 //----------------------------------------------------------------------------
 //      DatIndex
 //----------------------------------------------------------------------------
 
+namespace
+{
+    /** Grows one of the entry field arrays, leaving it untouched on failure. */
+    template <typename T>
+        bool growColumn(T*& pio_column, uint p_capacity)
+    {
+        auto column = static_cast<T*>(::realloc(pio_column, p_capacity * sizeof(T)));
+        if (!column) { return false; }
+        pio_column = column;
+        return true;
+    }
+
+    /** Copies one of the entry field arrays into newly allocated memory. */
+    template <typename T>
+        T* copyColumn(const T* p_column, uint p_count)
+    {
+        auto column = allocate<T>(p_count);
+        if (column) { ::memcpy(column, p_column, p_count * sizeof(T)); }
+        return column;
+    }
+};
+
 DatIndex::DatIndex()
     : m_datTimestamp(0)
+    , m_entryCapacity(0)
+    , m_fileIds(nullptr)
+    , m_baseIds(nullptr)
+    , m_mftEntries(nullptr)
+    , m_sizes(nullptr)
+    , m_fileTypes(nullptr)
+    , m_entryCategories(nullptr)
+    , m_nameOffsets(nullptr)
+    , m_nameLengths(nullptr)
+    , m_namePoolSize(0)
     , m_highestMftEntry(-1)
     , m_isDirty(false)
     , m_numEntries(0)
     , m_numCategories(0)
+    , m_numNotifiedEntries(0)
+    , m_numNotifiedCategories(0)
+    , m_batchDepth(0)
 {
 }
 
@@ -147,22 +244,29 @@ DatIndex::~DatIndex()
 
 void DatIndex::clear()
 {
-    // destruct all entries before clearing their memory
-    for (uint i = 0; i < m_numEntries; i++) {
-        delete m_entries[i];
+    // entry handles are trivial, so their blocks can just be freed
+    for (uint i = 0; i < m_entryBlocks.GetSize(); i++) {
+        ::operator delete(m_entryBlocks[i]);
     }
-    m_entries.Clear();
+    m_entryBlocks.Clear();
+    this->releaseColumns();
+    m_namePool.Clear();
+    m_entryCapacity = 0;
+    m_namePoolSize  = 0;
     // also destruct all categories before clearing their memory
     for (uint i = 0; i < m_numCategories; i++) {
         delete m_categories[i];
     }
     m_categories.Clear();
+    m_rootCategoryLookup.clear();
 
-    m_datTimestamp       = 0;
-    m_highestMftEntry    = -1;
-    m_isDirty            = false;
-    m_numEntries         = 0;
-    m_numCategories      = 0;
+    m_datTimestamp          = 0;
+    m_highestMftEntry       = -1;
+    m_isDirty               = false;
+    m_numEntries            = 0;
+    m_numCategories         = 0;
+    m_numNotifiedEntries    = 0;
+    m_numNotifiedCategories = 0;
 
     // Notify listeners
     for (auto it = m_listeners.begin(); it != m_listeners.end(); it++) {
@@ -172,24 +276,37 @@ void DatIndex::clear()
 
 DatIndexEntry* DatIndex::addIndexEntry(bool p_setDirty)
 {
-    if (m_numEntries == m_entries.GetSize()) {
-        if (!reserveEntries(1)) { return nullptr; }
+    if (m_numEntries == m_entryCapacity) {
+        if (!this->growEntries(std::max<uint>(m_entryCapacity * 2, ENTRY_BLOCK_SIZE))) { return nullptr; }
     }
 
     uint index = m_numEntries++;
-    m_entries[index] = new DatIndexEntry(*this);
+    m_fileIds[index]         = 0;
+    m_baseIds[index]         = 0;
+    m_mftEntries[index]      = 0;
+    m_sizes[index]           = std::numeric_limits<uint32>::max();
+    m_fileTypes[index]       = ANFT_Unknown;
+    m_entryCategories[index] = DatIndex_NoCategory;
+    m_nameOffsets[index]     = 0;
+    m_nameLengths[index]     = 0;
+
+    auto block = m_entryBlocks[index / ENTRY_BLOCK_SIZE];
+    auto entry = new(&block[index % ENTRY_BLOCK_SIZE]) DatIndexEntry(*this, index);
 
     m_isDirty = (m_isDirty || p_setDirty);
-    return m_entries[index];
+    return entry;
 }
 
 DatIndexCategory* DatIndex::findCategory(const wxString& p_name, bool p_rootsOnly) 
 {
+    if (p_rootsOnly) {
+        auto it = m_rootCategoryLookup.find(p_name);
+        return (it != m_rootCategoryLookup.end()) ? it->second : nullptr;
+    }
+
     for (uint i = 0; i < m_numCategories; i++) {
-        if (!p_rootsOnly || !(m_categories[i]->parent())) {
-            if (m_categories[i]->name() == p_name) {
-                return m_categories[i];
-            }
+        if (m_categories[i]->name() == p_name) {
+            return m_categories[i];
         }
     }
     return nullptr;
@@ -198,17 +315,15 @@ DatIndexCategory* DatIndex::findCategory(const wxString& p_name, bool p_rootsOnl
 DatIndexCategory* DatIndex::addIndexCategory(const wxString& p_name, bool p_setDirty)
 {
     if (m_numCategories == m_categories.GetSize()) {
-        if (!reserveCategories(1)) { return nullptr; }
+        if (!reserveCategories(std::max<uint>(m_numCategories, 0x10))) { return nullptr; }
     }
 
     uint index = m_numCategories++;
     m_categories[index] = new DatIndexCategory(*this, p_name, index);
     auto& category = *m_categories[index];
+    m_rootCategoryLookup.insert(std::make_pair(p_name, &category));
 
-    // Notify listeners
-    for (auto it = m_listeners.begin(); it != m_listeners.end(); it++) {
-        (*it)->onIndexCategoryAdded(*this, category);
-    }
+    if (!m_batchDepth) { this->notifyCategoriesAdded(); }
 
     m_isDirty = (m_isDirty || p_setDirty);
     return &category;
@@ -225,11 +340,184 @@ DatIndexCategory* DatIndex::findOrAddCategory(const wxString& p_name, bool p_set
 
 bool DatIndex::reserveEntries(uint p_additionalEntries)
 {
-    if ((UINT_MAX - m_entries.GetSize()) < p_additionalEntries) { return false; }
-    m_entries.SetSize(m_entries.GetSize() + p_additionalEntries);
+    if ((UINT_MAX - m_numEntries) < p_additionalEntries) { return false; }
+    if (m_numEntries + p_additionalEntries <= m_entryCapacity) { return true; }
+    return this->growEntries(m_numEntries + p_additionalEntries);
+}
+
+bool DatIndex::growEntries(uint p_capacity)
+{
+    // Round up to whole blocks, since handles are allocated a block at a time
+    if (p_capacity > UINT_MAX - ENTRY_BLOCK_SIZE) { return false; }
+    uint numBlocks = (p_capacity + ENTRY_BLOCK_SIZE - 1) / ENTRY_BLOCK_SIZE;
+    uint capacity  = numBlocks * ENTRY_BLOCK_SIZE;
+
+    // Mapped columns can't be reallocated
+    if (!this->unmapColumns()) { return false; }
+
+    bool result = growColumn(m_fileIds, capacity)
+        && growColumn(m_baseIds, capacity)
+        && growColumn(m_mftEntries, capacity)
+        && growColumn(m_sizes, capacity)
+        && growColumn(m_fileTypes, capacity)
+        && growColumn(m_entryCategories, capacity)
+        && growColumn(m_nameOffsets, capacity)
+        && growColumn(m_nameLengths, capacity);
+    if (!result) { return false; }
+
+    this->growEntryBlocks(capacity);
+    m_entryCapacity = capacity;
+    return true;
+}
+
+void DatIndex::growEntryBlocks(uint p_capacity)
+{
+    // Existing blocks stay where they are, so handles never move
+    uint numBlocks    = (p_capacity + ENTRY_BLOCK_SIZE - 1) / ENTRY_BLOCK_SIZE;
+    uint oldNumBlocks = m_entryBlocks.GetSize();
+    if (numBlocks <= oldNumBlocks) { return; }
+
+    m_entryBlocks.SetSize(numBlocks);
+    for (uint i = oldNumBlocks; i < numBlocks; i++) {
+        m_entryBlocks[i] = static_cast<DatIndexEntry*>(::operator new(ENTRY_BLOCK_SIZE * sizeof(DatIndexEntry)));
+    }
+}
+
+bool DatIndex::adoptColumns(const DatIndexColumns& p_columns, FileMapping* pio_mapping)
+{
+    if (m_numEntries) { return false; }
+    uint count = p_columns.numEntries;
+    if (!count) { return true; }
+
+    // Check everything up front, so a corrupt file leaves no entries behind
+    int highestMftEntry = m_highestMftEntry;
+    std::vector<uint> categorySizes(m_numCategories, 0);
+    for (uint i = 0; i < count; i++) {
+        uint category = static_cast<uint>(p_columns.categories[i]);
+        if (category >= m_numCategories) { return false; }
+        categorySizes[category]++;
+
+        uint32 nameOffset = p_columns.nameOffsets[i];
+        uint32 nameLength = p_columns.nameLengths[i];
+        if (nameLength && (nameOffset > p_columns.namePoolSize || nameLength > p_columns.namePoolSize - nameOffset)) { return false; }
+
+        highestMftEntry = std::max(highestMftEntry, static_cast<int>(p_columns.mftEntries[i]));
+    }
+
+    if (pio_mapping) {
+        // Used in place. Whatever the index changes goes to private copies
+        // of the mapped pages.
+        this->releaseColumns();
+        m_columnMapping.swap(*pio_mapping);
+        m_fileIds         = p_columns.fileIds;
+        m_baseIds         = p_columns.baseIds;
+        m_mftEntries      = p_columns.mftEntries;
+        m_sizes           = p_columns.sizes;
+        m_fileTypes       = p_columns.fileTypes;
+        m_entryCategories = p_columns.categories;
+        m_nameOffsets     = p_columns.nameOffsets;
+        m_nameLengths     = p_columns.nameLengths;
+        m_entryCapacity   = count;
+        this->growEntryBlocks(count);
+    } else {
+        if (!this->reserveEntries(count)) { return false; }
+        ::memcpy(m_fileIds, p_columns.fileIds, count * sizeof(uint32));
+        ::memcpy(m_baseIds, p_columns.baseIds, count * sizeof(uint32));
+        ::memcpy(m_mftEntries, p_columns.mftEntries, count * sizeof(uint32));
+        ::memcpy(m_sizes, p_columns.sizes, count * sizeof(uint32));
+        ::memcpy(m_fileTypes, p_columns.fileTypes, count * sizeof(uint16));
+        ::memcpy(m_entryCategories, p_columns.categories, count * sizeof(int32));
+        ::memcpy(m_nameOffsets, p_columns.nameOffsets, count * sizeof(uint32));
+        ::memcpy(m_nameLengths, p_columns.nameLengths, count * sizeof(uint32));
+    }
+
+    // Names are appended to the pool, so it is always copied
+    m_namePool.SetSize(p_columns.namePoolSize);
+    if (p_columns.namePoolSize) { ::memcpy(m_namePool.GetPointer(), p_columns.namePool, p_columns.namePoolSize); }
+    m_namePoolSize = p_columns.namePoolSize;
+
+    // Each category grows once, instead of once per entry
+    for (uint i = 0; i < m_numCategories; i++) {
+        auto& entries = m_categories[i]->m_entries;
+        uint numEntries = entries.GetSize();
+        entries.SetSize(numEntries + categorySizes[i]);
+        categorySizes[i] = numEntries;
+    }
+    for (uint i = 0; i < count; i++) {
+        auto entry = new(&m_entryBlocks[i / ENTRY_BLOCK_SIZE][i % ENTRY_BLOCK_SIZE]) DatIndexEntry(*this, i);
+        uint category = m_entryCategories[i];
+        m_categories[category]->m_entries[categorySizes[category]++] = entry;
+    }
+
+    m_numEntries      = count;
+    m_highestMftEntry = highestMftEntry;
+    if (!m_batchDepth) { this->notifyEntriesAdded(); }
+    return true;
+}
+
+bool DatIndex::unmapColumns()
+{
+    if (!m_columnMapping.isOpen()) { return true; }
+
+    // All or nothing, so no column is left pointing into the mapping
+    auto fileIds         = copyColumn(m_fileIds, m_entryCapacity);
+    auto baseIds         = copyColumn(m_baseIds, m_entryCapacity);
+    auto mftEntries      = copyColumn(m_mftEntries, m_entryCapacity);
+    auto sizes           = copyColumn(m_sizes, m_entryCapacity);
+    auto fileTypes       = copyColumn(m_fileTypes, m_entryCapacity);
+    auto entryCategories = copyColumn(m_entryCategories, m_entryCapacity);
+    auto nameOffsets     = copyColumn(m_nameOffsets, m_entryCapacity);
+    auto nameLengths     = copyColumn(m_nameLengths, m_entryCapacity);
+    if (!fileIds || !baseIds || !mftEntries || !sizes || !fileTypes || !entryCategories || !nameOffsets || !nameLengths) {
+        freePointer(fileIds);
+        freePointer(baseIds);
+        freePointer(mftEntries);
+        freePointer(sizes);
+        freePointer(fileTypes);
+        freePointer(entryCategories);
+        freePointer(nameOffsets);
+        freePointer(nameLengths);
+        return false;
+    }
+
+    m_fileIds         = fileIds;
+    m_baseIds         = baseIds;
+    m_mftEntries      = mftEntries;
+    m_sizes           = sizes;
+    m_fileTypes       = fileTypes;
+    m_entryCategories = entryCategories;
+    m_nameOffsets     = nameOffsets;
+    m_nameLengths     = nameLengths;
+    m_columnMapping.close();
     return true;
 }
 
+void DatIndex::releaseColumns()
+{
+    // Mapped columns go away with the mapping
+    if (m_columnMapping.isOpen()) {
+        m_fileIds         = nullptr;
+        m_baseIds         = nullptr;
+        m_mftEntries      = nullptr;
+        m_sizes           = nullptr;
+        m_fileTypes       = nullptr;
+        m_entryCategories = nullptr;
+        m_nameOffsets     = nullptr;
+        m_nameLengths     = nullptr;
+        m_columnMapping.close();
+        return;
+    }
+
+    freePointer(m_fileIds);
+    freePointer(m_baseIds);
+    freePointer(m_mftEntries);
+    freePointer(m_sizes);
+    freePointer(m_fileTypes);
+    freePointer(m_entryCategories);
+    freePointer(m_nameOffsets);
+    freePointer(m_nameLengths);
+}
+
 bool DatIndex::reserveCategories(uint p_additionalCategories)
 {
     if ((UINT_MAX - m_categories.GetSize()) < p_additionalCategories) { return false; }
@@ -253,9 +541,43 @@ void DatIndex::onEntryAddComplete(DatIndexEntry& p_entry)
         m_highestMftEntry = static_cast<int>(p_entry.mftEntry());
     }
 
-    // Notify listeners
+    if (!m_batchDepth) { this->notifyEntriesAdded(); }
+}
+
+void DatIndex::beginBatch()
+{
+    m_batchDepth++;
+}
+
+void DatIndex::endBatch()
+{
+    Assert(m_batchDepth > 0);
+    if (--m_batchDepth) { return; }
+
+    // Categories first, since the entries are in them
+    this->notifyCategoriesAdded();
+    this->notifyEntriesAdded();
+}
+
+void DatIndex::notifyCategoriesAdded()
+{
+    if (m_numNotifiedCategories >= m_numCategories) { return; }
+    uint first = m_numNotifiedCategories;
+    m_numNotifiedCategories = m_numCategories;
+
+    for (auto it = m_listeners.begin(); it != m_listeners.end(); it++) {
+        (*it)->onIndexCategoriesAdded(*this, first, m_numCategories);
+    }
+}
+
+void DatIndex::notifyEntriesAdded()
+{
+    if (m_numNotifiedEntries >= m_numEntries) { return; }
+    uint first = m_numNotifiedEntries;
+    m_numNotifiedEntries = m_numEntries;
+
     for (auto it = m_listeners.begin(); it != m_listeners.end(); it++) {
-        (*it)->onIndexFileAdded(*this, p_entry);
+        (*it)->onIndexEntriesAdded(*this, first, m_numEntries);
     }
 }
 
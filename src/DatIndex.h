@@ -27,9 +27,12 @@
 #define DATINDEX_H_INCLUDED
 
 #include <wx/filename.h>
+#include <wx/hashmap.h>
 #include <set>
+#include <unordered_map>
 
 #include "ANetStructs.h"
+#include "Util/FileMapping.h"
 
 namespace gw2b
 {
@@ -37,68 +40,110 @@ class DatIndex;
 class DatIndexEntry;
 class DatIndexCategory;
 
-/** Represents an entry in the .dat index. */
+enum { DatIndex_NoCategory = -1 };
+
+/** Maps category names to categories. */
+typedef std::unordered_map<wxString, DatIndexCategory*, wxStringHash, wxStringEqual> DatIndexCategoryMap;
+
+/** Entry fields laid out the way DatIndex stores them, one array per field,
+ *  such as those of a mapped index file. */
+struct DatIndexColumns
+{
+    uint            numEntries;         /**< Amount of entries in each array. */
+    uint32*         fileIds;            /**< File ID of each entry. */
+    uint32*         baseIds;            /**< Base ID of each entry. */
+    uint32*         mftEntries;         /**< MFT entry number of each entry. */
+    uint32*         sizes;              /**< Uncompressed size of each entry, UINT_MAX if unknown. */
+    uint16*         fileTypes;          /**< File type of each entry. */
+    int32*          categories;         /**< Index of the category holding each entry. */
+    uint32*         nameOffsets;        /**< Offset of each entry's name in the name pool. */
+    uint32*         nameLengths;        /**< Length of each entry's name. 0 if it uses the default name. */
+    const char*     namePool;           /**< UTF-8 names of the entries. */
+    uint            namePoolSize;       /**< Size of the name pool, in bytes. */
+};
+
+/** Represents an entry in the .dat index. Entries are lightweight handles:
+ *  their fields are stored by the owning index, one array per field. Handles
+ *  are allocated in blocks that never move, so pointers to them stay valid
+ *  until the index is cleared. */
 class DatIndexEntry
 {
     DatIndex*           m_owner;
-    uint32              m_fileId;
-    uint32              m_baseId;
-    uint32              m_mftEntry;
-    ANetFileType        m_fileType;
-    DatIndexCategory*   m_category;
-    wxString            m_displayName;
+    uint                m_index;
 public:
-    /** Constructor. Sets the various internal values to the given values. */
-    DatIndexEntry(DatIndex& p_owner);
+    /** Constructor. Creates a handle to the given entry.
+     *  \param[in]  p_owner  Index owning the entry.
+     *  \param[in]  p_index  Index of the entry in its owner. */
+    DatIndexEntry(DatIndex& p_owner, uint p_index);
     /** Gets the category this entry is contained in.
      *  \return DatIndexCategory*   pointer to the category containing this entry. */
-    DatIndexCategory* category()                            { return m_category; }
+    inline DatIndexCategory* category();
     /** Gets the const category this entry is contained in.
      *  \return DatIndexCategory*   pointer to the category containing this entry. */
-    const DatIndexCategory* category() const                { return m_category; }
+    inline const DatIndexCategory* category() const;
 
     /** Gets this entry's file ID.
      *  \return uint32  file ID associated with entry. */
-    uint32 fileId() const                                   { return m_fileId; }
+    inline uint32 fileId() const;
     /** Gets this entry's base ID.
      *  \return uint32  base ID associated with entry. */
-    uint32 baseId() const                                   { return m_baseId; }
+    inline uint32 baseId() const;
     /** Gets this entry's MFT entry number.
      *  \return uint32  MFT entry number associated with entry. */
-    uint32 mftEntry() const                                 { return m_mftEntry; }
+    inline uint32 mftEntry() const;
+    /** Gets this entry's uncompressed size.
+     *  \return uint32  uncompressed size of the file, UINT_MAX if unknown. */
+    inline uint32 size() const;
     /** Gets this entry's file type.
      *  \return ANetFileType  file type associated with entry. */
-    ANetFileType fileType() const                           { return m_fileType; }
+    inline ANetFileType fileType() const;
     /** Gets this entry's owner.
      *  \return DatIndex&   owner of this entry. */
     DatIndex& owner()                                       { return *m_owner; }
     /** Gets this entry's owner.
      *  \return DatIndex&   owner of this entry. */
     const DatIndex& owner() const                           { return *m_owner; }
-    /** Gets this entry's name.
-     *  \return DatIndex&   name of this entry. */
-    const wxString& name() const                            { return m_displayName; }
+    /** Gets the index of this entry in its owner.
+     *  \return uint    index of this entry. */
+    uint index() const                                      { return m_index; }
+    /** Gets this entry's name. Unless a custom name was set, it is built from
+     *  the base ID, or from the MFT entry number for files without one.
+     *  \return wxString    name of this entry. */
+    wxString name() const;
+    /** Checks whether this entry has a name other than the default one.
+     *  \return bool    true if a custom name was set, false if not. */
+    inline bool hasCustomName() const;
+    /** Builds the default name of an entry with the given IDs.
+     *  \param[in]  p_baseId     Base ID of the entry.
+     *  \param[in]  p_mftEntry   MFT entry number of the entry.
+     *  \return wxString    the default name. */
+    static wxString defaultName(uint32 p_baseId, uint32 p_mftEntry);
 
     /** Sets this entry's file ID.
      *  \param[in]  p_fileId     File ID associated with entry. 
      *  \return DatIndexEntry&  reference to this object. */
-    DatIndexEntry& setFileId(uint32 p_fileId)               { m_fileId = p_fileId; return *this; }
+    inline DatIndexEntry& setFileId(uint32 p_fileId);
     /** Sets this entry's base ID.
      *  \param[in]  p_baseId     Base ID associated with entry. 
      *  \return DatIndexEntry&  reference to this object. */
-    DatIndexEntry& setBaseId(uint32 p_baseId)                { m_baseId = p_baseId; return *this; }
+    inline DatIndexEntry& setBaseId(uint32 p_baseId);
     /** Sets this entry's MFT entry number.
      *  \param[in]  p_mftEntry   MFT entry number associated with entry. 
      *  \return DatIndexEntry&  reference to this object. */
-    DatIndexEntry& setMftEntry(uint32 p_mftEntry)            { m_mftEntry = p_mftEntry; return *this; }
+    inline DatIndexEntry& setMftEntry(uint32 p_mftEntry);
+    /** Sets this entry's uncompressed size.
+     *  \param[in]  p_size   Uncompressed size of the file, UINT_MAX if unknown.
+     *  \return DatIndexEntry&  reference to this object. */
+    inline DatIndexEntry& setSize(uint32 p_size);
     /** Sets this entry's file type.
      *  \param[in]  p_fileType   File type associated with entry. 
      *  \return DatIndexEntry&  reference to this object. */
-    DatIndexEntry& setFileType(ANetFileType p_fileType)      { m_fileType = p_fileType; return *this; }
-    /** Sets this entry's name.
+    inline DatIndexEntry& setFileType(ANetFileType p_fileType);
+    /** Sets this entry's name. Only names other than the default one are
+     *  stored, so the IDs should be set first.
      *  \param[in]  p_name   name of this entry.
      *  \return DatIndexEntry&  reference to this object. */
-    DatIndexEntry& setName(const wxString& p_name)           { m_displayName = p_name; return *this; }
+    DatIndexEntry& setName(const wxString& p_name);
 
     /** Completes the add operation by notifying the index, so it can notify
      *  its listeners. */
@@ -111,11 +156,13 @@ public:
 /** Represents a category of entries and other categories. */
 class DatIndexCategory
 {
+    friend class DatIndex;
     DatIndex*           m_owner;
     int                 m_index;
     wxString            m_name;
     DatIndexCategory*   m_parent;
     Array<DatIndexCategory*,0x3>  m_subCategories;
+    DatIndexCategoryMap           m_subCategoryLookup;
     Array<DatIndexEntry*,0x3>     m_entries;
 public:
     /** Constructor. Creates a category with the given name and index. 
@@ -166,7 +213,7 @@ public:
 
     /** Sets the name of this category.
      *  \param[in]  p_name   name of the category. */
-    void setName(const wxString& p_name)        { m_name = p_name; }
+    void setName(const wxString& p_name);
     /** Sets this category's owner.
      *  \param[in]  p_owner  Owner of this category. */
     void setOwner(DatIndex& p_owner)            { m_owner = &p_owner; }
@@ -196,6 +243,8 @@ public:
     /** Called by the parent category when this category is added to one.
      *  \param[in]  p_category   New parent category. */
     void onAddedToCategory(DatIndexCategory* p_category);
+private:
+    DatIndexCategoryMap& siblingLookup();
 };
 
 /** \interface  IDatIndexListener
@@ -203,14 +252,18 @@ public:
 class IDatIndexListener
 {
 public:
-    /** Raised when an entry was added to the index.
-     *  \param[in]  p_index  Reference to the index that had a file added to it.
-     *  \param[in]  p_entry  Reference to the newly added entry. */
-    virtual void onIndexFileAdded(DatIndex& p_index, const DatIndexEntry& p_entry) {}
-    /** Raised when a category was added to the index.
-     *  \param[in]  p_index      Reference to the index that had a file added to it.
-     *  \param[in]  p_category   Reference to the newly added category. */
-    virtual void onIndexCategoryAdded(DatIndex& p_index, const DatIndexCategory& p_category) {}
+    /** Raised when entries were added to the index. Adds made during a batch
+     *  are reported together once the batch ends.
+     *  \param[in]  p_index  Reference to the index that had files added to it.
+     *  \param[in]  p_first  Index of the first added entry.
+     *  \param[in]  p_end    Index following the last added entry. */
+    virtual void onIndexEntriesAdded(DatIndex& p_index, uint p_first, uint p_end) {}
+    /** Raised when categories were added to the index. Adds made during a
+     *  batch are reported together once the batch ends, before the entries.
+     *  \param[in]  p_index  Reference to the index that had categories added to it.
+     *  \param[in]  p_first  Index of the first added category.
+     *  \param[in]  p_end    Index following the last added category. */
+    virtual void onIndexCategoriesAdded(DatIndex& p_index, uint p_first, uint p_end) {}
     /** Raised when the index is cleared.
      *  \param[in]  p_index  Reference to the index being cleared. */
     virtual void onIndexCleared(DatIndex& p_index) {}
@@ -219,21 +272,42 @@ public:
     virtual void onIndexDestruction(DatIndex& p_index) {}
 };
 
-/** Represents a .dat index, for faster lookup. */
+/** Represents a .dat index, for faster lookup. Entry fields are stored in
+ *  separate arrays, so that walking a single field touches as little memory
+ *  as possible. */
 class DatIndex
 {
+    friend class DatIndexEntry;
+    friend class DatIndexCategory;
     typedef Array<DatIndexCategory*>        CategoryArray;
-    typedef Array<DatIndexEntry*>           EntryArray;
+    typedef Array<DatIndexEntry*>           EntryBlockArray;
     typedef std::set<IDatIndexListener*>    ListenerSet;
+    enum { ENTRY_BLOCK_SIZE = 0x1000 };
 private:
     CategoryArray       m_categories;
+    DatIndexCategoryMap m_rootCategoryLookup;
     uint64              m_datTimestamp;
-    EntryArray          m_entries;
+    EntryBlockArray     m_entryBlocks;
+    uint                m_entryCapacity;
+    uint32*             m_fileIds;
+    uint32*             m_baseIds;
+    uint32*             m_mftEntries;
+    uint32*             m_sizes;
+    uint16*             m_fileTypes;
+    int32*              m_entryCategories;
+    uint32*             m_nameOffsets;      // custom names only, length 0 means default
+    uint32*             m_nameLengths;
+    Array<char>         m_namePool;
+    uint                m_namePoolSize;
+    FileMapping         m_columnMapping;    // backs the columns, if used in place
     int                 m_highestMftEntry;
     bool                m_isDirty;
     ListenerSet         m_listeners;
     uint                m_numEntries;
     uint                m_numCategories;
+    uint                m_numNotifiedEntries;
+    uint                m_numNotifiedCategories;
+    uint                m_batchDepth;
 public:
     /** Constructor. Initializes internals. */
     DatIndex();
@@ -272,6 +346,21 @@ public:
      *              memory for.
      *  \return bool    true if successful, false if not. */
     bool reserveCategories(uint p_additionalCategories);
+    /** Adds the entries held by the given columns, which refer to categories
+     *  already in this index. Only an index without entries can take them.
+     *  If a mapping is given, the columns have to point into it, and they are
+     *  used in place: the index takes over the mapping instead of copying
+     *  them. Otherwise, the columns are copied.
+     *  \param[in]      p_columns    Columns holding the entries to add.
+     *  \param[in,out]  pio_mapping  Privately mapped file holding the columns,
+     *                              or nullptr to copy them.
+     *  \return bool    true if successful, false if the columns are invalid. */
+    bool adoptColumns(const DatIndexColumns& p_columns, FileMapping* pio_mapping);
+    /** Copies columns used in place into memory of the index's own and
+     *  unmaps the file holding them, which then can be replaced. Growing the
+     *  index does this as well.
+     *  \return bool    true if successful, false if out of memory. */
+    bool unmapColumns();
 
     /** Gets the amount of entries in this index.
      *  \return uint    Amount of entries. */
@@ -282,7 +371,7 @@ public:
     /** Gets the entry with the given index.
      *  \param[in]  p_index  Index of the entry to get.
      *  \return DatIndexEntry*  Const pointer to the entry if valid, nullptr if not. */
-    const DatIndexEntry* entry(uint p_index) const      { if (p_index >= m_numEntries) { return nullptr; } return m_entries[p_index]; }
+    const DatIndexEntry* entry(uint p_index) const      { if (p_index >= m_numEntries) { return nullptr; } return &m_entryBlocks[p_index / ENTRY_BLOCK_SIZE][p_index % ENTRY_BLOCK_SIZE]; }
     /** Gets the category with the given index.
      *  \param[in]  p_index  Index of the category to get.
      *  \return DatIndexCategory*   pointer to the category if valid, nullptr if not. */
@@ -316,12 +405,58 @@ public:
      *  \param[in]  p_listener   Listener to remove from this object. */
     void removeListener(IDatIndexListener* p_listener);
 
+    /** Starts a batch of adds. Listeners are not notified of entries and
+     *  categories added during the batch until it ends. Batches can nest. */
+    void beginBatch();
+    /** Ends a batch of adds, and notifies listeners of everything added
+     *  during it once the outermost batch ends. */
+    void endBatch();
+
     /** Called by DatIndexEntry upon calling FinalizeAdd(). Notifies this
-     *  index's listeners.
+     *  index's listeners, unless a batch is in progress.
      *  \param[in]  p_entry  Entry that was just added. */
     void onEntryAddComplete(DatIndexEntry& p_entry);
+private:
+    bool growEntries(uint p_capacity);
+    void growEntryBlocks(uint p_capacity);
+    void releaseColumns();
+    void notifyCategoriesAdded();
+    void notifyEntriesAdded();
 }; // class DatIndex
 
+/** Batches the adds made to a DatIndex during its lifetime. */
+class DatIndexBatch
+{
+    DatIndex&   m_index;
+public:
+    /** Constructor. Starts a batch on the given index.
+     *  \param[in]  p_index  Index to batch adds for. */
+    DatIndexBatch(DatIndex& p_index) : m_index(p_index)     { m_index.beginBatch(); }
+    /** Destructor. Ends the batch. */
+    ~DatIndexBatch()                                        { m_index.endBatch(); }
+private:
+    DatIndexBatch(const DatIndexBatch&);
+    DatIndexBatch& operator=(const DatIndexBatch&);
+}; // class DatIndexBatch
+
+//----------------------------------------------------------------------------
+//      DatIndexEntry inlines
+//----------------------------------------------------------------------------
+
+inline DatIndexCategory* DatIndexEntry::category()                      { return m_owner->category(m_owner->m_entryCategories[m_index]); }
+inline const DatIndexCategory* DatIndexEntry::category() const          { return m_owner->category(m_owner->m_entryCategories[m_index]); }
+inline uint32 DatIndexEntry::fileId() const                             { return m_owner->m_fileIds[m_index]; }
+inline uint32 DatIndexEntry::baseId() const                             { return m_owner->m_baseIds[m_index]; }
+inline uint32 DatIndexEntry::mftEntry() const                           { return m_owner->m_mftEntries[m_index]; }
+inline uint32 DatIndexEntry::size() const                               { return m_owner->m_sizes[m_index]; }
+inline ANetFileType DatIndexEntry::fileType() const                     { return static_cast<ANetFileType>(m_owner->m_fileTypes[m_index]); }
+inline bool DatIndexEntry::hasCustomName() const                        { return m_owner->m_nameLengths[m_index] != 0; }
+inline DatIndexEntry& DatIndexEntry::setFileId(uint32 p_fileId)         { m_owner->m_fileIds[m_index] = p_fileId; return *this; }
+inline DatIndexEntry& DatIndexEntry::setBaseId(uint32 p_baseId)         { m_owner->m_baseIds[m_index] = p_baseId; return *this; }
+inline DatIndexEntry& DatIndexEntry::setMftEntry(uint32 p_mftEntry)     { m_owner->m_mftEntries[m_index] = p_mftEntry; return *this; }
+inline DatIndexEntry& DatIndexEntry::setSize(uint32 p_size)             { m_owner->m_sizes[m_index] = p_size; return *this; }
+inline DatIndexEntry& DatIndexEntry::setFileType(ANetFileType p_fileType)   { m_owner->m_fileTypes[m_index] = static_cast<uint16>(p_fileType); return *this; }
+
 }; // namespace gw2b
 
 #endif // DATINDEX_H_INCLUDED
@@ -22,20 +22,147 @@
 */
 
 #include "stdafx.h"
+#include <algorithm>
+#include <wx/stdpaths.h>
 #include "DatIndexIO.h"
 
+#include "Imported/crc.h"
+#include "Util/Profiler.h"
+
 namespace gw2b
 {
 
+namespace
+{
+    enum {
+        PackedTypeBits      = 5,
+        PackedTypeEscape    = (1 << PackedTypeBits) - 1,
+        MaxVarintSize       = 5,
+    };
+
+    inline byte* writeVarint(byte* p_output, uint32 p_value)
+    {
+        while (p_value >= 0x80) {
+            *p_output++ = static_cast<byte>(p_value | 0x80);
+            p_value >>= 7;
+        }
+        *p_output++ = static_cast<byte>(p_value);
+        return p_output;
+    }
+
+    inline bool readVarint(const byte*& pio_data, const byte* p_end, uint32& po_value)
+    {
+        // Most values fit in a single byte
+        if (pio_data < p_end && *pio_data < 0x80) {
+            po_value = *pio_data++;
+            return true;
+        }
+
+        uint32 value = 0;
+        for (uint shift = 0; shift < 7 * MaxVarintSize; shift += 7) {
+            if (pio_data >= p_end) { return false; }
+            byte b = *pio_data++;
+            value |= static_cast<uint32>(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                po_value = value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline uint32 encodeDelta(uint32 p_value, uint32 p_previous)
+    {
+        int32 delta = static_cast<int32>(p_value - p_previous);
+        return (static_cast<uint32>(delta) << 1) ^ static_cast<uint32>(delta >> 31);
+    }
+
+    inline uint32 decodeDelta(uint32 p_encoded, uint32 p_previous)
+    {
+        return p_previous + ((p_encoded >> 1) ^ (0 - (p_encoded & 1)));
+    }
+
+    /** Offsets of the arrays in a column file, from the start of the file. */
+    struct ColumnLayout
+    {
+        uint64 categories;
+        uint64 fileIds;
+        uint64 baseIds;
+        uint64 mftEntries;
+        uint64 sizes;
+        uint64 entryCategories;
+        uint64 nameOffsets;
+        uint64 nameLengths;
+        uint64 fileTypes;
+        uint64 namePool;
+    };
+
+    ColumnLayout columnLayout(const DatIndexHead& p_header)
+    {
+        uint64 numEntries = p_header.numEntries;
+        ColumnLayout layout;
+        layout.categories      = sizeof(DatIndexHead);
+        layout.fileIds         = layout.categories + (uint64)p_header.numCategories * sizeof(DatIndexColumnCategory);
+        layout.baseIds         = layout.fileIds + numEntries * sizeof(uint32);
+        layout.mftEntries      = layout.baseIds + numEntries * sizeof(uint32);
+        layout.sizes           = layout.mftEntries + numEntries * sizeof(uint32);
+        layout.entryCategories = layout.sizes + numEntries * sizeof(uint32);
+        layout.nameOffsets     = layout.entryCategories + numEntries * sizeof(int32);
+        layout.nameLengths     = layout.nameOffsets + numEntries * sizeof(uint32);
+        layout.fileTypes       = layout.nameLengths + numEntries * sizeof(uint32);
+        layout.namePool        = layout.fileTypes + numEntries * sizeof(uint16);
+        return layout;
+    }
+
+    void setColumns(byte* p_data, const ColumnLayout& p_layout, uint p_numEntries, DatIndexColumns& po_columns)
+    {
+        po_columns.numEntries  = p_numEntries;
+        po_columns.fileIds     = reinterpret_cast<uint32*>(p_data + p_layout.fileIds);
+        po_columns.baseIds     = reinterpret_cast<uint32*>(p_data + p_layout.baseIds);
+        po_columns.mftEntries  = reinterpret_cast<uint32*>(p_data + p_layout.mftEntries);
+        po_columns.sizes       = reinterpret_cast<uint32*>(p_data + p_layout.sizes);
+        po_columns.categories  = reinterpret_cast<int32*>(p_data + p_layout.entryCategories);
+        po_columns.nameOffsets = reinterpret_cast<uint32*>(p_data + p_layout.nameOffsets);
+        po_columns.nameLengths = reinterpret_cast<uint32*>(p_data + p_layout.nameLengths);
+        po_columns.fileTypes   = reinterpret_cast<uint16*>(p_data + p_layout.fileTypes);
+    }
+
+    byte* reserveBytes(Array<byte>& pio_buffer, uint p_used, uint p_size)
+    {
+        if (UINT_MAX - p_used < p_size) { return nullptr; }
+
+        // Grow by doubling, the initial size is only an estimate
+        uint capacity = pio_buffer.GetSize();
+        if (p_used + p_size > capacity) {
+            capacity = std::max<uint>(capacity, 0x10000);
+            while (p_used + p_size > capacity) {
+                capacity = (capacity > UINT_MAX / 2) ? UINT_MAX : capacity * 2;
+            }
+            pio_buffer.SetSize(capacity);
+        }
+
+        return pio_buffer.GetPointer() + p_used;
+    }
+};
+
 //----------------------------------------------------------------------------
 //      DatIndexReader
 //----------------------------------------------------------------------------
 
 DatIndexReader::DatIndexReader(DatIndex& p_index)
     : m_index(p_index)
+    , m_entryFieldsSize(0)
+    , m_entriesRead(0)
+    , m_columnCategories(nullptr)
+    , m_stringPool(nullptr)
+    , m_stringPoolSize(0)
+    , m_packedData(nullptr)
+    , m_packedEnd(nullptr)
 {
     Ensure::notNull(&p_index);
     ::memset(&m_header, 0, sizeof(m_header));
+    ::memset(m_previousIds, 0, sizeof(m_previousIds));
+    ::memset(&m_columns, 0, sizeof(m_columns));
 }
 
 DatIndexReader::~DatIndexReader()
@@ -52,31 +179,117 @@ bool DatIndexReader::open(const wxString& p_filename)
     if (m_file.IsOpened() && m_file.Length() > sizeof(m_header)) {
         m_file.Read(&m_header, sizeof(m_header));
         if (m_header.magicInteger != DatIndex_Magic) { this->close(); return false; }
-        if (m_header.version != DatIndex_Version) { this->close(); return false; }
+        if (m_header.version < DatIndex_MinVersion || m_header.version > DatIndex_Version) { this->close(); return false; }
+        // Version 4 was a flat format that is no longer read, so those
+        // indexes are rebuilt instead
+        if (m_header.version == 4) { this->close(); return false; }
+        // Packed and column files are read from memory instead
+        if (m_header.version >= DatIndex_ColumnVersion) {
+            m_file.Close();
+            if (!this->openColumns(p_filename)) { this->close(); return false; }
+        } else if (m_header.version >= DatIndex_PackedVersion) {
+            m_file.Close();
+            if (!this->openPacked(p_filename)) { this->close(); return false; }
+        }
+        // Version 2 entries lack the size field
+        m_entryFieldsSize = sizeof(DatIndexEntryFields);
+        if (m_header.version < 3) { m_entryFieldsSize -= sizeof(uint32); }
         m_index.clear(); // always start with a fresh index
         m_index.setDatTimestamp(m_header.datTimestamp);
-        m_index.reserveEntries(m_header.numEntries);
+        // Columns come with their own memory
+        if (!m_columns.fileIds) { m_index.reserveEntries(m_header.numEntries); }
         m_index.reserveCategories(m_header.numEntries);
+        // Older versions get written again in the latest format
+        if (m_header.version < DatIndex_Version) { m_index.setDirty(true); }
         return true;
     }
 
     return false;
 }
 
+bool DatIndexReader::loadFile(const wxString& p_filename, const byte*& po_data, uint64& po_size, bool p_isPrivate)
+{
+    // Mapping may fail, in which case the file is read into memory
+    if (m_mapping.open(p_filename, p_isPrivate)) {
+        po_data = m_mapping.data();
+        po_size = m_mapping.size();
+        return true;
+    }
+
+    wxFile file(p_filename);
+    if (!file.IsOpened()) { return false; }
+    m_fileData.SetSize(file.Length());
+    if (file.Read(m_fileData.GetPointer(), m_fileData.GetSize()) != (ssize_t)m_fileData.GetSize()) { return false; }
+    po_data = m_fileData.GetPointer();
+    po_size = m_fileData.GetSize();
+    return true;
+}
+
+bool DatIndexReader::openPacked(const wxString& p_filename)
+{
+    const byte* data;
+    uint64 size;
+    if (!this->loadFile(p_filename, data, size)) { return false; }
+    if (size < sizeof(DatIndexHead)) { return false; }
+
+    // The records are only validated as they are read
+    m_packedData = data + sizeof(DatIndexHead);
+    m_packedEnd  = data + size;
+    ::memset(m_previousIds, 0, sizeof(m_previousIds));
+    return true;
+}
+
+bool DatIndexReader::openColumns(const wxString& p_filename)
+{
+    // Mapped privately, as the index writes to the columns it uses in place
+    const byte* data;
+    uint64 size;
+    if (!this->loadFile(p_filename, data, size, true)) { return false; }
+
+    // Make sure the arrays fit, whatever remains is the string pool
+    auto layout = columnLayout(m_header);
+    if (layout.namePool > size || size - layout.namePool > std::numeric_limits<uint32>::max()) { return false; }
+
+    byte* columns = m_mapping.isOpen() ? m_mapping.privateData() : m_fileData.GetPointer();
+    setColumns(columns, layout, m_header.numEntries, m_columns);
+    m_columnCategories      = reinterpret_cast<const DatIndexColumnCategory*>(data + layout.categories);
+    m_stringPool            = reinterpret_cast<const char*>(data + layout.namePool);
+    m_stringPoolSize        = static_cast<uint>(size - layout.namePool);
+    m_columns.namePool      = m_stringPool;
+    m_columns.namePoolSize  = m_stringPoolSize;
+    return true;
+}
+
 void DatIndexReader::close()
 {
     m_file.Close();
+    m_mapping.close();
+    m_fileData.Clear();
     ::memset(&m_header, 0, sizeof(m_header));
+    m_entryFieldsSize   = 0;
+    m_entriesRead       = 0;
+    m_columnCategories  = nullptr;
+    m_stringPool        = nullptr;
+    m_stringPoolSize    = 0;
+    m_packedData        = nullptr;
+    m_packedEnd         = nullptr;
+    ::memset(m_previousIds, 0, sizeof(m_previousIds));
+    ::memset(&m_columns, 0, sizeof(m_columns));
 }
 
 bool DatIndexReader::isDone() const
 {
     return (m_index.numCategories() == m_header.numCategories) 
-        && (m_index.numEntries() == m_header.numEntries);
+        && (m_entriesRead == m_header.numEntries);
 }
 
 DatIndexReader::ReadResult DatIndexReader::read(uint p_amount)
 {
+    ScopedTimer timer("DatIndexReader::read");
+
+    if (m_columns.fileIds) { return this->readColumns(p_amount); }
+    if (m_packedData) { return this->readPacked(p_amount); }
+
     ReadResult result = RR_Failure;
 
     for (uint i = 0; i < p_amount; i++) {
@@ -93,37 +306,24 @@ DatIndexReader::ReadResult DatIndexReader::read(uint p_amount)
             bytesRead = m_file.Read(nameData.GetPointer(), nameData.GetSize());
             if (bytesRead < (ssize_t)nameData.GetSize()) { result = RR_CorruptFile; goto READ_FAILED; }
             // Add category
-            auto name     = wxString::FromUTF8Unchecked(nameData.GetPointer(), nameData.GetSize());
-            auto category = m_index.addIndexCategory(name, false);
-            // Set parent
-            if (fields.parent != DatIndex_RootCategory) {
-                auto parent = m_index.category(fields.parent);
-                if (parent) { parent->addSubCategory(category); }
-            }
+            auto name = wxString::FromUTF8Unchecked(nameData.GetPointer(), nameData.GetSize());
+            this->addCategory(fields.parent, name);
         }
 
         // If all categories are read, start reading the files instead (note the 'else')
-        else if (m_index.numEntries() < m_header.numEntries) {
+        else if (m_entriesRead < m_header.numEntries) {
             // Read fixed-width fields
             DatIndexEntryFields fields;
-            bytesRead = m_file.Read(&fields, sizeof(fields));
-            if (bytesRead < sizeof(fields)) { result = RR_CorruptFile; goto READ_FAILED; }
+            fields.size = std::numeric_limits<uint32>::max();
+            bytesRead = m_file.Read(&fields, m_entryFieldsSize);
+            if (bytesRead < (ssize_t)m_entryFieldsSize) { result = RR_CorruptFile; goto READ_FAILED; }
             // Read name
             Array<char> nameData(fields.nameLength);
             bytesRead = m_file.Read(nameData.GetPointer(), nameData.GetSize());
             if (bytesRead < (ssize_t)nameData.GetSize()) { result = RR_CorruptFile; goto READ_FAILED; }
             // Add entry
-            auto name      = wxString::FromUTF8Unchecked(nameData.GetPointer(), nameData.GetSize());
-            auto& newEntry = m_index.addIndexEntry(false)
-                ->setBaseId(fields.baseId)
-                .setFileId(fields.fileId)
-                .setMftEntry(fields.mftEntry)
-                .setFileType((ANetFileType)fields.fileType)
-                .setName(name);
-            auto category = m_index.category(fields.category);
-            if (!category) { result = RR_CorruptFile; goto READ_FAILED; }
-            category->addEntry(&newEntry);
-            newEntry.finalizeAdd();
+            auto name = wxString::FromUTF8Unchecked(nameData.GetPointer(), nameData.GetSize());
+            if (!this->addEntry(fields, name)) { result = RR_CorruptFile; goto READ_FAILED; }
         }
 
         // If both are done we can skip this loop
@@ -138,16 +338,152 @@ READ_FAILED:
     return result;
 }
 
+DatIndexReader::ReadResult DatIndexReader::readPacked(uint p_amount)
+{
+    uint numRecords = p_amount * RECORDS_PER_READ;
+    const byte* data = m_packedData;
+    const byte* end  = m_packedEnd;
+    ReadResult result = RR_Success;
+
+    for (uint i = 0; i < numRecords; i++) {
+        // Categories first
+        if (m_index.numCategories() < m_header.numCategories) {
+            uint32 parent, nameLength;
+            if (!readVarint(data, end, parent) || !readVarint(data, end, nameLength)) { result = RR_CorruptFile; break; }
+            if (nameLength > (uint)(end - data)) { result = RR_CorruptFile; break; }
+            auto name = wxString::FromUTF8Unchecked(reinterpret_cast<const char*>(data), nameLength);
+            data += nameLength;
+            this->addCategory(static_cast<int32>(parent) - 1, name);
+        }
+
+        // Then entries (note the 'else')
+        else if (m_entriesRead < m_header.numEntries) {
+            uint32 categoryAndType, mftEntry, baseId, fileId, size, nameLength;
+            if (!readVarint(data, end, categoryAndType)) { result = RR_CorruptFile; break; }
+
+            DatIndexEntryFields fields;
+            fields.category = categoryAndType >> PackedTypeBits;
+            fields.fileType = categoryAndType & PackedTypeEscape;
+            if (fields.fileType == PackedTypeEscape && !readVarint(data, end, fields.fileType)) { result = RR_CorruptFile; break; }
+
+            if (!readVarint(data, end, mftEntry) || !readVarint(data, end, baseId) || !readVarint(data, end, fileId)
+                || !readVarint(data, end, size) || !readVarint(data, end, nameLength)) {
+                result = RR_CorruptFile;
+                break;
+            }
+            if (nameLength > (uint)(end - data)) { result = RR_CorruptFile; break; }
+
+            fields.mftEntry   = m_previousIds[0] = decodeDelta(mftEntry, m_previousIds[0]);
+            fields.baseId     = m_previousIds[1] = decodeDelta(baseId, m_previousIds[1]);
+            fields.fileId     = m_previousIds[2] = decodeDelta(fileId, m_previousIds[2]);
+            fields.size       = size - 1;
+            fields.nameLength = 0;
+
+            wxString name;
+            if (nameLength) { name = wxString::FromUTF8Unchecked(reinterpret_cast<const char*>(data), nameLength); }
+            data += nameLength;
+            if (!this->addEntry(fields, name)) { result = RR_CorruptFile; break; }
+        }
+
+        // Both done
+        else {
+            break;
+        }
+    }
+
+    m_packedData = data;
+    return result;
+}
+
+DatIndexReader::ReadResult DatIndexReader::readColumns(uint p_amount)
+{
+    // There are few categories, so they are all added at once
+    while (m_index.numCategories() < m_header.numCategories) {
+        auto& record = m_columnCategories[m_index.numCategories()];
+        if (record.nameOffset > m_stringPoolSize || record.nameLength > m_stringPoolSize - record.nameOffset) { return RR_CorruptFile; }
+        auto name = wxString::FromUTF8Unchecked(m_stringPool + record.nameOffset, record.nameLength);
+        this->addCategory(record.parent, name);
+    }
+    if (m_entriesRead == m_header.numEntries) { return RR_Success; }
+
+    // Unless some are left out, the index takes the entries as they are. It
+    // takes over the mapping too, and uses the columns in place.
+    if (!m_filter) {
+        if (!m_index.adoptColumns(m_columns, m_mapping.isOpen() ? &m_mapping : nullptr)) { return RR_CorruptFile; }
+        m_entriesRead = m_header.numEntries;
+        return RR_Success;
+    }
+
+    uint numRecords = p_amount * RECORDS_PER_READ;
+    for (uint i = 0; i < numRecords && m_entriesRead < m_header.numEntries; i++) {
+        uint index = m_entriesRead;
+        uint32 nameOffset = m_columns.nameOffsets[index];
+        uint32 nameLength = m_columns.nameLengths[index];
+        if (nameOffset > m_stringPoolSize || nameLength > m_stringPoolSize - nameOffset) { return RR_CorruptFile; }
+
+        DatIndexEntryFields fields;
+        fields.category   = m_columns.categories[index];
+        fields.baseId     = m_columns.baseIds[index];
+        fields.fileId     = m_columns.fileIds[index];
+        fields.mftEntry   = m_columns.mftEntries[index];
+        fields.fileType   = m_columns.fileTypes[index];
+        fields.nameLength = 0;
+        fields.size       = m_columns.sizes[index];
+
+        wxString name;
+        if (nameLength) { name = wxString::FromUTF8Unchecked(m_stringPool + nameOffset, nameLength); }
+        if (!this->addEntry(fields, name)) { return RR_CorruptFile; }
+    }
+
+    return RR_Success;
+}
+
+void DatIndexReader::addCategory(int32 p_parent, const wxString& p_name)
+{
+    auto category = m_index.addIndexCategory(p_name, false);
+    // Set parent
+    if (p_parent != DatIndex_RootCategory) {
+        auto parent = m_index.category(p_parent);
+        if (parent) { parent->addSubCategory(category); }
+    }
+}
+
+bool DatIndexReader::addEntry(const DatIndexEntryFields& p_fields, const wxString& p_name)
+{
+    m_entriesRead++;
+    // Skip it if filtered out
+    if (m_filter && !m_filter(p_fields.mftEntry, p_fields.baseId, p_fields.fileId)) { return true; }
+
+    auto category = m_index.category(p_fields.category);
+    if (!category) { return false; }
+
+    auto& newEntry = m_index.addIndexEntry(false)
+        ->setBaseId(p_fields.baseId)
+        .setFileId(p_fields.fileId)
+        .setMftEntry(p_fields.mftEntry)
+        .setFileType((ANetFileType)p_fields.fileType)
+        .setSize(p_fields.size);
+    // Empty names mean the default one
+    if (!p_name.IsEmpty()) { newEntry.setName(p_name); }
+    category->addEntry(&newEntry);
+    newEntry.finalizeAdd();
+    return true;
+}
+
 //----------------------------------------------------------------------------
 //      DatIndexWriter
 //----------------------------------------------------------------------------
 
 DatIndexWriter::DatIndexWriter(DatIndex& p_index)
     : m_index(p_index)
+    , m_version(0)
+    , m_bufferSize(0)
+    , m_namePoolSize(0)
     , m_categoriesWritten(0)
     , m_entriesWritten(0)
 {
     Ensure::notNull(&p_index);
+    ::memset(m_previousIds, 0, sizeof(m_previousIds));
 }
 
 DatIndexWriter::~DatIndexWriter()
@@ -155,33 +491,53 @@ DatIndexWriter::~DatIndexWriter()
     this->close();
 }
 
-bool DatIndexWriter::open(const wxString& p_filename)
+bool DatIndexWriter::open(const wxString& p_filename, uint p_version)
 {
     this->close();
-
-    m_file.Open(p_filename, wxFile::write);
-    if (m_file.IsOpened()) {
-        DatIndexHead header;
-        header.magicInteger  = DatIndex_Magic;
-        header.version       = DatIndex_Version;
-        header.datTimestamp  = m_index.datTimestamp();
-        header.numEntries    = m_index.numEntries();
-        header.numCategories = m_index.numCategories();
-
-        auto bytesWritten = m_file.Write(&header, sizeof(header));
-        if (bytesWritten < sizeof(header)) { this->close(); return false; }
-
-        return true;
+    if (p_filename.IsEmpty()) { return false; }
+    if (p_version != DatIndex_ColumnVersion && p_version != DatIndex_PackedVersion) { return false; }
+    // A mapped file can't be replaced on Windows
+    if (!m_index.unmapColumns()) { return false; }
+
+    DatIndexHead header;
+    header.magicInteger  = DatIndex_Magic;
+    header.version       = static_cast<uint16>(p_version);
+    header.datTimestamp  = m_index.datTimestamp();
+    header.numEntries    = m_index.numEntries();
+    header.numCategories = m_index.numCategories();
+
+    // Column files are of a known size, save for the names. Most packed
+    // entries fit in about 12 bytes, the buffer grows if needed.
+    uint64 expectedSize;
+    if (p_version == DatIndex_ColumnVersion) {
+        expectedSize = columnLayout(header).namePool;
+    } else {
+        expectedSize = sizeof(DatIndexHead)
+                     + (uint64)m_index.numCategories() * 0x20
+                     + (uint64)m_index.numEntries() * 0xc;
     }
+    if (expectedSize > UINT_MAX) { return false; }
+    m_buffer.SetSize(static_cast<uint>(expectedSize));
 
-    return false;
+    ::memcpy(m_buffer.GetPointer(), &header, sizeof(header));
+    m_bufferSize = (p_version == DatIndex_ColumnVersion) ? static_cast<uint>(expectedSize) : sizeof(header);
+
+    m_filename = p_filename;
+    m_version  = p_version;
+    return true;
 }
 
 void DatIndexWriter::close()
 {
-    m_file.Close();
+    m_filename.Clear();
+    m_buffer.Clear();
+    m_namePool.Clear();
+    m_version           = 0;
+    m_bufferSize        = 0;
+    m_namePoolSize      = 0;
     m_categoriesWritten = 0;
     m_entriesWritten    = 0;
+    ::memset(m_previousIds, 0, sizeof(m_previousIds));
 }
 
 bool DatIndexWriter::isDone() const
@@ -192,61 +548,187 @@ bool DatIndexWriter::isDone() const
 
 bool DatIndexWriter::write(uint p_amount)
 {
-    for (uint i = 0; i < p_amount; i++) {
-        ssize_t bytesWritten;
+    if (!this->isOpen()) { return false; }
+    ScopedTimer timer("DatIndexWriter::write");
+
+    // The header holds the counts, they can't change halfway through
+    auto header = reinterpret_cast<const DatIndexHead*>(m_buffer.GetPointer());
+    if (header->numEntries != m_index.numEntries() || header->numCategories != m_index.numCategories()) { return false; }
 
+    uint numRecords = p_amount * RECORDS_PER_WRITE;
+    if (m_version == DatIndex_ColumnVersion) { return this->writeColumns(numRecords); }
+    return this->writePacked(numRecords);
+}
+
+bool DatIndexWriter::writePacked(uint p_numRecords)
+{
+    for (uint i = 0; i < p_numRecords; i++) {
         // First write categories, one at a time
         if (m_categoriesWritten < m_index.numCategories()) {
-            auto category    = m_index.category(m_categoriesWritten);
-            auto parent      = category->parent();
-            wxScopedCharBuffer nameBuffer = category->name().ToUTF8();
-            // Fixed-width fields
-            DatIndexCategoryFields fields;
-            fields.parent     = (parent ? parent->index() : -1);
-            fields.nameLength = nameBuffer.length();
-            bytesWritten = m_file.Write(&fields, sizeof(fields));
-            if (bytesWritten < sizeof(fields)) { return false; }
-            // Name
-            bytesWritten = m_file.Write(nameBuffer, fields.nameLength);
-            if (bytesWritten < fields.nameLength) { return false; }
+            auto category = m_index.category(m_categoriesWritten);
+            auto parent   = category->parent();
+            auto name     = category->name().ToUTF8();
+            uint length   = name.length();
+
+            byte* output = reserveBytes(m_buffer, m_bufferSize, 2 * MaxVarintSize + length);
+            if (!output) { return false; }
+            output = writeVarint(output, parent ? parent->index() + 1 : 0);
+            output = writeVarint(output, length);
+            ::memcpy(output, name.data(), length);
+            m_bufferSize = (output + length) - m_buffer.GetPointer();
             // Increase the counter
             m_categoriesWritten++;
         }
 
         // Then, write entries one at a time (note the 'else')
         else if (m_entriesWritten < m_index.numEntries()) {
-            auto entry      = m_index.entry(m_entriesWritten);
-            auto category   = entry->category();
-            auto nameBuffer = entry->name().ToUTF8();
-            // Fixed-width fields
-            DatIndexEntryFields fields;
-            fields.category   = category->index();
-            fields.baseId     = entry->baseId();
-            fields.fileId     = entry->fileId();
-            fields.mftEntry   = entry->mftEntry();
-            fields.fileType   = entry->fileType();
-            fields.nameLength = nameBuffer.length();
-            bytesWritten = m_file.Write(&fields, sizeof(fields));
-            if (bytesWritten < sizeof(fields)) { return false; }
-            // Name
-            bytesWritten = m_file.Write(nameBuffer, fields.nameLength);
-            if (bytesWritten < fields.nameLength) { return false; }
+            auto entry = m_index.entry(m_entriesWritten);
+            wxScopedCharBuffer name;
+            uint length = 0;
+            if (entry->hasCustomName()) {
+                name   = entry->name().ToUTF8();
+                length = name.length();
+            }
+
+            // Category and file type share a varint
+            uint32 category = entry->category()->index();
+            uint32 fileType = entry->fileType();
+            if (category >= (1u << (32 - PackedTypeBits))) { return false; }
+            uint32 categoryAndType = (category << PackedTypeBits) | std::min<uint32>(fileType, PackedTypeEscape);
+
+            byte* output = reserveBytes(m_buffer, m_bufferSize, 7 * MaxVarintSize + length);
+            if (!output) { return false; }
+            output = writeVarint(output, categoryAndType);
+            if (fileType >= PackedTypeEscape) { output = writeVarint(output, fileType); }
+            output = writeVarint(output, encodeDelta(entry->mftEntry(), m_previousIds[0]));
+            output = writeVarint(output, encodeDelta(entry->baseId(), m_previousIds[1]));
+            output = writeVarint(output, encodeDelta(entry->fileId(), m_previousIds[2]));
+            output = writeVarint(output, entry->size() + 1);
+            output = writeVarint(output, length);
+            if (length) { ::memcpy(output, name.data(), length); }
+            m_bufferSize = (output + length) - m_buffer.GetPointer();
+
+            m_previousIds[0] = entry->mftEntry();
+            m_previousIds[1] = entry->baseId();
+            m_previousIds[2] = entry->fileId();
+            // Increase the counter
+            m_entriesWritten++;
+        }
+
+        // All done = ditch this loop
+        else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool DatIndexWriter::writeColumns(uint p_numRecords)
+{
+    auto layout = columnLayout(*reinterpret_cast<const DatIndexHead*>(m_buffer.GetPointer()));
+    auto categories = reinterpret_cast<DatIndexColumnCategory*>(m_buffer.GetPointer() + layout.categories);
+    DatIndexColumns columns;
+    setColumns(m_buffer.GetPointer(), layout, m_index.numEntries(), columns);
+
+    for (uint i = 0; i < p_numRecords; i++) {
+        // First write categories, one at a time
+        if (m_categoriesWritten < m_index.numCategories()) {
+            auto category = m_index.category(m_categoriesWritten);
+            auto parent   = category->parent();
+            auto& record  = categories[m_categoriesWritten];
+            auto name     = category->name().ToUTF8();
+
+            uint32 nameOffset;
+            if (!this->addName(name, nameOffset)) { return false; }
+            record.parent     = parent ? parent->index() : DatIndex_RootCategory;
+            record.nameOffset = nameOffset;
+            record.nameLength = name.length();
+            // Increase the counter
+            m_categoriesWritten++;
+        }
+
+        // Then, write entries one at a time (note the 'else')
+        else if (m_entriesWritten < m_index.numEntries()) {
+            uint index = m_entriesWritten;
+            auto entry = m_index.entry(index);
+            columns.fileIds[index]     = entry->fileId();
+            columns.baseIds[index]     = entry->baseId();
+            columns.mftEntries[index]  = entry->mftEntry();
+            columns.sizes[index]       = entry->size();
+            columns.fileTypes[index]   = static_cast<uint16>(entry->fileType());
+            columns.categories[index]  = entry->category()->index();
+            columns.nameOffsets[index] = 0;
+            columns.nameLengths[index] = 0;
+            if (entry->hasCustomName()) {
+                auto name = entry->name().ToUTF8();
+                columns.nameLengths[index] = name.length();
+                if (!this->addName(name, columns.nameOffsets[index])) { return false; }
+            }
             // Increase the counter
             m_entriesWritten++;
         }
 
-        // Both done = ditch this loop
+        // All done = ditch this loop
         else {
             break;
         }
     }
 
-    // Remove dirty flag if everything is saved
-    if (this->isDone()) {
-        m_index.setDirty(false);
+    return true;
+}
+
+bool DatIndexWriter::addName(const wxScopedCharBuffer& p_name, uint32& po_offset)
+{
+    uint length = p_name.length();
+    if (length) {
+        byte* output = reserveBytes(m_namePool, m_namePoolSize, length);
+        if (!output) { return false; }
+        ::memcpy(output, p_name.data(), length);
     }
 
+    po_offset       = m_namePoolSize;
+    m_namePoolSize += length;
     return true;
 }
 
+bool DatIndexWriter::commit()
+{
+    if (!this->isOpen() || !this->isDone()) { return false; }
+    ScopedTimer timer("DatIndexWriter::commit");
+    Profiler::addCount("DatIndexWriter.bytesWritten", m_bufferSize + m_namePoolSize);
+
+    // Write next to the target, so the rename stays on the same volume
+    auto tempFilename = m_filename + wxT(".tmp");
+
+    wxFile file(tempFilename, wxFile::write);
+    if (!file.IsOpened()) { return false; }
+
+    // Only column files have a separate name pool
+    bool isWritten = (file.Write(m_buffer.GetPointer(), m_bufferSize) == m_bufferSize)
+                  && (!m_namePoolSize || file.Write(m_namePool.GetPointer(), m_namePoolSize) == m_namePoolSize)
+                  && file.Flush();
+    file.Close();
+
+    // Only replace the old index once the new one is complete
+    if (!isWritten || !replaceFile(tempFilename, m_filename)) {
+        wxRemoveFile(tempFilename);
+        return false;
+    }
+    return true;
+}
+
+//----------------------------------------------------------------------------
+//      Free functions
+//----------------------------------------------------------------------------
+
+wxFileName defaultDatIndexPath(const wxString& p_datPath)
+{
+    auto configPath    = wxStandardPaths().GetUserDataDir();
+    auto datPathCrc    = ::compute_crc(INITIAL_CRC, p_datPath.char_str(), p_datPath.Length());
+    auto indexFileName = wxString::Format(wxT("%x.idx"), (uint)datPathCrc);
+
+    return wxFileName(configPath, indexFileName);
+}
+
 }; // namespace gw2b
@@ -26,15 +26,21 @@
 #ifndef DATINDEXREADER_H_INCLUDED
 #define DATINDEXREADER_H_INCLUDED
 
+#include <functional>
 #include <wx/file.h>
+#include <wx/filename.h>
 #include "DatIndex.h"
+#include "Util/FileMapping.h"
 
 namespace gw2b
 {
 
 enum {
     DatIndex_Magic          = 0x4944,
-    DatIndex_Version        =    0x2,
+    DatIndex_Version        =    0x6,
+    DatIndex_MinVersion     =    0x2,
+    DatIndex_PackedVersion  =    0x5,
+    DatIndex_ColumnVersion  =    0x6,
     DatIndex_RootCategory   =   -0x1,
 };
 
@@ -69,16 +75,73 @@ struct DatIndexEntryFields
     uint32 mftEntry;            /**< MFT entry number of the indexed file. */
     uint32 fileType;            /**< Type of the indexed file. */
     uint16 nameLength;          /**< Length of the entry's name, in bytes. */
+    // Version 3+. Fields added in later versions go at the end, so older
+    // versions can be read by reading only the first part of the struct.
+    uint32 size;                /**< Uncompressed size of the file. UINT_MAX if unknown. */
+};
+
+/** Structure of a category record in a column .dat index file. */
+struct DatIndexColumnCategory
+{
+    int32 parent;               /**< Index of the category's parent. -1 for none. */
+    uint32 nameOffset;          /**< Offset of the category's name in the string pool. */
+    uint32 nameLength;          /**< Length of the category's name, in bytes. */
 };
 
 #pragma pack(pop)
 
-/** Responsible for reading a .dat index from file. */
+// Version 5 files are packed: the header is followed by the categories and
+// then the entries, made up of unsigned LEB128 varints and inline names.
+//
+//  Category:   parent + 1, name length, name
+//  Entry:      category << 5 | file type, mftEntry delta, baseId delta,
+//              fileId delta, size + 1, name length, name
+//
+// File types of 31 and up are stored as 31, followed by the actual type. The
+// deltas are relative to the previous entry, zigzag encoded, as the IDs mostly
+// grow along with the MFT entry number. The size wraps around, so that unknown
+// sizes (UINT_MAX) are stored as 0. A name length of 0 means the default name.
+//
+// Version 6 files hold columns: the header is followed by an array of
+// DatIndexColumnCategory, then one array per entry field, and a pool holding
+// all names, which runs until the end of the file. The entry arrays are laid
+// out the same way DatIndex stores them, so a mapped file is used in place:
+//
+//  uint32 fileIds[], baseIds[], mftEntries[], sizes[]
+//  int32  categories[]
+//  uint32 nameOffsets[], nameLengths[]
+//  uint16 fileTypes[]
+//
+// The string pool offsets are relative to the start of the pool. A name
+// length of 0 means the default name.
+
+/** Responsible for reading a .dat index from file. Column files are mapped
+ *  into memory and handed to the index, which uses them in place. Packed
+ *  files are mapped and read from there, while older versions are read record
+ *  by record. */
 class DatIndexReader
 {
+public:
+    /** Decides whether a read entry is kept. Gets the entry's MFT file entry
+     *  number, base ID and file ID, and returns false to leave it out. */
+    typedef std::function<bool(uint p_fileNum, uint p_baseId, uint p_fileId)> EntryFilter;
+private:
     DatIndex&       m_index;
     DatIndexHead    m_header;
     wxFile          m_file;
+    uint            m_entryFieldsSize;
+    uint            m_entriesRead;
+    EntryFilter     m_filter;
+    FileMapping     m_mapping;
+    Array<byte>     m_fileData;
+    const DatIndexColumnCategory*   m_columnCategories;
+    const char*     m_stringPool;
+    uint            m_stringPoolSize;
+    const byte*     m_packedData;
+    const byte*     m_packedEnd;
+    uint32          m_previousIds[3];
+    DatIndexColumns m_columns;
+    enum { RECORDS_PER_READ = 0x400 };
 public:
     /** Result of the Read() operation. */
     enum ReadResult
@@ -108,7 +171,7 @@ public:
     bool isDone() const;
     /** Determines whether there is an open index file.
      *  \return bool    true if there is an open index file, false if not. */
-    bool isOpen() const                 { return m_file.IsOpened(); }
+    bool isOpen() const                 { return m_file.IsOpened() || m_columnCategories != nullptr || m_packedData != nullptr; }
 
     /** Gets the current amount of read categories.
      *  \return uint    amount of categories. */
@@ -117,27 +180,53 @@ public:
      *  \return uint    amount of categories. */
     uint numCategories() const          { return m_header.numCategories; }
 
-    /** Gets the current amount of read entries.
+    /** Gets the current amount of read entries, including filtered ones.
      *  \return uint    amount of entries. */
-    uint currentEntry() const           { return m_index.numEntries(); }
+    uint currentEntry() const           { return m_entriesRead; }
     /** Gets the total amount of entries in the file.
      *  \return uint    amount of entries. */
     uint numEntries() const             { return m_header.numEntries; }
 
+    /** Sets a filter deciding which entries get added to the index. Entries
+     *  the filter rejects are still read, but not added.
+     *  \param[in]  p_filter     Filter to use, or an empty function to keep all entries. */
+    void setEntryFilter(const EntryFilter& p_filter)  { m_filter = p_filter; }
+
     /** Performs a read cycle, reading some categories/entries from the file
-     *  and adding them to the index. 
+     *  and adding them to the index. For packed files, each cycle handles a
+     *  whole block of records. Column files are read in a single
+     *  cycle, unless entries are filtered.
      *  \param[in]  p_amount     Amount of read cycles to perform.
      *  \return ReadResult  The result of the read operation(s). */
     ReadResult read(uint p_amount = 1);
+private:
+    bool loadFile(const wxString& p_filename, const byte*& po_data, uint64& po_size, bool p_isPrivate = false);
+    bool openPacked(const wxString& p_filename);
+    bool openColumns(const wxString& p_filename);
+    ReadResult readPacked(uint p_amount);
+    ReadResult readColumns(uint p_amount);
+    void addCategory(int32 p_parent, const wxString& p_name);
+    bool addEntry(const DatIndexEntryFields& p_fields, const wxString& p_name);
 }; // class DatIndexReader
 
-/** Responsible for writing a .dat index to file. */
+/** Responsible for writing a .dat index to file. Writes column files, which
+ *  load fastest, unless asked for the smaller packed ones. The file is first
+ *  built in memory, a few records per write cycle. commit() then saves it to a
+ *  temporary file and renames that over the target, so that a failed write
+ *  never leaves a broken index behind. */
 class DatIndexWriter
 {
+    enum { RECORDS_PER_WRITE = 0x400 };
     DatIndex&       m_index;
-    wxFile          m_file;
+    wxString        m_filename;
+    uint            m_version;
+    Array<byte>     m_buffer;
+    uint            m_bufferSize;
+    Array<byte>     m_namePool;
+    uint            m_namePoolSize;
     uint            m_categoriesWritten;
     uint            m_entriesWritten;
+    uint32          m_previousIds[3];
 public:
     /** Constructor.
      *  \param[in]  p_index  Index to write onto disk. */
@@ -145,18 +234,22 @@ public:
     /** Destructor. */
     ~DatIndexWriter();
 
-    /** Opens the given file for writing.
-     *  \param[in]  p_filename   File to open.
+    /** Starts writing an index to the given file. Nothing is written to disk
+     *  until commit() is called. If the index uses the columns of a mapped
+     *  file in place, it lets go of the file first, so it can be replaced.
+     *  \param[in]  p_filename   File to write.
+     *  \param[in]  p_version    Format to write, either DatIndex_ColumnVersion
+     *                          or DatIndex_PackedVersion.
      *  \return bool    true if open was successful, false if not. */
-    bool open(const wxString& p_filename);
-    /** Closes the opened file. */
+    bool open(const wxString& p_filename, uint p_version = DatIndex_Version);
+    /** Drops the written data. */
     void close();
-    /** Determines whether this task is done. 
-     *  \return bool    true if the task is done, false if not. */
+    /** Determines whether the whole index has been written to memory.
+     *  \return bool    true if the index is written, false if not. */
     bool isDone() const;
     /** Determines whether there is an open index file.
      *  \return bool    true if there is an open index file, false if not. */
-    bool isOpen() const                 { return m_file.IsOpened(); }
+    bool isOpen() const                 { return !m_filename.IsEmpty(); }
 
     /** Gets the current amount of written categories.
      *  \return uint    amount of categories. */
@@ -172,13 +265,28 @@ public:
      *  \return uint    amount of entries. */
     uint numEntries() const             { return m_index.numEntries(); }
 
-    /** Performs a write cycle, writing some categories/entries to the file. 
+    /** Performs a write cycle, writing some categories/entries to memory. 
      *  \param[in]  p_amount     Amount of write cycles to perform.
      *  \return bool    true if successful, false if not. */
     bool write(uint p_amount = 1);
-
+    /** Saves the written index to disk. Writes to a temporary file next to
+     *  the target and renames it over the target when complete. Does not
+     *  touch the index, so it can be called from any thread once isDone()
+     *  returns true.
+     *  \return bool    true if successful, false if not. */
+    bool commit();
+private:
+    bool writePacked(uint p_numRecords);
+    bool writeColumns(uint p_numRecords);
+    bool addName(const wxScopedCharBuffer& p_name, uint32& po_offset);
 }; // class DatIndexWriter
 
+/** Gets where the index of the given .dat is kept, unless told otherwise. It
+ *  goes in the user's data directory, named after a CRC of the .dat's path.
+ *  \param[in]  p_datPath    Path of the .dat file.
+ *  \return wxFileName  Path of the index file. */
+wxFileName defaultDatIndexPath(const wxString& p_datPath);
+
 }; // namespace gw2b
 
 #endif // DATINDEXREADER_H_INCLUDED
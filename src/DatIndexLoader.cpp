@@ -0,0 +1,157 @@
+/** \file       DatIndexLoader.cpp
+ *  \brief      Contains the definition of the DatIndexLoader class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include "DatIndexLoader.h"
+
+#include "DatFile.h"
+#include "DatIndex.h"
+#include "DatIndexIO.h"
+#include "MftSnapshot.h"
+#include "Tasks/ReadIndexTask.h"
+#include "Tasks/ScanDatTask.h"
+
+namespace gw2b
+{
+
+DatIndexLoader::DatIndexLoader(DatFile& p_datFile, const std::shared_ptr<DatIndex>& p_index)
+    : m_datFile(p_datFile)
+    , m_index(p_index)
+{
+    Ensure::notNull(&p_datFile);
+    Ensure::notNull(p_index.get());
+}
+
+void DatIndexLoader::reset(const wxString& p_datPath, const wxFileName& p_indexPath)
+{
+    m_datPath   = p_datPath;
+    m_indexPath = p_indexPath.IsOk() ? p_indexPath : defaultDatIndexPath(p_datPath);
+    m_staleFiles.Clear();
+}
+
+wxFileName DatIndexLoader::snapshotPath() const
+{
+    auto snapshotFile = m_indexPath;
+    snapshotFile.SetExt(wxT("mft"));
+    return snapshotFile;
+}
+
+ReadIndexTask* DatIndexLoader::createReadTask()
+{
+    uint64 datTimestamp = wxFileModificationTime(m_datPath);
+    auto readIndexTask  = new ReadIndexTask(m_index, m_indexPath.GetFullPath(), datTimestamp);
+
+    m_staleFiles.Clear();
+    MftSnapshot snapshot;
+    if (snapshot.read(this->snapshotPath().GetFullPath()) && snapshot.datTimestamp() != datTimestamp) {
+        m_staleFiles.SetSize(m_datFile.numFiles());
+        for (uint i = 0; i < m_staleFiles.GetSize(); i++) {
+            m_staleFiles[i] = snapshot.hasFileChanged(m_datFile, i);
+        }
+        readIndexTask->allowOutdated(snapshot.datTimestamp(), [this](uint p_fileNum, uint p_baseId, uint p_fileId) {
+            return this->isIndexedFileValid(p_fileNum, p_baseId, p_fileId);
+        });
+    }
+
+    return readIndexTask;
+}
+
+ScanDatTask* DatIndexLoader::createScanTask(bool p_wasOutdated)
+{
+    // If it failed, it was cleared.
+    if (m_index->datTimestamp() == 0 || m_index->numEntries() == 0) {
+        return this->createRebuildTask();
+    }
+
+    // Hand the indexed file sizes to the .dat, so it doesn't have to look them up.
+    // Those of files that changed since the index was written are outdated.
+    for (uint i = 0; i < m_index->numEntries(); i++) {
+        auto entry   = m_index->entry(i);
+        auto fileNum = entry->mftEntry();
+        bool isStale = (fileNum < m_staleFiles.GetSize()) && m_staleFiles[fileNum];
+        if (!isStale && entry->size() != std::numeric_limits<uint32>::max()) {
+            m_datFile.setFileSize(fileNum, entry->size());
+        }
+    }
+
+    // If it was written for an older version of the .dat, scan the files that
+    // changed since along with any past the last indexed one
+    int highestEntry = m_index->highestMftEntry();
+    if (p_wasOutdated) {
+        uint numToScan = 0;
+        for (uint i = 0; i < m_staleFiles.GetSize(); i++) {
+            if (m_staleFiles[i] || (int)i > highestEntry) { numToScan++; }
+        }
+
+        Array<uint> fileNums(numToScan);
+        numToScan = 0;
+        for (uint i = 0; i < m_staleFiles.GetSize(); i++) {
+            if (m_staleFiles[i] || (int)i > highestEntry) { fileNums[numToScan++] = i; }
+        }
+        m_staleFiles.Clear();
+
+        return fileNums.GetSize() ? new ScanDatTask(m_index, m_datFile, fileNums) : nullptr;
+    }
+    m_staleFiles.Clear();
+
+    // Was it complete?
+    if ((uint)(highestEntry + 1) < m_datFile.numFiles()) {
+        return new ScanDatTask(m_index, m_datFile);
+    }
+    return nullptr;
+}
+
+ScanDatTask* DatIndexLoader::createRebuildTask()
+{
+    m_staleFiles.Clear();
+    m_index->clear();
+    m_index->setDatTimestamp(wxFileModificationTime(m_datPath));
+    return new ScanDatTask(m_index, m_datFile);
+}
+
+void DatIndexLoader::writeMftSnapshot()
+{
+    if (!m_indexPath.FileExists()) { return; }
+
+    // The index timestamp is what ties the two together
+    MftSnapshot snapshot;
+    snapshot.take(m_datFile, m_index->datTimestamp());
+    snapshot.write(this->snapshotPath().GetFullPath());
+}
+
+bool DatIndexLoader::isIndexedFileValid(uint p_fileNum, uint p_baseId, uint p_fileId)
+{
+    // Files that no longer exist, or changed since the index was written
+    if (p_fileNum >= m_staleFiles.GetSize()) { return false; }
+    if (m_staleFiles[p_fileNum]) { return false; }
+
+    // Unchanged files can still have been given new IDs
+    if (m_datFile.baseIdFromFileNum(p_fileNum) != p_baseId || m_datFile.fileIdFromFileNum(p_fileNum) != p_fileId) {
+        m_staleFiles[p_fileNum] = true;
+        return false;
+    }
+
+    return true;
+}
+
+}; // namespace gw2b
@@ -0,0 +1,96 @@
+/** \file       DatIndexLoader.h
+ *  \brief      Contains the declaration of the DatIndexLoader class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef DATINDEXLOADER_H_INCLUDED
+#define DATINDEXLOADER_H_INCLUDED
+
+#include <wx/filename.h>
+
+namespace gw2b
+{
+class DatFile;
+class DatIndex;
+class ReadIndexTask;
+class ScanDatTask;
+
+/** Brings the index of a .dat up to date. Knows where the index and its MFT
+ *  snapshot are kept, which indexed files went stale when the .dat was
+ *  patched, and which files still have to be scanned. It only creates the
+ *  tasks, running them is up to the front end. */
+class DatIndexLoader
+{
+    DatFile&                    m_datFile;
+    std::shared_ptr<DatIndex>   m_index;
+    wxString                    m_datPath;
+    wxFileName                  m_indexPath;
+    Array<byte>                 m_staleFiles;
+public:
+    /** Constructor.
+     *  \param[in]  p_datFile    .dat file to index.
+     *  \param[in]  p_index      Index to bring up to date. */
+    DatIndexLoader(DatFile& p_datFile, const std::shared_ptr<DatIndex>& p_index);
+
+    /** Starts over for a newly opened .dat.
+     *  \param[in]  p_datPath    Path of the .dat file.
+     *  \param[in]  p_indexPath  Path of its index file. Empty to use the
+     *                          default one. */
+    void reset(const wxString& p_datPath, const wxFileName& p_indexPath = wxFileName());
+    /** Gets the path of the index file.
+     *  \return wxFileName&  Path of the index file. */
+    const wxFileName& indexPath() const     { return m_indexPath; }
+    /** Gets the path of the MFT snapshot, which is stored next to the index.
+     *  \return wxFileName  Path of the snapshot file. */
+    wxFileName snapshotPath() const;
+
+    /** Creates the task reading the index. If the .dat was patched since it
+     *  was indexed, the MFT snapshot taken back then tells which files
+     *  changed. Only those are dropped from the index, rather than all of it.
+     *  \return ReadIndexTask*   Task reading the index. */
+    ReadIndexTask* createReadTask();
+    /** Creates the task scanning whatever the index is missing, once it has
+     *  been read. Also hands the indexed file sizes still valid to the .dat.
+     *  If the index couldn't be read, everything is scanned.
+     *  \param[in]  p_wasOutdated    true if the index read was written for an
+     *                              older version of the .dat.
+     *  \return ScanDatTask*     Task scanning the missing files, or nullptr if
+     *                          the index is complete. */
+    ScanDatTask* createScanTask(bool p_wasOutdated);
+    /** Clears the index and creates the task indexing the .dat from scratch.
+     *  \return ScanDatTask*     Task scanning all files. */
+    ScanDatTask* createRebuildTask();
+
+    /** Takes a snapshot of the .dat's MFT and writes it next to the index, so
+     *  that only changed files have to be scanned after the next patch. Does
+     *  nothing if there's no index file, as it would be of no use. */
+    void writeMftSnapshot();
+private:
+    bool isIndexedFileValid(uint p_fileNum, uint p_baseId, uint p_fileId);
+    DatIndexLoader(const DatIndexLoader&);
+    DatIndexLoader& operator=(const DatIndexLoader&);
+}; // class DatIndexLoader
+
+}; // namespace gw2b
+
+#endif // DATINDEXLOADER_H_INCLUDED
@@ -0,0 +1,469 @@
+/** \file       DatInflater.cpp
+ *  \brief      Contains the definition of the .dat entry inflater.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include "DatInflater.h"
+
+namespace gw2b
+{
+
+namespace
+{
+    // Every 0x4000th dword of the input is a checksum, and not part of the
+    // bit stream
+    const uint CRC_INTERVAL = 0x4000;
+
+    // Table entries. A zero entry means the code is longer than the table
+    // bits, or not a code at all.
+    //  bits 0-4:   Length of the first code
+    //  bits 5-9:   Length of both codes combined
+    //  bits 10-18: First symbol
+    //  bits 19-26: Second symbol, if any (literals only)
+    //  bits 27-28: Number of symbols
+    inline uint32 makeEntry(uint p_symbol, uint p_bits)
+    {
+        return p_bits | (p_bits << 5) | (p_symbol << 10) | (1 << 27);
+    }
+
+    inline uint32 makePairEntry(uint p_symbol1, uint p_bits1, uint p_symbol2, uint p_bits2)
+    {
+        return p_bits1 | ((p_bits1 + p_bits2) << 5) | (p_symbol1 << 10) | (p_symbol2 << 19) | (2 << 27);
+    }
+
+    inline uint entryBits(uint32 p_entry)           { return p_entry & 0x1f; }
+    inline uint entryTotalBits(uint32 p_entry)      { return (p_entry >> 5) & 0x1f; }
+    inline uint entrySymbol(uint32 p_entry)         { return (p_entry >> 10) & 0x1ff; }
+    inline uint entrySecondSymbol(uint32 p_entry)   { return (p_entry >> 19) & 0xff; }
+    inline uint entryNumSymbols(uint32 p_entry)     { return p_entry >> 27; }
+
+    // Code lengths of the static tree that the block trees are encoded with.
+    // Symbols not listed here are 16 bits.
+    const uint8 s_dictionaryCodes[][2] = {
+        { 0x0A, 3  }, { 0x09, 3  }, { 0x08, 3  },
+        { 0x0C, 4  }, { 0x0B, 4  }, { 0x07, 4  }, { 0x00, 4  },
+        { 0xE0, 5  }, { 0x2A, 5  }, { 0x29, 5  }, { 0x06, 5  },
+        { 0x4A, 6  }, { 0x40, 6  }, { 0x2C, 6  }, { 0x2B, 6  }, { 0x28, 6  }, { 0x20, 6  }, { 0x05, 6  }, { 0x04, 6  },
+        { 0x49, 7  }, { 0x48, 7  }, { 0x27, 7  }, { 0x26, 7  }, { 0x25, 7  }, { 0x0D, 7  }, { 0x03, 7  },
+        { 0x6A, 8  }, { 0x69, 8  }, { 0x4C, 8  }, { 0x4B, 8  }, { 0x47, 8  }, { 0x24, 8  },
+        { 0xE8, 9  }, { 0xA0, 9  }, { 0x89, 9  }, { 0x88, 9  }, { 0x68, 9  }, { 0x67, 9  }, { 0x63, 9  }, { 0x60, 9  },
+        { 0x46, 9  }, { 0x23, 9  },
+        { 0xE9, 10 }, { 0xC9, 10 }, { 0xC0, 10 }, { 0xA9, 10 }, { 0xA8, 10 }, { 0x8A, 10 }, { 0x87, 10 }, { 0x80, 10 },
+        { 0x66, 10 }, { 0x65, 10 }, { 0x45, 10 }, { 0x44, 10 }, { 0x43, 10 }, { 0x2D, 10 }, { 0x02, 10 }, { 0x01, 10 },
+        { 0xE5, 11 }, { 0xC8, 11 }, { 0xAA, 11 }, { 0xA5, 11 }, { 0xA4, 11 }, { 0x8B, 11 }, { 0x85, 11 }, { 0x84, 11 },
+        { 0x6C, 11 }, { 0x6B, 11 }, { 0x64, 11 }, { 0x4D, 11 }, { 0x0E, 11 },
+        { 0xE7, 12 }, { 0xCA, 12 }, { 0xC7, 12 }, { 0xA7, 12 }, { 0xA6, 12 }, { 0x86, 12 }, { 0x83, 12 },
+        { 0xE6, 13 }, { 0xE4, 13 }, { 0xC4, 13 }, { 0x8C, 13 }, { 0x2E, 13 }, { 0x22, 13 },
+        { 0xEC, 14 }, { 0xC6, 14 }, { 0x6D, 14 }, { 0x4E, 14 },
+        { 0xEA, 15 }, { 0xCC, 15 }, { 0xAC, 15 }, { 0xAB, 15 }, { 0x8D, 15 }, { 0x11, 15 }, { 0x10, 15 }, { 0x0F, 15 },
+    };
+};
+
+//============================================================================/
+//      BitReader
+//============================================================================/
+
+/** Reads the input most significant bit first, a dword at a time. The
+ *  buffer is kept left aligned, with at least 32 bits in it after refill(). */
+class DatInflater::BitReader
+{
+    const byte*     m_input;
+    uint            m_numWords;
+    uint            m_position;
+    uint            m_numGraceWords;
+    uint64          m_buffer;
+    uint            m_numBits;
+    uint            m_numPastEndBits;
+public:
+    BitReader(const byte* p_input, uint p_inputSize, bool p_isPartial)
+        : m_input(p_input)
+        , m_numWords(p_inputSize / 4)
+        , m_position(0)
+        , m_numGraceWords(p_isPartial ? 0 : 1)
+        , m_buffer(0)
+        , m_numBits(0)
+        , m_numPastEndBits(0)
+    {
+    }
+
+    void refill()
+    {
+        if (m_numBits > 32) { return; }
+
+        if ((m_position + 1) % CRC_INTERVAL == 0) {
+            m_position++;
+        }
+
+        // Complete input may use the dword past its end, which is read as
+        // zeroes. Anything past that is only there to keep the lookups
+        // going, and using it flags the reader as overrun.
+        uint32 word = 0;
+        if (m_position < m_numWords) {
+            ::memcpy(&word, m_input + m_position * 4, sizeof(word));
+        } else if (m_numGraceWords) {
+            m_numGraceWords--;
+        } else {
+            m_numPastEndBits += 32;
+        }
+        m_position++;
+
+        m_buffer  |= static_cast<uint64>(word) << (32 - m_numBits);
+        m_numBits += 32;
+    }
+
+    uint32 peek(uint p_bits) const
+    {
+        return static_cast<uint32>(m_buffer >> (64 - p_bits));
+    }
+
+    void drop(uint p_bits)
+    {
+        m_buffer <<= p_bits;
+        m_numBits -= p_bits;
+    }
+
+    uint32 read(uint p_bits)
+    {
+        this->refill();
+        uint32 value = this->peek(p_bits);
+        this->drop(p_bits);
+        return value;
+    }
+
+    bool isOverrun() const
+    {
+        return m_numBits < m_numPastEndBits;
+    }
+
+    bool hasReadPastEnd() const
+    {
+        return m_numPastEndBits > 0;
+    }
+}; // class DatInflater::BitReader
+
+//============================================================================/
+//      DatInflater
+//============================================================================/
+
+DatInflater::HuffmanTree    DatInflater::s_dictionary;
+const bool                  DatInflater::s_isDictionaryBuilt = DatInflater::buildDictionary();
+
+DatInflater::DatInflater()
+{
+}
+
+DatInflater::~DatInflater()
+{
+}
+
+uint DatInflater::uncompressedSize(const byte* p_input, uint p_inputSize)
+{
+    if (p_inputSize < 8) { return UINT_MAX; }
+
+    uint32 size;
+    ::memcpy(&size, p_input + 4, sizeof(size));
+    return size;
+}
+
+DatInflater::InflateResult DatInflater::inflate(const byte* p_input, uint p_inputSize, bool p_isPartial, byte* po_output, uint& pio_outputSize, const CancellationToken& p_cancellation)
+{
+    Ensure::notNull(p_input);
+    Ensure::notNull(po_output);
+    Assert(s_isDictionaryBuilt);
+
+    BitReader reader(p_input, p_inputSize, p_isPartial);
+    auto failure = IR_Corrupt;
+
+    while (true) {
+        // Header: an unused dword, the uncompressed size, an unused nibble and
+        // a nibble holding the minimum copy size
+        reader.read(32);
+        uint outputSize = reader.read(32);
+        reader.read(4);
+        uint minCopySize = reader.read(4) + 1;
+        if (reader.isOverrun()) { break; }
+
+        if (pio_outputSize && pio_outputSize < outputSize) {
+            outputSize = pio_outputSize;
+        }
+
+        uint outputPos = 0;
+        while (outputPos < outputSize) {
+            // Blocks are small enough for this to stop huge entries promptly
+            if (p_cancellation.isCancelled()) {
+                pio_outputSize = 0;
+                return IR_Cancelled;
+            }
+
+            if (!parseTree(reader, true, m_symbolTree)) { break; }
+            if (!parseTree(reader, false, m_copyTree)) { break; }
+            uint maxCount = (reader.read(4) + 1) << 12;
+
+            uint count = 0;
+            while (count < maxCount && outputPos < outputSize) {
+                reader.refill();
+                uint32 entry = m_symbolTree.table[reader.peek(TABLE_BITS)];
+
+                // Two literals in one lookup
+                if (entryNumSymbols(entry) == 2 && count + 2 <= maxCount && outputPos + 2 <= outputSize) {
+                    po_output[outputPos++] = static_cast<byte>(entrySymbol(entry));
+                    po_output[outputPos++] = static_cast<byte>(entrySecondSymbol(entry));
+                    reader.drop(entryTotalBits(entry));
+                    count += 2;
+                    continue;
+                }
+
+                uint symbol;
+                if (entryNumSymbols(entry)) {
+                    symbol = entrySymbol(entry);
+                    reader.drop(entryBits(entry));
+                } else if (!readSymbolSlow(reader, m_symbolTree, symbol)) {
+                    break;
+                }
+                count++;
+
+                if (symbol < 0x100) {
+                    po_output[outputPos++] = static_cast<byte>(symbol);
+                    continue;
+                }
+
+                // Copy size: the symbol picks a range, extra bits pick the
+                // value within it
+                symbol -= 0x100;
+                uint sizeRange = symbol >> 2;
+                uint copySize;
+                if (sizeRange == 0) {
+                    copySize = symbol;
+                } else if (sizeRange < 7) {
+                    copySize = (1 << (sizeRange - 1)) * (4 + (symbol & 3));
+                    if (sizeRange > 1) { copySize |= reader.read(sizeRange - 1); }
+                } else if (symbol == 28) {
+                    copySize = 0xff;
+                } else {
+                    break;
+                }
+                copySize += minCopySize;
+
+                // Copy offset, same idea
+                if (!readSymbol(reader, m_copyTree, symbol)) { break; }
+                uint offsetRange = symbol >> 1;
+                uint copyOffset;
+                if (offsetRange == 0) {
+                    copyOffset = symbol;
+                } else if (offsetRange < 17) {
+                    copyOffset = (1 << (offsetRange - 1)) * (2 + (symbol & 1));
+                    if (offsetRange > 1) { copyOffset |= reader.read(offsetRange - 1); }
+                } else {
+                    break;
+                }
+                copyOffset += 1;
+
+                if (copyOffset > outputPos) { break; }
+                copySize = wxMin(copySize, outputSize - outputPos);
+
+                // Overlapping copies repeat the data, and must go byte by byte
+                byte* dest = po_output + outputPos;
+                const byte* source = dest - copyOffset;
+                if (copyOffset >= copySize) {
+                    ::memcpy(dest, source, copySize);
+                } else {
+                    for (uint i = 0; i < copySize; i++) { dest[i] = source[i]; }
+                }
+                outputPos += copySize;
+            }
+
+            if (count < maxCount && outputPos < outputSize) { break; }
+        }
+
+        if (reader.isOverrun() || outputPos < outputSize) { break; }
+
+        pio_outputSize = outputPos;
+        return IR_Success;
+    }
+
+    // Partial input is expected to run out at some point, and anything that
+    // goes wrong once it has is likely caused by that. Codes are looked up
+    // with bits from past the end before being found invalid, so reaching the
+    // end is enough.
+    if (p_isPartial && reader.hasReadPastEnd()) {
+        failure = IR_NotEnoughData;
+    }
+    pio_outputSize = 0;
+    return failure;
+}
+
+bool DatInflater::buildDictionary()
+{
+    uint8 codeBits[0x100];
+    ::memset(codeBits, 16, sizeof(codeBits));
+
+    for (uint i = 0; i < sizeof(s_dictionaryCodes) / sizeof(s_dictionaryCodes[0]); i++) {
+        codeBits[s_dictionaryCodes[i][0]] = s_dictionaryCodes[i][1];
+    }
+
+    return buildTree(codeBits, 0x100, false, s_dictionary);
+}
+
+bool DatInflater::parseTree(BitReader& p_reader, bool p_pairLiterals, HuffmanTree& po_tree)
+{
+    uint numSymbols = p_reader.read(16);
+    if (numSymbols > MAX_SYMBOLS) { return false; }
+
+    // Code lengths are run-length encoded, from the last symbol to the first.
+    // Symbols with a length of 0 are not used.
+    uint8 codeBits[MAX_SYMBOLS];
+    ::memset(codeBits, 0, sizeof(codeBits));
+
+    int remaining = numSymbols - 1;
+    while (remaining >= 0) {
+        uint code;
+        if (!readSymbol(p_reader, s_dictionary, code)) { return false; }
+
+        uint bits  = code & 0x1f;
+        int  count = (code >> 5) + 1;
+
+        if (bits == 0) {
+            remaining -= count;
+            continue;
+        }
+
+        if (count > remaining + 1) { return false; }
+        while (count--) {
+            codeBits[remaining--] = bits;
+        }
+    }
+
+    return buildTree(codeBits, numSymbols, p_pairLiterals, po_tree);
+}
+
+bool DatInflater::buildTree(const uint8* p_codeBits, uint p_numSymbols, bool p_pairLiterals, HuffmanTree& po_tree)
+{
+    // Sort the symbols by code length, then by value
+    uint counts[MAX_CODE_BITS];
+    ::memset(counts, 0, sizeof(counts));
+    for (uint i = 0; i < p_numSymbols; i++) {
+        counts[p_codeBits[i]]++;
+    }
+
+    uint starts[MAX_CODE_BITS];
+    uint next[MAX_CODE_BITS];
+    uint numUsed = 0;
+    for (uint bits = 1; bits < MAX_CODE_BITS; bits++) {
+        starts[bits] = next[bits] = numUsed;
+        numUsed += counts[bits];
+    }
+
+    for (uint i = 0; i < p_numSymbols; i++) {
+        if (p_codeBits[i]) {
+            po_tree.symbols[next[p_codeBits[i]]++] = i;
+        }
+    }
+
+    // Codes are handed out from all ones and down, shorter codes first. Among
+    // codes of the same length, the lowest symbol gets the highest code.
+    ::memset(po_tree.table, 0, sizeof(po_tree.table));
+    po_tree.numRanges = 0;
+
+    int64 code = 0;
+    for (uint bits = 1; bits < MAX_CODE_BITS; bits++) {
+        code = code * 2 + 1;
+        if (!counts[bits]) { continue; }
+        if (code + 1 < counts[bits]) { return false; }
+
+        int64 lowest = code + 1 - counts[bits];
+        uint range   = po_tree.numRanges++;
+        po_tree.rangeStart[range]  = static_cast<uint32>(lowest << (32 - bits));
+        po_tree.rangeOffset[range] = starts[bits] + counts[bits] - 1;
+        po_tree.rangeCount[range]  = counts[bits];
+        po_tree.rangeBits[range]   = bits;
+
+        if (bits <= TABLE_BITS) {
+            for (uint i = 0; i < counts[bits]; i++) {
+                uint   symbol = po_tree.symbols[starts[bits] + i];
+                uint   first  = static_cast<uint>(code - i) << (TABLE_BITS - bits);
+                uint   last   = first + (1 << (TABLE_BITS - bits));
+                uint32 entry  = makeEntry(symbol, bits);
+                for (uint j = first; j < last; j++) {
+                    po_tree.table[j] = entry;
+                }
+            }
+        }
+
+        code = lowest - 1;
+    }
+
+    // Let a literal also pick up the literal after it, if both codes fit
+    if (p_pairLiterals) {
+        for (uint i = 0; i < TABLE_SIZE; i++) {
+            uint32 entry = po_tree.table[i];
+            if (!entryNumSymbols(entry) || entrySymbol(entry) >= 0x100) { continue; }
+
+            uint bits = entryBits(entry);
+            if (bits >= TABLE_BITS) { continue; }
+
+            uint32 second = po_tree.table[(i << bits) & (TABLE_SIZE - 1)];
+            if (!entryNumSymbols(second) || entrySymbol(second) >= 0x100) { continue; }
+            if (bits + entryBits(second) > TABLE_BITS) { continue; }
+
+            po_tree.table[i] = makePairEntry(entrySymbol(entry), bits, entrySymbol(second), entryBits(second));
+        }
+    }
+
+    return true;
+}
+
+inline bool DatInflater::readSymbol(BitReader& p_reader, const HuffmanTree& p_tree, uint& po_symbol)
+{
+    p_reader.refill();
+    uint32 entry = p_tree.table[p_reader.peek(TABLE_BITS)];
+
+    if (entryNumSymbols(entry)) {
+        po_symbol = entrySymbol(entry);
+        p_reader.drop(entryBits(entry));
+        return true;
+    }
+
+    return readSymbolSlow(p_reader, p_tree, po_symbol);
+}
+
+bool DatInflater::readSymbolSlow(BitReader& p_reader, const HuffmanTree& p_tree, uint& po_symbol)
+{
+    p_reader.refill();
+    uint32 bits = p_reader.peek(32);
+
+    // Ranges are ordered from the shortest codes to the longest, which also
+    // puts them in descending order
+    for (uint i = 0; i < p_tree.numRanges; i++) {
+        if (bits < p_tree.rangeStart[i]) { continue; }
+
+        uint index = (bits - p_tree.rangeStart[i]) >> (32 - p_tree.rangeBits[i]);
+        if (index >= p_tree.rangeCount[i]) { return false; }
+
+        po_symbol = p_tree.symbols[p_tree.rangeOffset[i] - index];
+        p_reader.drop(p_tree.rangeBits[i]);
+        return true;
+    }
+
+    return false;
+}
+
+}; // namespace gw2b
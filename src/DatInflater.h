@@ -0,0 +1,120 @@
+/** \file       DatInflater.h
+ *  \brief      Contains the declaration of the .dat entry inflater.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef DATINFLATER_H_INCLUDED
+#define DATINFLATER_H_INCLUDED
+
+#include "Util/CancellationToken.h"
+
+namespace gw2b
+{
+
+/** Inflates compressed .dat entries.
+ *
+ *  The compressed data is a series of blocks, each starting with two
+ *  canonical huffman trees: one for literals and copy sizes, and one for copy
+ *  offsets. The trees are themselves encoded with a static tree. Codes are
+ *  decoded through a lookup table on the next few bits of input, which yields
+ *  two literals at once whenever both fit. Longer codes fall back to a search
+ *  of the code ranges.
+ *
+ *  The object holds the decoding tables, which makes it fairly large, but it
+ *  has no shared state. Separate objects can be used from separate threads. */
+class DatInflater
+{
+public:
+    /** Result of an inflate operation. */
+    enum InflateResult
+    {
+        IR_Success,                 /**< The requested data was inflated. */
+        IR_NotEnoughData,           /**< The input ended before the requested data was inflated. */
+        IR_Corrupt,                 /**< The input is not valid compressed data. */
+        IR_Cancelled,               /**< The operation was cancelled. */
+    };
+private:
+    enum {
+        TABLE_BITS      = 11,
+        TABLE_SIZE      = 1 << TABLE_BITS,
+        MAX_CODE_BITS   = 32,
+        MAX_SYMBOLS     = 285,
+    };
+    struct HuffmanTree
+    {
+        uint32      table[TABLE_SIZE];
+        uint32      rangeStart[MAX_CODE_BITS];
+        uint16      rangeOffset[MAX_CODE_BITS];
+        uint16      rangeCount[MAX_CODE_BITS];
+        uint8       rangeBits[MAX_CODE_BITS];
+        uint16      symbols[MAX_SYMBOLS];
+        uint        numRanges;
+    };
+    class BitReader;
+private:
+    HuffmanTree     m_symbolTree;
+    HuffmanTree     m_copyTree;
+    static HuffmanTree  s_dictionary;
+    static const bool   s_isDictionaryBuilt;
+public:
+    /** Constructor. */
+    DatInflater();
+    /** Destructor. */
+    ~DatInflater();
+
+    /** Inflates compressed entry data.
+     *  \param[in]  p_input          Compressed data.
+     *  \param[in]  p_inputSize      Size of the compressed data, in bytes.
+     *  \param[in]  p_isPartial      true if p_input is only the start of the
+     *                              compressed data. Running out of input then
+     *                              gives IR_NotEnoughData instead of IR_Corrupt.
+     *  \param[out] po_output        Buffer to inflate into. Must be large
+     *                              enough to hold pio_outputSize bytes, or the
+     *                              whole uncompressed data if that is 0.
+     *  \param[in,out]  pio_outputSize   Max amount of bytes to inflate, or 0
+     *                              to inflate everything. Receives the amount
+     *                              of bytes inflated.
+     *  \param[in]  p_cancellation   Token checked between blocks. Optional.
+     *  \return InflateResult   Result of the operation. */
+    InflateResult inflate(const byte* p_input, uint p_inputSize, bool p_isPartial, byte* po_output, uint& pio_outputSize, const CancellationToken& p_cancellation = CancellationToken());
+
+    /** Gets the uncompressed size stored in the header of compressed data.
+     *  \param[in]  p_input      Compressed data.
+     *  \param[in]  p_inputSize  Size of the compressed data, in bytes.
+     *  \return uint    Size of the uncompressed data, or UINT_MAX if the input
+     *                  is too small to contain the header. */
+    static uint uncompressedSize(const byte* p_input, uint p_inputSize);
+private:
+    DatInflater(const DatInflater&);
+    DatInflater& operator=(const DatInflater&);
+
+    static bool buildDictionary();
+    static bool parseTree(BitReader& p_reader, bool p_pairLiterals, HuffmanTree& po_tree);
+    static bool buildTree(const uint8* p_codeBits, uint p_numSymbols, bool p_pairLiterals, HuffmanTree& po_tree);
+    static bool readSymbol(BitReader& p_reader, const HuffmanTree& p_tree, uint& po_symbol);
+    static bool readSymbolSlow(BitReader& p_reader, const HuffmanTree& p_tree, uint& po_symbol);
+}; // class DatInflater
+
+}; // namespace gw2b
+
+#endif // DATINFLATER_H_INCLUDED
@@ -0,0 +1,203 @@
+/** \file       DatPipeline.cpp
+ *  \brief      Contains the definition of the bulk read pipeline.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include <vector>
+#include "DatPipeline.h"
+
+#include "DatFile.h"
+#include "Util/ThreadPool.h"
+#include "Util/WorkPool.h"
+
+namespace gw2b
+{
+
+/** Compressed entry data on its way from the reader to an inflater. Passed
+ *  around by pointer, so that only one thread at a time touches its array. */
+struct DatPipeline::Blob
+{
+    uint        index;
+    uint        entryNum;
+    bool        isRead;
+    Array<byte> input;
+};
+
+DatPipeline::DatPipeline(const DatFile& p_datFile, const Array<uint>& p_entryNums, uint p_peekSize, Ordering p_ordering, const ProcessHandler& p_processHandler)
+    : m_datFile(p_datFile)
+    , m_peekSize(p_peekSize)
+    , m_ordering(p_ordering)
+    , m_resultReady(m_mutex)
+    , m_windowOpen(m_mutex)
+    , m_numConsumed(0)
+    , m_stopping(false)
+    , m_reader(nullptr)
+    , m_inflaters(nullptr)
+    , m_processHandler(p_processHandler)
+    , m_cancellation(CancellationToken::create())
+{
+    Ensure::notNull(&p_datFile);
+
+    // Take a private copy, since the reader thread uses it
+    m_entryNums.SetSize(p_entryNums.GetSize());
+    if (p_entryNums.GetSize()) {
+        ::memcpy(m_entryNums.GetPointer(), p_entryNums.GetPointer(), p_entryNums.GetByteSize());
+    }
+
+    m_inflaters   = new TaskGroup();
+    m_maxInFlight = WorkPool::shared().numThreads() * 8;
+    m_reader      = new ThreadPool(1);
+    m_reader->post([this]() { this->read(); });
+}
+
+DatPipeline::~DatPipeline()
+{
+    {
+        wxMutexLocker lock(m_mutex);
+        m_stopping = true;
+        m_windowOpen.Broadcast();
+    }
+
+    // Inflaters skip their work once stopping, and in-flight inflates bail
+    // out on the cancellation, so this is quick
+    m_cancellation.cancel();
+    m_reader->wait();
+    m_inflaters->wait();
+    deletePointer(m_reader);
+    deletePointer(m_inflaters);
+
+    for (auto it = m_results.begin(); it != m_results.end(); ++it) {
+        delete it->second;
+    }
+}
+
+bool DatPipeline::next(Result& po_result, uint p_timeout)
+{
+    wxMutexLocker lock(m_mutex);
+
+    while (m_numConsumed < m_entryNums.GetSize()) {
+        // Ordered results are handed out by index, unordered in any order
+        auto it = m_results.end();
+        if (m_ordering == PO_Ordered) {
+            it = m_results.find(m_numConsumed);
+        } else {
+            it = m_results.begin();
+        }
+
+        if (it != m_results.end()) {
+            auto result = it->second;
+            m_results.erase(it);
+            m_numConsumed++;
+            m_windowOpen.Signal();
+
+            po_result = *result;
+            delete result;
+            return true;
+        }
+
+        if (!p_timeout || m_resultReady.WaitTimeout(p_timeout) == wxCOND_TIMEOUT) {
+            break;
+        }
+    }
+
+    return false;
+}
+
+bool DatPipeline::isDone()
+{
+    wxMutexLocker lock(m_mutex);
+    return m_numConsumed >= m_entryNums.GetSize();
+}
+
+void DatPipeline::read()
+{
+    Array<byte> scratch;
+    std::vector<Array<byte> > inputs;
+    uint index = 0;
+
+    while (index < m_entryNums.GetSize()) {
+        // Don't get too far ahead of the consumer
+        uint maxEntries;
+        {
+            wxMutexLocker lock(m_mutex);
+            while (!m_stopping && index >= m_numConsumed + m_maxInFlight) {
+                m_windowOpen.Wait();
+            }
+            if (m_stopping) { return; }
+            maxEntries = wxMin(m_numConsumed + m_maxInFlight - index, m_entryNums.GetSize() - index);
+        }
+
+        // The whole window is read in the order it is stored, with
+        // neighbouring entries read together. Peeks only read the start of
+        // each entry, and if that turns out not to be enough the inflater
+        // fetches the rest.
+        inputs.resize(maxEntries);
+        m_datFile.readRawEntries(m_entryNums.GetPointer() + index, maxEntries, (m_peekSize ? PEEK_INPUT_SIZE : 0), &inputs[0], scratch);
+
+        for (uint i = 0; i < maxEntries; i++) {
+            auto blob      = new Blob;
+            blob->index    = index + i;
+            blob->entryNum = m_entryNums[index + i];
+            blob->input    = inputs[i];
+            blob->isRead   = (blob->input.GetSize() > 0);
+            inputs[i]      = Array<byte>();
+
+            m_inflaters->run([this, blob]() { this->inflate(blob); });
+        }
+        index += maxEntries;
+    }
+}
+
+void DatPipeline::inflate(Blob* p_blob)
+{
+    auto result      = new Result;
+    result->index    = p_blob->index;
+    result->entryNum = p_blob->entryNum;
+    result->userData = 0;
+
+    bool isStopping;
+    {
+        wxMutexLocker lock(m_mutex);
+        isStopping = m_stopping;
+    }
+
+    if (!isStopping && p_blob->isRead) {
+        result->data = m_datFile.inflateRawEntry(p_blob->entryNum, p_blob->input, m_peekSize, m_cancellation);
+
+        // The start of the entry may not have been enough
+        bool wasTruncated = (m_peekSize && p_blob->input.GetSize() == PEEK_INPUT_SIZE);
+        if (!result->data.GetSize() && wasTruncated && !m_cancellation.isCancelled()) {
+            result->data.SetSize(m_peekSize);
+            uint size = m_datFile.peekEntry(p_blob->entryNum, m_peekSize, result->data.GetPointer(), p_blob->input);
+            result->data.SetSize(size);
+        }
+
+        if (m_processHandler) { m_processHandler(*result); }
+    }
+    delete p_blob;
+
+    wxMutexLocker lock(m_mutex);
+    m_results[result->index] = result;
+    m_resultReady.Broadcast();
+}
+
+}; // namespace gw2b
@@ -0,0 +1,123 @@
+/** \file       DatPipeline.h
+ *  \brief      Contains the declaration of the bulk read pipeline.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef DATPIPELINE_H_INCLUDED
+#define DATPIPELINE_H_INCLUDED
+
+#include <functional>
+#include <map>
+#include <wx/thread.h>
+
+#include "Util/CancellationToken.h"
+
+namespace gw2b
+{
+class DatFile;
+class TaskGroup;
+class ThreadPool;
+
+/** Reads and inflates a list of .dat entries in the background. A single
+ *  reader stage pulls the compressed data off disk, in the order given, and
+ *  hands it to inflater jobs on the shared WorkPool. Results are picked up
+ *  with next(), either in the order the entries were given or in the order
+ *  they finish. */
+class DatPipeline
+{
+public:
+    /** Determines the order results are returned in. */
+    enum Ordering
+    {
+        PO_Ordered,             /**< Results come out in the order the entries were given. */
+        PO_Unordered,           /**< Results come out as soon as they are done. */
+    };
+    /** Result of reading a single entry. */
+    struct Result
+    {
+        uint        index;      /**< Index of the entry in the list given to the pipeline. */
+        uint        entryNum;   /**< MFT entry number of the entry. */
+        Array<byte> data;       /**< Inflated data. Empty if the entry could not be read. */
+        uint        userData;   /**< Free for the process handler to use. 0 by default. */
+    };
+    /** Handler run by the inflater jobs for each inflated entry, before it
+     *  is handed out. Lets per-entry work run in parallel with the inflating,
+     *  as long as it touches no shared state. */
+    typedef std::function<void(Result& pio_result)> ProcessHandler;
+private:
+    struct Blob;
+    typedef std::map<uint, Result*>     ResultMap;
+    enum { PEEK_INPUT_SIZE = 0x4000 };
+private:
+    const DatFile&  m_datFile;
+    Array<uint>     m_entryNums;
+    uint            m_peekSize;
+    Ordering        m_ordering;
+    uint            m_maxInFlight;
+    wxMutex         m_mutex;
+    wxCondition     m_resultReady;
+    wxCondition     m_windowOpen;
+    ResultMap       m_results;
+    uint            m_numConsumed;
+    bool            m_stopping;
+    ThreadPool*     m_reader;
+    TaskGroup*      m_inflaters;
+    ProcessHandler  m_processHandler;
+    CancellationToken m_cancellation;
+public:
+    /** Constructor. Starts reading right away.
+     *  \param[in]  p_datFile        .dat file to read from. Must stay open
+     *                              while the pipeline is alive.
+     *  \param[in]  p_entryNums      MFT entry numbers to read, in the order they
+     *                              should be read from disk.
+     *  \param[in]  p_peekSize       Amount of bytes to inflate per entry. 0 to
+     *                              inflate entire entries.
+     *  \param[in]  p_ordering       Order in which results are returned.
+     *  \param[in]  p_processHandler Handler to run on each inflated entry,
+     *                              by the inflater jobs. Optional. */
+    DatPipeline(const DatFile& p_datFile, const Array<uint>& p_entryNums, uint p_peekSize, Ordering p_ordering, const ProcessHandler& p_processHandler = ProcessHandler());
+    /** Destructor. Stops the pipeline, dropping any unread results. */
+    ~DatPipeline();
+
+    /** Gets the next result, waiting for it if it isn't done yet.
+     *  \param[out] po_result    Receives the result.
+     *  \param[in]  p_timeout    Max amount of milliseconds to wait. 0 to not wait.
+     *  \return bool    true if a result was returned, false on timeout or if
+     *                  all results have been returned. */
+    bool next(Result& po_result, uint p_timeout);
+    /** Determines whether all results have been returned.
+     *  \return bool    true if done, false if not. */
+    bool isDone();
+    /** Gets the amount of entries the pipeline was given.
+     *  \return uint    Amount of entries. */
+    uint numEntries() const             { return m_entryNums.GetSize(); }
+private:
+    void read();
+    void inflate(Blob* p_blob);
+    DatPipeline(const DatPipeline&);
+    DatPipeline& operator=(const DatPipeline&);
+}; // class DatPipeline
+
+}; // namespace gw2b
+
+#endif // DATPIPELINE_H_INCLUDED
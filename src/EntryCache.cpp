@@ -0,0 +1,158 @@
+/** \file       EntryCache.cpp
+ *  \brief      Contains the definition of the decompressed entry cache.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include "EntryCache.h"
+
+namespace gw2b
+{
+
+EntryCache::EntryCache(uint64 p_budget)
+    : m_budget(p_budget)
+{
+    ::memset(&m_stats, 0, sizeof(m_stats));
+}
+
+EntryCache::~EntryCache()
+{
+}
+
+EntryCache::NodeList::iterator EntryCache::find(uint p_entryNum) const
+{
+    auto it = m_lookup.find(p_entryNum);
+    if (it == m_lookup.end()) {
+        m_stats.misses++;
+        return m_nodes.end();
+    }
+
+    // Move it to the front, since it was just used
+    m_nodes.splice(m_nodes.begin(), m_nodes, it->second);
+    m_stats.hits++;
+    return it->second;
+}
+
+bool EntryCache::get(uint p_entryNum, Array<byte>& po_data) const
+{
+    wxMutexLocker lock(m_mutex);
+
+    auto node = this->find(p_entryNum);
+    if (node == m_nodes.end()) { return false; }
+
+    po_data.SetSize(node->data.GetSize());
+    ::memcpy(po_data.GetPointer(), node->data.GetPointer(), node->data.GetSize());
+    return true;
+}
+
+uint EntryCache::peek(uint p_entryNum, uint p_size, byte* po_buffer) const
+{
+    Ensure::notNull(po_buffer);
+    wxMutexLocker lock(m_mutex);
+
+    auto node = this->find(p_entryNum);
+    if (node == m_nodes.end()) { return 0; }
+
+    uint size = wxMin(p_size, node->data.GetSize());
+    ::memcpy(po_buffer, node->data.GetPointer(), size);
+    return size;
+}
+
+void EntryCache::add(uint p_entryNum, const Array<byte>& p_data)
+{
+    wxMutexLocker lock(m_mutex);
+
+    uint64 size = p_data.GetSize();
+    if (!size || size > m_budget) { return; }
+
+    // Replace any old copy
+    auto it = m_lookup.find(p_entryNum);
+    if (it != m_lookup.end()) {
+        m_stats.size -= it->second->data.GetSize();
+        m_stats.numEntries--;
+        m_nodes.erase(it->second);
+        m_lookup.erase(it);
+    }
+
+    // Make room for it
+    this->evict(m_budget - size);
+
+    Node node;
+    node.entryNum = p_entryNum;
+    node.data.SetSize(p_data.GetSize());
+    ::memcpy(node.data.GetPointer(), p_data.GetPointer(), p_data.GetSize());
+
+    m_nodes.push_front(node);
+    m_lookup[p_entryNum] = m_nodes.begin();
+    m_stats.size += size;
+    m_stats.numEntries++;
+}
+
+void EntryCache::clear()
+{
+    wxMutexLocker lock(m_mutex);
+    m_nodes.clear();
+    m_lookup.clear();
+    m_stats.size       = 0;
+    m_stats.numEntries = 0;
+}
+
+void EntryCache::setBudget(uint64 p_budget)
+{
+    wxMutexLocker lock(m_mutex);
+    m_budget = p_budget;
+    this->evict(p_budget);
+}
+
+uint64 EntryCache::budget() const
+{
+    wxMutexLocker lock(m_mutex);
+    return m_budget;
+}
+
+EntryCache::Stats EntryCache::stats() const
+{
+    wxMutexLocker lock(m_mutex);
+    return m_stats;
+}
+
+void EntryCache::resetStats()
+{
+    wxMutexLocker lock(m_mutex);
+    m_stats.hits      = 0;
+    m_stats.misses    = 0;
+    m_stats.evictions = 0;
+}
+
+void EntryCache::evict(uint64 p_budget)
+{
+    // Drop the least recently used entries until within the given budget
+    while (m_stats.size > p_budget && !m_nodes.empty()) {
+        auto& node = m_nodes.back();
+        m_stats.size -= node.data.GetSize();
+        m_stats.numEntries--;
+        m_stats.evictions++;
+        m_lookup.erase(node.entryNum);
+        m_nodes.pop_back();
+    }
+}
+
+}; // namespace gw2b
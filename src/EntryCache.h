@@ -0,0 +1,112 @@
+/** \file       EntryCache.h
+ *  \brief      Contains the declaration of the decompressed entry cache.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef ENTRYCACHE_H_INCLUDED
+#define ENTRYCACHE_H_INCLUDED
+
+#include <list>
+#include <unordered_map>
+#include <wx/thread.h>
+
+namespace gw2b
+{
+
+/** Least-recently-used cache of decompressed .dat entries, keyed by MFT
+ *  entry number and limited by the total amount of bytes it holds. All
+ *  members are thread safe. Data is copied in and out of the cache, since
+ *  the reference count of Array is not safe to share between threads. */
+class EntryCache
+{
+    struct Node
+    {
+        uint        entryNum;
+        Array<byte> data;
+    };
+    typedef std::list<Node>                                     NodeList;
+    typedef std::unordered_map<uint, NodeList::iterator>        NodeMap;
+public:
+    /** Cache usage statistics. */
+    struct Stats
+    {
+        uint64  hits;           /**< Amount of lookups that found their entry. */
+        uint64  misses;         /**< Amount of lookups that did not. */
+        uint64  evictions;      /**< Amount of entries dropped to stay within budget. */
+        uint64  size;           /**< Amount of bytes currently cached. */
+        uint    numEntries;     /**< Amount of entries currently cached. */
+    };
+private:
+    mutable wxMutex     m_mutex;
+    mutable NodeList    m_nodes;        // most recently used first
+    mutable NodeMap     m_lookup;
+    uint64              m_budget;
+    mutable Stats       m_stats;
+public:
+    /** Constructor.
+     *  \param[in]  p_budget     Max amount of bytes to keep cached. */
+    EntryCache(uint64 p_budget);
+    /** Destructor. */
+    ~EntryCache();
+
+    /** Looks up the given entry and copies its data if it's cached.
+     *  \param[in]  p_entryNum   MFT entry number to look for.
+     *  \param[out] po_data      Receives a copy of the cached data.
+     *  \return bool    true if the entry was cached, false if not. */
+    bool get(uint p_entryNum, Array<byte>& po_data) const;
+    /** Looks up the given entry and copies the start of its data if it's
+     *  cached.
+     *  \param[in]  p_entryNum   MFT entry number to look for.
+     *  \param[in]  p_size       Max amount of bytes to copy.
+     *  \param[out] po_buffer    Buffer to copy to. Must be at least p_size bytes.
+     *  \return uint    Amount of bytes copied, 0 if the entry wasn't cached. */
+    uint peek(uint p_entryNum, uint p_size, byte* po_buffer) const;
+    /** Adds a copy of the given data to the cache, evicting the least
+     *  recently used entries until it fits. Data larger than the whole budget
+     *  is not cached.
+     *  \param[in]  p_entryNum   MFT entry number of the data.
+     *  \param[in]  p_data       Decompressed entry data. */
+    void add(uint p_entryNum, const Array<byte>& p_data);
+    /** Removes all entries. Statistics are kept. */
+    void clear();
+
+    /** Sets the max amount of bytes to keep cached, evicting entries as
+     *  needed. A budget of 0 disables the cache.
+     *  \param[in]  p_budget     Max amount of bytes to keep cached. */
+    void setBudget(uint64 p_budget);
+    /** Gets the max amount of bytes to keep cached.
+     *  \return uint64  Cache budget in bytes. */
+    uint64 budget() const;
+    /** Gets the cache usage statistics.
+     *  \return Stats   Current statistics. */
+    Stats stats() const;
+    /** Resets the hit, miss and eviction counters. */
+    void resetStats();
+private:
+    NodeList::iterator find(uint p_entryNum) const;
+    void evict(uint64 p_budget);
+}; // class EntryCache
+
+}; // namespace gw2b
+
+#endif // ENTRYCACHE_H_INCLUDED
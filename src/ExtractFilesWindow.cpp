@@ -22,24 +22,15 @@
 */
 
 #include "stdafx.h"
-#include <wx/filename.h>
-
-#include "DatFile.h"
-#include "DatIndex.h"
 #include "ExtractFilesWindow.h"
-#include "FileReader.h"
 
 namespace gw2b
 {
 
-ExtractFilesWindow::ExtractFilesWindow(const Array<const DatIndexEntry*>& p_entries, DatFile& p_datFile, const wxString& p_path, ExtractionMode p_mode)
+ExtractFilesWindow::ExtractFilesWindow(const Array<const DatIndexEntry*>& p_entries, DatFile& p_datFile, const wxString& p_path, FileExtractor::ExtractionMode p_mode)
     : wxFrame(nullptr, wxID_ANY, wxT("ProxyWindow"))
-    , m_datFile(p_datFile)
-    , m_entries(p_entries)
+    , m_extractor(nullptr)
     , m_progress(nullptr)
-    , m_path(p_path)
-    , m_currentProgress(0)
-    , m_mode(p_mode)
 {
     this->Hide();
     if (p_entries.GetSize() == 0) {
@@ -47,6 +38,8 @@ ExtractFilesWindow::ExtractFilesWindow(const Array<const DatIndexEntry*>& p_entr
         return;
     }
 
+    m_extractor = new FileExtractor(p_entries, p_datFile, p_path, p_mode);
+
     // Init progress dialog
     auto title = wxString::Format(wxT("Extracting %d %s..."), p_entries.GetSize(), (p_entries.GetSize() == 1 ? wxT("file") : wxT("files")));
     m_progress = new wxProgressDialog(title, wxT("Preparing to extract..."), p_entries.GetSize(), this, wxPD_SMOOTH | wxPD_CAN_ABORT | wxPD_ELAPSED_TIME);
@@ -56,71 +49,39 @@ ExtractFilesWindow::ExtractFilesWindow(const Array<const DatIndexEntry*>& p_entr
     this->Connect(wxEVT_IDLE, wxIdleEventHandler(ExtractFilesWindow::onIdleEvt));
 }
 
-void ExtractFilesWindow::onIdleEvt(wxIdleEvent& p_event)
+void ExtractFilesWindow::stop()
 {
-    // DONE
-    if (m_currentProgress >= m_entries.GetSize()) {
-        deletePointer(m_progress);
-        this->Disconnect(wxEVT_IDLE, wxIdleEventHandler(ExtractFilesWindow::onIdleEvt));
-        this->Destroy();
-        return;
-    }
-
-    // Extract current file
-    this->extractFile(*m_entries[m_currentProgress]);
-    bool shouldContinue = m_progress->Update(m_currentProgress, wxString::Format(wxT("Extracting file %d/%d..."), m_currentProgress, m_entries.GetSize()));
+    if (!m_extractor) { return; }
 
-    if (shouldContinue) {
-        m_currentProgress++;
-    } else {
-        m_currentProgress = m_entries.GetSize();
-    }
-
-    p_event.RequestMore();
+    // Deleting the extractor waits for its pipeline to stop
+    deletePointer(m_extractor);
+    deletePointer(m_progress);
+    this->Disconnect(wxEVT_IDLE, wxIdleEventHandler(ExtractFilesWindow::onIdleEvt));
+    this->Destroy();
 }
 
-void ExtractFilesWindow::extractFile(const DatIndexEntry& p_entry)
+void ExtractFilesWindow::onIdleEvt(wxIdleEvent& p_event)
 {
-    wxFileName filename(m_path, p_entry.name());
-    this->appendPaths(filename, *p_entry.category());
-
-    // Create directory if in-existant
-    if (!filename.DirExists()) {
-        filename.Mkdir(511, wxPATH_MKDIR_FULL);
+    // DONE
+    if (m_extractor->isDone()) {
+        this->stop();
+        return;
     }
 
-    // Read file contents
-    auto contents = m_datFile.readFile(p_entry.mftEntry());
-    if (!contents.GetSize()) { return; }
-
-    // Should we convert the files first?
-    FileReader* reader = nullptr;
-    if (m_mode == EM_Converted) {
-        auto fileType = ANFT_Unknown;
-        m_datFile.identifyFileType(contents.GetPointer(), contents.GetSize(), fileType);
-        reader = FileReader::readerForData(contents, fileType);
+    // Write whatever files the pipeline has finished, waiting a little for
+    // the first one so we don't spin while it's busy
+    uint numExtracted = m_extractor->extract(MAX_FILES_PER_IDLE, 10);
 
-        if (reader) {
-            contents = reader->convertData();
-            filename.SetExt(wxString(reader->extension()).AfterFirst(wxT('.')));
+    if (numExtracted) {
+        uint lastExtracted = m_extractor->numProcessed() - 1;
+        if (!m_progress->Update(lastExtracted, wxString::Format(wxT("Extracting file %d/%d..."), lastExtracted, m_extractor->numFiles()))) {
+            m_extractor->cancel();
         }
+    } else if (!m_progress->Update(m_extractor->numProcessed())) {
+        m_extractor->cancel();
     }
 
-    // Open file for writing
-    wxFile file(filename.GetFullPath(), wxFile::write);
-    if (file.IsOpened()) {
-        file.Write(contents.GetPointer(), contents.GetSize());
-    }
-    file.Close();
-
-    deletePointer(reader);
-}
-
-void ExtractFilesWindow::appendPaths(wxFileName& p_path, const DatIndexCategory& p_category)
-{
-    auto parent = p_category.parent();
-    if (parent) { this->appendPaths(p_path, *parent); }
-    p_path.AppendDir(p_category.name());
+    p_event.RequestMore();
 }
 
 }; // namespace gw2b
@@ -26,37 +26,28 @@
 #ifndef EXTRACTFILESWINDOW_H_INCLUDED
 #define EXTRACTFILESWINDOW_H_INCLUDED
 
-#include <wx/filename.h>
 #include <wx/progdlg.h>
 
+#include "FileExtractor.h"
+
 namespace gw2b
 {
 class DatFile;
-class DatIndexCategory;
 class DatIndexEntry;
 
 /** Acts as a proxy for a progress dialog, since they cannot receive idle events... */
 class ExtractFilesWindow : public wxFrame
 {
-public:
-    enum ExtractionMode
-    {
-        EM_Raw,
-        EM_Converted,
-    };
-private:
-    DatFile&                    m_datFile;
-    Array<const DatIndexEntry*> m_entries;
+    enum { MAX_FILES_PER_IDLE = 0x40 };
+    FileExtractor*              m_extractor;
     wxProgressDialog*           m_progress;
-    uint                        m_currentProgress;
-    wxString                    m_path;
-    ExtractionMode              m_mode;
 public:
-    ExtractFilesWindow(const Array<const DatIndexEntry*>& p_entries, DatFile& p_datFile, const wxString& p_path, ExtractionMode p_mode);
+    ExtractFilesWindow(const Array<const DatIndexEntry*>& p_entries, DatFile& p_datFile, const wxString& p_path, FileExtractor::ExtractionMode p_mode);
+    /** Stops extracting and destroys this window. Files still being read are
+     *  waited for, so the .dat isn't touched anymore once this returns. */
+    void stop();
 private:
     void onIdleEvt(wxIdleEvent& p_event);
-    void extractFile(const DatIndexEntry& p_entry);
-    void appendPaths(wxFileName& p_path, const DatIndexCategory& p_category);
 }; // class ExtractFilesWindow
 
 }; // namespace gw2b
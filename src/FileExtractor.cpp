@@ -0,0 +1,147 @@
+/** \file       FileExtractor.cpp
+ *  \brief      Contains definition of the FileExtractor class.
+ *  \author     Rhoot
+ */
+
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include <algorithm>
+#include <wx/file.h>
+
+#include "DatFile.h"
+#include "DatIndex.h"
+#include "DatPipeline.h"
+#include "FileExtractor.h"
+#include "FileReader.h"
+#include "Util/Profiler.h"
+
+namespace gw2b
+{
+
+FileExtractor::FileExtractor(const Array<const DatIndexEntry*>& p_entries, const DatFile& p_datFile, const wxString& p_path, ExtractionMode p_mode)
+    : m_datFile(p_datFile)
+    , m_entries(p_entries)
+    , m_pipeline(nullptr)
+    , m_path(p_path)
+    , m_mode(p_mode)
+    , m_numProcessed(0)
+    , m_numFailed(0)
+    , m_isCancelled(false)
+{
+    // Extract the files in the order they are stored in the .dat, so that
+    // reading them moves through it sequentially
+    std::sort(m_entries.GetPointer(), m_entries.GetPointer() + m_entries.GetSize(), [&p_datFile](const DatIndexEntry* p_a, const DatIndexEntry* p_b) {
+        return p_datFile.fileOffset(p_a->mftEntry()) < p_datFile.fileOffset(p_b->mftEntry());
+    });
+
+    // Read and inflate the files in the background. Results are written in
+    // whatever order they finish.
+    Array<uint> entryNums(m_entries.GetSize());
+    for (uint i = 0; i < m_entries.GetSize(); i++) {
+        entryNums[i] = m_entries[i]->mftEntry() + p_datFile.mftFileOffset();
+    }
+    m_pipeline = new DatPipeline(p_datFile, entryNums, 0, DatPipeline::PO_Unordered);
+}
+
+FileExtractor::~FileExtractor()
+{
+    deletePointer(m_pipeline);
+}
+
+uint FileExtractor::extract(uint p_maxFiles, uint p_timeout)
+{
+    if (this->isDone()) { return 0; }
+
+    DatPipeline::Result result;
+    uint timeout      = p_timeout;
+    uint numExtracted = 0;
+
+    while (numExtracted < p_maxFiles && m_pipeline->next(result, timeout)) {
+        if (!this->extractFile(*m_entries[result.index], result.data)) {
+            m_numFailed++;
+        }
+        numExtracted++;
+        timeout = 0;
+    }
+
+    m_numProcessed += numExtracted;
+    return numExtracted;
+}
+
+wxString FileExtractor::convertFile(const DatFile& p_datFile, Array<byte>& pio_contents)
+{
+    ScopedTimer timer("FileExtractor::convert");
+
+    auto fileType = ANFT_Unknown;
+    p_datFile.identifyFileType(pio_contents.GetPointer(), pio_contents.GetSize(), fileType);
+    auto reader = FileReader::readerForData(pio_contents, fileType);
+    if (!reader) { return wxEmptyString; }
+
+    // Files that fail to convert, such as ATEX textures on builds that can't
+    // decompress them, are kept as they are
+    wxString extension;
+    auto converted = reader->convertData();
+    if (converted.GetSize()) {
+        pio_contents = converted;
+        extension    = wxString(reader->extension()).AfterFirst(wxT('.'));
+    }
+
+    deletePointer(reader);
+    return extension;
+}
+
+bool FileExtractor::extractFile(const DatIndexEntry& p_entry, Array<byte> p_contents)
+{
+    if (!p_contents.GetSize()) { return false; }
+
+    wxFileName filename(m_path, p_entry.name());
+    this->appendPaths(filename, *p_entry.category());
+
+    // Create directory if in-existant
+    if (!filename.DirExists()) {
+        filename.Mkdir(511, wxPATH_MKDIR_FULL);
+    }
+
+    // Should we convert the files first?
+    if (m_mode == EM_Converted) {
+        auto extension = convertFile(m_datFile, p_contents);
+        if (!extension.IsEmpty()) {
+            filename.SetExt(extension);
+        }
+    }
+
+    // Open file for writing
+    ScopedTimer timer("FileExtractor::write");
+    Profiler::addCount("FileExtractor.bytesWritten", p_contents.GetSize());
+
+    wxFile file(filename.GetFullPath(), wxFile::write);
+    if (!file.IsOpened()) { return false; }
+    return (file.Write(p_contents.GetPointer(), p_contents.GetSize()) == p_contents.GetSize());
+}
+
+void FileExtractor::appendPaths(wxFileName& p_path, const DatIndexCategory& p_category)
+{
+    auto parent = p_category.parent();
+    if (parent) { this->appendPaths(p_path, *parent); }
+    p_path.AppendDir(p_category.name());
+}
+
+}; // namespace gw2b
@@ -0,0 +1,113 @@
+/** \file       FileExtractor.h
+ *  \brief      Contains declaration of the FileExtractor class.
+ *  \author     Rhoot
+ */
+
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef FILEEXTRACTOR_H_INCLUDED
+#define FILEEXTRACTOR_H_INCLUDED
+
+#include <wx/filename.h>
+
+namespace gw2b
+{
+class DatFile;
+class DatIndexCategory;
+class DatIndexEntry;
+class DatPipeline;
+
+/** Extracts index entries into a directory, laid out the same way as the
+ *  categories. The files are read and inflated in the background, in the
+ *  order they are stored in the .dat, and written as they finish. Has no UI
+ *  of its own, so both the extraction window and the command line can drive
+ *  it. */
+class FileExtractor
+{
+public:
+    /** Determines what is written for each file. */
+    enum ExtractionMode
+    {
+        EM_Raw,             /**< Files are written as they are stored in the .dat. */
+        EM_Converted,       /**< Files are converted to a common format where possible. */
+    };
+private:
+    const DatFile&              m_datFile;
+    Array<const DatIndexEntry*> m_entries;
+    DatPipeline*                m_pipeline;
+    wxString                    m_path;
+    ExtractionMode              m_mode;
+    uint                        m_numProcessed;
+    uint                        m_numFailed;
+    bool                        m_isCancelled;
+public:
+    /** Constructor. Starts reading the files right away.
+     *  \param[in]  p_entries    Entries to extract.
+     *  \param[in]  p_datFile    .dat file containing the entries. Must stay
+     *                          open while the extractor is alive.
+     *  \param[in]  p_path       Directory to extract the files to.
+     *  \param[in]  p_mode       What to write for each file. */
+    FileExtractor(const Array<const DatIndexEntry*>& p_entries, const DatFile& p_datFile, const wxString& p_path, ExtractionMode p_mode);
+    /** Destructor. Stops reading any files not yet extracted. */
+    ~FileExtractor();
+
+    /** Writes the files that have been read so far.
+     *  \param[in]  p_maxFiles   Max amount of files to write.
+     *  \param[in]  p_timeout    Max amount of milliseconds to wait for the
+     *                          first file, if none are ready.
+     *  \return uint    Amount of files handled, including failed ones. */
+    uint extract(uint p_maxFiles, uint p_timeout);
+    /** Stops the extraction. Files already written are left as they are. */
+    void cancel()                           { m_isCancelled = true; }
+    /** Determines whether all files were handled, or the extraction was
+     *  cancelled.
+     *  \return bool    true if done, false if not. */
+    bool isDone() const                     { return m_isCancelled || m_numProcessed >= m_entries.GetSize(); }
+    /** Gets the amount of files to extract.
+     *  \return uint    Amount of files. */
+    uint numFiles() const                   { return m_entries.GetSize(); }
+    /** Gets the amount of files handled so far, including failed ones.
+     *  \return uint    Amount of files handled. */
+    uint numProcessed() const               { return m_numProcessed; }
+    /** Gets the amount of files that could not be read or written.
+     *  \return uint    Amount of failed files. */
+    uint numFailed() const                  { return m_numFailed; }
+
+    /** Converts file contents to a common format, the same way converted
+     *  extraction does.
+     *  \param[in]  p_datFile        .dat file the contents were read from.
+     *  \param[in,out]  pio_contents File contents, replaced by the converted
+     *                              data. Left untouched if they couldn't be
+     *                              converted.
+     *  \return wxString    Extension fitting the converted data, without the
+     *                      leading dot. Empty if the data wasn't converted. */
+    static wxString convertFile(const DatFile& p_datFile, Array<byte>& pio_contents);
+private:
+    bool extractFile(const DatIndexEntry& p_entry, Array<byte> p_contents);
+    void appendPaths(wxFileName& p_path, const DatIndexCategory& p_category);
+    FileExtractor(const FileExtractor&);
+    FileExtractor& operator=(const FileExtractor&);
+}; // class FileExtractor
+
+}; // namespace gw2b
+
+#endif // FILEEXTRACTOR_H_INCLUDED
@@ -28,6 +28,7 @@
 #define FILEREADER_H_INCLUDED
 
 #include "Util/Array.h"
+#include "Util/CancellationToken.h"
 #include "ANetStructs.h"
 
 namespace gw2b
@@ -40,6 +41,7 @@ class FileReader
 protected:
     Array<byte>     m_data;
     ANetFileType    m_fileType;
+    CancellationToken m_cancellation;
 public:
     /** Type of data contained in this file. Determines how it is exported. */
     enum DataType
@@ -70,6 +72,14 @@ public:
     /** Converts the data associated with this file into a usable format.
      *  \return Array<byte> converted data. */
     virtual Array<byte> convertData() const;
+    /** Does the expensive part of reading the data up front, so that it can
+     *  be done off the main thread. Readers that have nothing to prepare
+     *  leave this as is. */
+    virtual void prepare()                      { }
+    /** Sets the token that stops the reader from doing any more work once
+     *  cancelled. Readers that are cancelled produce empty output.
+     *  \param[in]  p_cancellation   Token to check. */
+    void setCancellationToken(const CancellationToken& p_cancellation)  { m_cancellation = p_cancellation; }
 
     /** Analyzes the given data and creates an appropriate subclass of 
      *  FileReader to handle it. Caller is responsible for freeing the reader.
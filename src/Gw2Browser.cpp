@@ -25,8 +25,11 @@
 #include "Gw2Browser.h"
 
 #include <vld.h>
+#include <wx/filename.h>
 
 #include "BrowserWindow.h"
+#include "Util/Profiler.h"
+#include "Util/WorkPool.h"
 
 namespace gw2b
 {
@@ -41,13 +44,20 @@ namespace
     struct ArgumentOptions
     {
         wxString datPath;
+        wxString profilePath;
     };
 
     ArgumentOptions parseArguments(int argc, wchar_t** argv)
     {
         ArgumentOptions options;
-        if (argc > 1) {
-            options.datPath = argv[1];
+        for (int i = 1; i < argc; i++) {
+            wxString argument(argv[i]);
+            wxString value;
+            if (argument.StartsWith(wxT("--profile="), &value)) {
+                options.profilePath = value;
+            } else {
+                options.datPath = argument;
+            }
         }
         return options;
     }
@@ -64,6 +74,14 @@ bool Gw2Browser::OnInit()
     window->Show();
 
     auto options = parseArguments(this->argc, this->argv);
+
+    // Profiling is only worth its overhead when asked for
+    m_profilePath = options.profilePath;
+    if (!m_profilePath.IsEmpty()) {
+        Profiler::reset();
+        Profiler::setEnabled(true);
+    }
+
     if (!options.datPath.IsEmpty()) {
         window->openFile(options.datPath);
     }
@@ -73,4 +91,25 @@ bool Gw2Browser::OnInit()
 
 //============================================================================/
 
+int Gw2Browser::OnExit()
+{
+    // Its workers must be joined before wxWidgets shuts down
+    WorkPool::destroyShared();
+
+    // The trace goes where asked, with the totals next to it
+    if (!m_profilePath.IsEmpty()) {
+        Profiler::setEnabled(false);
+        wxFileName summaryPath(m_profilePath);
+        summaryPath.SetName(summaryPath.GetName() + wxT(".summary"));
+        summaryPath.SetExt(wxT("json"));
+
+        Profiler::writeTrace(m_profilePath);
+        Profiler::writeSummary(summaryPath.GetFullPath());
+    }
+
+    return wxApp::OnExit();
+}
+
+//============================================================================/
+
 }; // namespace gw2b
@@ -32,10 +32,14 @@ namespace gw2b
 /** Represents the Gw2Browser application. */
 class Gw2Browser : public wxApp
 {
+    wxString    m_profilePath;
 public:
     /** Initializes the application (acts as the application entry-point). 
      *  \return bool    True if initialization was successful, false if not. */
     virtual bool OnInit() override;
+    /** Cleans up the application before it exits.
+     *  \return int     Exit code of the application. */
+    virtual int OnExit() override;
 
 }; // class Gw2Browser
 
@@ -6,6 +6,10 @@
 #include <cstdio>
 #include "AtexAsm.h"
 
+// The decompressor is x86 inline assembly, which only MSVC's 32-bit compiler
+// understands. Elsewhere ATEX textures can't be decompressed.
+#if defined(_MSC_VER) && defined(_M_IX86)
+
 unsigned int ImageFormats[]={ 0x0B2,0x12,0x0B2,0x72,0x12,0x12,0x12,0x100,0x1A4,0x1A4,0x1A4,0x104,0x0A2,0x78,0x400,0x71,0x0B1,0x0B1,0x0B1,0x0B1,0x0A1,0x11,0x201 };
 
 unsigned char byte_79053C[]={0x6,0x10,0x6,0x0F,0x6,0x0E,0x6,0x0D,0x6,0x0C,0x6,0x0B,0x6,0x0A,0x6,0x9,0x6,0x8,0x6,0x7,0x6,0x6,0x6,0x5,0x6,0x4,0x6,0x3,0x6,0x2,0x6,0x1,0x2,0x11,0x2,0x11,0x2,0x11,0x2,0x11,0x2,0x11,0x2,0x11,0x2,0x11,0x2,0x11,0x2,0x11,0x2,0x11,0x2,0x11,0x2,0x11,0x2,0x11,0x2,0x11,0x2,0x11,0x2,0x11,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0,0x1,0x0};
@@ -2055,3 +2059,12 @@ bool AtexDecompress(const unsigned int *InputBuffer, unsigned int BufferSize, un
 	gw2b::freePointer(DcmpBuffer1);
     return true;
 }
+
+#else
+
+bool AtexDecompress(const unsigned int *InputBuffer, unsigned int BufferSize, unsigned int ImageFormat, SImageDescriptor ImageDescriptor, unsigned int *OutBuffer)
+{
+    return false;
+}
+
+#endif
@@ -4,7 +4,7 @@
 #include "stdafx.h"
 #include "crc.h"
 
-int crc_table[16] =
+unsigned int crc_table[16] =
 {
     0x00000000,	0xfdb71064,	0xfb6e20c8,	0x06d930ac,
     0xf6dc4190,	0x0b6b51f4,	0x0db26158,	0xf005713c,
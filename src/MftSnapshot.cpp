@@ -0,0 +1,136 @@
+/** \file       MftSnapshot.cpp
+ *  \brief      Contains the definition of the MFT snapshot class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include <wx/file.h>
+#include "MftSnapshot.h"
+
+#include "DatFile.h"
+
+namespace gw2b
+{
+
+MftSnapshot::MftSnapshot()
+    : m_datTimestamp(0)
+{
+}
+
+MftSnapshot::~MftSnapshot()
+{
+}
+
+void MftSnapshot::take(const DatFile& p_datFile, uint64 p_datTimestamp)
+{
+    this->clear();
+    if (!p_datFile.isOpen()) { return; }
+
+    m_records.SetSize(p_datFile.numFiles());
+    for (uint i = 0; i < m_records.GetSize(); i++) {
+        ANetMftEntry entry;
+        ::memset(&entry, 0, sizeof(entry));
+        p_datFile.fileRecord(i, entry);
+
+        m_records[i].offset  = entry.offset;
+        m_records[i].size    = entry.size;
+        m_records[i].crc     = entry.crc;
+        m_records[i].counter = entry.counter;
+    }
+    m_datTimestamp = p_datTimestamp;
+}
+
+bool MftSnapshot::read(const wxString& p_filename)
+{
+    this->clear();
+    if (!wxFile::Exists(p_filename)) { return false; }
+
+    wxFile file(p_filename);
+    if (!file.IsOpened()) { return false; }
+
+    while (true) {
+        Head head;
+        if (file.Read(&head, sizeof(head)) != sizeof(head)) { break; }
+        if (head.magic != MftSnapshot_Magic || head.version != MftSnapshot_Version) { break; }
+        if (file.Length() != (wxFileOffset)(sizeof(head) + head.numFiles * (uint64)sizeof(Record))) { break; }
+
+        m_records.SetSize(head.numFiles);
+        uint recordsSize = m_records.GetSize() * sizeof(Record);
+        if (file.Read(m_records.GetPointer(), recordsSize) != (ssize_t)recordsSize) { break; }
+
+        m_datTimestamp = head.datTimestamp;
+        return true;
+    }
+
+    this->clear();
+    return false;
+}
+
+bool MftSnapshot::write(const wxString& p_filename) const
+{
+    // Write next to the target and rename it over, like the index, so a
+    // failed write never leaves a broken snapshot behind
+    auto tempFilename = p_filename + wxT(".tmp");
+
+    wxFile file(tempFilename, wxFile::write);
+    if (!file.IsOpened()) { return false; }
+
+    Head head;
+    head.magic        = MftSnapshot_Magic;
+    head.version      = MftSnapshot_Version;
+    head.datTimestamp = m_datTimestamp;
+    head.numFiles     = m_records.GetSize();
+
+    uint recordsSize = m_records.GetSize() * sizeof(Record);
+    bool isWritten   = (file.Write(&head, sizeof(head)) == sizeof(head))
+                    && (file.Write(m_records.GetPointer(), recordsSize) == recordsSize)
+                    && file.Flush();
+    file.Close();
+
+    if (!isWritten || !replaceFile(tempFilename, p_filename)) {
+        wxRemoveFile(tempFilename);
+        return false;
+    }
+    return true;
+}
+
+void MftSnapshot::clear()
+{
+    m_records.Clear();
+    m_datTimestamp = 0;
+}
+
+bool MftSnapshot::hasFileChanged(const DatFile& p_datFile, uint p_fileNum) const
+{
+    // Files past the end of the snapshot are new
+    if (p_fileNum >= m_records.GetSize()) { return true; }
+
+    ANetMftEntry entry;
+    if (!p_datFile.fileRecord(p_fileNum, entry)) { return true; }
+
+    auto& record = m_records[p_fileNum];
+    return (record.offset  != entry.offset)
+        || (record.size    != entry.size)
+        || (record.crc     != entry.crc)
+        || (record.counter != entry.counter);
+}
+
+}; // namespace gw2b
@@ -0,0 +1,102 @@
+/** \file       MftSnapshot.h
+ *  \brief      Contains the declaration of the MFT snapshot class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef MFTSNAPSHOT_H_INCLUDED
+#define MFTSNAPSHOT_H_INCLUDED
+
+namespace gw2b
+{
+class DatFile;
+
+enum {
+    MftSnapshot_Magic       = 0x534d,
+    MftSnapshot_Version     =    0x1,
+};
+
+/** Snapshot of the MFT file records of a .dat, taken when it is indexed. The
+ *  game patches the .dat in place, so comparing a snapshot against the current
+ *  MFT tells which files were added or changed since, and only those need to
+ *  be scanned again. */
+class MftSnapshot
+{
+#pragma pack(push, 1)
+    struct Head
+    {
+        uint16  magic;              /**< Contains 'MS'. */
+        uint16  version;            /**< Snapshot format version. */
+        uint64  datTimestamp;       /**< Timestamp of the .dat the snapshot was taken of. */
+        uint32  numFiles;           /**< Amount of file records. */
+    };
+    struct Record
+    {
+        uint64  offset;             /**< Location of the file in the .dat. */
+        uint32  size;               /**< Stored size of the file. */
+        uint32  crc;                /**< CRC of the file, as stored in the MFT. */
+        uint32  counter;            /**< Counter of the file, as stored in the MFT. */
+    };
+#pragma pack(pop)
+private:
+    Array<Record>   m_records;
+    uint64          m_datTimestamp;
+public:
+    /** Constructor. Creates an empty snapshot. */
+    MftSnapshot();
+    /** Destructor. */
+    ~MftSnapshot();
+
+    /** Takes a snapshot of the file records of the given .dat.
+     *  \param[in]  p_datFile        .dat file to take the snapshot of.
+     *  \param[in]  p_datTimestamp   Timestamp of the .dat file. */
+    void take(const DatFile& p_datFile, uint64 p_datTimestamp);
+    /** Reads a snapshot from file.
+     *  \param[in]  p_filename   File to read from.
+     *  \return bool    true if successful, false if not. The snapshot is
+     *                  left empty on failure. */
+    bool read(const wxString& p_filename);
+    /** Writes the snapshot to file.
+     *  \param[in]  p_filename   File to write to.
+     *  \return bool    true if successful, false if not. */
+    bool write(const wxString& p_filename) const;
+    /** Empties the snapshot. */
+    void clear();
+
+    /** Checks whether the given file was added or changed since the snapshot
+     *  was taken.
+     *  \param[in]  p_datFile    Current version of the .dat file.
+     *  \param[in]  p_fileNum    File entry number to check.
+     *  \return bool    true if the file differs from the snapshot, false if not. */
+    bool hasFileChanged(const DatFile& p_datFile, uint p_fileNum) const;
+
+    /** Gets the timestamp of the .dat the snapshot was taken of.
+     *  \return uint64  Timestamp of the .dat, 0 if the snapshot is empty. */
+    uint64 datTimestamp() const         { return m_datTimestamp; }
+    /** Gets the amount of file records in the snapshot.
+     *  \return uint    Amount of file records. */
+    uint numFiles() const               { return m_records.GetSize(); }
+}; // class MftSnapshot
+
+}; // namespace gw2b
+
+#endif // MFTSNAPSHOT_H_INCLUDED
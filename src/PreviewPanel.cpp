@@ -25,7 +25,6 @@
 #include "PreviewPanel.h"
 
 #include "DatFile.h"
-#include "DatIndex.h"
 
 #include "Viewers/BinaryViewer.h"
 #include "Viewers/ImageViewer.h"
@@ -48,19 +47,13 @@ PreviewPanel::~PreviewPanel()
 {
 }
 
-bool PreviewPanel::previewFile(DatFile& p_datFile, const DatIndexEntry& p_entry)
+bool PreviewPanel::previewFile(DatFile& p_datFile, FileReader* p_reader)
 {
-    auto entryData = p_datFile.readFile(p_entry.mftEntry());
-    if (!entryData.GetSize()) { return false; }
-
-    // Create file reader
-    auto reader = FileReader::readerForData(entryData, p_entry.fileType());
-
-    if (reader) {
+    if (p_reader) {
         if (m_currentView) {
             // Check if we can re-use the current viewer
-            if (m_currentDataType == reader->dataType()) {
-                m_currentView->setReader(reader);
+            if (m_currentDataType == p_reader->dataType()) {
+                m_currentView->setReader(p_reader);
                 return true;
             }
         
@@ -71,17 +64,18 @@ bool PreviewPanel::previewFile(DatFile& p_datFile, const DatIndexEntry& p_entry)
             }
         }
 
-        m_currentView = this->createViewerForDataType(reader->dataType(), p_datFile);
+        m_currentView = this->createViewerForDataType(p_reader->dataType(), p_datFile);
         if (m_currentView) {
             // Workaround for wxWidgets fuckups
             this->GetSizer()->Add(m_currentView, wxSizerFlags().Expand().Proportion(1));
             this->GetSizer()->Layout();
             this->GetSizer()->Fit(this);
             // Set the reader
-            m_currentView->setReader(reader);
-            m_currentDataType = reader->dataType();
+            m_currentView->setReader(p_reader);
+            m_currentDataType = p_reader->dataType();
             return true;
         }
+        deletePointer(p_reader);
     }
 
     return false;
@@ -32,7 +32,6 @@
 namespace gw2b
 {
 class DatFile;
-class DatIndexEntry;
 
 /** Panel control used to preview files from the .dat. */
 class PreviewPanel : public wxPanel
@@ -49,9 +48,10 @@ public:
     ~PreviewPanel();
     /** Tells this panel to preview a file.
      *  \param[in]  p_datFile    .dat file containing the file to preview.
-     *  \param[in]  p_entry      Entry to preview.
+     *  \param[in]  p_reader     Reader holding the file to preview. The panel
+     *                          takes ownership of it.
      *  \return bool    true if successful, false if not. */
-    bool previewFile(DatFile& p_datFile, const DatIndexEntry& p_entry);
+    bool previewFile(DatFile& p_datFile, FileReader* p_reader);
 private:
     /** Helper method to create a viewer control to handle the given data type.
      *  The caller is responsible for freeing the viewer.
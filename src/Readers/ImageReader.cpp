@@ -25,6 +25,8 @@
 #include <wx/mstream.h>
 
 #include "Imported/AtexAsm.h"
+#include "Util/Profiler.h"
+#include "Util/WorkPool.h"
 #include "ImageReader.h"
 
 #ifdef RGB
@@ -65,9 +67,23 @@ ImageReader::~ImageReader()
 {
 }
 
+void ImageReader::prepare()
+{
+    m_image = this->decodeImage();
+}
+
 wxImage ImageReader::getImage() const
+{
+    if (m_image.IsOk()) {
+        return m_image;
+    }
+    return this->decodeImage();
+}
+
+wxImage ImageReader::decodeImage() const
 {
     Assert(m_data.GetSize() >= 4);
+    ScopedTimer timer("ImageReader::decode");
 
     wxSize size;
     BGR* colors   = nullptr;
@@ -85,6 +101,13 @@ wxImage ImageReader::getImage() const
         }
     }
 
+    // Partially decoded images are of no use to anyone
+    if (m_cancellation.isCancelled()) {
+        freePointer(colors);
+        freePointer(alphas);
+        return wxImage();
+    }
+
     // Create image and fill it with color data
     wxImage image(size.x, size.y);
     image.SetData(reinterpret_cast<unsigned char*>(colors));
@@ -186,15 +209,14 @@ bool ImageReader::processLuminanceDDS(const DDSHeader* p_header, RGB*& po_colors
     // Read the data (we've already determined that the data is 8bpp above)
     auto pixelData = static_cast<const uint8*>(&m_data[sizeof(*p_header)]);
 
-#pragma omp parallel for
-    for (int y = 0; y < static_cast<int>(p_header->height); y++) {
+    parallelFor(0, static_cast<int>(p_header->height), [&](int y) {
         uint32 curPixel  = (y * p_header->width);
 
         for (uint x = 0; x < p_header->width; x++) {
             ::memset(&po_colors[curPixel], pixelData[curPixel], sizeof(po_colors[curPixel]));
             curPixel++;
         }
-    }
+    }, m_cancellation);
 
     return true;
 }
@@ -229,8 +251,7 @@ bool ImageReader::processUncompressedDDS(const DDSHeader* p_header, RGB*& po_col
     // Read the data (we've already determined that the data is 32bpp)
     auto pixelData = reinterpret_cast<const uint32*>(&m_data[sizeof(*p_header)]);
 
-#pragma omp parallel for
-    for (int y = 0; y < static_cast<int>(p_header->height); y++) {
+    parallelFor(0, static_cast<int>(p_header->height), [&](int y) {
         uint32 curPixel = (y * p_header->width);
 
         for (uint x = 0; x < p_header->width; x++) {
@@ -244,7 +265,7 @@ bool ImageReader::processUncompressedDDS(const DDSHeader* p_header, RGB*& po_col
 
             curPixel++;
         }
-    }
+    }, m_cancellation);
 
     return true;
 }
@@ -433,14 +454,13 @@ void ImageReader::processDXT1(const BGRA* p_data, uint p_width, uint p_height, B
     const uint numHorizBlocks = p_width >> 2;
     const uint numVertBlocks  = p_height >> 2;
 
-#pragma omp parallel for
-    for (int y = 0; y < static_cast<int>(numVertBlocks); y++) {
+    parallelFor(0, static_cast<int>(numVertBlocks), [&](int y) {
         for (uint x = 0; x < numHorizBlocks; x++)
         {
             const DXT1Block& block = blocks[(y * numHorizBlocks) + x];
             this->processDXT1Block(po_colors, po_alphas, block, x * 4, y * 4, p_width);
         }    
-    }
+    }, m_cancellation);
 }
 
 void ImageReader::processDXT1Block(BGR* p_colors, uint8* p_alphas, const DXT1Block& p_block, uint p_blockX, uint p_blockY, uint p_width) const
@@ -478,14 +498,13 @@ void ImageReader::processDXTA(const uint64* p_data, uint p_width, uint p_height,
     const uint numHorizBlocks = p_width >> 2;
     const uint numVertBlocks  = p_height >> 2;
 
-#pragma omp parallel for
-    for (int y = 0; y < static_cast<int>(numVertBlocks); y++) {
+    parallelFor(0, static_cast<int>(numVertBlocks), [&](int y) {
         for (uint x = 0; x < numHorizBlocks; x++)
         {
             uint64 block = p_data[(y * numHorizBlocks) + x];
             this->processDXTABlock(po_colors, block, x * 4, y * 4, p_width);
         }    
-    }
+    }, m_cancellation);
 }
 
 void ImageReader::processDXTABlock(BGR* p_colors, uint64 p_block, uint p_blockX, uint p_blockY, uint p_width) const
@@ -532,14 +551,13 @@ void ImageReader::processDXT3(const BGRA* p_data, uint p_width, uint p_height, B
     const uint numHorizBlocks = p_width >> 2;
     const uint numVertBlocks  = p_height >> 2;
 
-#pragma omp parallel for
-    for (int y = 0; y < static_cast<int>(numVertBlocks); y++) {
+    parallelFor(0, static_cast<int>(numVertBlocks), [&](int y) {
         for (uint x = 0; x < numHorizBlocks; x++)
         {
             const DXT3Block& block = blocks[(y * numHorizBlocks) + x];
             this->processDXT3Block(po_colors, po_alphas, block, x * 4, y * 4, p_width);
         }
-    }
+    }, m_cancellation);
 }
 
 void ImageReader::processDXT3Block(BGR* p_colors, uint8* p_alphas, const DXT3Block& p_block, uint p_blockX, uint p_blockY, uint p_width) const
@@ -580,14 +598,13 @@ void ImageReader::processDXT5(const BGRA* p_data, uint p_width, uint p_height, B
     const uint numHorizBlocks = p_width >> 2;
     const uint numVertBlocks  = p_height >> 2;
 
-#pragma omp parallel for
-    for (int y = 0; y < static_cast<int>(numVertBlocks); y++) {
+    parallelFor(0, static_cast<int>(numVertBlocks), [&](int y) {
         for (uint x = 0; x < numHorizBlocks; x++)
         {
             const DXT3Block& block = blocks[(y * numHorizBlocks) + x];
             this->processDXT5Block(po_colors, po_alphas, block, x * 4, y * 4, p_width);
         }
-    }
+    }, m_cancellation);
 }
 
 void ImageReader::processDXT5Block(BGR* p_colors, uint8* p_alphas, const DXT3Block& p_block, uint p_blockX, uint p_blockY, uint p_width) const
@@ -646,15 +663,14 @@ void ImageReader::process3DCX(const RGBA* p_data, uint p_width, uint p_height, B
     const uint numHorizBlocks = p_width >> 2;
     const uint numVertBlocks  = p_height >> 2;
 
-#pragma omp parallel for
-    for (int y = 0; y < static_cast<int>(numVertBlocks); y++) {
+    parallelFor(0, static_cast<int>(numVertBlocks), [&](int y) {
         for (uint x = 0; x < numHorizBlocks; x++)
         {
             const DCXBlock& block = blocks[(y * numHorizBlocks) + x];
             // 3DCX actually uses RGB and not BGR, so *pretend* that's what the output is
             this->process3DCXBlock(reinterpret_cast<RGB*>(po_colors), block, x * 4, y * 4, p_width);
         }
-    }
+    }, m_cancellation);
 }
 
 void ImageReader::process3DCXBlock(RGB* p_colors, const DCXBlock& p_block, uint p_blockX, uint p_blockY, uint p_width) const
@@ -145,6 +145,7 @@ struct DDSHeader
 
 class ImageReader : public FileReader
 {
+    wxImage     m_image;
 public:
     /** Constructor.
      *  \param[in]  p_data       Data to be handled by this reader.
@@ -163,13 +164,18 @@ public:
     /** Converts the data associated with this file into PNG.
      *  \return Array<byte> converted data. */
     virtual Array<byte> convertData() const;
+    /** Decodes the image up front, so that getImage() only has to hand it
+     *  out. */
+    virtual void prepare() override;
     /** Gets the image contained in the data owned by this reader.
-     *  \return wxImage     Newly created image. */
+     *  \return wxImage     Decoded image. Invalid if the data could not be
+     *                      read, or the reader was cancelled. */
     wxImage getImage() const;
     /** Determines whether the header of this image is valid.
      *  \return bool    true if valid, false if not. */
     static bool isValidHeader(const byte* p_data, uint p_size);
 private:
+    wxImage decodeImage() const;
     bool readDDS(wxSize& po_size, BGR*& po_colors, uint8*& po_alphas) const;
     bool readATEX(wxSize& po_size, BGR*& po_colors, uint8*& po_alphas) const;
 
@@ -26,12 +26,13 @@
 #include <wx/txtstrm.h>
 #include <sstream>
 #include <new>
-#include <vector>
 
 #include "ModelReader.h"
 
 #include "DatFile.h"
 #include "PackFile.h"
+#include "Util/Profiler.h"
+#include "Util/WorkPool.h"
 
 namespace gw2b
 {
@@ -171,6 +172,7 @@ Bounds Model::bounds() const
 
 ModelReader::ModelReader(const Array<byte>& p_data, ANetFileType p_fileType)
     : FileReader(p_data, p_fileType)
+    , m_isPrepared(false)
 {
 }
 
@@ -257,7 +259,21 @@ Array<byte> ModelReader::convertData() const
     return outputData;
 }
 
+void ModelReader::prepare()
+{
+    m_model      = this->readModel();
+    m_isPrepared = true;
+}
+
 Model ModelReader::getModel() const
+{
+    if (m_isPrepared) {
+        return m_model;
+    }
+    return this->readModel();
+}
+
+Model ModelReader::readModel() const
 {
     Model newModel;
 
@@ -267,9 +283,12 @@ Model ModelReader::getModel() const
     }
 
     // Populate the model
+    ScopedTimer timer("ModelReader::parse");
     PackFile packFile(m_data);
     this->readGeometry(newModel, packFile);
+    if (m_cancellation.isCancelled()) { return Model(); }
     this->readMaterialData(newModel, packFile);
+    if (m_cancellation.isCancelled()) { return Model(); }
 
     return newModel;
 }
@@ -299,8 +318,7 @@ void ModelReader::readGeometry(Model& p_model, PackFile& p_packFile) const
     // Create storage for submeshes now, so we can parallelize the loop
     Mesh* meshes = p_model.addMeshes(meshCount);
 
-#pragma omp parallel for shared(meshes)
-    for (int i = 0; i < static_cast<int>(meshCount); i++) {
+    parallelFor(0, static_cast<int>(meshCount), [&](int i) {
         auto pos = reinterpret_cast<const byte*>(&meshInfoOffsetTable[i]);
         
         // Fetch mesh info
@@ -331,7 +349,7 @@ void ModelReader::readGeometry(Model& p_model, PackFile& p_packFile) const
             pos += bufferInfo->indexBufferOffset;
             this->readIndexBuffer(mesh, pos, bufferInfo->indexCount);
         }
-    }
+    }, m_cancellation);
 }
 
 void ModelReader::readIndexBuffer(Mesh& p_mesh, const byte* p_data, uint p_indexCount) const
@@ -368,8 +386,7 @@ void ModelReader::readVertexBuffer(Mesh& p_mesh, const byte* p_data, uint p_vert
     p_mesh.hasNormal = (p_vertexFormat & ANFVF_Normal);
     p_mesh.hasUV     = ((p_vertexFormat & (ANFVF_UV32Mask | ANFVF_UV16Mask)) ? 1 : 0);
 
-#pragma omp parallel for
-    for (int i = 0; i < static_cast<int>(p_vertexCount); i++) {
+    parallelFor(0, static_cast<int>(p_vertexCount), [&](int i) {
         auto pos       = &p_data[i * vertexSize];
         Vertex& vertex = p_mesh.vertices[i];
         uint uvIndex   = 0;
@@ -460,7 +477,7 @@ void ModelReader::readVertexBuffer(Mesh& p_mesh, const byte* p_data, uint p_vert
         if (p_vertexFormat & ANFVF_Unknown5) {
             pos += 12;
         }
-    }
+    }, m_cancellation);
 }
 
 uint ModelReader::vertexSize(ANetFlexibleVertexFormat p_vertexFormat) const
@@ -525,18 +542,14 @@ void ModelReader::readMaterialData(Model& p_model, PackFile& p_packFile) const
     }
 
     // Prepare parallel loop
-    std::vector<omp_lock_t> locks(materialCount);
-    for (auto iter = std::begin(locks); iter != std::end(locks); iter++) {
-        omp_init_lock(&(*iter));
-    }
+    std::unique_ptr<wxMutex[]> locks(new wxMutex[materialCount]);
 
     MaterialData* materialData = p_model.addMaterialData(materialCount);
 
     // Loop through each material info
-#pragma omp parallel for shared(locks, materialData)
-    for (int i = 0; i < static_cast<int>(numMaterialInfo); i++) {
+    parallelFor(0, static_cast<int>(numMaterialInfo), [&](int i) {
         // Bail if no offset or count
-        if (!materialInfoArray[i].materialCount || !materialInfoArray[i].materialsOffset) { continue; }
+        if (!materialInfoArray[i].materialCount || !materialInfoArray[i].materialsOffset) { return; }
 
         // Read the offset table for this set of materials
         auto pos = materialInfoArray[i].materialsOffset + reinterpret_cast<const byte*>(&materialInfoArray[i].materialsOffset);
@@ -550,13 +563,10 @@ void ModelReader::readMaterialData(Model& p_model, PackFile& p_packFile) const
             if (offsetTable[j] == 0) { continue; }
 
             // Only one thread must access this material at a time
-            omp_set_lock(&locks[j]);
+            wxMutexLocker lock(locks[j]);
 
             // Bail if this material index already has data
-            if (data.diffuseMap && data.flags) { 
-                omp_unset_lock(&locks[j]);
-                continue; 
-            }
+            if (data.diffuseMap && data.flags) { continue; }
 
             // Read material info
             pos = offsetTable[j] + reinterpret_cast<const byte*>(&offsetTable[j]);
@@ -564,10 +574,7 @@ void ModelReader::readMaterialData(Model& p_model, PackFile& p_packFile) const
 
             // We are (almost) *only* interested in textures
             data.flags = materialInfo->flags;
-            if (materialInfo->textureCount == 0) { 
-                omp_unset_lock(&locks[j]);
-                continue; 
-            }
+            if (materialInfo->textureCount == 0) { continue; }
 
             pos = materialInfo->texturesOffset + reinterpret_cast<const byte*>(&materialInfo->texturesOffset);
             auto textures = reinterpret_cast<const ANetModelTextureReference*>(pos);
@@ -584,16 +591,8 @@ void ModelReader::readMaterialData(Model& p_model, PackFile& p_packFile) const
                     break;
                 }
             }
-
-            // Let other threads access this material now that we're done
-            omp_unset_lock(&locks[j]);
         }
-    }
-
-    // Destroy locks
-    for (auto iter = std::begin(locks); iter != std::end(locks); iter++) {
-        omp_destroy_lock(&(*iter));
-    }
+    }, m_cancellation);
 }
 
 }; // namespace gw2b
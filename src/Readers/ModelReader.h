@@ -150,6 +150,8 @@ private:
 
 class ModelReader : public FileReader
 {
+    Model   m_model;
+    bool    m_isPrepared;
 public:
     /** Constructor.
      *  \param[in]  pData       Data to be handled by this reader.
@@ -168,11 +170,15 @@ public:
     /** Converts the data associated with this file into OBJ.
      *  \return Array<byte> converted data. */
     virtual Array<byte> convertData() const override;
+    /** Reads the model up front, so that getModel() only has to hand it
+     *  out. */
+    virtual void prepare() override;
     /** Gets the model represented by this data.
-     *  \return Model   model. */
+     *  \return Model   model. Empty if the reader was cancelled. */
     Model getModel() const;
 
 private:
+    Model readModel() const;
     void readGeometry(Model& p_model, PackFile& p_packFile) const;
     void readVertexBuffer(Mesh& p_mesh, const byte* p_data, uint p_vertexCount, ANetFlexibleVertexFormat p_vertexFormat) const;
     void readIndexBuffer(Mesh& p_mesh, const byte* p_data, uint p_indexCount) const;
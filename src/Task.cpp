@@ -44,4 +44,16 @@ void Task::invokeOnCompleteHandler()
     }
 }
 
+void Task::addOnAbortHandler(const OnCompleteHandler& p_handler)
+{
+    m_onAbort.push_back(p_handler);
+}
+
+void Task::invokeOnAbortHandler()
+{
+    for (auto iter = m_onAbort.begin(); iter != m_onAbort.end(); iter++) {
+        (*iter)();
+    }
+}
+
 }; // namespace gw2b
@@ -29,6 +29,8 @@
 #include <functional>
 #include <list>
 
+#include "Util/CancellationToken.h"
+
 namespace gw2b
 {
 
@@ -38,15 +40,24 @@ class Task
 public:
     /** Event handler for task completion. */
     typedef std::function<void()>   OnCompleteHandler;
+    /** Thread a task is performed on. */
+    enum Affinity
+    {
+        TA_MainThread,  /**< Performed in between events on the main thread. */
+        TA_Worker,      /**< Performed from start to end on a worker thread. */
+    };
 private:
     std::list<OnCompleteHandler>    m_onComplete;
+    std::list<OnCompleteHandler>    m_onAbort;
 
-    uint                            m_currentProgress;
-    uint                            m_maxProgress;
+    // Progress is read by the main thread while workers update it
+    volatile uint                   m_currentProgress;
+    volatile uint                   m_maxProgress;
     wxString                        m_label;
+    CancellationToken               m_cancellation;
 public:
     /** Constructor. */
-    Task() : m_currentProgress(0), m_maxProgress(0) {}
+    Task() : m_currentProgress(0), m_maxProgress(0), m_cancellation(CancellationToken::create()) {}
     /** Destructor. */
     virtual ~Task() {}
 
@@ -68,6 +79,12 @@ public:
     void addOnCompleteHandler(const OnCompleteHandler& p_handler);
     void addOnCompleteHandler(OnCompleteHandler&& p_handler);
     void invokeOnCompleteHandler();
+    /** Adds a handler that is invoked when the scheduler aborts this task,
+     *  right before deleting it. Not invoked when the scheduler itself is
+     *  destroyed.
+     *  \param[in]  p_handler    Handler to add. */
+    void addOnAbortHandler(const OnCompleteHandler& p_handler);
+    void invokeOnAbortHandler();
 
     /** Initializes this task.
      *  \return bool    true upon success, false on failure. */
@@ -81,6 +98,21 @@ public:
     /** Determines whether the task can be aborted.
      *  \return bool    true if the task is abortable, false if not. */
     virtual bool canAbort() const                   { return true; }
+    /** Gets the token telling whether this task was cancelled. Long running
+     *  work in perform() should pass it on, or check it every so often.
+     *  \return CancellationToken&  Token of this task. */
+    const CancellationToken& cancellationToken() const { return m_cancellation; }
+    /** Asks this task to stop as soon as it can. Safe to call from any thread.
+     *  Abortable tasks cancelled this way are aborted by the scheduler. */
+    void cancel()                                   { m_cancellation.cancel(); }
+    /** Cancels this task once the given amount of time has passed. Should be
+     *  set before the task is scheduled.
+     *  \param[in]  p_milliseconds   Time from now until the deadline. */
+    void setDeadline(uint p_milliseconds)           { m_cancellation.setDeadline(p_milliseconds); }
+    /** Gets the thread this task should be performed on. Worker tasks must
+     *  not touch the UI, and should set their text before they are started.
+     *  \return Affinity   Thread affinity of this task. */
+    virtual Affinity affinity() const               { return TA_MainThread; }
     
 protected:
     /** Used by subclasses to set current progress.
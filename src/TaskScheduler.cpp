@@ -0,0 +1,288 @@
+/** \file       TaskScheduler.cpp
+ *  \brief      Contains the definition of the task scheduler class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include "TaskScheduler.h"
+
+#include <typeinfo>
+
+#include "Util/Profiler.h"
+
+namespace gw2b
+{
+
+struct TaskScheduler::ScheduledTask
+{
+    enum State
+    {
+        TS_Queued,
+        TS_Running,
+        TS_Finished,
+    };
+
+    Task*           task;
+    Task::Affinity  affinity;
+    Priority        priority;
+    State           state;          // Only used by worker tasks, guarded by m_mutex
+};
+
+TaskScheduler::TaskScheduler(uint p_numWorkers)
+    : m_workerDone(m_mutex)
+    , m_numBusyWorkers(0)
+    , m_numPumps(0)
+    , m_workers(p_numWorkers)
+{
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    for (auto iter = m_tasks.begin(); iter != m_tasks.end(); iter++) {
+        auto scheduled = *iter;
+        auto canAbort  = scheduled->task->canAbort();
+        if (scheduled->affinity == Task::TA_Worker) {
+            this->waitForWorkerTask(scheduled, canAbort);
+        }
+        if (canAbort) {
+            scheduled->task->abort();
+        }
+        deletePointer(scheduled->task);
+        deletePointer(scheduled);
+    }
+}
+
+bool TaskScheduler::schedule(Task* p_task, Priority p_priority)
+{
+    Ensure::notNull(p_task);
+
+    if (!p_task->init()) {
+        deletePointer(p_task);
+        return false;
+    }
+
+    auto scheduled         = new ScheduledTask();
+    scheduled->task        = p_task;
+    scheduled->affinity    = p_task->affinity();
+    scheduled->priority    = p_priority;
+    scheduled->state       = ScheduledTask::TS_Queued;
+
+    // Keep the list sorted by priority, first come first served within one
+    auto iter = m_tasks.begin();
+    while (iter != m_tasks.end() && (*iter)->priority >= p_priority) {
+        iter++;
+    }
+    m_tasks.insert(iter, scheduled);
+    return true;
+}
+
+bool TaskScheduler::abort(Task* p_task)
+{
+    auto iter = this->findTask(p_task);
+    if (iter == m_tasks.end() || !p_task->canAbort()) {
+        return false;
+    }
+
+    auto scheduled = *iter;
+    m_tasks.erase(iter);
+
+    // Running work stops at its next check of the token
+    p_task->cancel();
+    if (scheduled->affinity == Task::TA_Worker) {
+        this->waitForWorkerTask(scheduled, false);
+    }
+    p_task->abort();
+    p_task->invokeOnAbortHandler();
+    deletePointer(scheduled->task);
+    deletePointer(scheduled);
+    return true;
+}
+
+bool TaskScheduler::abortAll()
+{
+    auto iter = m_tasks.begin();
+    while (iter != m_tasks.end()) {
+        // abort() erases the task, so step past it first
+        auto task = (*iter)->task;
+        iter++;
+        this->abort(task);
+    }
+    return m_tasks.empty();
+}
+
+bool TaskScheduler::pump()
+{
+    this->startWorkerTasks();
+    m_numPumps++;
+
+    // Give each main thread task a go, high priority ones get an extra cycle
+    // and low priority ones only get one every other pump
+    for (auto iter = m_tasks.begin(); iter != m_tasks.end(); iter++) {
+        auto scheduled = *iter;
+        if (scheduled->affinity != Task::TA_MainThread) { continue; }
+        if (scheduled->priority == TP_Low && (m_numPumps & 1)) { continue; }
+        if (this->isTaskCancelled(scheduled)) { continue; }
+
+        uint numCycles = (scheduled->priority == TP_High) ? 2 : 1;
+        for (uint i = 0; i < numCycles; i++) {
+            ScopedTimer timer(typeid(*scheduled->task).name());
+            scheduled->task->perform();
+            if (scheduled->task->isDone()) { break; }
+        }
+    }
+
+    // Take the finished tasks off the list before invoking their handlers, as
+    // those are likely to schedule new ones. Tasks that were cancelled, or
+    // whose deadline passed, are aborted once they have stopped instead.
+    TaskList finished;
+    TaskList cancelled;
+    auto iter = m_tasks.begin();
+    while (iter != m_tasks.end()) {
+        if (this->isTaskDone(*iter) && (*iter)->task->isDone()) {
+            finished.push_back(*iter);
+            iter = m_tasks.erase(iter);
+        } else if (this->isTaskCancelled(*iter) && !this->isTaskRunning(*iter)) {
+            cancelled.push_back(*iter);
+            iter = m_tasks.erase(iter);
+        } else {
+            iter++;
+        }
+    }
+
+    for (auto iter = cancelled.begin(); iter != cancelled.end(); iter++) {
+        (*iter)->task->abort();
+        (*iter)->task->invokeOnAbortHandler();
+        deletePointer((*iter)->task);
+        deletePointer(*iter);
+    }
+    for (auto iter = finished.begin(); iter != finished.end(); iter++) {
+        (*iter)->task->invokeOnCompleteHandler();
+        deletePointer((*iter)->task);
+        deletePointer(*iter);
+    }
+
+    // Start any worker tasks the handlers scheduled
+    this->startWorkerTasks();
+
+    // Workers wake the main thread up when they finish, so only main thread
+    // tasks need pumping right away. The handlers may have scheduled some.
+    for (auto iter = m_tasks.begin(); iter != m_tasks.end(); iter++) {
+        if ((*iter)->affinity == Task::TA_MainThread) { return true; }
+    }
+    return false;
+}
+
+bool TaskScheduler::isScheduled(const Task* p_task) const
+{
+    for (auto iter = m_tasks.begin(); iter != m_tasks.end(); iter++) {
+        if ((*iter)->task == p_task) { return true; }
+    }
+    return false;
+}
+
+Task* TaskScheduler::foremostTask() const
+{
+    return m_tasks.empty() ? nullptr : m_tasks.front()->task;
+}
+
+TaskScheduler::TaskList::iterator TaskScheduler::findTask(const Task* p_task)
+{
+    for (auto iter = m_tasks.begin(); iter != m_tasks.end(); iter++) {
+        if ((*iter)->task == p_task) { return iter; }
+    }
+    return m_tasks.end();
+}
+
+void TaskScheduler::startWorkerTasks()
+{
+    wxMutexLocker lock(m_mutex);
+
+    // The list is sorted by priority, so the most important ones start first
+    for (auto iter = m_tasks.begin(); iter != m_tasks.end(); iter++) {
+        if (m_numBusyWorkers >= m_workers.numThreads()) { break; }
+
+        auto scheduled = *iter;
+        if (scheduled->affinity != Task::TA_Worker || scheduled->state != ScheduledTask::TS_Queued) { continue; }
+
+        scheduled->state = ScheduledTask::TS_Running;
+        m_numBusyWorkers++;
+        m_workers.post([this, scheduled]() { this->performWorkerTask(scheduled); });
+    }
+}
+
+void TaskScheduler::performWorkerTask(ScheduledTask* p_scheduled)
+{
+    auto task = p_scheduled->task;
+    while (!this->isTaskCancelled(p_scheduled) && !task->isDone()) {
+        ScopedTimer timer(typeid(*task).name());
+        task->perform();
+    }
+
+    {
+        wxMutexLocker lock(m_mutex);
+        p_scheduled->state = ScheduledTask::TS_Finished;
+        m_numBusyWorkers--;
+        m_workerDone.Broadcast();
+    }
+
+    // Have the main thread pump again, to complete the task
+    ::wxWakeUpIdle();
+}
+
+bool TaskScheduler::isTaskCancelled(ScheduledTask* p_scheduled) const
+{
+    // Tasks that can't be aborted have to run to completion regardless
+    auto task = p_scheduled->task;
+    return task->canAbort() && task->cancellationToken().isCancelled();
+}
+
+bool TaskScheduler::isTaskRunning(ScheduledTask* p_scheduled)
+{
+    // Main thread tasks only run while being pumped
+    if (p_scheduled->affinity == Task::TA_Worker) {
+        wxMutexLocker lock(m_mutex);
+        return (p_scheduled->state == ScheduledTask::TS_Running);
+    }
+    return false;
+}
+
+bool TaskScheduler::isTaskDone(ScheduledTask* p_scheduled)
+{
+    if (p_scheduled->affinity == Task::TA_Worker) {
+        wxMutexLocker lock(m_mutex);
+        return (p_scheduled->state == ScheduledTask::TS_Finished);
+    }
+    return p_scheduled->task->isDone();
+}
+
+void TaskScheduler::waitForWorkerTask(ScheduledTask* p_scheduled, bool p_cancel)
+{
+    if (p_cancel) {
+        p_scheduled->task->cancel();
+    }
+
+    wxMutexLocker lock(m_mutex);
+    while (p_scheduled->state == ScheduledTask::TS_Running) {
+        m_workerDone.Wait();
+    }
+}
+
+}; // namespace gw2b
@@ -0,0 +1,117 @@
+/** \file       TaskScheduler.h
+ *  \brief      Contains the declaration of the task scheduler class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef TASKSCHEDULER_H_INCLUDED
+#define TASKSCHEDULER_H_INCLUDED
+
+#include <list>
+
+#include "Task.h"
+#include "Util/ThreadPool.h"
+
+namespace gw2b
+{
+
+/** Runs any number of tasks side by side. Main thread tasks get a few cycles
+ *  each time the scheduler is pumped, while worker tasks are performed on a
+ *  pool of worker threads. Completion handlers are always invoked from pump(),
+ *  so they run on the main thread regardless of the task's affinity. Abort
+ *  handlers are invoked wherever a task is aborted. */
+class TaskScheduler
+{
+public:
+    /** Priority of a scheduled task. Higher priority tasks are started first
+     *  and get more cycles per pump. */
+    enum Priority
+    {
+        TP_Low,
+        TP_Normal,
+        TP_High,
+    };
+private:
+    struct ScheduledTask;
+    typedef std::list<ScheduledTask*>   TaskList;
+
+    TaskList        m_tasks;
+    wxMutex         m_mutex;
+    wxCondition     m_workerDone;
+    uint            m_numBusyWorkers;
+    uint            m_numPumps;
+    ThreadPool      m_workers;
+public:
+    /** Constructor. Starts the worker threads.
+     *  \param[in]  p_numWorkers     Amount of workers. 0 to use one per CPU. */
+    TaskScheduler(uint p_numWorkers = 0);
+    /** Destructor. Aborts and deletes all tasks still scheduled. */
+    ~TaskScheduler();
+
+    /** Initializes the given task and schedules it for execution.
+     *  \param[in]  p_task       Task to schedule. Ownership is taken.
+     *  \param[in]  p_priority   Priority of the task.
+     *  \return bool    true if the task's init succeeded, false if not. */
+    bool schedule(Task* p_task, Priority p_priority = TP_Normal);
+    /** Aborts and deletes the given task, unless it can't be aborted.
+     *  \param[in]  p_task   Task to abort.
+     *  \return bool    true if the task was aborted, false if not. */
+    bool abort(Task* p_task);
+    /** Aborts and deletes all tasks that can be aborted.
+     *  \return bool    true if no tasks remain, false if not. */
+    bool abortAll();
+    /** Performs the main thread tasks for a few cycles, starts queued worker
+     *  tasks and completes any tasks that are done. Must be called from the
+     *  main thread. Never waits for workers; they call wxWakeUpIdle() when
+     *  they finish a task, so that it gets pumped again.
+     *  \return bool    true if main thread tasks remain, and it should be
+     *                  pumped again right away, false if not. */
+    bool pump();
+
+    /** Determines whether the given task is still scheduled.
+     *  \param[in]  p_task   Task to look for.
+     *  \return bool    true if the task is scheduled, false if not. */
+    bool isScheduled(const Task* p_task) const;
+    /** Determines whether there are no tasks scheduled.
+     *  \return bool    true if no tasks are scheduled, false if not. */
+    bool isIdle() const                 { return m_tasks.empty(); }
+    /** Gets the amount of scheduled tasks.
+     *  \return uint    Amount of tasks. */
+    uint numTasks() const               { return m_tasks.size(); }
+    /** Gets the highest priority task, the one whose progress should be shown.
+     *  \return Task*   Foremost task, or nullptr if idle. */
+    Task* foremostTask() const;
+private:
+    TaskList::iterator findTask(const Task* p_task);
+    void startWorkerTasks();
+    void performWorkerTask(ScheduledTask* p_scheduled);
+    bool isTaskCancelled(ScheduledTask* p_scheduled) const;
+    bool isTaskRunning(ScheduledTask* p_scheduled);
+    bool isTaskDone(ScheduledTask* p_scheduled);
+    void waitForWorkerTask(ScheduledTask* p_scheduled, bool p_cancel);
+    TaskScheduler(const TaskScheduler&);
+    TaskScheduler& operator=(const TaskScheduler&);
+}; // class TaskScheduler
+
+}; // namespace gw2b
+
+#endif // TASKSCHEDULER_H_INCLUDED
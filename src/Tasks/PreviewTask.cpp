@@ -0,0 +1,77 @@
+/** \file       PreviewTask.cpp
+ *  \brief      Contains definition of the PreviewTask class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include "PreviewTask.h"
+
+#include "DatFile.h"
+#include "FileReader.h"
+
+namespace gw2b
+{
+
+PreviewTask::PreviewTask(const DatFile& p_datFile, uint p_fileNum, ANetFileType p_fileType)
+    : m_datFile(p_datFile)
+    , m_fileNum(p_fileNum)
+    , m_fileType(p_fileType)
+    , m_reader(nullptr)
+{
+    Ensure::notNull(&p_datFile);
+}
+
+PreviewTask::~PreviewTask()
+{
+    deletePointer(m_reader);
+}
+
+bool PreviewTask::init()
+{
+    this->setMaxProgress(1);
+    this->setText(wxT("Loading preview..."));
+    return m_datFile.isOpen();
+}
+
+void PreviewTask::perform()
+{
+    auto& cancellation = this->cancellationToken();
+
+    Array<byte> scratch;
+    auto entryData = m_datFile.readFile(m_fileNum, scratch, cancellation);
+
+    if (entryData.GetSize() && !cancellation.isCancelled()) {
+        m_reader = FileReader::readerForData(entryData, m_fileType);
+        m_reader->setCancellationToken(cancellation);
+        m_reader->prepare();
+    }
+
+    this->setCurrentProgress(1);
+}
+
+FileReader* PreviewTask::takeReader()
+{
+    auto reader = m_reader;
+    m_reader    = nullptr;
+    return reader;
+}
+
+}; // namespace gw2b
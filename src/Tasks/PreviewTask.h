@@ -0,0 +1,68 @@
+/** \file       PreviewTask.h
+ *  \brief      Contains declaration of the PreviewTask class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef TASKS_PREVIEWTASK_H_INCLUDED
+#define TASKS_PREVIEWTASK_H_INCLUDED
+
+#include "ANetStructs.h"
+#include "Task.h"
+
+namespace gw2b
+{
+class DatFile;
+class FileReader;
+
+/** Reads and decodes a file for the preview panel on a worker thread, so that
+ *  the UI stays responsive while large files load. Cancelling the task, e.g.
+ *  because another file was selected, stops the read and decode early. */
+class PreviewTask : public Task
+{
+    const DatFile&  m_datFile;
+    uint            m_fileNum;
+    ANetFileType    m_fileType;
+    FileReader*     m_reader;
+public:
+    /** Constructor.
+     *  \param[in]  p_datFile    .dat file to read from. Must stay open while
+     *                          the task is scheduled.
+     *  \param[in]  p_fileNum    MFT file entry number of the file to preview.
+     *  \param[in]  p_fileType   File type of the file to preview. */
+    PreviewTask(const DatFile& p_datFile, uint p_fileNum, ANetFileType p_fileType);
+    virtual ~PreviewTask();
+
+    virtual bool init() override;
+    virtual void perform() override;
+    virtual Affinity affinity() const override  { return TA_Worker; }
+
+    /** Hands over the reader holding the decoded file. The caller is
+     *  responsible for freeing it.
+     *  \return FileReader*     Reader for the file, or nullptr if the file
+     *                          could not be read, or it was already taken. */
+    FileReader* takeReader();
+}; // class PreviewTask
+
+}; // namespace gw2b
+
+#endif // TASKS_PREVIEWTASK_H_INCLUDED
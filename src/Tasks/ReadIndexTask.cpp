@@ -33,17 +33,36 @@ ReadIndexTask::ReadIndexTask(const std::shared_ptr<DatIndex>& p_index, const wxS
     , m_filename(p_filename)
     , m_errorOccured(false)
     , m_datTimestamp(p_datTimestamp)
+    , m_outdatedTimestamp(0)
+    , m_wasOutdated(false)
 {
     Ensure::notNull(p_index.get());
 }
 
+void ReadIndexTask::allowOutdated(uint64 p_indexTimestamp, const DatIndexReader::EntryFilter& p_filter)
+{
+    m_outdatedTimestamp = p_indexTimestamp;
+    m_outdatedFilter    = p_filter;
+}
+
 bool ReadIndexTask::init()
 {
     m_index->clear();
     m_index->setDirty(false);
 
     bool result = m_reader.open(m_filename);
-    if (result) { result = (m_index->datTimestamp() == m_datTimestamp); }
+
+    // An index for an older .dat can only be used if we know which of its
+    // entries are still valid
+    if (result && m_index->datTimestamp() != m_datTimestamp) {
+        result = (m_outdatedFilter && m_index->datTimestamp() == m_outdatedTimestamp);
+        if (result) {
+            m_reader.setEntryFilter(m_outdatedFilter);
+            m_index->setDatTimestamp(m_datTimestamp);
+            m_index->setDirty(true);
+            m_wasOutdated = true;
+        }
+    }
     if (result) { this->setMaxProgress(m_reader.numEntries() + m_reader.numCategories()); }
 
     return result;
@@ -52,6 +71,7 @@ bool ReadIndexTask::init()
 void ReadIndexTask::perform()
 {
     if (!this->isDone()) {
+        DatIndexBatch batch(*m_index);
         m_errorOccured = !(m_reader.read(7) & DatIndexReader::RR_Success);
         if (m_errorOccured) { m_index->clear(); }
         uint progress = m_reader.currentEntry() + m_reader.currentCategory();
@@ -40,9 +40,24 @@ class ReadIndexTask : public Task
     wxString                    m_filename;
     bool                        m_errorOccured;
     uint64                      m_datTimestamp;
+    uint64                      m_outdatedTimestamp;
+    DatIndexReader::EntryFilter m_outdatedFilter;
+    bool                        m_wasOutdated;
 public:
     ReadIndexTask(const std::shared_ptr<DatIndex>& p_index, const wxString& p_filename, uint64 p_datTimestamp);
 
+    /** Allows reading an index written for an older version of the .dat.
+     *  Entries rejected by the filter are left out of the index, which is
+     *  then flagged as dirty so it gets written again.
+     *  \param[in]  p_indexTimestamp     .dat timestamp the index must have
+     *                                  been written for.
+     *  \param[in]  p_filter     Decides which entries are still valid. */
+    void allowOutdated(uint64 p_indexTimestamp, const DatIndexReader::EntryFilter& p_filter);
+    /** Checks whether the index was written for an older version of the .dat,
+     *  and had its entries filtered. Only valid once the task has been initialized.
+     *  \return bool    true if the index was outdated, false if not. */
+    bool wasOutdated() const            { return m_wasOutdated; }
+
     virtual bool init() override;
     virtual void perform() override;
     virtual void abort() override;
@@ -22,11 +22,14 @@
 */
 
 #include "stdafx.h"
+#include <algorithm>
 #include "ScanDatTask.h"
 
 #include "DatFile.h"
 #include "DatIndex.h"
+#include "DatPipeline.h"
 #include "FileReader.h"
+#include "Util/Profiler.h"
 
 namespace gw2b
 {
@@ -34,6 +37,21 @@ namespace gw2b
 ScanDatTask::ScanDatTask(const std::shared_ptr<DatIndex>& p_index, DatFile& p_datFile)
     : m_index(p_index)
     , m_datFile(p_datFile)
+    , m_pipeline(nullptr)
+    , m_progressOffset(0)
+    , m_numScanned(0)
+{
+    Ensure::notNull(p_index.get());
+    Ensure::notNull(&p_datFile);
+}
+
+ScanDatTask::ScanDatTask(const std::shared_ptr<DatIndex>& p_index, DatFile& p_datFile, const Array<uint>& p_fileNums)
+    : m_index(p_index)
+    , m_datFile(p_datFile)
+    , m_pipeline(nullptr)
+    , m_fileNums(p_fileNums)
+    , m_progressOffset(0)
+    , m_numScanned(0)
 {
     Ensure::notNull(p_index.get());
     Ensure::notNull(&p_datFile);
@@ -41,81 +59,130 @@ ScanDatTask::ScanDatTask(const std::shared_ptr<DatIndex>& p_index, DatFile& p_da
 
 ScanDatTask::~ScanDatTask()
 {
+    deletePointer(m_pipeline);
 }
 
 bool ScanDatTask::init()
 {
-    this->setMaxProgress(m_datFile.numFiles());
-    this->setCurrentProgress(m_index->highestMftEntry() + 1);
+    // Unless given the files to scan, continue after the last indexed one
+    if (!m_fileNums.GetSize()) {
+        uint firstFile = m_index->highestMftEntry() + 1;
+        uint filesLeft = m_datFile.numFiles() - firstFile;
+        m_fileNums.SetSize(filesLeft);
+        for (uint i = 0; i < filesLeft; i++) {
+            m_fileNums[i] = firstFile + i;
+        }
+        m_progressOffset = firstFile;
+    }
 
-    uint filesLeft = m_datFile.numFiles() - (m_index->highestMftEntry() + 1);
-    m_index->reserveEntries(filesLeft);
+    this->setMaxProgress(m_progressOffset + m_fileNums.GetSize());
+    this->setCurrentProgress(m_progressOffset);
+    m_index->reserveEntries(m_fileNums.GetSize());
+
+    // Let the pipeline read and inflate the start of each file in the
+    // background. Results are ordered, so that entries are added in the
+    // order the files were given.
+    Array<uint> entryNums(m_fileNums.GetSize());
+    for (uint i = 0; i < m_fileNums.GetSize(); i++) {
+        entryNums[i] = m_fileNums[i] + m_datFile.mftFileOffset();
+    }
+    // Identifying the file types only looks at the data, so it happens on the
+    // pipeline's threads as well. Categorizing touches the index, so that is
+    // left for perform().
+    m_pipeline = new DatPipeline(m_datFile, entryNums, PEEK_SIZE, DatPipeline::PO_Ordered, [this](DatPipeline::Result& pio_result) {
+        this->identifyEntry(pio_result);
+    });
+    m_stopWatch.Start();
 
     return true;
 }
 
 void ScanDatTask::perform()
 {
-    // Make sure the output buffer is big enough
-    this->ensureBufferSize(0x20);
+    // Listeners hear about the added entries once, when this cycle is done
+    DatIndexBatch batch(*m_index);
+
+    // Handle whatever the pipeline has finished, waiting a little for the
+    // first result so we don't spin while it's busy
+    DatPipeline::Result result;
+    uint timeout = 10;
+
+    for (uint i = 0; i < MAX_ENTRIES_PER_PERFORM; i++) {
+        if (!m_pipeline->next(result, timeout)) { break; }
+        timeout = 0;
+
+        uint entryNumber = result.entryNum - m_datFile.mftFileOffset();
+        this->addEntry(entryNumber, static_cast<ANetFileType>(result.userData), result.data);
+        m_numScanned++;
+        this->setCurrentProgress(m_progressOffset + m_numScanned);
+    }
 
-    // Read file
-    uint32 entryNumber = this->currentProgress();
-    uint size = m_datFile.peekFile(entryNumber, 0x20, m_outputBuffer.GetPointer());
+    uint64 filesPerSecond = (uint64)m_numScanned * 1000 / std::max<long>(m_stopWatch.Time(), 1);
+    this->setText(wxString::Format(wxT("Scanning .dat: %d/%d (%d files/s)"), this->currentProgress(), this->maxProgress(), (uint)filesPerSecond));
+}
 
+void ScanDatTask::identifyEntry(DatPipeline::Result& pio_result) const
+{
     // Skip if empty
-    if (!size) {
-        this->setCurrentProgress(entryNumber + 1);
+    if (!pio_result.data.GetSize()) {
         return;
     }
+    ScopedTimer timer("ScanDatTask::identify");
+
+    const byte* data = pio_result.data.GetPointer();
+    uint size        = pio_result.data.GetSize();
+    uint fileNum     = pio_result.entryNum - m_datFile.mftFileOffset();
 
     // Get the file type
     ANetFileType fileType;
-    auto results = m_datFile.identifyFileType(m_outputBuffer.GetPointer(), size, fileType);
+    auto results = m_datFile.identifyFileType(data, size, fileType);
 
     // Enough data to identify the file type?
-    uint lastRequestedSize = 0x20;
+    uint lastRequestedSize = size;
+    Array<byte> scratch;
     while (results == DatFile::IR_NotEnoughData) {
-        uint sizeRequired = this->requiredIdentificationSize(m_outputBuffer.GetPointer(), size, fileType);
+        uint sizeRequired = requiredIdentificationSize(data, size, fileType);
 
         // Prevent infinite loops
-        if (sizeRequired == lastRequestedSize) { break; }
+        if (sizeRequired <= lastRequestedSize) { break; }
         lastRequestedSize = sizeRequired;
 
-        // Re-read with the newly asked-for size
-        this->ensureBufferSize(sizeRequired);
-        size    = m_datFile.peekFile(entryNumber, sizeRequired, m_outputBuffer.GetPointer());
-        results = m_datFile.identifyFileType(m_outputBuffer.GetPointer(), size, fileType);
+        // Re-read with the newly asked-for size. This runs on one of the
+        // pipeline's threads, so it can't use the .dat's own buffers.
+        Array<byte> buffer(sizeRequired);
+        size = m_datFile.peekFile(fileNum, sizeRequired, buffer.GetPointer(), scratch);
+        buffer.SetSize(size);
+        pio_result.data = buffer;
+
+        data    = pio_result.data.GetPointer();
+        results = m_datFile.identifyFileType(data, size, fileType);
     }
 
+    pio_result.userData = fileType;
+}
+
+void ScanDatTask::addEntry(uint p_entryNumber, ANetFileType p_fileType, const Array<byte>& p_data)
+{
     // Need another check, since the file might have been reloaded a couple of times
-    if (!size) {
-        this->setCurrentProgress(entryNumber + 1);
+    if (!p_data.GetSize()) {
         return;
     }
 
     // Categorize the entry
-    auto category = this->categorize(fileType, m_outputBuffer.GetPointer(), size);
+    auto category = this->categorize(p_fileType, p_data.GetPointer(), p_data.GetSize());
 
     // Add to index
-    uint baseId = m_datFile.baseIdFromFileNum(entryNumber);
+    uint baseId = m_datFile.baseIdFromFileNum(p_entryNumber);
     auto& newEntry = m_index->addIndexEntry()
         ->setBaseId(baseId)
-        .setFileId(m_datFile.fileIdFromFileNum(entryNumber))
-        .setFileType(fileType)
-        .setMftEntry(entryNumber)
-        .setName(wxString::Format(wxT("%d"), baseId));
-    // Found a file with no baseId...
-    if (baseId == 0) {
-        newEntry.setName(wxString::Format(wxT("ID-less_%d"), entryNumber));
-    }
+        .setFileId(m_datFile.fileIdFromFileNum(p_entryNumber))
+        .setFileType(p_fileType)
+        .setMftEntry(p_entryNumber)
+        .setSize(m_datFile.fileSize(p_entryNumber));
+    // The name is left at its default, which is derived from the IDs
     // Finalize the add
     category->addEntry(&newEntry);
     newEntry.finalizeAdd();
-
-    // Delete the reader and proceed to the next file
-    this->setText(wxString::Format(wxT("Scanning .dat: %d/%d"), entryNumber, this->maxProgress()));
-    this->setCurrentProgress(entryNumber + 1);
 }
 
 uint ScanDatTask::requiredIdentificationSize(const byte* p_data, uint p_size, ANetFileType p_fileType)
@@ -136,9 +203,68 @@ uint ScanDatTask::requiredIdentificationSize(const byte* p_data, uint p_size, AN
     }
 }
 
+DatIndexCategory* ScanDatTask::categorize(ANetFileType p_fileType, const byte* p_data, uint p_size)
+{
+    ScopedTimer timer("ScanDatTask::categorize");
+
+    // Most files end up in one of a few hundred categories, so remember
+    // which one each kind of file went to instead of looking it up by name
+    uint64 key;
+    if (!categoryKey(p_fileType, p_data, p_size, key)) {
+        return this->findOrAddCategory(p_fileType, p_data, p_size);
+    }
+
+    auto it = m_categoryCache.find(key);
+    if (it != m_categoryCache.end()) {
+        Profiler::addCount("ScanDatTask.categoryCacheHits");
+        return it->second;
+    }
+
+    auto category = this->findOrAddCategory(p_fileType, p_data, p_size);
+    m_categoryCache.insert(std::make_pair(key, category));
+    return category;
+}
+
+bool ScanDatTask::categoryKey(ANetFileType p_fileType, const byte* p_data, uint p_size, uint64& po_key)
+{
+    // The key is made up of the file type and whatever findOrAddCategory
+    // reads from the data to pick a subcategory
+    enum { HAS_DETAIL = 1 << 7 };
+    uint   flags  = p_fileType;
+    uint64 detail = 0;
+    if (p_fileType > 0x7f) { return false; }
+
+    if (p_fileType > ANFT_TextureStart && p_fileType < ANFT_TextureEnd) {
+        if (p_fileType != ANFT_DDS && p_size >= 12) {
+            uint16 width  = *reinterpret_cast<const uint16*>(p_data + 0x8);
+            uint16 height = *reinterpret_cast<const uint16*>(p_data + 0xa);
+            detail = (static_cast<uint64>(width) << 24) | height;
+            flags |= HAS_DETAIL;
+        } else if (p_size >= 20) {
+            uint32 width  = *reinterpret_cast<const uint32*>(p_data + 0x10);
+            uint32 height = *reinterpret_cast<const uint32*>(p_data + 0x0c);
+            if (width >= (1 << 24) || height >= (1 << 24)) { return false; }
+            detail = (static_cast<uint64>(width) << 24) | height;
+            flags |= HAS_DETAIL;
+        }
+    } else if (p_fileType == ANFT_PF) {
+        if (p_size >= 12) {
+            detail = *reinterpret_cast<const uint32*>(p_data + 8);
+            flags |= HAS_DETAIL;
+        }
+    } else if (p_fileType == ANFT_Unknown) {
+        if (p_size < 4) { return false; }
+        detail = *reinterpret_cast<const uint32*>(p_data);
+        flags |= HAS_DETAIL;
+    }
+
+    po_key = (static_cast<uint64>(flags) << 56) | detail;
+    return true;
+}
+
 #define MakeCategory(x)     { category = m_index->findOrAddCategory(x); }
 #define MakeSubCategory(x)  { category = category->findOrAddSubCategory(x); }
-DatIndexCategory* ScanDatTask::categorize(ANetFileType p_fileType, const byte* p_data, uint p_size)
+DatIndexCategory* ScanDatTask::findOrAddCategory(ANetFileType p_fileType, const byte* p_data, uint p_size)
 {
     DatIndexCategory* category = nullptr;
     
@@ -265,11 +391,4 @@ DatIndexCategory* ScanDatTask::categorize(ANetFileType p_fileType, const byte* p
     return category;
 }
 
-void ScanDatTask::ensureBufferSize(uint p_size)
-{
-    if (m_outputBuffer.GetSize() < p_size) {
-        m_outputBuffer.SetSize(p_size);
-    }
-}
-
 }; // namespace gw2b
@@ -26,7 +26,10 @@
 #ifndef TASKS_SCANDATTASK_H_INCLUDED
 #define TASKS_SCANDATTASK_H_INCLUDED
 
+#include <unordered_map>
+#include <wx/stopwatch.h>
 #include "ANetStructs.h"
+#include "DatPipeline.h"
 #include "Task.h"
 
 namespace gw2b
@@ -37,19 +40,35 @@ class DatIndexCategory;
 
 class ScanDatTask : public Task
 {
+    typedef std::unordered_map<uint64, DatIndexCategory*>  CategoryCache;
     std::shared_ptr<DatIndex>   m_index;
-    Array<byte>                 m_outputBuffer;
     DatFile&                    m_datFile;
+    DatPipeline*                m_pipeline;
+    Array<uint>                 m_fileNums;
+    uint                        m_progressOffset;
+    uint                        m_numScanned;
+    wxStopWatch                 m_stopWatch;
+    CategoryCache               m_categoryCache;
+    enum { PEEK_SIZE = 0x200, MAX_ENTRIES_PER_PERFORM = 0x400 };
 public:
+    /** Constructor. Scans the files following the highest one in the index. */
     ScanDatTask(const std::shared_ptr<DatIndex>& p_index, DatFile& p_datFile);
+    /** Constructor. Scans only the given files, in the given order.
+     *  \param[in]  p_index      Index to add the scanned files to.
+     *  \param[in]  p_datFile    .dat file to scan.
+     *  \param[in]  p_fileNums   MFT file entry numbers of the files to scan. */
+    ScanDatTask(const std::shared_ptr<DatIndex>& p_index, DatFile& p_datFile, const Array<uint>& p_fileNums);
     virtual ~ScanDatTask();
 
     virtual bool init() override ;
     virtual void perform() override;
 private:
-    uint requiredIdentificationSize(const byte* p_data, uint p_size, ANetFileType p_fileType);
+    void identifyEntry(DatPipeline::Result& pio_result) const;
+    void addEntry(uint p_entryNumber, ANetFileType p_fileType, const Array<byte>& p_data);
+    static uint requiredIdentificationSize(const byte* p_data, uint p_size, ANetFileType p_fileType);
     DatIndexCategory* categorize(ANetFileType p_fileType, const byte* p_data, uint p_size);
-    void ensureBufferSize(uint p_size);
+    DatIndexCategory* findOrAddCategory(ANetFileType p_fileType, const byte* p_data, uint p_size);
+    static bool categoryKey(ANetFileType p_fileType, const byte* p_data, uint p_size, uint64& po_key);
 }; // class ScanDatTask
 
 }; // namespace gw2b
@@ -31,11 +31,17 @@ WriteIndexTask::WriteIndexTask(const std::shared_ptr<DatIndex>& p_index, const w
     : m_index(p_index)
     , m_writer(*p_index)
     , m_filename(p_filename)
+    , m_isCommitted(false)
     , m_errorOccured(false)
 {
     Ensure::notNull(p_index.get());
 }
 
+WriteIndexTask::~WriteIndexTask()
+{
+    this->clean();
+}
+
 bool WriteIndexTask::init()
 {
     if (!m_filename.DirExists()) {
@@ -44,7 +50,10 @@ bool WriteIndexTask::init()
 
     if (m_index->isDirty()) {
         bool result = m_writer.open(m_filename.GetFullPath());
-        if (result) { this->setMaxProgress(m_writer.numEntries() + m_writer.numCategories()); }
+        // The extra step is the commit
+        if (result) { this->setMaxProgress(m_writer.numEntries() + m_writer.numCategories() + 1); }
+        // Worker tasks can't touch the text once started
+        this->setText(wxT("Saving .dat index..."));
         return result;
     }
     return false;
@@ -52,31 +61,31 @@ bool WriteIndexTask::init()
 
 void WriteIndexTask::perform()
 {
-    if (!this->isDone()) {
-        m_errorOccured = !m_writer.write(7);
+    if (this->isDone()) { return; }
+
+    // Write in large chunks, progress only needs updating every so often
+    if (!m_writer.isDone()) {
+        m_errorOccured = !m_writer.write(0x1000);
         uint progress = m_writer.currentEntry() + m_writer.currentCategory();
         this->setCurrentProgress(progress);
-        this->setText(wxT("Saving .dat index..."));
-        // If something went wrong, we should delete the file again since it's half-complete
-        auto path = m_filename.GetFullPath();
-        if (m_errorOccured && wxFile::Exists(path)) {
-            wxRemoveFile(path);
-        }
-        // If done, remove the dirty flag from the index
-        if (this->isDone()) {
-            m_index->setDirty(false);
-        }
+        return;
+    }
+
+    // The index is only clean once it is actually on disk
+    if (m_writer.commit()) {
+        m_index->setDirty(false);
+        m_isCommitted = true;
+        this->setCurrentProgress(this->maxProgress());
+    } else {
+        m_errorOccured = true;
     }
 }
 
 void WriteIndexTask::abort()
 {
-    m_writer.close();
-    // Remove the file again
-    auto path = m_filename.GetFullPath();
-    if (wxFile::Exists(path)) {
-        wxRemoveFile(path);
-    }
+    // The old index is only replaced once the new one is complete, so there
+    // is nothing to remove
+    this->clean();
 }
 
 void WriteIndexTask::clean()
@@ -86,7 +95,7 @@ void WriteIndexTask::clean()
 
 bool WriteIndexTask::isDone() const
 {
-    return (m_writer.isDone() || m_errorOccured);
+    return (m_isCommitted || m_errorOccured);
 }
 
 }; // namespace gw2b
@@ -35,22 +35,28 @@ namespace gw2b
 {
 class DatIndex;
 
+/** Writes the index to disk. Both building the file and saving it happen on a
+ *  worker thread, so the UI keeps running meanwhile. Nothing may change the
+ *  index until the task is done. */
 class WriteIndexTask : public Task
 {
     std::shared_ptr<DatIndex>   m_index;
     DatIndexWriter              m_writer;
     wxFileName                  m_filename;
-    bool                        m_errorOccured;
+    volatile bool               m_isCommitted;
+    volatile bool               m_errorOccured;
 public:
     WriteIndexTask(const std::shared_ptr<DatIndex>& p_index, const wxFileName& p_filename);
+    virtual ~WriteIndexTask();
 
     virtual bool init();
     virtual void perform();
     virtual void abort();
     virtual void clean();
 
-    virtual bool canAbort() const   { return false; }
+    virtual bool canAbort() const       { return false; }
     virtual bool isDone() const;
+    virtual Affinity affinity() const   { return TA_Worker; }
 }; // class WriteIndexTask
 
 }; // namespace gw2b
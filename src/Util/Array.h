@@ -26,6 +26,8 @@
 #ifndef UTIL_ARRAY_H_INCLUDED
 #define UTIL_ARRAY_H_INCLUDED
 
+#include "Misc.h"
+
 namespace gw2b
 {
     template <typename T>
@@ -117,10 +119,11 @@ namespace gw2b
             return *this;
         }
 
-        /** Clears this array's elements, making it an empty array. */
+        /** Clears this array's elements, making it an empty array. Other
+         *  arrays sharing the elements keep them. */
         void Clear()
         {
-            this->UnShare();
+            this->UnShare(false);
         }
 
         /** Appends an item to this array.
@@ -153,7 +156,7 @@ namespace gw2b
             T*& data   = mData.get()->mData;
 
             for (uint i = 0; i < size; i++) {
-                if (data[i] == pItem)
+                if (data[i] == item)
                     RemoveAt(i);
             }
         }
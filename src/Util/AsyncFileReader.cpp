@@ -0,0 +1,379 @@
+/** \file       Util/AsyncFileReader.cpp
+ *  \brief      Contains the definition of the asynchronous file reader class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include "AsyncFileReader.h"
+#include "RandomAccessFile.h"
+
+#ifdef __linux__
+#  include <errno.h>
+#  include <linux/io_uring.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+namespace gw2b
+{
+
+namespace
+{
+
+/** Slot of the nop that tells the completion thread to stop. */
+const uint STOP_SLOT = ~0u;
+
+}; // namespace
+
+//----------------------------------------------------------------------------
+//      AsyncFileReader::Completer
+//----------------------------------------------------------------------------
+
+class AsyncFileReader::Completer : public wxThread
+{
+    AsyncFileReader& m_reader;
+public:
+    Completer(AsyncFileReader& p_reader)
+        : wxThread(wxTHREAD_JOINABLE)
+        , m_reader(p_reader)
+    {
+    }
+
+    virtual ExitCode Entry()
+    {
+        while (m_reader.complete()) { }
+        return 0;
+    }
+}; // class AsyncFileReader::Completer
+
+//----------------------------------------------------------------------------
+//      AsyncFileReader
+//----------------------------------------------------------------------------
+
+AsyncFileReader::AsyncFileReader(const RandomAccessFile& p_file, uint p_depth)
+    : m_file(p_file)
+    , m_idle(m_mutex)
+    , m_completer(nullptr)
+    , m_ring(-1)
+    , m_numInFlight(0)
+    , m_sqMask(0)
+    , m_cqMask(0)
+    , m_sqTail(nullptr)
+    , m_sqArray(nullptr)
+    , m_sqEntries(nullptr)
+    , m_cqHead(nullptr)
+    , m_cqTail(nullptr)
+    , m_cqEntries(nullptr)
+    , m_sqRing(nullptr)
+    , m_sqRingSize(0)
+    , m_cqRing(nullptr)
+    , m_cqRingSize(0)
+    , m_sqEntriesSize(0)
+{
+    Assert(p_depth > 0);
+    if (!this->setup(p_depth)) {
+        this->release();
+        return;
+    }
+
+    m_slots.resize(p_depth);
+    for (uint i = 0; i < p_depth; i++) {
+        m_freeSlots.push_back(p_depth - i - 1);
+    }
+
+    m_completer = new Completer(*this);
+    if (m_completer->Create() != wxTHREAD_NO_ERROR || m_completer->Run() != wxTHREAD_NO_ERROR) {
+        deletePointer(m_completer);
+        this->release();
+    }
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+    if (this->isAvailable()) {
+        this->cancelPending();
+        this->wait();
+
+        // Wake the completion thread with a nop it knows to stop on
+        {
+            wxMutexLocker lock(m_mutex);
+            this->submit(STOP_SLOT);
+        }
+        m_completer->Wait();
+        deletePointer(m_completer);
+    }
+    this->release();
+}
+
+void AsyncFileReader::read(uint64 p_offset, uint p_size, const CompletionHandler& p_handler)
+{
+    // Without a ring, there is nothing to be asynchronous with
+    if (!this->isAvailable()) {
+        auto buffer = allocate<byte>(p_size);
+        p_handler(buffer, m_file.readAt(p_offset, buffer, p_size));
+        return;
+    }
+
+    Request request;
+    request.offset    = p_offset;
+    request.buffer    = nullptr;
+    request.size      = p_size;
+    request.bytesRead = 0;
+    request.handler   = p_handler;
+
+    wxMutexLocker lock(m_mutex);
+    if (m_freeSlots.empty()) {
+        m_queued.push_back(request);
+        return;
+    }
+
+    uint slot = m_freeSlots.back();
+    m_freeSlots.pop_back();
+    m_slots[slot] = request;
+    m_numInFlight++;
+    this->submit(slot);
+}
+
+void AsyncFileReader::wait()
+{
+    wxMutexLocker lock(m_mutex);
+    while (!m_queued.empty() || m_numInFlight > 0) {
+        m_idle.Wait();
+    }
+}
+
+uint AsyncFileReader::cancelPending()
+{
+    wxMutexLocker lock(m_mutex);
+    uint numDropped = m_queued.size();
+    m_queued.clear();
+    if (!m_numInFlight) { m_idle.Broadcast(); }
+    return numDropped;
+}
+
+bool AsyncFileReader::isIdle()
+{
+    wxMutexLocker lock(m_mutex);
+    return m_queued.empty() && !m_numInFlight;
+}
+
+void AsyncFileReader::finish(uint p_slot)
+{
+    // Run the handler without the lock, so that it may queue more reads
+    CompletionHandler handler;
+    byte* buffer;
+    uint bytesRead;
+    {
+        wxMutexLocker lock(m_mutex);
+        auto& request = m_slots[p_slot];
+        std::swap(handler, request.handler);
+        buffer         = request.buffer;
+        bytesRead      = request.bytesRead;
+        request.buffer = nullptr;
+    }
+    handler(buffer, bytesRead);
+
+    // Hand the slot to the next queued read, if any
+    wxMutexLocker lock(m_mutex);
+    m_numInFlight--;
+    if (m_queued.empty()) {
+        m_freeSlots.push_back(p_slot);
+        if (!m_numInFlight) { m_idle.Broadcast(); }
+        return;
+    }
+
+    m_slots[p_slot] = m_queued.front();
+    m_queued.pop_front();
+    m_numInFlight++;
+    this->submit(p_slot);
+}
+
+#ifdef __linux__
+
+bool AsyncFileReader::setup(uint p_depth)
+{
+    io_uring_params params;
+    ::memset(&params, 0, sizeof(params));
+    m_ring = static_cast<int>(::syscall(__NR_io_uring_setup, p_depth, &params));
+    if (m_ring < 0) { return false; }
+
+    // IORING_OP_READ came with the same kernel as this flag, and there is no
+    // cheaper way to tell whether it is supported
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) { return false; }
+
+    m_sqRingSize    = params.sq_off.array + params.sq_entries * sizeof(uint32);
+    m_cqRingSize    = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    m_sqEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+    // Newer kernels map both rings with a single mapping
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        m_sqRingSize = wxMax(m_sqRingSize, m_cqRingSize);
+        m_cqRingSize = 0;
+    }
+
+    m_sqRing = ::mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQ_RING);
+    if (m_sqRing == MAP_FAILED) { m_sqRing = nullptr; return false; }
+
+    m_cqRing = m_sqRing;
+    if (m_cqRingSize) {
+        m_cqRing = ::mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_CQ_RING);
+        if (m_cqRing == MAP_FAILED) { m_cqRing = nullptr; return false; }
+    }
+
+    m_sqEntries = ::mmap(nullptr, m_sqEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQES);
+    if (m_sqEntries == MAP_FAILED) { m_sqEntries = nullptr; return false; }
+
+    auto sqRing = static_cast<byte*>(m_sqRing);
+    auto cqRing = static_cast<byte*>(m_cqRing);
+    m_sqTail    = reinterpret_cast<uint32*>(sqRing + params.sq_off.tail);
+    m_sqMask    = *reinterpret_cast<uint32*>(sqRing + params.sq_off.ring_mask);
+    m_sqArray   = reinterpret_cast<uint32*>(sqRing + params.sq_off.array);
+    m_cqHead    = reinterpret_cast<uint32*>(cqRing + params.cq_off.head);
+    m_cqTail    = reinterpret_cast<uint32*>(cqRing + params.cq_off.tail);
+    m_cqMask    = *reinterpret_cast<uint32*>(cqRing + params.cq_off.ring_mask);
+    m_cqEntries = cqRing + params.cq_off.cqes;
+
+    // Submission entries are always used in ring order
+    for (uint i = 0; i < params.sq_entries; i++) {
+        m_sqArray[i] = i;
+    }
+    return true;
+}
+
+void AsyncFileReader::release()
+{
+    if (m_sqEntries) { ::munmap(m_sqEntries, m_sqEntriesSize); }
+    if (m_cqRing && m_cqRing != m_sqRing) { ::munmap(m_cqRing, m_cqRingSize); }
+    if (m_sqRing) { ::munmap(m_sqRing, m_sqRingSize); }
+    if (m_ring >= 0) { ::close(m_ring); }
+
+    m_sqEntries = nullptr;
+    m_cqRing    = nullptr;
+    m_sqRing    = nullptr;
+    m_ring      = -1;
+}
+
+void AsyncFileReader::submit(uint p_slot)
+{
+    // Only called with the lock held, so there is a single producer. The
+    // kernel consumes each entry during enter, so the ring never fills up.
+    uint32 tail = *m_sqTail;
+    auto& entry = static_cast<io_uring_sqe*>(m_sqEntries)[tail & m_sqMask];
+    ::memset(&entry, 0, sizeof(entry));
+    entry.user_data = p_slot;
+
+    if (p_slot != STOP_SLOT) {
+        auto& request = m_slots[p_slot];
+        if (!request.buffer) {
+            request.buffer = allocate<byte>(request.size);
+        }
+
+        entry.opcode    = IORING_OP_READ;
+        entry.fd        = m_file.m_file;
+        entry.off       = request.offset + request.bytesRead;
+        entry.addr      = reinterpret_cast<uintptr_t>(request.buffer + request.bytesRead);
+        entry.len       = request.size - request.bytesRead;
+    } else {
+        entry.opcode    = IORING_OP_NOP;
+    }
+
+    storeRelease(*m_sqTail, tail + 1);
+    this->enter(1, 0);
+}
+
+void AsyncFileReader::enter(uint p_toSubmit, uint p_minComplete)
+{
+    uint flags = (p_minComplete ? IORING_ENTER_GETEVENTS : 0);
+    while (::syscall(__NR_io_uring_enter, m_ring, p_toSubmit, p_minComplete, flags, nullptr, 0) < 0) {
+        // Interrupted waits are retried, anything else is a bug
+        Assert(errno == EINTR || errno == EAGAIN || errno == EBUSY);
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) { return; }
+    }
+}
+
+bool AsyncFileReader::complete()
+{
+    this->enter(0, 1);
+
+    // Only this thread moves the head, so no need to load it atomically
+    uint32 head = *m_cqHead;
+    uint32 tail = loadAcquire(*m_cqTail);
+    bool isStopping = false;
+
+    for (; head != tail; head++) {
+        auto& entry     = static_cast<const io_uring_cqe*>(m_cqEntries)[head & m_cqMask];
+        uint slot   = static_cast<uint>(entry.user_data);
+        int result  = entry.res;
+        storeRelease(*m_cqHead, head + 1);
+
+        if (slot == STOP_SLOT) {
+            isStopping = true;
+            continue;
+        }
+
+        // The slot was filled in by another thread. The kernel orders that
+        // before the completion, but the lock says so to the tools too.
+        bool isDone;
+        {
+            wxMutexLocker lock(m_mutex);
+            auto& request = m_slots[slot];
+            if (result > 0) {
+                request.bytesRead += result;
+            }
+
+            // Short reads are continued where they stopped, like readAt does
+            isDone = !((result > 0 && request.bytesRead < request.size) || result == -EINTR || result == -EAGAIN);
+            if (!isDone) { this->submit(slot); }
+        }
+        if (isDone) { this->finish(slot); }
+    }
+
+    return !isStopping;
+}
+
+#else
+
+bool AsyncFileReader::setup(uint WXUNUSED(p_depth))
+{
+    return false;
+}
+
+void AsyncFileReader::release()
+{
+}
+
+void AsyncFileReader::submit(uint WXUNUSED(p_slot))
+{
+}
+
+void AsyncFileReader::enter(uint WXUNUSED(p_toSubmit), uint WXUNUSED(p_minComplete))
+{
+}
+
+bool AsyncFileReader::complete()
+{
+    return false;
+}
+
+#endif
+
+}; // namespace gw2b
@@ -0,0 +1,131 @@
+/** \file       Util/AsyncFileReader.h
+ *  \brief      Contains the declaration of the asynchronous file reader class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef UTIL_ASYNCFILEREADER_H_INCLUDED
+#define UTIL_ASYNCFILEREADER_H_INCLUDED
+
+#include <deque>
+#include <functional>
+#include <vector>
+#include <wx/thread.h>
+
+namespace gw2b
+{
+class RandomAccessFile;
+
+/** Keeps several reads of a RandomAccessFile in flight at once, without a
+ *  thread per read. On Linux the reads are handed to the kernel through
+ *  io_uring, and a single thread waits for them to complete. Where io_uring
+ *  is missing, or the kernel refuses to set up a ring, isAvailable() returns
+ *  false and callers are expected to read on threads of their own. */
+class AsyncFileReader
+{
+public:
+    /** Called once a read has completed, on the reader's own thread. Should
+     *  return quickly, as no other completions are handled meanwhile.
+     *  \param[in]  po_data      Data read, allocated with malloc. The handler
+     *                          takes ownership of it, e.g. by wrapping it in
+     *                          an Array.
+     *  \param[in]  p_bytesRead  Amount of bytes read. Less than requested if
+     *                          the read failed or hit the end of the file. */
+    typedef std::function<void(byte* po_data, uint p_bytesRead)>  CompletionHandler;
+private:
+    struct Request
+    {
+        uint64              offset;
+        byte*               buffer;
+        uint                size;
+        uint                bytesRead;
+        CompletionHandler   handler;
+    };
+    class Completer;
+    const RandomAccessFile& m_file;
+    wxMutex                 m_mutex;
+    wxCondition             m_idle;
+    std::deque<Request>     m_queued;
+    std::vector<Request>    m_slots;
+    std::vector<uint>       m_freeSlots;
+    Completer*              m_completer;
+    int                     m_ring;
+    uint                    m_numInFlight;
+    uint                    m_sqMask;
+    uint                    m_cqMask;
+    volatile uint32*        m_sqTail;
+    uint32*                 m_sqArray;
+    void*                   m_sqEntries;
+    volatile uint32*        m_cqHead;
+    volatile uint32*        m_cqTail;
+    const void*             m_cqEntries;
+    void*                   m_sqRing;
+    uint                    m_sqRingSize;
+    void*                   m_cqRing;
+    uint                    m_cqRingSize;
+    uint                    m_sqEntriesSize;
+public:
+    /** Constructor. Sets up the ring and starts the completion thread.
+     *  \param[in]  p_file       File to read from. Must stay open for as long
+     *                          as the reader exists.
+     *  \param[in]  p_depth      Max amount of reads in flight at once. Reads
+     *                          past that are queued until others complete. */
+    AsyncFileReader(const RandomAccessFile& p_file, uint p_depth);
+    /** Destructor. Drops any reads not yet started, and waits for the ones in
+     *  flight to complete. */
+    ~AsyncFileReader();
+
+    /** Determines whether reads are performed asynchronously. If not, read
+     *  performs the read right away, on the calling thread.
+     *  \return bool    true if the ring was set up, false if not. */
+    bool isAvailable() const            { return m_ring >= 0; }
+    /** Queues a read and returns right away. Thread safe. The buffer is not
+     *  allocated until the read is handed to the kernel, so queued reads
+     *  cost next to nothing.
+     *  \param[in]  p_offset     Offset to start reading at.
+     *  \param[in]  p_size       Amount of bytes to read.
+     *  \param[in]  p_handler    Handler to invoke once the read completes. */
+    void read(uint64 p_offset, uint p_size, const CompletionHandler& p_handler);
+    /** Blocks until all queued reads have completed and their handlers have
+     *  returned. */
+    void wait();
+    /** Drops all reads that have not been handed to the kernel yet. Their
+     *  handlers are never called.
+     *  \return uint    Amount of reads dropped. */
+    uint cancelPending();
+    /** Determines whether there are no reads queued or in flight.
+     *  \return bool    true if idle, false if not. */
+    bool isIdle();
+private:
+    bool setup(uint p_depth);
+    void release();
+    void submit(uint p_slot);
+    void enter(uint p_toSubmit, uint p_minComplete);
+    bool complete();
+    void finish(uint p_slot);
+    AsyncFileReader(const AsyncFileReader&);
+    AsyncFileReader& operator=(const AsyncFileReader&);
+}; // class AsyncFileReader
+
+}; // namespace gw2b
+
+#endif // UTIL_ASYNCFILEREADER_H_INCLUDED
@@ -0,0 +1,74 @@
+/** \file       Util/CancellationToken.cpp
+ *  \brief      Contains the definition of the cancellation token class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include "CancellationToken.h"
+
+namespace gw2b
+{
+
+CancellationToken::CancellationToken()
+{
+}
+
+CancellationToken CancellationToken::create()
+{
+    CancellationToken token;
+    token.m_state = std::make_shared<State>();
+    token.m_state->isCancelled = false;
+    token.m_state->hasDeadline = false;
+    token.m_state->deadline    = 0;
+    return token;
+}
+
+void CancellationToken::cancel()
+{
+    if (m_state) {
+        storeRelease(m_state->isCancelled, true);
+    }
+}
+
+void CancellationToken::setDeadline(uint p_milliseconds)
+{
+    Assert(m_state);
+    if (!m_state) { return; }
+
+    // The deadline is written whole, and before the flag that makes readers
+    // look at it
+    storeRelease(m_state->deadline, m_state->clock.Time() + static_cast<long>(p_milliseconds));
+    storeRelease(m_state->hasDeadline, true);
+}
+
+bool CancellationToken::isCancelled() const
+{
+    if (!m_state) { return false; }
+    if (loadAcquire(m_state->isCancelled)) { return true; }
+
+    if (loadAcquire(m_state->hasDeadline) && m_state->clock.Time() >= loadAcquire(m_state->deadline)) {
+        storeRelease(m_state->isCancelled, true);
+        return true;
+    }
+    return false;
+}
+
+}; // namespace gw2b
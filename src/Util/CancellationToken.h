@@ -0,0 +1,75 @@
+/** \file       Util/CancellationToken.h
+ *  \brief      Contains the declaration of the cancellation token class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef UTIL_CANCELLATIONTOKEN_H_INCLUDED
+#define UTIL_CANCELLATIONTOKEN_H_INCLUDED
+
+#include <memory>
+#include <wx/stopwatch.h>
+
+namespace gw2b
+{
+
+/** Lets long running work be stopped from another thread, either explicitly
+ *  or once a deadline passes. Copies share their state, so whoever may cancel
+ *  the work hands a copy to the code doing it, which checks it every so often
+ *  and bails when it is cancelled. A default constructed token is never
+ *  cancelled, and costs next to nothing to check. */
+class CancellationToken
+{
+    struct State
+    {
+        volatile bool   isCancelled;
+        volatile bool   hasDeadline;
+        volatile long   deadline;       // At most pointer sized, so it can be read and written atomically
+        wxStopWatch     clock;
+    };
+    std::shared_ptr<State>  m_state;
+public:
+    /** Constructor. Creates a token that is never cancelled. */
+    CancellationToken();
+
+    /** Creates a token that can be cancelled.
+     *  \return CancellationToken   New token. */
+    static CancellationToken create();
+
+    /** Cancels the work this token was handed to. Does nothing for tokens
+     *  that can't be cancelled. */
+    void cancel();
+    /** Cancels the work once the given amount of time has passed. Should be
+     *  set before the token is handed out.
+     *  \param[in]  p_milliseconds   Time from now until the deadline. */
+    void setDeadline(uint p_milliseconds);
+    /** Determines whether the work was cancelled, or its deadline passed.
+     *  \return bool    true if cancelled, false if not. */
+    bool isCancelled() const;
+    /** Determines whether this token can be cancelled at all.
+     *  \return bool    true if it can be cancelled, false if not. */
+    bool canBeCancelled() const         { return !!m_state; }
+}; // class CancellationToken
+
+}; // namespace gw2b
+
+#endif // UTIL_CANCELLATIONTOKEN_H_INCLUDED
@@ -0,0 +1,177 @@
+/** \file       Util/FileMapping.cpp
+ *  \brief      Contains the definition of the read-only file mapping class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include <algorithm>
+#include "FileMapping.h"
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace gw2b
+{
+
+#ifdef _WIN32
+
+FileMapping::FileMapping()
+    : m_file(INVALID_HANDLE_VALUE)
+    , m_mapping(nullptr)
+    , m_data(nullptr)
+    , m_size(0)
+    , m_isPrivate(false)
+{
+}
+
+bool FileMapping::open(const wxString& p_filename, bool p_isPrivate)
+{
+    this->close();
+
+    while (true) {
+        // The game keeps the .dat open for writing while it runs, so opening
+        // it without sharing writes would fail
+        m_file = ::CreateFileW(p_filename.wc_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) { break; }
+
+        LARGE_INTEGER size;
+        if (!::GetFileSizeEx(m_file, &size) || size.QuadPart == 0) { break; }
+        // The whole file has to fit in the address space
+        if (static_cast<uint64>(size.QuadPart) > static_cast<uint64>(std::numeric_limits<size_t>::max())) { break; }
+
+        // Copy-on-write pages give a private mapping
+        m_mapping = ::CreateFileMappingW(m_file, nullptr, p_isPrivate ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+        if (!m_mapping) { break; }
+
+        m_data = static_cast<byte*>(::MapViewOfFile(m_mapping, p_isPrivate ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+        if (!m_data) { break; }
+
+        m_size      = size.QuadPart;
+        m_isPrivate = p_isPrivate;
+        return true;
+    }
+
+    this->close();
+    return false;
+}
+
+void FileMapping::close()
+{
+    if (m_data) {
+        ::UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+    if (m_mapping) {
+        ::CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        ::CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+    m_size      = 0;
+    m_isPrivate = false;
+}
+
+void FileMapping::swap(FileMapping& pio_other)
+{
+    std::swap(m_file, pio_other.m_file);
+    std::swap(m_mapping, pio_other.m_mapping);
+    std::swap(m_data, pio_other.m_data);
+    std::swap(m_size, pio_other.m_size);
+    std::swap(m_isPrivate, pio_other.m_isPrivate);
+}
+
+#else
+
+FileMapping::FileMapping()
+    : m_file(-1)
+    , m_data(nullptr)
+    , m_size(0)
+    , m_isPrivate(false)
+{
+}
+
+bool FileMapping::open(const wxString& p_filename, bool p_isPrivate)
+{
+    this->close();
+
+    while (true) {
+        m_file = ::open(p_filename.fn_str(), O_RDONLY);
+        if (m_file < 0) { break; }
+
+        struct stat info;
+        if (::fstat(m_file, &info) != 0 || info.st_size == 0) { break; }
+        // The whole file has to fit in the address space
+        if (static_cast<uint64>(info.st_size) > static_cast<uint64>(std::numeric_limits<size_t>::max())) { break; }
+
+        auto protection = p_isPrivate ? (PROT_READ | PROT_WRITE) : PROT_READ;
+        auto data = ::mmap(nullptr, info.st_size, protection, p_isPrivate ? MAP_PRIVATE : MAP_SHARED, m_file, 0);
+        if (data == MAP_FAILED) { break; }
+        // Entries are read in no particular order
+        if (!p_isPrivate) { ::madvise(data, info.st_size, MADV_RANDOM); }
+
+        m_data      = static_cast<byte*>(data);
+        m_size      = info.st_size;
+        m_isPrivate = p_isPrivate;
+        return true;
+    }
+
+    this->close();
+    return false;
+}
+
+void FileMapping::close()
+{
+    if (m_data) {
+        ::munmap(m_data, m_size);
+        m_data = nullptr;
+    }
+    if (m_file >= 0) {
+        ::close(m_file);
+        m_file = -1;
+    }
+    m_size      = 0;
+    m_isPrivate = false;
+}
+
+void FileMapping::swap(FileMapping& pio_other)
+{
+    std::swap(m_file, pio_other.m_file);
+    std::swap(m_data, pio_other.m_data);
+    std::swap(m_size, pio_other.m_size);
+    std::swap(m_isPrivate, pio_other.m_isPrivate);
+}
+
+#endif
+
+FileMapping::~FileMapping()
+{
+    this->close();
+}
+
+}; // namespace gw2b
@@ -0,0 +1,85 @@
+/** \file       Util/FileMapping.h
+ *  \brief      Contains the declaration of the read-only file mapping class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef UTIL_FILEMAPPING_H_INCLUDED
+#define UTIL_FILEMAPPING_H_INCLUDED
+
+namespace gw2b
+{
+
+/** Maps a whole file into memory for reading. Mapping fails if the file does
+ *  not fit in the address space, which is the case for the .dat on 32-bit
+ *  builds, so callers must always be prepared to fall back to regular reads. */
+class FileMapping
+{
+#ifdef _WIN32
+    void*           m_file;
+    void*           m_mapping;
+#else
+    int             m_file;
+#endif
+    byte*           m_data;
+    uint64          m_size;
+    bool            m_isPrivate;
+public:
+    /** Constructor. Initializes internals. */
+    FileMapping();
+    /** Destructor. Unmaps the file, if mapped. */
+    ~FileMapping();
+
+    /** Maps the given file into memory. Private mappings can be written to,
+     *  but the writes only go to this process' copy of the pages and never
+     *  reach the file.
+     *  \param[in]  p_filename   Name of the file to map.
+     *  \param[in]  p_isPrivate  true to map a private, writable copy.
+     *  \return bool    true if mapping succeeded, false if not. */
+    bool open(const wxString& p_filename, bool p_isPrivate = false);
+    /** Unmaps the mapped file, if any. */
+    void close();
+    /** Determines whether a file is currently mapped.
+     *  \return bool    true if a file is mapped, false if not. */
+    bool isOpen() const                 { return m_data != nullptr; }
+
+    /** Gets a pointer to the first byte of the mapped file.
+     *  \return byte*   Pointer to the mapped data, nullptr if not mapped. */
+    const byte* data() const            { return m_data; }
+    /** Gets a writable pointer to the first byte of a private mapping.
+     *  \return byte*   Pointer to the mapped data, nullptr if not mapped privately. */
+    byte* privateData()                 { return m_isPrivate ? m_data : nullptr; }
+    /** Gets the size of the mapped file.
+     *  \return uint64  Size of the mapped file, in bytes. */
+    uint64 size() const                 { return m_size; }
+
+    /** Swaps the mapped files of this and the given mapping.
+     *  \param[in,out]  pio_other   Mapping to swap with. */
+    void swap(FileMapping& pio_other);
+private:
+    FileMapping(const FileMapping&);
+    FileMapping& operator=(const FileMapping&);
+}; // class FileMapping
+
+}; // namespace gw2b
+
+#endif // UTIL_FILEMAPPING_H_INCLUDED
@@ -0,0 +1,119 @@
+/** \file       Util/IdTable.cpp
+ *  \brief      Contains the definition of the ID lookup table class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include "IdTable.h"
+
+namespace gw2b
+{
+
+IdTable::IdTable()
+    : m_mask(0)
+    , m_count(0)
+{
+}
+
+IdTable::~IdTable()
+{
+}
+
+void IdTable::reset(uint p_count)
+{
+    // Keep the load factor at or below 50%, so probe sequences stay short
+    uint capacity = 16;
+    while (capacity < p_count * 2) {
+        capacity <<= 1;
+    }
+
+    m_slots.SetSize(capacity);
+    ::memset(m_slots.GetPointer(), 0, m_slots.GetByteSize());
+    m_mask  = capacity - 1;
+    m_count = 0;
+}
+
+void IdTable::clear()
+{
+    m_slots.Clear();
+    m_mask  = 0;
+    m_count = 0;
+}
+
+bool IdTable::insert(uint32 p_key, uint32 p_value)
+{
+    if (p_key == 0) { return false; }
+    if ((m_count + 1) * 2 > m_slots.GetSize()) {
+        this->grow();
+    }
+
+    auto slots = m_slots.GetPointer();
+    uint index = hash(p_key) & m_mask;
+    while (slots[index].key != 0) {
+        if (slots[index].key == p_key) { return false; }
+        index = (index + 1) & m_mask;
+    }
+
+    slots[index].key   = p_key;
+    slots[index].value = p_value;
+    m_count++;
+    return true;
+}
+
+uint IdTable::find(uint32 p_key) const
+{
+    if (p_key == 0 || m_count == 0) { return std::numeric_limits<uint>::max(); }
+
+    auto slots = m_slots.GetPointer();
+    uint index = hash(p_key) & m_mask;
+    while (slots[index].key != 0) {
+        if (slots[index].key == p_key) { return slots[index].value; }
+        index = (index + 1) & m_mask;
+    }
+
+    return std::numeric_limits<uint>::max();
+}
+
+void IdTable::grow()
+{
+    Array<Slot> oldSlots = m_slots;
+    this->reset(wxMax(m_count * 2, 8u));
+
+    for (uint i = 0; i < oldSlots.GetSize(); i++) {
+        if (oldSlots[i].key != 0) {
+            this->insert(oldSlots[i].key, oldSlots[i].value);
+        }
+    }
+}
+
+uint IdTable::hash(uint32 p_key)
+{
+    // File IDs are mostly sequential, so scramble the bits (fmix32 from
+    // MurmurHash3) to avoid long runs of occupied slots.
+    p_key ^= p_key >> 16;
+    p_key *= 0x85ebca6b;
+    p_key ^= p_key >> 13;
+    p_key *= 0xc2b2ae35;
+    p_key ^= p_key >> 16;
+    return p_key;
+}
+
+}; // namespace gw2b
@@ -0,0 +1,77 @@
+/** \file       Util/IdTable.h
+ *  \brief      Contains the declaration of the ID lookup table class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef UTIL_IDTABLE_H_INCLUDED
+#define UTIL_IDTABLE_H_INCLUDED
+
+namespace gw2b
+{
+
+/** Open-addressing hash table mapping non-zero 32-bit IDs to 32-bit values.
+ *  Used for constant-time lookups of MFT entries from file and base IDs. */
+class IdTable
+{
+    struct Slot
+    {
+        uint32  key;
+        uint32  value;
+    };
+private:
+    Array<Slot>     m_slots;
+    uint            m_mask;
+    uint            m_count;
+public:
+    /** Constructor. Creates an empty table. */
+    IdTable();
+    /** Destructor. */
+    ~IdTable();
+
+    /** Clears the table and makes room for the given amount of IDs without
+     *  having to grow.
+     *  \param[in]  p_count  Expected amount of IDs. */
+    void reset(uint p_count);
+    /** Removes all IDs and frees the table's memory. */
+    void clear();
+    /** Adds the given ID to the table. If the ID already exists, the old value
+     *  is kept.
+     *  \param[in]  p_key    ID to add. IDs of 0 are ignored.
+     *  \param[in]  p_value  Value to associate with the ID.
+     *  \return bool    true if the ID was added, false if it already existed. */
+    bool insert(uint32 p_key, uint32 p_value);
+    /** Finds the value associated with the given ID.
+     *  \param[in]  p_key    ID to look for.
+     *  \return uint    The value if the ID was found, UINT_MAX if not. */
+    uint find(uint32 p_key) const;
+    /** Gets the amount of IDs in the table.
+     *  \return uint    Amount of IDs. */
+    uint count() const                  { return m_count; }
+private:
+    void grow();
+    static uint hash(uint32 p_key);
+}; // class IdTable
+
+}; // namespace gw2b
+
+#endif // UTIL_IDTABLE_H_INCLUDED
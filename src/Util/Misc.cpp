@@ -25,6 +25,12 @@
 #include "stdafx.h"
 #include "Misc.h"
 
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <wx/filefn.h>
+#endif
+
 namespace gw2b
 {
 
@@ -54,4 +60,16 @@ uint numSetBits(uint32 p_value)
 
 #pragma warning(pop)
 
+bool replaceFile(const wxString& p_source, const wxString& p_target)
+{
+#ifdef _WIN32
+    // wxRenameFile falls back to copying when the target exists, which could
+    // leave a half-written target behind
+    return !!::MoveFileExW(p_source.wc_str(), p_target.wc_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    // rename() already replaces the target atomically
+    return wxRenameFile(p_source, p_target, true);
+#endif
+}
+
 }; // namespace gw2b
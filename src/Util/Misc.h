@@ -106,6 +106,42 @@ template <typename T>
 
 //============================================================================/
 
+/** Reads a value another thread may be writing with storeRelease. Whatever
+ *  that thread wrote before the value is visible to this one afterwards.
+ *  \param[in]  p_value Value to read.
+ *  \tparam     T       Type of value. Must be at most pointer sized.
+ *  \return T           The value read. */
+template <typename T>
+    T loadAcquire(const volatile T& p_value)
+{
+#ifdef _MSC_VER
+    // MSVC already gives volatile reads acquire semantics
+    return p_value;
+#else
+    return __atomic_load_n(&p_value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+//============================================================================/
+
+/** Writes a value other threads may be reading with loadAcquire. Whatever
+ *  this thread wrote before is visible to those that see the new value.
+ *  \param[out] po_value    Value to write to.
+ *  \param[in]  p_value     Value to write.
+ *  \tparam     T           Type of value. Must be at most pointer sized. */
+template <typename T>
+    void storeRelease(volatile T& po_value, T p_value)
+{
+#ifdef _MSC_VER
+    // MSVC already gives volatile writes release semantics
+    po_value = p_value;
+#else
+    __atomic_store_n(&po_value, p_value, __ATOMIC_RELEASE);
+#endif
+}
+
+//============================================================================/
+
 /** Determines whether the program was compiled in debug mode. Returns
  *  p_true if it was, p_false if it wasn't.
  *  \param[in]  p_true   Value to return if in debug mode.
@@ -134,6 +170,16 @@ uint lowestSetBit(uint32 p_value);
  *  \return uint    Amount of bits set. */
 uint numSetBits(uint32 p_value);
 
+//============================================================================/
+
+/** Moves the source file over the target file in a single step, so that
+ *  readers see either the old or the new target but never a partial one. The
+ *  source should be on the same volume as the target.
+ *  \param[in]  p_source    File to move.
+ *  \param[in]  p_target    File to replace.
+ *  \return bool    true if the target was replaced, false if not. */
+bool replaceFile(const wxString& p_source, const wxString& p_target);
+
 }; // namespace gw2b
 
 #endif // UTIL_MISC_H_INCLUDED
@@ -0,0 +1,301 @@
+/** \file       Util/Profiler.cpp
+ *  \brief      Contains definition of the Profiler class.
+ *  \author     Rhoot
+ */
+
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include "Profiler.h"
+
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <vector>
+#include <wx/file.h>
+#include <wx/stopwatch.h>
+#include <wx/thread.h>
+
+namespace gw2b
+{
+
+namespace
+{
+
+    enum { NUM_BUCKETS = 64 };
+
+    /** Totals of a timer or histogram. Bucket N holds the values that need
+     *  N bits, i.e. those below 2^N. */
+    struct Stat
+    {
+        uint64  count;
+        uint64  total;
+        uint64  min;
+        uint64  max;
+        uint64  buckets[NUM_BUCKETS];
+
+        Stat()
+            : count(0)
+            , total(0)
+            , min(0)
+            , max(0)
+        {
+            ::memset(buckets, 0, sizeof(buckets));
+        }
+
+        void add(uint64 p_value)
+        {
+            min = (count ? wxMin(min, p_value) : p_value);
+            max = wxMax(max, p_value);
+            count++;
+            total += p_value;
+
+            uint bucket = 0;
+            while (bucket < NUM_BUCKETS - 1 && (p_value >> bucket)) { bucket++; }
+            buckets[bucket]++;
+        }
+    };
+
+    struct TraceEvent
+    {
+        const char* name;
+        uint        thread;
+        int64       start;
+        int64       duration;
+    };
+
+    struct NameLess
+    {
+        bool operator()(const char* p_lhs, const char* p_rhs) const { return ::strcmp(p_lhs, p_rhs) < 0; }
+    };
+
+    typedef std::map<const char*, Stat, NameLess>   StatMap;
+    typedef std::map<const char*, int64, NameLess>  CounterMap;
+    typedef std::map<wxThreadIdType, uint>          ThreadMap;
+
+    volatile bool           g_isEnabled = false;
+    wxCriticalSection       g_lock;
+    wxStopWatch             g_clock;
+    StatMap                 g_timers;
+    StatMap                 g_histograms;
+    CounterMap              g_counters;
+    std::vector<TraceEvent> g_events;
+    uint64                  g_numDroppedEvents = 0;
+    ThreadMap               g_threads;
+
+    /** Gets a small number identifying the calling thread. The main thread is
+     *  always 0. Must be called with the lock held. */
+    uint currentThread()
+    {
+        if (wxThread::IsMain()) { return 0; }
+
+        auto id   = wxThread::GetCurrentId();
+        auto iter = g_threads.find(id);
+        if (iter == g_threads.end()) {
+            iter = g_threads.insert(std::make_pair(id, static_cast<uint>(g_threads.size() + 1))).first;
+        }
+        return iter->second;
+    }
+
+    /** Writes the given string as a JSON string. Names are plain ASCII, so
+     *  only quotes and backslashes need escaping. */
+    void writeString(std::ostream& p_stream, const char* p_string)
+    {
+        p_stream << '"';
+        for (const char* c = p_string; *c; c++) {
+            if (*c == '"' || *c == '\\') { p_stream << '\\'; }
+            p_stream << *c;
+        }
+        p_stream << '"';
+    }
+
+    void writeStats(std::ostream& p_stream, const StatMap& p_stats)
+    {
+        p_stream << '{';
+        for (auto iter = p_stats.begin(); iter != p_stats.end(); iter++) {
+            auto& stat = iter->second;
+            if (iter != p_stats.begin()) { p_stream << ','; }
+
+            p_stream << "\n    ";
+            writeString(p_stream, iter->first);
+            p_stream << ": {\"count\": " << stat.count
+                     << ", \"total\": " << stat.total
+                     << ", \"min\": " << stat.min
+                     << ", \"max\": " << stat.max
+                     << ", \"mean\": " << (stat.count ? stat.total / stat.count : 0)
+                     << ", \"buckets\": [";
+
+            // Only the buckets that were hit, as [upper bound, count] pairs
+            bool isFirst = true;
+            for (uint i = 0; i < NUM_BUCKETS; i++) {
+                if (!stat.buckets[i]) { continue; }
+                if (!isFirst) { p_stream << ", "; }
+                p_stream << '[' << (uint64(1) << i) << ", " << stat.buckets[i] << ']';
+                isFirst = false;
+            }
+            p_stream << "]}";
+        }
+        p_stream << (p_stats.empty() ? "}" : "\n  }");
+    }
+
+    bool writeFile(const wxString& p_filename, const std::string& p_contents)
+    {
+        wxFile file(p_filename, wxFile::write);
+        if (!file.IsOpened()) { return false; }
+        return (file.Write(p_contents.c_str(), p_contents.length()) == p_contents.length());
+    }
+
+}; // anon namespace
+
+//----------------------------------------------------------------------------
+//      Profiler
+//----------------------------------------------------------------------------
+
+void Profiler::setEnabled(bool p_isEnabled)
+{
+    g_isEnabled = p_isEnabled;
+}
+
+bool Profiler::isEnabled()
+{
+    return g_isEnabled;
+}
+
+int64 Profiler::now()
+{
+    return g_clock.TimeInMicro().GetValue();
+}
+
+void Profiler::reset()
+{
+    wxCriticalSectionLocker lock(g_lock);
+    g_timers.clear();
+    g_histograms.clear();
+    g_counters.clear();
+    g_events.clear();
+    g_numDroppedEvents = 0;
+    g_threads.clear();
+    g_clock.Start();
+}
+
+void Profiler::addTime(const char* p_name, int64 p_start, int64 p_end)
+{
+    if (!g_isEnabled) { return; }
+    int64 duration = wxMax(p_end - p_start, int64(0));
+
+    wxCriticalSectionLocker lock(g_lock);
+    g_timers[p_name].add(duration);
+
+    if (g_events.size() < MAX_TRACE_EVENTS) {
+        TraceEvent event = { p_name, currentThread(), p_start, duration };
+        g_events.push_back(event);
+    } else {
+        g_numDroppedEvents++;
+    }
+}
+
+void Profiler::addCount(const char* p_name, int64 p_amount)
+{
+    if (!g_isEnabled) { return; }
+
+    wxCriticalSectionLocker lock(g_lock);
+    g_counters[p_name] += p_amount;
+}
+
+void Profiler::addSample(const char* p_name, uint64 p_value)
+{
+    if (!g_isEnabled) { return; }
+
+    wxCriticalSectionLocker lock(g_lock);
+    g_histograms[p_name].add(p_value);
+}
+
+bool Profiler::writeSummary(const wxString& p_filename)
+{
+    std::ostringstream stream;
+    stream.imbue(std::locale("C"));
+
+    {
+        wxCriticalSectionLocker lock(g_lock);
+
+        // Timers are in microseconds
+        stream << "{\n  \"elapsed\": " << Profiler::now() << ",\n  \"timers\": ";
+        writeStats(stream, g_timers);
+        stream << ",\n  \"histograms\": ";
+        writeStats(stream, g_histograms);
+
+        stream << ",\n  \"counters\": {";
+        for (auto iter = g_counters.begin(); iter != g_counters.end(); iter++) {
+            if (iter != g_counters.begin()) { stream << ','; }
+            stream << "\n    ";
+            writeString(stream, iter->first);
+            stream << ": " << iter->second;
+        }
+        stream << (g_counters.empty() ? "}" : "\n  }");
+
+        stream << ",\n  \"droppedTraceEvents\": " << g_numDroppedEvents << "\n}\n";
+    }
+
+    return writeFile(p_filename, stream.str());
+}
+
+bool Profiler::writeTrace(const wxString& p_filename)
+{
+    std::ostringstream stream;
+    stream.imbue(std::locale("C"));
+
+    {
+        wxCriticalSectionLocker lock(g_lock);
+        stream << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+        // Name the threads, so the viewer doesn't just show their numbers
+        uint numThreads = g_threads.size() + 1;
+        for (uint i = 0; i < numThreads; i++) {
+            stream << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << i
+                   << ", \"args\": {\"name\": \"";
+            if (i) { stream << "Worker " << i; } else { stream << "Main thread"; }
+            stream << "\"}},\n";
+        }
+
+        for (uint i = 0; i < g_events.size(); i++) {
+            auto& event = g_events[i];
+            stream << "{\"name\": ";
+            writeString(stream, event.name);
+            stream << ", \"cat\": \"gw2b\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.thread
+                   << ", \"ts\": " << event.start << ", \"dur\": " << event.duration << "},\n";
+        }
+
+        // Counters only have their final value, so they go last
+        int64 end = Profiler::now();
+        for (auto iter = g_counters.begin(); iter != g_counters.end(); iter++) {
+            stream << "{\"name\": ";
+            writeString(stream, iter->first);
+            stream << ", \"ph\": \"C\", \"pid\": 1, \"tid\": 0, \"ts\": " << end
+                   << ", \"args\": {\"value\": " << iter->second << "}},\n";
+        }
+
+        stream << "{\"name\": \"droppedTraceEvents\", \"ph\": \"C\", \"pid\": 1, \"tid\": 0, \"ts\": " << end
+               << ", \"args\": {\"value\": " << g_numDroppedEvents << "}}\n]}\n";
+    }
+
+    return writeFile(p_filename, stream.str());
+}
+
+}; // namespace gw2b
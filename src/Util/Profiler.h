@@ -0,0 +1,113 @@
+/** \file       Util/Profiler.h
+ *  \brief      Contains declaration of the Profiler and ScopedTimer classes.
+ *  \author     Rhoot
+ */
+
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef UTIL_PROFILER_H_INCLUDED
+#define UTIL_PROFILER_H_INCLUDED
+
+namespace gw2b
+{
+
+/** Records where time goes, so that indexing and extraction runs can be
+ *  profiled without attaching a profiler. Keeps three kinds of measurements,
+ *  each identified by name:
+ *  - Timers, which sum up the durations of a stage and remember each call
+ *    for the trace.
+ *  - Counters, which are plain running totals.
+ *  - Histograms, which bucket sampled values by powers of two.
+ *
+ *  Recording is disabled by default, in which case it costs a single check.
+ *  Thread safe. Only pointers to the names are kept, so they must stay valid
+ *  for as long as the profiler runs, e.g. string literals or type names. */
+class Profiler
+{
+public:
+    /** Enables or disables recording. Measurements already recorded are
+     *  kept.
+     *  \param[in]  p_isEnabled  true to record, false to stop. */
+    static void setEnabled(bool p_isEnabled);
+    /** Determines whether recording is enabled.
+     *  \return bool    true if enabled, false if not. */
+    static bool isEnabled();
+    /** Gets the current time of the profiler's clock.
+     *  \return int64   Microseconds since the profiler was last reset. */
+    static int64 now();
+    /** Drops all measurements and restarts the clock. */
+    static void reset();
+
+    /** Records one call of a timed stage.
+     *  \param[in]  p_name   Name of the stage.
+     *  \param[in]  p_start  Time the call started, as returned by now().
+     *  \param[in]  p_end    Time the call ended, as returned by now(). */
+    static void addTime(const char* p_name, int64 p_start, int64 p_end);
+    /** Adds to a counter.
+     *  \param[in]  p_name   Name of the counter.
+     *  \param[in]  p_amount Amount to add. */
+    static void addCount(const char* p_name, int64 p_amount = 1);
+    /** Adds a value to a histogram.
+     *  \param[in]  p_name   Name of the histogram.
+     *  \param[in]  p_value  Value to add. */
+    static void addSample(const char* p_name, uint64 p_value);
+
+    /** Writes the timer, counter and histogram totals as JSON.
+     *  \param[in]  p_filename   File to write to.
+     *  \return bool    true if successful, false if not. */
+    static bool writeSummary(const wxString& p_filename);
+    /** Writes each timed call in the Chrome trace event format, to be loaded
+     *  in chrome://tracing. Only the first MAX_TRACE_EVENTS calls are kept.
+     *  \param[in]  p_filename   File to write to.
+     *  \return bool    true if successful, false if not. */
+    static bool writeTrace(const wxString& p_filename);
+
+    enum { MAX_TRACE_EVENTS = 0x100000 };
+}; // class Profiler
+
+/** Times the scope it is declared in, when the profiler is enabled. */
+class ScopedTimer
+{
+    const char* m_name;
+    int64       m_start;
+public:
+    /** Constructor. Starts the timer.
+     *  \param[in]  p_name   Name of the timed stage. Must stay valid, see
+     *                      Profiler. */
+    ScopedTimer(const char* p_name)
+        : m_name(Profiler::isEnabled() ? p_name : nullptr)
+        , m_start(m_name ? Profiler::now() : 0)
+    {
+    }
+    /** Destructor. Records the time spent. */
+    ~ScopedTimer()
+    {
+        if (m_name) { Profiler::addTime(m_name, m_start, Profiler::now()); }
+    }
+private:
+    ScopedTimer(const ScopedTimer&);
+    ScopedTimer& operator=(const ScopedTimer&);
+}; // class ScopedTimer
+
+}; // namespace gw2b
+
+#endif // UTIL_PROFILER_H_INCLUDED
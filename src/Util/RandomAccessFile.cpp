@@ -0,0 +1,179 @@
+/** \file       Util/RandomAccessFile.cpp
+ *  \brief      Contains the definition of the positional file reader class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include "RandomAccessFile.h"
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace gw2b
+{
+
+#ifdef _WIN32
+
+RandomAccessFile::RandomAccessFile()
+    : m_file(INVALID_HANDLE_VALUE)
+    , m_length(0)
+{
+}
+
+bool RandomAccessFile::open(const wxString& p_filename)
+{
+    this->close();
+
+    // The game keeps the .dat open for writing while it runs, so writes have
+    // to be shared. Reads through a synchronous handle are serialized, so the
+    // handle is opened for overlapped I/O, even though each read still waits
+    // for its own completion.
+    m_file = ::CreateFileW(p_filename.wc_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+        FILE_FLAG_RANDOM_ACCESS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) { return false; }
+
+    LARGE_INTEGER length;
+    if (!::GetFileSizeEx(m_file, &length)) {
+        this->close();
+        return false;
+    }
+
+    m_length = length.QuadPart;
+    return true;
+}
+
+void RandomAccessFile::close()
+{
+    if (m_file != INVALID_HANDLE_VALUE) {
+        ::CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+    m_length = 0;
+}
+
+bool RandomAccessFile::isOpen() const
+{
+    return m_file != INVALID_HANDLE_VALUE;
+}
+
+uint RandomAccessFile::readAt(uint64 p_offset, void* po_buffer, uint p_size) const
+{
+    Ensure::notNull(po_buffer);
+    uint totalRead = 0;
+
+    // Each read waits on an event of its own, as waiting on the file handle
+    // could wake up for another thread's read
+    HANDLE event = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!event) { return 0; }
+
+    while (totalRead < p_size) {
+        uint64 offset = p_offset + totalRead;
+        OVERLAPPED overlapped;
+        ::memset(&overlapped, 0, sizeof(overlapped));
+        overlapped.Offset     = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        overlapped.hEvent     = event;
+
+        // Fails right away with ERROR_HANDLE_EOF past the end of the file
+        if (!::ReadFile(m_file, static_cast<byte*>(po_buffer) + totalRead, p_size - totalRead, nullptr, &overlapped)
+            && ::GetLastError() != ERROR_IO_PENDING) {
+            break;
+        }
+
+        DWORD bytesRead = 0;
+        if (!::GetOverlappedResult(m_file, &overlapped, &bytesRead, TRUE) || bytesRead == 0) {
+            break;
+        }
+        totalRead += bytesRead;
+    }
+
+    ::CloseHandle(event);
+    return totalRead;
+}
+
+#else
+
+RandomAccessFile::RandomAccessFile()
+    : m_file(-1)
+    , m_length(0)
+{
+}
+
+bool RandomAccessFile::open(const wxString& p_filename)
+{
+    this->close();
+
+    m_file = ::open(p_filename.fn_str(), O_RDONLY);
+    if (m_file < 0) { return false; }
+
+    struct stat info;
+    if (::fstat(m_file, &info) != 0) {
+        this->close();
+        return false;
+    }
+
+    m_length = info.st_size;
+    return true;
+}
+
+void RandomAccessFile::close()
+{
+    if (m_file >= 0) {
+        ::close(m_file);
+        m_file = -1;
+    }
+    m_length = 0;
+}
+
+bool RandomAccessFile::isOpen() const
+{
+    return m_file >= 0;
+}
+
+uint RandomAccessFile::readAt(uint64 p_offset, void* po_buffer, uint p_size) const
+{
+    Ensure::notNull(po_buffer);
+    uint totalRead = 0;
+
+    while (totalRead < p_size) {
+        auto bytesRead = ::pread(m_file, static_cast<byte*>(po_buffer) + totalRead, p_size - totalRead, p_offset + totalRead);
+        if (bytesRead < 0 && errno == EINTR) { continue; }
+        if (bytesRead <= 0) { break; }
+        totalRead += static_cast<uint>(bytesRead);
+    }
+
+    return totalRead;
+}
+
+#endif
+
+RandomAccessFile::~RandomAccessFile()
+{
+    this->close();
+}
+
+}; // namespace gw2b
@@ -0,0 +1,76 @@
+/** \file       Util/RandomAccessFile.h
+ *  \brief      Contains the declaration of the positional file reader class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef UTIL_RANDOMACCESSFILE_H_INCLUDED
+#define UTIL_RANDOMACCESSFILE_H_INCLUDED
+
+namespace gw2b
+{
+
+/** Read-only file that is read at explicit offsets instead of through a
+ *  shared file pointer. Since there is no cursor to fight over, any number of
+ *  threads may read from the same object at the same time. */
+class RandomAccessFile
+{
+    friend class AsyncFileReader;
+#ifdef _WIN32
+    void*           m_file;
+#else
+    int             m_file;
+#endif
+    uint64          m_length;
+public:
+    /** Constructor. Initializes internals. */
+    RandomAccessFile();
+    /** Destructor. Closes the file, if open. */
+    ~RandomAccessFile();
+
+    /** Opens the given file for reading.
+     *  \param[in]  p_filename   Name of the file to open.
+     *  \return bool    true if opening succeeded, false if not. */
+    bool open(const wxString& p_filename);
+    /** Closes the open file, if any. */
+    void close();
+    /** Determines whether a file is currently open.
+     *  \return bool    true if a file is open, false if not. */
+    bool isOpen() const;
+    /** Gets the length of the open file, as it was when it was opened.
+     *  \return uint64  Length of the file, in bytes. */
+    uint64 length() const               { return m_length; }
+
+    /** Reads data from the given offset. Thread safe.
+     *  \param[in]  p_offset     Offset to start reading at.
+     *  \param[out] po_buffer    Buffer to read into. Must be at least p_size bytes.
+     *  \param[in]  p_size       Amount of bytes to read.
+     *  \return uint    Amount of bytes actually read. */
+    uint readAt(uint64 p_offset, void* po_buffer, uint p_size) const;
+private:
+    RandomAccessFile(const RandomAccessFile&);
+    RandomAccessFile& operator=(const RandomAccessFile&);
+}; // class RandomAccessFile
+
+}; // namespace gw2b
+
+#endif // UTIL_RANDOMACCESSFILE_H_INCLUDED
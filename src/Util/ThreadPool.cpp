@@ -0,0 +1,145 @@
+/** \file       Util/ThreadPool.cpp
+ *  \brief      Contains the definition of the thread pool class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include "ThreadPool.h"
+
+namespace gw2b
+{
+
+//----------------------------------------------------------------------------
+//      ThreadPool::Worker
+//----------------------------------------------------------------------------
+
+class ThreadPool::Worker : public wxThread
+{
+    ThreadPool& m_pool;
+public:
+    Worker(ThreadPool& p_pool)
+        : wxThread(wxTHREAD_JOINABLE)
+        , m_pool(p_pool)
+    {
+    }
+
+    virtual ExitCode Entry()
+    {
+        Job job;
+        while (m_pool.takeJob(job)) {
+            job();
+            job = nullptr;
+            m_pool.finishJob();
+        }
+        return 0;
+    }
+}; // class ThreadPool::Worker
+
+//----------------------------------------------------------------------------
+//      ThreadPool
+//----------------------------------------------------------------------------
+
+ThreadPool::ThreadPool(uint p_numThreads)
+    : m_jobAvailable(m_mutex)
+    , m_idle(m_mutex)
+    , m_numBusy(0)
+    , m_stopping(false)
+{
+    if (!p_numThreads) {
+        p_numThreads = wxMax(wxThread::GetCPUCount(), 1);
+    }
+
+    for (uint i = 0; i < p_numThreads; i++) {
+        auto worker = new Worker(*this);
+        if (worker->Create() != wxTHREAD_NO_ERROR || worker->Run() != wxTHREAD_NO_ERROR) {
+            deletePointer(worker);
+            continue;
+        }
+        m_workers.Add(worker);
+    }
+
+    // Without any workers, nothing would ever run
+    Assert(m_workers.GetSize() > 0);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        wxMutexLocker lock(m_mutex);
+        m_jobs.clear();
+        m_stopping = true;
+        m_jobAvailable.Broadcast();
+    }
+
+    for (uint i = 0; i < m_workers.GetSize(); i++) {
+        m_workers[i]->Wait();
+        delete m_workers[i];
+    }
+}
+
+void ThreadPool::post(const Job& p_job)
+{
+    wxMutexLocker lock(m_mutex);
+    m_jobs.push_back(p_job);
+    m_jobAvailable.Signal();
+}
+
+void ThreadPool::wait()
+{
+    wxMutexLocker lock(m_mutex);
+    while (!m_jobs.empty() || m_numBusy > 0) {
+        m_idle.Wait();
+    }
+}
+
+uint ThreadPool::cancelPending()
+{
+    wxMutexLocker lock(m_mutex);
+    uint numDropped = m_jobs.size();
+    m_jobs.clear();
+    if (!m_numBusy) { m_idle.Broadcast(); }
+    return numDropped;
+}
+
+bool ThreadPool::takeJob(Job& po_job)
+{
+    wxMutexLocker lock(m_mutex);
+    while (m_jobs.empty() && !m_stopping) {
+        m_jobAvailable.Wait();
+    }
+    if (m_stopping) { return false; }
+
+    po_job = m_jobs.front();
+    m_jobs.pop_front();
+    m_numBusy++;
+    return true;
+}
+
+void ThreadPool::finishJob()
+{
+    wxMutexLocker lock(m_mutex);
+    m_numBusy--;
+    if (!m_numBusy && m_jobs.empty()) {
+        m_idle.Broadcast();
+    }
+}
+
+}; // namespace gw2b
@@ -0,0 +1,79 @@
+/** \file       Util/ThreadPool.h
+ *  \brief      Contains the declaration of the thread pool class.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef UTIL_THREADPOOL_H_INCLUDED
+#define UTIL_THREADPOOL_H_INCLUDED
+
+#include <deque>
+#include <functional>
+#include <wx/thread.h>
+
+namespace gw2b
+{
+
+/** Fixed set of worker threads executing queued jobs in FIFO order. */
+class ThreadPool
+{
+public:
+    /** A unit of work to be executed by one of the workers. */
+    typedef std::function<void()>   Job;
+private:
+    class Worker;
+    wxMutex                 m_mutex;
+    wxCondition             m_jobAvailable;
+    wxCondition             m_idle;
+    std::deque<Job>         m_jobs;
+    Array<Worker*>          m_workers;
+    uint                    m_numBusy;
+    bool                    m_stopping;
+public:
+    /** Constructor. Starts the worker threads.
+     *  \param[in]  p_numThreads     Amount of workers. 0 to use one per CPU. */
+    ThreadPool(uint p_numThreads = 0);
+    /** Destructor. Drops any jobs not yet started, and waits for the running
+     *  ones to finish. */
+    ~ThreadPool();
+
+    /** Queues a job for execution on one of the workers.
+     *  \param[in]  p_job    Job to execute. */
+    void post(const Job& p_job);
+    /** Blocks until all queued jobs have finished. */
+    void wait();
+    /** Drops all jobs that have not started yet.
+     *  \return uint    Amount of jobs dropped. */
+    uint cancelPending();
+    /** Gets the amount of worker threads.
+     *  \return uint    Amount of workers. */
+    uint numThreads() const             { return m_workers.GetSize(); }
+private:
+    bool takeJob(Job& po_job);
+    void finishJob();
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+}; // class ThreadPool
+
+}; // namespace gw2b
+
+#endif // UTIL_THREADPOOL_H_INCLUDED
@@ -0,0 +1,308 @@
+/** \file       Util/WorkPool.cpp
+ *  \brief      Contains the definition of the work stealing pool and task groups.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include "WorkPool.h"
+
+namespace gw2b
+{
+
+namespace
+{
+
+    WorkPool* volatile  g_sharedPool = nullptr;
+    wxCriticalSection   g_sharedPoolLock;
+
+}; // anon namespace
+
+//----------------------------------------------------------------------------
+//      WorkPool::Worker
+//----------------------------------------------------------------------------
+
+class WorkPool::Worker : public wxThread
+{
+    WorkPool&   m_pool;
+    int         m_index;
+public:
+    Worker(WorkPool& p_pool, int p_index)
+        : wxThread(wxTHREAD_JOINABLE)
+        , m_pool(p_pool)
+        , m_index(p_index)
+    {
+    }
+
+    virtual ExitCode Entry()
+    {
+        Job job;
+        do {
+            while (m_pool.takeJob(m_index, job)) {
+                job();
+                job = nullptr;
+            }
+        } while (m_pool.waitForJob());
+        return 0;
+    }
+}; // class WorkPool::Worker
+
+//----------------------------------------------------------------------------
+//      WorkPool
+//----------------------------------------------------------------------------
+
+WorkPool::WorkPool(uint p_numThreads)
+    : m_jobAvailable(m_mutex)
+    , m_numQueued(0)
+    , m_nextQueue(0)
+    , m_stopping(false)
+{
+    if (!p_numThreads) {
+        p_numThreads = wxMax(wxThread::GetCPUCount(), 1);
+    }
+
+    // Queues are all set up before any worker starts stealing from them
+    m_queues.SetSize(p_numThreads);
+    for (uint i = 0; i < p_numThreads; i++) {
+        m_queues[i] = new Queue();
+    }
+
+    // Workers look each other up, so the list must be complete before they run
+    for (uint i = 0; i < p_numThreads; i++) {
+        auto worker = new Worker(*this, m_workers.GetSize());
+        if (worker->Create() != wxTHREAD_NO_ERROR) {
+            deletePointer(worker);
+            continue;
+        }
+        m_workers.Add(worker);
+    }
+    for (uint i = 0; i < m_workers.GetSize(); i++) {
+        auto result = m_workers[i]->Run();
+        Assert(result == wxTHREAD_NO_ERROR);
+        wxUnusedVar(result);
+    }
+
+    // Without any workers, nothing would ever run
+    Assert(m_workers.GetSize() > 0);
+}
+
+WorkPool::~WorkPool()
+{
+    {
+        wxMutexLocker lock(m_mutex);
+        m_stopping = true;
+        m_jobAvailable.Broadcast();
+    }
+
+    for (uint i = 0; i < m_workers.GetSize(); i++) {
+        m_workers[i]->Wait();
+        delete m_workers[i];
+    }
+    for (uint i = 0; i < m_queues.GetSize(); i++) {
+        delete m_queues[i];
+    }
+}
+
+WorkPool& WorkPool::shared()
+{
+    // The pool must be fully constructed before other threads see it, which
+    // the release store makes sure of
+    auto pool = loadAcquire(g_sharedPool);
+    if (!pool) {
+        wxCriticalSectionLocker lock(g_sharedPoolLock);
+        pool = g_sharedPool;
+        if (!pool) {
+            pool = new WorkPool();
+            storeRelease(g_sharedPool, pool);
+        }
+    }
+    return *pool;
+}
+
+void WorkPool::destroyShared()
+{
+    wxCriticalSectionLocker lock(g_sharedPoolLock);
+    WorkPool* pool = g_sharedPool;
+    storeRelease(g_sharedPool, static_cast<WorkPool*>(nullptr));
+    deletePointer(pool);
+}
+
+void WorkPool::post(const Job& p_job)
+{
+    // Workers keep their own jobs local, anything else is spread evenly
+    int queue = this->currentWorker();
+
+    wxMutexLocker lock(m_mutex);
+    if (queue < 0) {
+        queue       = m_nextQueue;
+        m_nextQueue = (m_nextQueue + 1) % m_workers.GetSize();
+    }
+
+    {
+        wxMutexLocker queueLock(m_queues[queue]->mutex);
+        m_queues[queue]->jobs.push_back(p_job);
+    }
+    m_numQueued++;
+    m_jobAvailable.Signal();
+}
+
+bool WorkPool::runPending()
+{
+    Job job;
+    if (!this->takeJob(this->currentWorker(), job)) {
+        return false;
+    }
+    job();
+    return true;
+}
+
+int WorkPool::currentWorker() const
+{
+    auto thread = wxThread::This();
+    if (!thread) { return -1; }
+
+    for (uint i = 0; i < m_workers.GetSize(); i++) {
+        if (m_workers[i] == thread) { return i; }
+    }
+    return -1;
+}
+
+bool WorkPool::takeJob(int p_queue, Job& po_job)
+{
+    bool hasJob   = false;
+    uint numQueues = m_workers.GetSize();
+
+    // Newest job of our own first, as its data is most likely still cached
+    if (p_queue >= 0) {
+        auto queue = m_queues[p_queue];
+        wxMutexLocker lock(queue->mutex);
+        if (!queue->jobs.empty()) {
+            po_job = queue->jobs.back();
+            queue->jobs.pop_back();
+            hasJob = true;
+        }
+    }
+
+    // Otherwise steal the oldest one off someone else
+    for (uint i = 1; !hasJob && i <= numQueues; i++) {
+        auto queue = m_queues[(p_queue + i) % numQueues];
+        wxMutexLocker lock(queue->mutex);
+        if (!queue->jobs.empty()) {
+            po_job = queue->jobs.front();
+            queue->jobs.pop_front();
+            hasJob = true;
+        }
+    }
+
+    if (hasJob) {
+        wxMutexLocker lock(m_mutex);
+        m_numQueued--;
+    }
+    return hasJob;
+}
+
+bool WorkPool::waitForJob()
+{
+    wxMutexLocker lock(m_mutex);
+    while (!m_numQueued && !m_stopping) {
+        m_jobAvailable.Wait();
+    }
+    return !m_stopping;
+}
+
+//----------------------------------------------------------------------------
+//      TaskGroup
+//----------------------------------------------------------------------------
+
+TaskGroup::TaskGroup(WorkPool& p_pool)
+    : m_pool(p_pool)
+    , m_done(m_mutex)
+    , m_numPending(0)
+    , m_isCancelled(false)
+{
+}
+
+TaskGroup::TaskGroup(const CancellationToken& p_cancellation, WorkPool& p_pool)
+    : m_pool(p_pool)
+    , m_done(m_mutex)
+    , m_numPending(0)
+    , m_isCancelled(false)
+    , m_cancellation(p_cancellation)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    this->wait();
+}
+
+void TaskGroup::run(const WorkPool::Job& p_job)
+{
+    {
+        wxMutexLocker lock(m_mutex);
+        m_numPending++;
+    }
+
+    m_pool.post([this, p_job]() {
+        if (!this->isCancelled()) { p_job(); }
+        this->finishJob();
+    });
+}
+
+void TaskGroup::wait()
+{
+    // Any queued job may belong to another group and take a while, which is
+    // no way to hold up a thread outside the pool, like the UI thread. The
+    // workers are enough to get through this group's jobs.
+    if (!m_pool.isWorker()) {
+        wxMutexLocker lock(m_mutex);
+        while (m_numPending) {
+            m_done.Wait();
+        }
+        return;
+    }
+
+    for (;;) {
+        {
+            wxMutexLocker lock(m_mutex);
+            if (!m_numPending) { return; }
+        }
+
+        // Help out rather than block, so that nested groups can't starve the
+        // pool. Once nothing is left to take, the remaining jobs are running.
+        if (!m_pool.runPending()) {
+            wxMutexLocker lock(m_mutex);
+            if (m_numPending) {
+                m_done.WaitTimeout(1);
+            }
+        }
+    }
+}
+
+void TaskGroup::finishJob()
+{
+    wxMutexLocker lock(m_mutex);
+    m_numPending--;
+    if (!m_numPending) {
+        m_done.Broadcast();
+    }
+}
+
+}; // namespace gw2b
@@ -0,0 +1,185 @@
+/** \file       Util/WorkPool.h
+ *  \brief      Contains the declaration of the work stealing pool and task groups.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef UTIL_WORKPOOL_H_INCLUDED
+#define UTIL_WORKPOOL_H_INCLUDED
+
+#include <deque>
+#include <functional>
+#include <wx/thread.h>
+
+#include "CancellationToken.h"
+
+namespace gw2b
+{
+
+/** Worker threads sharing short jobs through work stealing. Each worker has
+ *  its own queue; it runs its newest job first, and steals the oldest job of
+ *  another worker once it runs out. Jobs are meant to be used through a
+ *  TaskGroup, which has waiting workers help out rather than block, so that
+ *  parallel work can be nested inside jobs. */
+class WorkPool
+{
+public:
+    /** A unit of work to be executed by one of the workers. */
+    typedef std::function<void()>   Job;
+private:
+    class Worker;
+    struct Queue
+    {
+        wxMutex             mutex;
+        std::deque<Job>     jobs;
+    };
+    Array<Queue*>           m_queues;
+    Array<Worker*>          m_workers;
+    wxMutex                 m_mutex;
+    wxCondition             m_jobAvailable;
+    uint                    m_numQueued;
+    uint                    m_nextQueue;
+    bool                    m_stopping;
+public:
+    /** Constructor. Starts the worker threads.
+     *  \param[in]  p_numThreads     Amount of workers. 0 to use one per CPU. */
+    WorkPool(uint p_numThreads = 0);
+    /** Destructor. Drops any jobs not yet started, and waits for the running
+     *  ones to finish. */
+    ~WorkPool();
+
+    /** Gets the pool shared by everything that doesn't need one of its own.
+     *  Created on first use.
+     *  \return WorkPool&   Shared pool. */
+    static WorkPool& shared();
+    /** Destroys the shared pool. Must be done before the application exits. */
+    static void destroyShared();
+
+    /** Queues a job. Posted from a worker, it goes to that worker's queue.
+     *  \param[in]  p_job    Job to execute. */
+    void post(const Job& p_job);
+    /** Runs one queued job on the calling thread, if there is any.
+     *  \return bool    true if a job was run, false if none were queued. */
+    bool runPending();
+    /** Gets the amount of worker threads.
+     *  \return uint    Amount of workers. */
+    uint numThreads() const             { return m_workers.GetSize(); }
+    /** Determines whether the calling thread is one of the workers.
+     *  \return bool    true if it is, false if not. */
+    bool isWorker() const               { return this->currentWorker() >= 0; }
+private:
+    int currentWorker() const;
+    bool takeJob(int p_queue, Job& po_job);
+    bool waitForJob();
+    WorkPool(const WorkPool&);
+    WorkPool& operator=(const WorkPool&);
+}; // class WorkPool
+
+/** Set of jobs on a WorkPool that can be waited on and cancelled together. */
+class TaskGroup
+{
+    enum { CHUNKS_PER_THREAD = 4 };
+
+    WorkPool&               m_pool;
+    wxMutex                 m_mutex;
+    wxCondition             m_done;
+    uint                    m_numPending;
+    volatile bool           m_isCancelled;
+    CancellationToken       m_cancellation;
+public:
+    /** Constructor.
+     *  \param[in]  p_pool   Pool to run the jobs on. */
+    TaskGroup(WorkPool& p_pool = WorkPool::shared());
+    /** Constructor. Creates a group that is also cancelled along with the
+     *  given token.
+     *  \param[in]  p_cancellation   Token of the work this group is part of.
+     *  \param[in]  p_pool           Pool to run the jobs on. */
+    TaskGroup(const CancellationToken& p_cancellation, WorkPool& p_pool = WorkPool::shared());
+    /** Destructor. Waits for the jobs still pending. */
+    ~TaskGroup();
+
+    /** Queues a job as part of this group. Jobs not started by the time the
+     *  group is cancelled are skipped.
+     *  \param[in]  p_job    Job to execute. */
+    void run(const WorkPool::Job& p_job);
+    /** Blocks until all jobs in this group are done. Workers of the pool run
+     *  queued jobs in the meantime; other threads just block. */
+    void wait();
+    /** Cancels this group. */
+    void cancel()                       { storeRelease(m_isCancelled, true); }
+    /** Determines whether this group, or the work it is part of, was
+     *  cancelled.
+     *  \return bool    true if cancelled, false if not. */
+    bool isCancelled() const            { return loadAcquire(m_isCancelled) || m_cancellation.isCancelled(); }
+
+    /** Calls the given body for each index in [p_begin, p_end), split into
+     *  chunks across the pool, and waits for it to finish. Indices not yet
+     *  reached when the group is cancelled are skipped.
+     *  \param[in]  p_begin  First index.
+     *  \param[in]  p_end    One past the last index.
+     *  \param[in]  p_body   Functor taking an int index. */
+    template <typename Body>
+    void parallelFor(int p_begin, int p_end, const Body& p_body);
+private:
+    void finishJob();
+    TaskGroup(const TaskGroup&);
+    TaskGroup& operator=(const TaskGroup&);
+}; // class TaskGroup
+
+template <typename Body>
+void TaskGroup::parallelFor(int p_begin, int p_end, const Body& p_body)
+{
+    if (p_end <= p_begin) { return; }
+
+    int64 size      = p_end - p_begin;
+    int   numChunks = static_cast<int>(wxMin(size, static_cast<int64>(m_pool.numThreads() * CHUNKS_PER_THREAD)));
+
+    for (int i = 0; i < numChunks; i++) {
+        int first = p_begin + static_cast<int>((size * i) / numChunks);
+        int last  = p_begin + static_cast<int>((size * (i + 1)) / numChunks);
+        this->run([this, &p_body, first, last]() {
+            for (int j = first; j < last && !this->isCancelled(); j++) {
+                p_body(j);
+            }
+        });
+    }
+    this->wait();
+}
+
+/** Calls the given body for each index in [p_begin, p_end) on the shared pool,
+ *  and waits for it to finish.
+ *  \param[in]  p_begin          First index.
+ *  \param[in]  p_end            One past the last index.
+ *  \param[in]  p_body           Functor taking an int index.
+ *  \param[in]  p_cancellation   Token that stops the loop early. Optional.
+ *  \return bool    false if the loop was cancelled, true if it finished. */
+template <typename Body>
+bool parallelFor(int p_begin, int p_end, const Body& p_body, const CancellationToken& p_cancellation = CancellationToken())
+{
+    TaskGroup group(p_cancellation);
+    group.parallelFor(p_begin, p_end, p_body);
+    return !group.isCancelled();
+}
+
+}; // namespace gw2b
+
+#endif // UTIL_WORKPOOL_H_INCLUDED
@@ -0,0 +1,184 @@
+/** \file       Util/XnaMath.h
+ *  \brief      Contains a portable subset of the XNA math library.
+ *  \author     Rhoot
+ */
+
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef UTIL_XNAMATH_H_INCLUDED
+#define UTIL_XNAMATH_H_INCLUDED
+
+#include <algorithm>
+
+// Only what the readers need from xnamath.h, in plain scalar code, so the
+// headless front end builds without the DirectX SDK. Names and semantics match
+// the originals, which is why they live in the global namespace.
+
+//----------------------------------------------------------------------------
+//      Types
+//----------------------------------------------------------------------------
+
+/** Four component vector, the SIMD register type of the original. */
+struct XMVECTOR
+{
+    float   v[4];
+};
+
+/** Two component float vector. */
+struct XMFLOAT2
+{
+    float   x, y;
+
+    XMFLOAT2() {}
+    XMFLOAT2(float p_x, float p_y) : x(p_x), y(p_y) {}
+};
+
+/** Three component float vector. */
+struct XMFLOAT3
+{
+    float   x, y, z;
+
+    XMFLOAT3() {}
+    XMFLOAT3(float p_x, float p_y, float p_z) : x(p_x), y(p_y), z(p_z) {}
+};
+
+/** Four component float vector. */
+struct XMFLOAT4
+{
+    float   x, y, z, w;
+
+    XMFLOAT4() {}
+    XMFLOAT4(float p_x, float p_y, float p_z, float p_w) : x(p_x), y(p_y), z(p_z), w(p_w) {}
+};
+
+/** 5-6-5 packed color, x in the lowest bits. */
+struct XMU565
+{
+    unsigned short  v;
+
+    XMU565() {}
+    explicit XMU565(unsigned short p_packed) : v(p_packed) {}
+};
+
+/** Four unsigned bytes. */
+struct XMUBYTE4
+{
+    unsigned char   x, y, z, w;
+};
+
+//----------------------------------------------------------------------------
+//      Loads and stores
+//----------------------------------------------------------------------------
+
+inline XMVECTOR XMVectorSet(float p_x, float p_y, float p_z, float p_w)
+{
+    XMVECTOR result = {{ p_x, p_y, p_z, p_w }};
+    return result;
+}
+
+inline XMVECTOR XMLoadFloat3(const XMFLOAT3* p_source)
+{
+    return XMVectorSet(p_source->x, p_source->y, p_source->z, 0.0f);
+}
+
+inline XMVECTOR XMLoadFloat4(const XMFLOAT4* p_source)
+{
+    return XMVectorSet(p_source->x, p_source->y, p_source->z, p_source->w);
+}
+
+/** Loads the components unnormalized, as 0-31, 0-63 and 0-31. */
+inline XMVECTOR XMLoadU565(const XMU565* p_source)
+{
+    return XMVectorSet(static_cast<float>(p_source->v & 0x1f),
+                       static_cast<float>((p_source->v >> 5) & 0x3f),
+                       static_cast<float>((p_source->v >> 11) & 0x1f),
+                       0.0f);
+}
+
+inline void XMStoreFloat3(XMFLOAT3* po_destination, const XMVECTOR& p_vector)
+{
+    po_destination->x = p_vector.v[0];
+    po_destination->y = p_vector.v[1];
+    po_destination->z = p_vector.v[2];
+}
+
+/** Clamps the components to 0-255 and truncates them, like the SSE version of
+ *  the original that the browser is built with. */
+inline void XMStoreUByte4(XMUBYTE4* po_destination, const XMVECTOR& p_vector)
+{
+    unsigned char components[4];
+    for (int i = 0; i < 4; i++) {
+        float clamped = std::min(std::max(p_vector.v[i], 0.0f), 255.0f);
+        components[i] = static_cast<unsigned char>(clamped);
+    }
+    po_destination->x = components[0];
+    po_destination->y = components[1];
+    po_destination->z = components[2];
+    po_destination->w = components[3];
+}
+
+//----------------------------------------------------------------------------
+//      Arithmetic
+//----------------------------------------------------------------------------
+
+inline XMVECTOR XMVectorSetW(const XMVECTOR& p_vector, float p_w)
+{
+    XMVECTOR result = p_vector;
+    result.v[3] = p_w;
+    return result;
+}
+
+inline XMVECTOR XMVectorSwizzle(const XMVECTOR& p_vector, unsigned int p_e0, unsigned int p_e1, unsigned int p_e2, unsigned int p_e3)
+{
+    return XMVectorSet(p_vector.v[p_e0 & 3], p_vector.v[p_e1 & 3], p_vector.v[p_e2 & 3], p_vector.v[p_e3 & 3]);
+}
+
+inline XMVECTOR XMVectorMultiply(const XMVECTOR& p_v1, const XMVECTOR& p_v2)
+{
+    return XMVectorSet(p_v1.v[0] * p_v2.v[0], p_v1.v[1] * p_v2.v[1], p_v1.v[2] * p_v2.v[2], p_v1.v[3] * p_v2.v[3]);
+}
+
+inline XMVECTOR XMVectorSubtract(const XMVECTOR& p_v1, const XMVECTOR& p_v2)
+{
+    return XMVectorSet(p_v1.v[0] - p_v2.v[0], p_v1.v[1] - p_v2.v[1], p_v1.v[2] - p_v2.v[2], p_v1.v[3] - p_v2.v[3]);
+}
+
+inline XMVECTOR XMVectorMin(const XMVECTOR& p_v1, const XMVECTOR& p_v2)
+{
+    return XMVectorSet(std::min(p_v1.v[0], p_v2.v[0]), std::min(p_v1.v[1], p_v2.v[1]), std::min(p_v1.v[2], p_v2.v[2]), std::min(p_v1.v[3], p_v2.v[3]));
+}
+
+inline XMVECTOR XMVectorMax(const XMVECTOR& p_v1, const XMVECTOR& p_v2)
+{
+    return XMVectorSet(std::max(p_v1.v[0], p_v2.v[0]), std::max(p_v1.v[1], p_v2.v[1]), std::max(p_v1.v[2], p_v2.v[2]), std::max(p_v1.v[3], p_v2.v[3]));
+}
+
+/** Interpolates linearly, returning p_v0 at p_t = 0 and p_v1 at p_t = 1. */
+inline XMVECTOR XMVectorLerp(const XMVECTOR& p_v0, const XMVECTOR& p_v1, float p_t)
+{
+    XMVECTOR result;
+    for (int i = 0; i < 4; i++) {
+        result.v[i] = p_v0.v[i] + (p_v1.v[i] - p_v0.v[i]) * p_t;
+    }
+    return result;
+}
+
+#endif // UTIL_XNAMATH_H_INCLUDED
@@ -22,6 +22,7 @@
 */
 
 #include "stdafx.h"
+#include <vector>
 
 #include "ModelViewer.h"
 
@@ -153,17 +154,26 @@ void ModelViewer::setReader(FileReader* p_reader)
     // Create DX texture cache
     m_textureCache.SetSize(m_model.numMaterialData());
 
-    // Load textures
+    // Models tend to use several textures, so read all of them at once. The
+    // textures themselves have to be created on this thread.
+    std::vector<Array<byte>> textureData(m_model.numMaterialData());
     for (uint i = 0; i < m_model.numMaterialData(); i++) {
         auto& material = m_model.materialData(i);
-        auto& cache    = m_textureCache[i];
+        if (!material.diffuseMap) { continue; }
 
-        // Load diffuse texture
-        if (material.diffuseMap) {
-            cache.diffuseMap = this->loadTexture(material.diffuseMap);
-        } else {
-            cache.diffuseMap = nullptr;
-        }
+        auto entryNumber = this->datFile()->entryNumFromFileId(material.diffuseMap);
+        if (entryNumber == std::numeric_limits<uint>::max()) { continue; }
+
+        auto& data = textureData[i];
+        this->datFile()->readEntryAsync(entryNumber, [&data](uint, const Array<byte>& p_data) {
+            data = p_data;
+        });
+    }
+    this->datFile()->waitForAsyncReads();
+
+    // Load textures
+    for (uint i = 0; i < m_model.numMaterialData(); i++) {
+        m_textureCache[i].diffuseMap = this->loadTexture(textureData[i]);
     }
 
     // Re-focus and re-render
@@ -395,18 +405,15 @@ void ModelViewer::updateMatrices()
     m_effect->SetMatrix("g_WorldViewProjMatrix", reinterpret_cast<D3DXMATRIX*>(&worldViewProjMatrix));
 }
 
-IDirect3DTexture9* ModelViewer::loadTexture(uint p_fileId)
+IDirect3DTexture9* ModelViewer::loadTexture(const Array<byte>& p_fileData)
 {
-    auto entryNumber = this->datFile()->entryNumFromFileId(p_fileId);
-    auto fileData    = this->datFile()->readEntry(entryNumber);
-
     // Bail if read failed
-    if (fileData.GetSize() == 0) { return nullptr; }
+    if (p_fileData.GetSize() == 0) { return nullptr; }
 
     // Convert to image
     ANetFileType fileType;
-    this->datFile()->identifyFileType(fileData.GetPointer(), fileData.GetSize(), fileType);
-    auto reader = FileReader::readerForData(fileData, fileType);
+    this->datFile()->identifyFileType(p_fileData.GetPointer(), p_fileData.GetSize(), fileType);
+    auto reader = FileReader::readerForData(p_fileData, fileType);
     
     // Bail if not an image
     auto imgReader = dynamic_cast<ImageReader*>(reader);
@@ -96,7 +96,7 @@ private:
     bool createBuffers(MeshCache& p_cache, uint p_vertexCount, uint p_vertexSize, uint p_indexCount, uint p_indexSize);
     bool populateBuffers(const Mesh& p_mesh, MeshCache& p_cache);
     void updateMatrices();
-    IDirect3DTexture9* loadTexture(uint p_fileId);
+    IDirect3DTexture9* loadTexture(const Array<byte>& p_fileData);
 }; // class ImageViewer
 
 }; // namespace gw2b
@@ -27,24 +27,26 @@
 #define STDAFX_H_INCLUDED
 
 // STL includes
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <memory>
 
-// OMP
-#include <omp.h>
-
 // wxWidgets
 #include <wx/wxprec.h>
 #ifndef WX_PRECOMP
 #  include <wx/wx.h>
 #endif
 
-// gw2CoreTools
-#include <gw2DatTools/compression/inflateDatFileBuffer.h>
-
-// DirectX9
-#include <d3d9.h>
-#include <d3dx9.h>
-#include <xnamath.h>
+// DirectX9. The headless front end only needs the math types, and uses a
+// portable subset of them so it builds without the DirectX SDK.
+#ifndef GW2B_HEADLESS
+#  include <d3d9.h>
+#  include <d3dx9.h>
+#  include <xnamath.h>
+#else
+#  include "Util/XnaMath.h"
+#endif
 
 // 16-bit floats
 #include "Imported/half.h"
@@ -54,8 +56,10 @@
 #define Assert                      wxASSERT
 
 // Compiler specific
-#define NakedCall                   __declspec(naked)
-#define InlineAsm                   __asm
+#ifdef _MSC_VER
+#  define NakedCall                 __declspec(naked)
+#  define InlineAsm                 __asm
+#endif
 #define ZeroSizeArray               1
 
 namespace gw2b
@@ -0,0 +1,148 @@
+/** \file       AsyncReadBench.cpp
+ *  \brief      Compares asynchronous entry reads with synchronous ones.
+ *  \author     Rhoot
+ */
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include <cstdlib>
+#include <wx/crt.h>
+#include <wx/filefn.h>
+#include <wx/init.h>
+#include <wx/stopwatch.h>
+#include <wx/thread.h>
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#include "DatFile.h"
+#include "SyntheticDat.h"
+
+using namespace gw2b;
+
+namespace
+{
+
+    enum { DEFAULT_NUM_FILES = 0x2000 };
+    enum { DEFAULT_MAX_FILE_SIZE = 0x40000 };   // About 512 MB in total
+    enum { NUM_READS = 0x1000 };
+
+    // Picks the files to read, in random order
+    Array<uint> pickFiles(uint p_numFiles)
+    {
+        Array<uint> fileNums(NUM_READS);
+        uint random = 1;
+        for (uint i = 0; i < NUM_READS; i++) {
+            random = random * 1103515245u + 12345u;
+            fileNums[i] = (random >> 8) % p_numFiles;
+        }
+        return fileNums;
+    }
+
+    // Drops the file from the OS cache, so that reads have to go to the
+    // drive. Not available on Windows, where the numbers are warm.
+    bool evictFromCache(const wxString& p_filename)
+    {
+#ifndef _WIN32
+        int file = ::open(p_filename.fn_str(), O_RDONLY);
+        if (file < 0) { return false; }
+        // Dirty pages are not dropped, and the file was just written
+        ::fsync(file);
+        bool success = ::posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED) == 0;
+        ::close(file);
+        return success;
+#else
+        return false;
+#endif
+    }
+
+    void printResult(const wxChar* p_what, uint64 p_bytes, int64 p_time)
+    {
+        double seconds = wxMax(p_time, (int64)1) / 1000000.0;
+        wxPrintf(wxT("%s\t%.1f\t%.0f\n"), p_what, p_bytes / seconds / 1048576.0, NUM_READS / seconds);
+    }
+
+}; // namespace
+
+int main(int argc, char** argv)
+{
+    wxInitializer initializer;
+
+    uint numFiles    = (argc > 1) ? (uint)::strtoul(argv[1], nullptr, 0) : (uint)DEFAULT_NUM_FILES;
+    uint maxFileSize = (argc > 2) ? (uint)::strtoul(argv[2], nullptr, 0) : (uint)DEFAULT_MAX_FILE_SIZE;
+    wxString filename((argc > 3) ? wxString(argv[3]) : wxString(wxT("AsyncReadBench.dat")));
+    numFiles = wxMax(numFiles, 1u);
+
+    SyntheticDat dat(numFiles, maxFileSize);
+    if (!dat.write(filename)) {
+        wxPrintf(wxT("Failed to write %s\n"), filename);
+        return 2;
+    }
+
+    // Each method gets a freshly opened file with the entry cache off, and
+    // the file is dropped from the OS cache where possible, so neither can be
+    // served from the other's reads
+    auto fileNums = pickFiles(numFiles);
+    uint numBadReads = 0;
+    bool isCold = evictFromCache(filename);
+    wxPrintf(wxT("%s cache\nmethod\tMB/s\treads/s\n"), isCold ? wxT("cold") : wxT("warm"));
+
+    {
+        DatFile datFile(filename);
+        datFile.setCacheBudget(0);
+
+        uint64 bytes = 0;
+        wxStopWatch stopWatch;
+        for (uint i = 0; i < NUM_READS; i++) {
+            auto data = datFile.readFile(fileNums[i]);
+            if (data.GetSize() != dat.fileSize(fileNums[i])) { numBadReads++; }
+            bytes += data.GetSize();
+        }
+        printResult(wxT("sync"), bytes, stopWatch.TimeInMicro().GetValue());
+    }
+
+    {
+        if (isCold) { evictFromCache(filename); }
+        DatFile datFile(filename);
+        datFile.setCacheBudget(0);
+
+        wxMutex mutex;
+        uint64 bytes = 0;
+        wxStopWatch stopWatch;
+        for (uint i = 0; i < NUM_READS; i++) {
+            datFile.readFileAsync(fileNums[i], [&](uint p_fileNum, const Array<byte>& p_data) {
+                wxMutexLocker lock(mutex);
+                if (p_data.GetSize() != dat.fileSize(p_fileNum)) { numBadReads++; }
+                bytes += p_data.GetSize();
+            });
+        }
+        datFile.waitForAsyncReads();
+        printResult(wxT("async"), bytes, stopWatch.TimeInMicro().GetValue());
+    }
+
+    ::wxRemoveFile(filename);
+
+    if (numBadReads) {
+        wxPrintf(wxT("%u reads returned the wrong amount of data\n"), numBadReads);
+        return 1;
+    }
+    return 0;
+}
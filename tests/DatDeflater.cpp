@@ -0,0 +1,396 @@
+/** \file       DatDeflater.cpp
+ *  \brief      Contains the definition of the .dat compressor used by the tests.
+ *  \author     Rhoot
+ */
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "DatDeflater.h"
+
+namespace gw2b
+{
+
+namespace
+{
+
+    enum { MIN_COPY_SIZE = 4 };
+    enum { MAX_COPY_SIZE = MIN_COPY_SIZE + 0xff };
+    enum { MAX_COPY_OFFSET = 0x20000 };
+    enum { NUM_SYMBOLS = 0x100 + 29 };
+    enum { NUM_COPY_SYMBOLS = 34 };
+    enum { MAX_CODE_BITS = 32 };
+    enum { CRC_INTERVAL = 0x4000 };
+    enum { HASH_BITS = 15 };
+    enum { MAX_CHAIN_LENGTH = 0x20 };
+
+    // Code lengths of the static tree that the block trees are encoded with,
+    // same as DatInflater's. Symbols not listed here are 16 bits.
+    const uint8 s_dictionaryCodes[][2] = {
+        { 0x0A, 3  }, { 0x09, 3  }, { 0x08, 3  },
+        { 0x0C, 4  }, { 0x0B, 4  }, { 0x07, 4  }, { 0x00, 4  },
+        { 0xE0, 5  }, { 0x2A, 5  }, { 0x29, 5  }, { 0x06, 5  },
+        { 0x4A, 6  }, { 0x40, 6  }, { 0x2C, 6  }, { 0x2B, 6  }, { 0x28, 6  }, { 0x20, 6  }, { 0x05, 6  }, { 0x04, 6  },
+        { 0x49, 7  }, { 0x48, 7  }, { 0x27, 7  }, { 0x26, 7  }, { 0x25, 7  }, { 0x0D, 7  }, { 0x03, 7  },
+        { 0x6A, 8  }, { 0x69, 8  }, { 0x4C, 8  }, { 0x4B, 8  }, { 0x47, 8  }, { 0x24, 8  },
+        { 0xE8, 9  }, { 0xA0, 9  }, { 0x89, 9  }, { 0x88, 9  }, { 0x68, 9  }, { 0x67, 9  }, { 0x63, 9  }, { 0x60, 9  },
+        { 0x46, 9  }, { 0x23, 9  },
+        { 0xE9, 10 }, { 0xC9, 10 }, { 0xC0, 10 }, { 0xA9, 10 }, { 0xA8, 10 }, { 0x8A, 10 }, { 0x87, 10 }, { 0x80, 10 },
+        { 0x66, 10 }, { 0x65, 10 }, { 0x45, 10 }, { 0x44, 10 }, { 0x43, 10 }, { 0x2D, 10 }, { 0x02, 10 }, { 0x01, 10 },
+        { 0xE5, 11 }, { 0xC8, 11 }, { 0xAA, 11 }, { 0xA5, 11 }, { 0xA4, 11 }, { 0x8B, 11 }, { 0x85, 11 }, { 0x84, 11 },
+        { 0x6C, 11 }, { 0x6B, 11 }, { 0x64, 11 }, { 0x4D, 11 }, { 0x0E, 11 },
+        { 0xE7, 12 }, { 0xCA, 12 }, { 0xC7, 12 }, { 0xA7, 12 }, { 0xA6, 12 }, { 0x86, 12 }, { 0x83, 12 },
+        { 0xE6, 13 }, { 0xE4, 13 }, { 0xC4, 13 }, { 0x8C, 13 }, { 0x2E, 13 }, { 0x22, 13 },
+        { 0xEC, 14 }, { 0xC6, 14 }, { 0x6D, 14 }, { 0x4E, 14 },
+        { 0xEA, 15 }, { 0xCC, 15 }, { 0xAC, 15 }, { 0xAB, 15 }, { 0x8D, 15 }, { 0x11, 15 }, { 0x10, 15 }, { 0x0F, 15 },
+    };
+
+    // A literal, or a copy of size bytes from value bytes back
+    struct Token
+    {
+        uint    size;       // 0 for literals
+        uint    value;
+    };
+
+    // A symbol, and the extra bits written after its code
+    struct Code
+    {
+        uint    symbol;
+        uint    extra;
+        uint    numExtraBits;
+    };
+
+    uint highestBit(uint p_value)
+    {
+        uint bit = 0;
+        while (p_value >>= 1) { bit++; }
+        return bit;
+    }
+
+    // Copy sizes: 0-3 have symbols of their own, larger sizes pick a range
+    // with the symbol and the value within it with the extra bits
+    Code sizeCode(uint p_size)
+    {
+        uint value = p_size - MIN_COPY_SIZE;
+        Code code  = { value, 0, 0 };
+
+        if (value == 0xff) {
+            code.symbol = 28;
+        } else if (value >= 4) {
+            uint range        = highestBit(value) - 1;
+            code.symbol       = range * 4 + (value >> (range - 1)) - 4;
+            code.numExtraBits = range - 1;
+            code.extra        = value & ((1 << code.numExtraBits) - 1);
+        }
+        return code;
+    }
+
+    // Copy offsets, same idea
+    Code offsetCode(uint p_offset)
+    {
+        uint value = p_offset - 1;
+        Code code  = { value, 0, 0 };
+
+        if (value >= 2) {
+            uint range        = highestBit(value);
+            code.symbol       = range * 2 + (value >> (range - 1)) - 2;
+            code.numExtraBits = range - 1;
+            code.extra        = value & ((1 << code.numExtraBits) - 1);
+        }
+        return code;
+    }
+
+    // Plain huffman code lengths. Blocks are far too short for the codes to
+    // get anywhere near MAX_CODE_BITS, so they are not limited.
+    void buildCodeBits(const uint* p_counts, uint p_numSymbols, uint8* po_bits)
+    {
+        typedef std::pair<uint, uint> Node;     // Weight, node number
+        std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+        std::vector<uint> parents(p_numSymbols, 0);
+
+        for (uint i = 0; i < p_numSymbols; i++) {
+            po_bits[i] = 0;
+            if (p_counts[i]) { queue.push(Node(p_counts[i], i)); }
+        }
+        if (queue.empty()) { return; }
+
+        // A lone symbol still needs a code
+        if (queue.size() == 1) {
+            po_bits[queue.top().second] = 1;
+            return;
+        }
+
+        // Parents are always numbered after their children, so depths can be
+        // filled in from the root down
+        uint numNodes = p_numSymbols;
+        while (queue.size() > 1) {
+            Node first  = queue.top(); queue.pop();
+            Node second = queue.top(); queue.pop();
+            parents[first.second] = parents[second.second] = numNodes;
+            parents.push_back(0);
+            queue.push(Node(first.first + second.first, numNodes++));
+        }
+
+        std::vector<uint> depths(numNodes, 0);
+        for (uint i = numNodes - 1; i-- > 0;) {
+            depths[i] = depths[parents[i]] + 1;
+        }
+        for (uint i = 0; i < p_numSymbols; i++) {
+            if (p_counts[i]) { po_bits[i] = depths[i]; }
+        }
+    }
+
+    // Hands out codes the way DatInflater expects them: from all ones and
+    // down, shorter codes first, and the lowest symbol first among codes of
+    // the same length
+    void buildCodes(const uint8* p_bits, uint p_numSymbols, uint32* po_codes)
+    {
+        uint counts[MAX_CODE_BITS];
+        ::memset(counts, 0, sizeof(counts));
+        for (uint i = 0; i < p_numSymbols; i++) {
+            counts[p_bits[i]]++;
+        }
+
+        int64 code = 0;
+        for (uint bits = 1; bits < MAX_CODE_BITS; bits++) {
+            code = code * 2 + 1;
+            if (!counts[bits]) { continue; }
+
+            for (uint i = 0; i < p_numSymbols; i++) {
+                if (p_bits[i] == bits) { po_codes[i] = static_cast<uint32>(code--); }
+            }
+        }
+    }
+
+    uint hashAt(const byte* p_data)
+    {
+        uint32 value;
+        ::memcpy(&value, p_data, sizeof(value));
+        return (value * 0x9e3779b1u) >> (32 - HASH_BITS);
+    }
+
+    // Greedy parse into literals and copies, taking the longest copy found
+    // within MAX_CHAIN_LENGTH earlier positions with the same hash
+    std::vector<Token> findTokens(const byte* p_input, uint p_inputSize)
+    {
+        std::vector<Token> tokens;
+        std::vector<int> heads(1 << HASH_BITS, -1);
+        std::vector<int> previous(p_inputSize, -1);
+
+        uint position = 0;
+        while (position < p_inputSize) {
+            uint bestSize   = 0;
+            uint bestOffset = 0;
+
+            if (position + MIN_COPY_SIZE <= p_inputSize) {
+                uint maxSize  = wxMin(p_inputSize - position, static_cast<uint>(MAX_COPY_SIZE));
+                int candidate = heads[hashAt(p_input + position)];
+
+                for (uint i = 0; i < MAX_CHAIN_LENGTH && candidate >= 0; i++) {
+                    uint offset = position - candidate;
+                    if (offset > MAX_COPY_OFFSET) { break; }
+
+                    uint size = 0;
+                    while (size < maxSize && p_input[candidate + size] == p_input[position + size]) { size++; }
+                    if (size > bestSize) {
+                        bestSize   = size;
+                        bestOffset = offset;
+                        if (size == maxSize) { break; }
+                    }
+                    candidate = previous[candidate];
+                }
+            }
+
+            Token token;
+            if (bestSize >= MIN_COPY_SIZE) {
+                token.size  = bestSize;
+                token.value = bestOffset;
+            } else {
+                token.size  = 0;
+                token.value = p_input[position];
+            }
+            tokens.push_back(token);
+
+            // Every position passed gets to be a copy source
+            uint end = position + wxMax(token.size, 1u);
+            for (; position < end; position++) {
+                if (position + MIN_COPY_SIZE > p_inputSize) { continue; }
+                uint hash          = hashAt(p_input + position);
+                previous[position] = heads[hash];
+                heads[hash]        = position;
+            }
+        }
+
+        return tokens;
+    }
+
+    /** Writes the output most significant bit first, a dword at a time. */
+    class BitWriter
+    {
+        std::vector<uint32> m_words;
+        uint64              m_buffer;
+        uint                m_numBits;
+    public:
+        BitWriter()
+            : m_buffer(0)
+            , m_numBits(0)
+        {
+        }
+
+        void write(uint32 p_value, uint p_bits)
+        {
+            if (!p_bits) { return; }
+
+            m_buffer   = (m_buffer << p_bits) | (p_value & ((static_cast<uint64>(1) << p_bits) - 1));
+            m_numBits += p_bits;
+            if (m_numBits >= 32) {
+                m_numBits -= 32;
+                this->putWord(static_cast<uint32>(m_buffer >> m_numBits));
+            }
+        }
+
+        Array<byte> finish()
+        {
+            if (m_numBits) {
+                this->putWord(static_cast<uint32>(m_buffer << (32 - m_numBits)));
+                m_numBits = 0;
+            }
+
+            Array<byte> output(m_words.size() * sizeof(uint32));
+            if (!m_words.empty()) {
+                ::memcpy(output.GetPointer(), &m_words[0], output.GetSize());
+            }
+            return output;
+        }
+    private:
+        void putWord(uint32 p_word)
+        {
+            // The inflater skips every CRC_INTERVAL:th dword without looking
+            // at it, so it is left zero
+            if ((m_words.size() + 1) % CRC_INTERVAL == 0) {
+                m_words.push_back(0);
+            }
+            m_words.push_back(p_word);
+        }
+    }; // class BitWriter
+
+    // Writes the code lengths of a tree, up to its last used symbol. They are
+    // run-length encoded with the static tree, from the last symbol to the
+    // first.
+    void writeTree(BitWriter& p_writer, const uint8* p_bits, uint p_numSymbols, const uint32* p_dictionaryCodes, const uint8* p_dictionaryBits)
+    {
+        while (p_numSymbols && !p_bits[p_numSymbols - 1]) { p_numSymbols--; }
+        p_writer.write(p_numSymbols, 16);
+
+        int remaining = p_numSymbols - 1;
+        while (remaining >= 0) {
+            uint bits = p_bits[remaining];
+            int count = 1;
+            while (count < 8 && remaining - count >= 0 && p_bits[remaining - count] == bits) { count++; }
+
+            uint code = ((count - 1) << 5) | bits;
+            p_writer.write(p_dictionaryCodes[code], p_dictionaryBits[code]);
+            remaining -= count;
+        }
+    }
+
+}; // namespace
+
+Array<byte> DatDeflater::deflate(const byte* p_input, uint p_inputSize, uint p_blockSymbols)
+{
+    if (p_inputSize) { Ensure::notNull(p_input); }
+
+    // Blocks come in multiples of 0x1000 symbols
+    uint blockUnits   = wxMin(wxMax((p_blockSymbols + 0xfff) >> 12, 1u), 16u);
+    uint blockSymbols = blockUnits << 12;
+
+    uint8  dictionaryBits[0x100];
+    uint32 dictionaryCodes[0x100];
+    ::memset(dictionaryBits, 16, sizeof(dictionaryBits));
+    for (uint i = 0; i < sizeof(s_dictionaryCodes) / sizeof(s_dictionaryCodes[0]); i++) {
+        dictionaryBits[s_dictionaryCodes[i][0]] = s_dictionaryCodes[i][1];
+    }
+    buildCodes(dictionaryBits, 0x100, dictionaryCodes);
+
+    auto tokens = findTokens(p_input, p_inputSize);
+    BitWriter writer;
+
+    // Header: an unused dword, the uncompressed size, an unused nibble and
+    // a nibble holding the minimum copy size
+    writer.write(0, 32);
+    writer.write(p_inputSize, 32);
+    writer.write(0, 4);
+    writer.write(MIN_COPY_SIZE - 1, 4);
+
+    // Every block but the last has exactly blockSymbols symbols. The last one
+    // ends with the output.
+    for (uint first = 0; first < tokens.size(); first += blockSymbols) {
+        uint last = wxMin(first + blockSymbols, static_cast<uint>(tokens.size()));
+
+        uint symbolCounts[NUM_SYMBOLS];
+        uint copyCounts[NUM_COPY_SYMBOLS];
+        ::memset(symbolCounts, 0, sizeof(symbolCounts));
+        ::memset(copyCounts, 0, sizeof(copyCounts));
+
+        for (uint i = first; i < last; i++) {
+            if (!tokens[i].size) {
+                symbolCounts[tokens[i].value]++;
+            } else {
+                symbolCounts[0x100 + sizeCode(tokens[i].size).symbol]++;
+                copyCounts[offsetCode(tokens[i].value).symbol]++;
+            }
+        }
+
+        uint8  symbolBits[NUM_SYMBOLS];
+        uint8  copyBits[NUM_COPY_SYMBOLS];
+        uint32 symbolCodes[NUM_SYMBOLS];
+        uint32 copyCodes[NUM_COPY_SYMBOLS];
+        buildCodeBits(symbolCounts, NUM_SYMBOLS, symbolBits);
+        buildCodeBits(copyCounts, NUM_COPY_SYMBOLS, copyBits);
+        buildCodes(symbolBits, NUM_SYMBOLS, symbolCodes);
+        buildCodes(copyBits, NUM_COPY_SYMBOLS, copyCodes);
+
+        writeTree(writer, symbolBits, NUM_SYMBOLS, dictionaryCodes, dictionaryBits);
+        writeTree(writer, copyBits, NUM_COPY_SYMBOLS, dictionaryCodes, dictionaryBits);
+        writer.write(blockUnits - 1, 4);
+
+        for (uint i = first; i < last; i++) {
+            if (!tokens[i].size) {
+                uint symbol = tokens[i].value;
+                writer.write(symbolCodes[symbol], symbolBits[symbol]);
+                continue;
+            }
+
+            auto size = sizeCode(tokens[i].size);
+            writer.write(symbolCodes[0x100 + size.symbol], symbolBits[0x100 + size.symbol]);
+            writer.write(size.extra, size.numExtraBits);
+
+            auto offset = offsetCode(tokens[i].value);
+            writer.write(copyCodes[offset.symbol], copyBits[offset.symbol]);
+            writer.write(offset.extra, offset.numExtraBits);
+        }
+    }
+
+    return writer.finish();
+}
+
+}; // namespace gw2b
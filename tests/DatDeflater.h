@@ -0,0 +1,52 @@
+/** \file       DatDeflater.h
+ *  \brief      Contains the declaration of the .dat compressor used by the tests.
+ *  \author     Rhoot
+ */
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef DATDEFLATER_H_INCLUDED
+#define DATDEFLATER_H_INCLUDED
+
+namespace gw2b
+{
+
+/** Compresses data into the format DatInflater reads, so tests can write
+ *  compressed .dat entries without game data.
+ *
+ *  Copies are found with a greedy hash chain search, and each block gets its
+ *  own huffman trees built from the symbols in it. Nothing is tuned for
+ *  ratio or speed; the point is valid input that uses every part of the
+ *  format, including the checksum dwords that split up long input. */
+class DatDeflater
+{
+public:
+    /** Compresses data.
+     *  \param[in]  p_input          Data to compress.
+     *  \param[in]  p_inputSize      Size of the data, in bytes.
+     *  \param[in]  p_blockSymbols   Amount of symbols per block. Rounded up
+     *                              to a multiple of 0x1000, max 0x10000.
+     *  \return Array<byte> Compressed data. */
+    static Array<byte> deflate(const byte* p_input, uint p_inputSize, uint p_blockSymbols = 0x2000);
+}; // class DatDeflater
+
+}; // namespace gw2b
+
+#endif // DATDEFLATER_H_INCLUDED
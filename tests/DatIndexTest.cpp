@@ -0,0 +1,205 @@
+/** \file       DatIndexTest.cpp
+ *  \brief      Writes .dat indexes in each format and checks what is read back.
+ *  \author     Rhoot
+ */
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include <wx/crt.h>
+#include <wx/filefn.h>
+#include <wx/init.h>
+
+#include "DatIndex.h"
+#include "DatIndexIO.h"
+
+using namespace gw2b;
+
+namespace
+{
+
+    enum { NUM_ROOT_CATEGORIES = 8 };
+    enum { NUM_SUB_CATEGORIES = 3 };
+    enum { NUM_ENTRIES = 0x12345 };         // Not a whole amount of handle blocks
+    enum { NAMED_ENTRY_INTERVAL = 97 };
+
+    // Builds an index with a bit of everything the formats have to keep:
+    // nested categories, unknown sizes, file types past the packed escape and
+    // a few custom names
+    void buildIndex(DatIndex& po_index)
+    {
+        po_index.setDatTimestamp(0x123456789abcull);
+        for (uint i = 0; i < NUM_ROOT_CATEGORIES; i++) {
+            auto root = po_index.addIndexCategory(wxString::Format(wxT("Root %u"), i));
+            for (uint j = 0; j < NUM_SUB_CATEGORIES; j++) {
+                root->findOrAddSubCategory(wxString::Format(wxT("Sub %u.%u"), i, j));
+            }
+        }
+
+        for (uint i = 0; i < NUM_ENTRIES; i++) {
+            auto& entry = po_index.addIndexEntry()
+                ->setMftEntry(i + 16)
+                .setBaseId(i * 3 + 5)
+                .setFileId(i * 3 + 7)
+                .setSize((i % 7) ? i * 13 : std::numeric_limits<uint32>::max())
+                .setFileType(static_cast<ANetFileType>(i % 40));
+            if (!(i % NAMED_ENTRY_INTERVAL)) { entry.setName(wxString::Format(wxT("Entry %u"), i)); }
+            po_index.category(i % po_index.numCategories())->addEntry(&entry);
+            entry.finalizeAdd();
+        }
+    }
+
+    bool writeIndex(DatIndex& p_index, const wxString& p_filename, uint p_version)
+    {
+        DatIndexWriter writer(p_index);
+        if (!writer.open(p_filename, p_version)) { return false; }
+        while (!writer.isDone()) {
+            if (!writer.write()) { return false; }
+        }
+        return writer.commit();
+    }
+
+    // Returns the amount of read cycles it took, or 0 on failure
+    uint readIndex(DatIndex& po_index, const wxString& p_filename, const DatIndexReader::EntryFilter& p_filter = DatIndexReader::EntryFilter())
+    {
+        DatIndexReader reader(po_index);
+        if (!reader.open(p_filename)) { return 0; }
+        reader.setEntryFilter(p_filter);
+
+        DatIndexBatch batch(po_index);
+        uint numCycles = 0;
+        while (!reader.isDone()) {
+            if (!(reader.read() & DatIndexReader::RR_Success)) { return 0; }
+            numCycles++;
+        }
+        return numCycles;
+    }
+
+    bool isSameEntry(const DatIndexEntry& p_expected, const DatIndexEntry& p_actual)
+    {
+        return p_expected.fileId() == p_actual.fileId()
+            && p_expected.baseId() == p_actual.baseId()
+            && p_expected.mftEntry() == p_actual.mftEntry()
+            && p_expected.size() == p_actual.size()
+            && p_expected.fileType() == p_actual.fileType()
+            && p_expected.hasCustomName() == p_actual.hasCustomName()
+            && p_expected.name() == p_actual.name()
+            && p_expected.category()->index() == p_actual.category()->index();
+    }
+
+    // Compares the given index against the expected one. Returns the amount
+    // of differences.
+    uint compareIndexes(const DatIndex& p_expected, const DatIndex& p_actual)
+    {
+        uint numDifferences = 0;
+        if (p_expected.datTimestamp() != p_actual.datTimestamp()) { numDifferences++; }
+        if (p_expected.highestMftEntry() != p_actual.highestMftEntry()) { numDifferences++; }
+        if (p_expected.numCategories() != p_actual.numCategories()) { return numDifferences + 1; }
+        if (p_expected.numEntries() != p_actual.numEntries()) { return numDifferences + 1; }
+
+        for (uint i = 0; i < p_expected.numCategories(); i++) {
+            auto expected = p_expected.category(i);
+            auto actual   = p_actual.category(i);
+            if (expected->name() != actual->name()
+                || (expected->parent() ? expected->parent()->index() : -1) != (actual->parent() ? actual->parent()->index() : -1)
+                || expected->numEntries() != actual->numEntries()) {
+                numDifferences++;
+                continue;
+            }
+            // Entries keep their order within a category
+            for (uint j = 0; j < expected->numEntries(); j++) {
+                if (expected->entry(j)->index() != actual->entry(j)->index()) { numDifferences++; }
+            }
+        }
+
+        for (uint i = 0; i < p_expected.numEntries(); i++) {
+            if (!isSameEntry(*p_expected.entry(i), *p_actual.entry(i))) { numDifferences++; }
+        }
+        return numDifferences;
+    }
+
+    uint report(const wxChar* p_what, uint p_numDifferences)
+    {
+        wxPrintf(wxT("%s: %u differences\n"), p_what, p_numDifferences);
+        return p_numDifferences;
+    }
+
+}; // namespace
+
+int main(int argc, char** argv)
+{
+    wxInitializer initializer;
+
+    wxString filename = (argc > 1) ? wxString(argv[1]) : wxString(wxT("DatIndexTest.idx"));
+    uint numFailures = 0;
+
+    DatIndex expected;
+    buildIndex(expected);
+
+    // Column files are taken in place, in a single read cycle
+    {
+        DatIndex index;
+        uint numCycles = writeIndex(expected, filename, DatIndex_ColumnVersion) ? readIndex(index, filename) : 0;
+        numFailures += report(wxT("columns"), numCycles ? compareIndexes(expected, index) : 1);
+        if (numCycles != 1) {
+            wxPrintf(wxT("columns took %u read cycles\n"), numCycles);
+            ::wxRemoveFile(filename);
+            return 1;
+        }
+
+        // Changing entries in place mustn't touch the file, while adding one
+        // moves them out of it
+        index.category(0)->entry(0)->setSize(42);
+        expected.category(0)->entry(0)->setSize(42);
+        DatIndex unchanged;
+        readIndex(unchanged, filename);
+        numFailures += report(wxT("columns, changed in place"), unchanged.entry(0)->size() == 42);
+
+        for (uint i = 0; i < 2; i++) {
+            auto& entry = (i ? expected : index).addIndexEntry()->setMftEntry(NUM_ENTRIES + 16).setBaseId(1).setFileId(2);
+            (i ? expected : index).category(1)->addEntry(&entry);
+            entry.finalizeAdd();
+        }
+        numFailures += report(wxT("columns, grown"), compareIndexes(expected, index));
+
+        // The file in use is replaced
+        DatIndex rewritten;
+        numCycles = writeIndex(index, filename, DatIndex_ColumnVersion) ? readIndex(rewritten, filename) : 0;
+        numFailures += report(wxT("columns, rewritten"), numCycles ? compareIndexes(expected, rewritten) : 1);
+    }
+
+    // Filtered entries are added one at a time
+    {
+        DatIndex index;
+        uint numCycles = readIndex(index, filename, [](uint p_fileNum, uint, uint) { return (p_fileNum % 2) == 0; });
+        bool isFiltered = (numCycles > 1) && (index.numEntries() == (NUM_ENTRIES + 1) / 2);
+        for (uint i = 0; isFiltered && i < index.numEntries(); i++) {
+            isFiltered = isSameEntry(*expected.entry(i * 2), *index.entry(i));
+        }
+        numFailures += report(wxT("columns, filtered"), isFiltered ? 0 : 1);
+    }
+
+    {
+        DatIndex index;
+        uint numCycles = writeIndex(expected, filename, DatIndex_PackedVersion) ? readIndex(index, filename) : 0;
+        numFailures += report(wxT("packed"), numCycles ? compareIndexes(expected, index) : 1);
+    }
+
+    ::wxRemoveFile(filename);
+    return numFailures ? 1 : 0;
+}
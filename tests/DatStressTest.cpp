@@ -0,0 +1,195 @@
+/** \file       DatStressTest.cpp
+ *  \brief      Has many threads read random entries from one DatFile at once.
+ *  \author     Rhoot
+ */
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include <cstdlib>
+#include <wx/crt.h>
+#include <wx/filefn.h>
+#include <wx/init.h>
+
+#include "DatFile.h"
+#include "SyntheticDat.h"
+#include "Util/ThreadPool.h"
+
+using namespace gw2b;
+
+namespace
+{
+
+    enum { NUM_FILES = 0x1000 };
+    enum { MAX_FILE_SIZE = 0x8000 };
+    enum { READS_PER_THREAD = 0x800 };
+    enum { MIN_THREADS = 16 };
+    enum { CACHE_BUDGET = 0x100000 };
+    enum { BATCH_SIZE = 8 };
+    enum { ASYNC_READS = 0x800 };
+
+    // Reads random files through each of the thread safe read functions, and
+    // checks them against what was written. Returns the amount of bad reads.
+    uint readRandomFiles(const DatFile& p_datFile, const SyntheticDat& p_dat, uint p_seed)
+    {
+        Array<byte> scratch;
+        Array<byte> buffer;
+        uint numFailures = 0;
+        uint random      = p_seed * 2654435761u + 1;
+
+        for (uint i = 0; i < READS_PER_THREAD; i++) {
+            random = random * 1103515245u + 12345u;
+            uint fileNum  = (random >> 8) % p_dat.numFiles();
+            uint fileSize = p_dat.fileSize(fileNum);
+
+            switch (i % 5) {
+            case 0: {
+                auto data = p_datFile.readFile(fileNum, scratch);
+                if (data.GetSize() != fileSize || !p_dat.isFileData(fileNum, data.GetPointer(), data.GetSize())) { numFailures++; }
+                break;
+            }
+            case 1: {
+                uint peekSize = 1 + (random >> 4) % fileSize;
+                buffer.SetSize(peekSize);
+                uint size = p_datFile.peekFile(fileNum, peekSize, buffer.GetPointer(), scratch);
+                if (size != peekSize || !p_dat.isFileData(fileNum, buffer.GetPointer(), size)) { numFailures++; }
+                break;
+            }
+            case 2: {
+                // Compressed entries come back raw, and are inflated apart
+                // from the read
+                Array<byte> raw;
+                uint entryNum = fileNum + p_datFile.mftFileOffset();
+                if (!p_datFile.readRawEntry(entryNum, 0, raw)) {
+                    numFailures++;
+                    break;
+                }
+                if (p_dat.isCompressed(fileNum)) {
+                    raw = p_datFile.inflateRawEntry(entryNum, raw, 0);
+                }
+                if (raw.GetSize() != fileSize || !p_dat.isFileData(fileNum, raw.GetPointer(), raw.GetSize())) {
+                    numFailures++;
+                }
+                break;
+            }
+            case 3: {
+                // Batches are read in the order they are stored, but have to
+                // come back in the order they were asked for
+                uint fileNums[BATCH_SIZE];
+                uint entryNums[BATCH_SIZE];
+                Array<byte> raw[BATCH_SIZE];
+                for (uint j = 0; j < BATCH_SIZE; j++) {
+                    random = random * 1103515245u + 12345u;
+                    fileNums[j]  = (random >> 8) % p_dat.numFiles();
+                    entryNums[j] = fileNums[j] + p_datFile.mftFileOffset();
+                }
+                p_datFile.readRawEntries(entryNums, BATCH_SIZE, 0, raw, scratch);
+
+                for (uint j = 0; j < BATCH_SIZE; j++) {
+                    if (p_dat.isCompressed(fileNums[j])) {
+                        raw[j] = p_datFile.inflateRawEntry(entryNums[j], raw[j], 0);
+                    }
+                    if (raw[j].GetSize() != p_dat.fileSize(fileNums[j]) || !p_dat.isFileData(fileNums[j], raw[j].GetPointer(), raw[j].GetSize())) {
+                        numFailures++;
+                    }
+                }
+                break;
+            }
+            default: {
+                // Lazily opened files build their ID tables on first use,
+                // which the other threads race for
+                uint entryNum = fileNum + p_datFile.mftFileOffset();
+                if (p_datFile.entryNumFromFileId(SyntheticDat::fileId(fileNum)) != entryNum) { numFailures++; }
+                if (p_datFile.entryNumFromBaseId(SyntheticDat::baseId(fileNum)) != entryNum) { numFailures++; }
+                break;
+            }
+            }
+        }
+
+        return numFailures;
+    }
+
+    uint stressTest(const wxString& p_filename, const SyntheticDat& p_dat, DatFile::OpenMode p_mode, DatFile::TableMode p_tableMode, uint64 p_cacheBudget)
+    {
+        DatFile datFile;
+        if (!datFile.open(p_filename, p_mode, p_tableMode)) {
+            wxPrintf(wxT("Failed to open %s\n"), p_filename);
+            return 1;
+        }
+        datFile.setCacheBudget(p_cacheBudget);
+
+        uint numThreads = wxMax((uint)wxThread::GetCPUCount() * 2, (uint)MIN_THREADS);
+        Array<uint> failures(numThreads);
+        ThreadPool pool(numThreads);
+
+        for (uint t = 0; t < numThreads; t++) {
+            pool.post([&, t] { failures[t] = readRandomFiles(datFile, p_dat, t); });
+        }
+
+        // Asynchronous reads race the others for the cache and entry sizes
+        wxMutex mutex;
+        uint numAsyncFailures = 0;
+        for (uint i = 0; i < ASYNC_READS; i++) {
+            uint fileNum = (i * 2654435761u >> 8) % p_dat.numFiles();
+            datFile.readFileAsync(fileNum, [&](uint p_fileNum, const Array<byte>& p_data) {
+                if (p_data.GetSize() != p_dat.fileSize(p_fileNum) || !p_dat.isFileData(p_fileNum, p_data.GetPointer(), p_data.GetSize())) {
+                    wxMutexLocker lock(mutex);
+                    numAsyncFailures++;
+                }
+            });
+        }
+        pool.wait();
+        datFile.waitForAsyncReads();
+
+        uint numFailures = numAsyncFailures;
+        for (uint t = 0; t < numThreads; t++) {
+            numFailures += failures[t];
+        }
+
+        wxPrintf(wxT("%s, %s tables, cache %s: %u threads, %u bad reads\n"),
+            datFile.isMapped() ? wxT("mapped") : wxT("streamed"),
+            (p_tableMode == DatFile::TM_Lazy) ? wxT("lazy") : wxT("eager"),
+            p_cacheBudget ? wxT("on") : wxT("off"),
+            numThreads, numFailures);
+        return numFailures;
+    }
+
+}; // namespace
+
+int main(int argc, char** argv)
+{
+    wxInitializer initializer;
+
+    wxString filename = (argc > 1) ? wxString(argv[1]) : wxString(wxT("DatStressTest.dat"));
+    // Most files are compressed, so that inflating, the streamed peeks and
+    // the uncompressed sizes filled in as they are found are all raced for
+    SyntheticDat dat(NUM_FILES, MAX_FILE_SIZE, true);
+    if (!dat.write(filename)) {
+        wxPrintf(wxT("Failed to write %s\n"), filename);
+        return 2;
+    }
+
+    uint numFailures = 0;
+    numFailures += stressTest(filename, dat, DatFile::OM_Stream, DatFile::TM_Eager, 0);
+    numFailures += stressTest(filename, dat, DatFile::OM_Stream, DatFile::TM_Lazy, CACHE_BUDGET);
+    numFailures += stressTest(filename, dat, DatFile::OM_Mapped, DatFile::TM_Lazy, 0);
+    numFailures += stressTest(filename, dat, DatFile::OM_Mapped, DatFile::TM_Eager, CACHE_BUDGET);
+
+    ::wxRemoveFile(filename);
+    return numFailures ? 1 : 0;
+}
@@ -0,0 +1,150 @@
+/** \file       IdLookupBench.cpp
+ *  \brief      Compares DatFile's ID lookups with a linear scan of the entries.
+ *  \author     Rhoot
+ */
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include <cstdlib>
+#include <wx/crt.h>
+#include <wx/filefn.h>
+#include <wx/init.h>
+#include <wx/stopwatch.h>
+
+#include "DatFile.h"
+#include "SyntheticDat.h"
+
+using namespace gw2b;
+
+namespace
+{
+
+    enum { DEFAULT_NUM_FILES = 0x50000 };   // About as many as Gw2.dat has
+    enum { MAX_FILE_SIZE = 0x10 };
+    enum { NUM_SCAN_LOOKUPS = 0x400 };
+    enum { NUM_TABLE_LOOKUPS = 0x1000000 };
+
+    struct EntryIds
+    {
+        uint    baseId;
+        uint    fileId;
+    };
+
+    // Looks up the file ID the way DatFile used to, by checking every entry
+    uint scanForFileId(const Array<EntryIds>& p_ids, uint p_fileId)
+    {
+        for (uint i = 0; i < p_ids.GetSize(); i++) {
+            if (p_ids[i].fileId == p_fileId) { return i; }
+        }
+        return std::numeric_limits<uint>::max();
+    }
+
+    uint scanForBaseId(const Array<EntryIds>& p_ids, uint p_baseId)
+    {
+        for (uint i = 0; i < p_ids.GetSize(); i++) {
+            if (p_ids[i].baseId == p_baseId) { return i; }
+        }
+        return std::numeric_limits<uint>::max();
+    }
+
+    // Picks IDs spread across the whole file, so the scans don't all end
+    // early
+    uint randomFileNum(uint& pio_random, uint p_numFiles)
+    {
+        pio_random = pio_random * 1103515245u + 12345u;
+        return (pio_random >> 8) % p_numFiles;
+    }
+
+    void printResult(const wxChar* p_what, uint p_numLookups, int64 p_time)
+    {
+        double nsPerLookup = (p_time * 1000.0) / p_numLookups;
+        wxPrintf(wxT("%s\t%u\t%.1f\n"), p_what, p_numLookups, nsPerLookup);
+    }
+
+}; // namespace
+
+int main(int argc, char** argv)
+{
+    wxInitializer initializer;
+
+    uint numFiles = (argc > 1) ? (uint)::strtoul(argv[1], nullptr, 0) : (uint)DEFAULT_NUM_FILES;
+    numFiles = wxMax(numFiles, 1u);
+    wxString filename(wxT("IdLookupBench.dat"));
+
+    SyntheticDat dat(numFiles, MAX_FILE_SIZE);
+    DatFile datFile;
+    if (!dat.write(filename) || !datFile.open(filename)) {
+        wxPrintf(wxT("Failed to create %s\n"), filename);
+        return 2;
+    }
+
+    // The scans get the IDs of every entry, as DatFile keeps them
+    Array<EntryIds> ids(datFile.numEntries());
+    for (uint i = 0; i < ids.GetSize(); i++) {
+        ids[i].baseId = datFile.baseIdFromEntryNum(i);
+        ids[i].fileId = datFile.fileIdFromEntryNum(i);
+    }
+
+    wxPrintf(wxT("%u entries\nlookup\tcount\tns each\n"), datFile.numEntries());
+    uint numMismatches = 0;
+    uint random;
+
+    // Linear scans
+    random = 1;
+    wxStopWatch stopWatch;
+    for (uint i = 0; i < NUM_SCAN_LOOKUPS; i++) {
+        uint fileNum = randomFileNum(random, numFiles);
+        if (scanForFileId(ids, SyntheticDat::fileId(fileNum)) != fileNum + datFile.mftFileOffset()) { numMismatches++; }
+    }
+    printResult(wxT("fileId scan"), NUM_SCAN_LOOKUPS, stopWatch.TimeInMicro().GetValue());
+
+    random = 1;
+    stopWatch.Start();
+    for (uint i = 0; i < NUM_SCAN_LOOKUPS; i++) {
+        uint fileNum = randomFileNum(random, numFiles);
+        if (scanForBaseId(ids, SyntheticDat::baseId(fileNum)) != fileNum + datFile.mftFileOffset()) { numMismatches++; }
+    }
+    printResult(wxT("baseId scan"), NUM_SCAN_LOOKUPS, stopWatch.TimeInMicro().GetValue());
+
+    // Lookup tables
+    random = 1;
+    stopWatch.Start();
+    for (uint i = 0; i < NUM_TABLE_LOOKUPS; i++) {
+        uint fileNum = randomFileNum(random, numFiles);
+        if (datFile.entryNumFromFileId(SyntheticDat::fileId(fileNum)) != fileNum + datFile.mftFileOffset()) { numMismatches++; }
+    }
+    printResult(wxT("fileId table"), NUM_TABLE_LOOKUPS, stopWatch.TimeInMicro().GetValue());
+
+    random = 1;
+    stopWatch.Start();
+    for (uint i = 0; i < NUM_TABLE_LOOKUPS; i++) {
+        uint fileNum = randomFileNum(random, numFiles);
+        if (datFile.entryNumFromBaseId(SyntheticDat::baseId(fileNum)) != fileNum + datFile.mftFileOffset()) { numMismatches++; }
+    }
+    printResult(wxT("baseId table"), NUM_TABLE_LOOKUPS, stopWatch.TimeInMicro().GetValue());
+
+    datFile.close();
+    ::wxRemoveFile(filename);
+
+    if (numMismatches) {
+        wxPrintf(wxT("%u lookups found the wrong entry\n"), numMismatches);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,183 @@
+/** \file       IndexFormatBench.cpp
+ *  \brief      Compares the size and load time of the .dat index formats.
+ *  \author     Rhoot
+ */
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include <cstdlib>
+#include <wx/crt.h>
+#include <wx/file.h>
+#include <wx/filefn.h>
+#include <wx/init.h>
+#include <wx/stopwatch.h>
+
+#include "DatIndex.h"
+#include "DatIndexIO.h"
+
+using namespace gw2b;
+
+namespace
+{
+
+    enum { DEFAULT_NUM_ENTRIES = 0x50000 }; // About as many as Gw2.dat has
+    enum { NUM_CATEGORIES = 0x20 };
+    enum { NAMED_ENTRY_INTERVAL = 97 };
+    enum { NUM_LOADS = 5 };
+
+    // Builds an index shaped like that of Gw2.dat: IDs growing along with
+    // the MFT entry number, with some gaps, and few custom names
+    void buildIndex(DatIndex& po_index, uint p_numEntries)
+    {
+        po_index.setDatTimestamp(0x123456789abcull);
+        for (uint i = 0; i < NUM_CATEGORIES; i++) {
+            po_index.addIndexCategory(wxString::Format(wxT("Category %u"), i));
+        }
+
+        uint random = 1;
+        uint baseId = 0x10;
+        for (uint i = 0; i < p_numEntries; i++) {
+            random  = random * 1103515245u + 12345u;
+            baseId += 1 + ((random >> 8) % 4);
+            auto& entry = po_index.addIndexEntry()
+                ->setMftEntry(i + 16)
+                .setBaseId(baseId)
+                .setFileId(baseId + 1)
+                .setSize((random >> 12) % 0x40000)
+                .setFileType(static_cast<ANetFileType>((random >> 16) % 28));
+            if (!(i % NAMED_ENTRY_INTERVAL)) { entry.setName(wxString::Format(wxT("Entry %u"), i)); }
+            po_index.category((random >> 20) % NUM_CATEGORIES)->addEntry(&entry);
+            entry.finalizeAdd();
+        }
+    }
+
+    // The writer only writes current formats, so version 2 files are written
+    // here. They stored every name, default or not.
+    bool writeVersion2(const DatIndex& p_index, const wxString& p_filename)
+    {
+        wxFile file(p_filename, wxFile::write);
+        if (!file.IsOpened()) { return false; }
+
+        DatIndexHead header;
+        header.magicInteger  = DatIndex_Magic;
+        header.version       = 2;
+        header.datTimestamp  = p_index.datTimestamp();
+        header.numEntries    = p_index.numEntries();
+        header.numCategories = p_index.numCategories();
+        bool result = (file.Write(&header, sizeof(header)) == sizeof(header));
+
+        for (uint i = 0; result && i < p_index.numCategories(); i++) {
+            auto category = p_index.category(i);
+            auto name     = category->name().ToUTF8();
+            DatIndexCategoryFields fields;
+            fields.parent     = category->parent() ? category->parent()->index() : DatIndex_RootCategory;
+            fields.nameLength = name.length();
+            result = (file.Write(&fields, sizeof(fields)) == sizeof(fields))
+                  && (file.Write(name.data(), name.length()) == name.length());
+        }
+
+        // Version 2 entries lack the size field
+        uint fieldsSize = sizeof(DatIndexEntryFields) - sizeof(uint32);
+        for (uint i = 0; result && i < p_index.numEntries(); i++) {
+            auto entry = p_index.entry(i);
+            auto name  = entry->name().ToUTF8();
+            DatIndexEntryFields fields;
+            fields.category   = entry->category()->index();
+            fields.baseId     = entry->baseId();
+            fields.fileId     = entry->fileId();
+            fields.mftEntry   = entry->mftEntry();
+            fields.fileType   = entry->fileType();
+            fields.nameLength = name.length();
+            result = (file.Write(&fields, fieldsSize) == fieldsSize)
+                  && (file.Write(name.data(), name.length()) == name.length());
+        }
+
+        return result;
+    }
+
+    bool writeIndex(DatIndex& p_index, const wxString& p_filename, uint p_version)
+    {
+        DatIndexWriter writer(p_index);
+        if (!writer.open(p_filename, p_version)) { return false; }
+        while (!writer.isDone()) {
+            if (!writer.write()) { return false; }
+        }
+        return writer.commit();
+    }
+
+    // Loads the file the way ReadIndexTask does, a few read cycles at a time.
+    // Returns the fastest of a few loads, in microseconds, or -1 on failure.
+    int64 loadIndex(const wxString& p_filename, uint p_numEntries)
+    {
+        int64 bestTime = -1;
+        for (uint i = 0; i < NUM_LOADS; i++) {
+            DatIndex index;
+            DatIndexReader reader(index);
+            wxStopWatch stopWatch;
+
+            if (!reader.open(p_filename)) { return -1; }
+            while (!reader.isDone()) {
+                DatIndexBatch batch(index);
+                if (!(reader.read(7) & DatIndexReader::RR_Success)) { return -1; }
+            }
+            int64 time = stopWatch.TimeInMicro().GetValue();
+
+            if (index.numEntries() != p_numEntries) { return -1; }
+            if (bestTime < 0 || time < bestTime) { bestTime = time; }
+        }
+        return bestTime;
+    }
+
+    bool benchFormat(DatIndex& p_index, const wxChar* p_name, uint p_version, const wxString& p_filename)
+    {
+        wxStopWatch stopWatch;
+        bool isWritten = (p_version == 2) ? writeVersion2(p_index, p_filename) : writeIndex(p_index, p_filename, p_version);
+        int64 writeTime = stopWatch.TimeInMicro().GetValue();
+        int64 loadTime  = isWritten ? loadIndex(p_filename, p_index.numEntries()) : -1;
+        if (loadTime < 0) {
+            wxPrintf(wxT("%s: failed\n"), p_name);
+            return false;
+        }
+
+        auto size = wxFile(p_filename).Length();
+        wxPrintf(wxT("%s\t%u\t%.1f\t%.2f\t%.2f\n"), p_name, (uint)size, (double)size / p_index.numEntries(),
+            writeTime / 1000.0, loadTime / 1000.0);
+        return true;
+    }
+
+}; // namespace
+
+int main(int argc, char** argv)
+{
+    wxInitializer initializer;
+
+    uint numEntries = (argc > 1) ? (uint)::strtoul(argv[1], nullptr, 0) : (uint)DEFAULT_NUM_ENTRIES;
+    wxString filename(wxT("IndexFormatBench.idx"));
+
+    DatIndex index;
+    buildIndex(index, wxMax(numEntries, 1u));
+    wxPrintf(wxT("%u entries\nformat\tbytes\tper entry\twrite ms\tload ms\n"), index.numEntries());
+
+    bool result = benchFormat(index, wxT("v2"), 2, filename)
+        && benchFormat(index, wxT("packed"), DatIndex_PackedVersion, filename)
+        && benchFormat(index, wxT("columns"), DatIndex_ColumnVersion, filename);
+
+    ::wxRemoveFile(filename);
+    return result ? 0 : 1;
+}
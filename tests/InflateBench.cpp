@@ -0,0 +1,153 @@
+/** \file       InflateBench.cpp
+ *  \brief      Measures DatInflater throughput per core.
+ *  \author     Rhoot
+ */
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include <cstdlib>
+#include <vector>
+#include <wx/crt.h>
+#include <wx/init.h>
+#include <wx/stopwatch.h>
+
+#include "DatFile.h"
+#include "DatInflater.h"
+#include "Util/ThreadPool.h"
+
+using namespace gw2b;
+
+namespace
+{
+
+    enum { DEFAULT_MAX_ENTRIES = 0x2000 };
+    enum { TARGET_RUN_TIME = 2000000 };     // Microseconds
+
+    struct Sample
+    {
+        Array<byte> input;
+        uint        outputSize;
+    };
+
+    // Inflates the whole corpus p_passes times, split across p_numThreads
+    // threads. Returns the time it took, in microseconds.
+    int64 inflateCorpus(const std::vector<Sample>& p_corpus, uint p_maxOutputSize, uint p_numThreads, uint p_passes)
+    {
+        ThreadPool pool(p_numThreads);
+        wxStopWatch stopWatch;
+
+        // Each thread takes every p_numThreads:th sample, so no
+        // synchronization is needed while running
+        uint numSamples = p_corpus.size() * p_passes;
+        for (uint t = 0; t < p_numThreads; t++) {
+            pool.post([&, t] {
+                DatInflater inflater;
+                Array<byte> output(p_maxOutputSize);
+                for (uint i = t; i < numSamples; i += p_numThreads) {
+                    auto& sample    = p_corpus[i % p_corpus.size()];
+                    uint outputSize = 0;
+                    inflater.inflate(sample.input.GetPointer(), sample.input.GetSize(), false, output.GetPointer(), outputSize);
+                }
+            });
+        }
+        pool.wait();
+
+        return stopWatch.TimeInMicro().GetValue();
+    }
+
+}; // namespace
+
+int main(int argc, char** argv)
+{
+    wxInitializer initializer;
+
+    if (argc < 2) {
+        wxPrintf(wxT("Usage: InflateBench <dat> [max entries] [max threads]\n"));
+        return 2;
+    }
+
+    DatFile datFile;
+    if (!datFile.open(wxString(argv[1]))) {
+        wxPrintf(wxT("Failed to open %s\n"), wxString(argv[1]));
+        return 2;
+    }
+
+    uint maxEntries = (argc > 2) ? (uint)::strtoul(argv[2], nullptr, 0) : (uint)DEFAULT_MAX_ENTRIES;
+    uint maxThreads = (argc > 3) ? ::strtoul(argv[3], nullptr, 0) : wxThread::GetCPUCount();
+    maxThreads = wxMax(maxThreads, 1u);
+
+    // Load an evenly spread sample of the compressed entries up front, so
+    // that only inflating is measured. Entries that fail to inflate are left
+    // out.
+    Array<uint> compressed;
+    for (uint i = datFile.mftFileOffset(); i < datFile.numEntries(); i++) {
+        ANetMftEntry record;
+        if (datFile.entryRecord(i, record) && (record.entryFlags & ANMEF_InUse) && record.compressionFlag) {
+            compressed.Add(i);
+        }
+    }
+
+    std::vector<Sample> corpus;
+    uint64 inputBytes  = 0;
+    uint64 outputBytes = 0;
+    uint maxOutputSize = 0;
+    uint stride = (maxEntries && compressed.GetSize() > maxEntries) ? compressed.GetSize() / maxEntries : 1;
+
+    for (uint i = 0; i < compressed.GetSize(); i += stride) {
+        Sample sample;
+        if (!datFile.readRawEntry(compressed[i], 0, sample.input)) { continue; }
+
+        sample.outputSize = DatInflater::uncompressedSize(sample.input.GetPointer(), sample.input.GetSize());
+        if (sample.outputSize == std::numeric_limits<uint>::max()) { continue; }
+
+        DatInflater inflater;
+        Array<byte> output(sample.outputSize);
+        uint outputSize = 0;
+        if (inflater.inflate(sample.input.GetPointer(), sample.input.GetSize(), false, output.GetPointer(), outputSize) != DatInflater::IR_Success) {
+            continue;
+        }
+
+        corpus.push_back(sample);
+        inputBytes   += sample.input.GetSize();
+        outputBytes  += sample.outputSize;
+        maxOutputSize = wxMax(maxOutputSize, sample.outputSize);
+    }
+
+    if (corpus.empty()) {
+        wxPrintf(wxT("No compressed entries to inflate\n"));
+        return 1;
+    }
+    wxPrintf(wxT("Corpus: %u entries, %.1f MB compressed, %.1f MB inflated\n"),
+        (uint)corpus.size(), inputBytes / 1048576.0, outputBytes / 1048576.0);
+
+    // Size each run so that one thread takes about TARGET_RUN_TIME, and give
+    // every extra thread as much work again
+    int64 passTime = wxMax(inflateCorpus(corpus, maxOutputSize, 1, 1), (int64)1);
+    uint passes    = wxMax((uint)(TARGET_RUN_TIME / passTime), 1u);
+
+    wxPrintf(wxT("threads\tMB/s\tMB/s per core\n"));
+    for (uint numThreads = 1; ; numThreads = wxMin(numThreads * 2, maxThreads)) {
+        int64 time = wxMax(inflateCorpus(corpus, maxOutputSize, numThreads, passes * numThreads), (int64)1);
+        double rate = (outputBytes * passes * numThreads) / (time / 1000000.0) / 1048576.0;
+        wxPrintf(wxT("%u\t%.1f\t%.1f\n"), numThreads, rate, rate / numThreads);
+        if (numThreads == maxThreads) { break; }
+    }
+
+    return 0;
+}
@@ -0,0 +1,152 @@
+/** \file       InflateTest.cpp
+ *  \brief      Differential test of DatInflater against gw2DatTools.
+ *  \author     Rhoot
+ */
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include <cstdlib>
+#include <wx/crt.h>
+#include <wx/init.h>
+#include <gw2DatTools/compression/inflateDatFileBuffer.h>
+
+#include "DatFile.h"
+#include "DatInflater.h"
+
+using namespace gw2b;
+
+namespace
+{
+
+    enum { DEFAULT_MAX_ENTRIES = 0x4000 };
+    enum { MAX_REPORTED_FAILURES = 0x20 };
+
+    // Output limits each entry is peeked at, on top of being inflated whole
+    const uint g_peekSizes[] = { 1, 0x20, 0x1000, 0x10000 };
+
+    uint g_numFailures = 0;
+
+    void reportFailure(uint p_entryNum, const wxChar* p_what)
+    {
+        if (g_numFailures++ < MAX_REPORTED_FAILURES) {
+            wxPrintf(wxT("entry %u: %s\n"), p_entryNum, p_what);
+        }
+    }
+
+    // Inflates p_input with DatInflater, and checks that it gives the first
+    // p_size bytes of p_expected. A p_size of 0 inflates everything.
+    bool inflatesTo(const Array<byte>& p_input, uint p_inputSize, uint p_size, const Array<byte>& p_expected)
+    {
+        DatInflater inflater;
+        Array<byte> output(p_expected.GetSize());
+        uint outputSize = p_size;
+        bool isPartial  = p_inputSize < p_input.GetSize();
+
+        auto result = inflater.inflate(p_input.GetPointer(), p_inputSize, isPartial, output.GetPointer(), outputSize);
+
+        // Running out of a partial input is fine, anything else is not
+        if (isPartial && result == DatInflater::IR_NotEnoughData) { return true; }
+        if (result != DatInflater::IR_Success) { return false; }
+
+        uint expectedSize = p_size ? p_size : p_expected.GetSize();
+        if (outputSize != expectedSize) { return false; }
+        return ::memcmp(output.GetPointer(), p_expected.GetPointer(), outputSize) == 0;
+    }
+
+}; // namespace
+
+int main(int argc, char** argv)
+{
+    wxInitializer initializer;
+
+    if (argc < 2) {
+        wxPrintf(wxT("Usage: InflateTest <dat> [max entries]\n"));
+        return 2;
+    }
+
+    DatFile datFile;
+    if (!datFile.open(wxString(argv[1]))) {
+        wxPrintf(wxT("Failed to open %s\n"), wxString(argv[1]));
+        return 2;
+    }
+
+    // The corpus is every compressed entry, or an evenly spread sample of
+    // them if there are more than asked for
+    uint maxEntries = (argc > 2) ? ::strtoul(argv[2], nullptr, 0) : DEFAULT_MAX_ENTRIES;
+    Array<uint> compressed;
+    for (uint i = datFile.mftFileOffset(); i < datFile.numEntries(); i++) {
+        ANetMftEntry record;
+        if (datFile.entryRecord(i, record) && (record.entryFlags & ANMEF_InUse) && record.compressionFlag) {
+            compressed.Add(i);
+        }
+    }
+
+    uint stride = (maxEntries && compressed.GetSize() > maxEntries) ? compressed.GetSize() / maxEntries : 1;
+    uint numCompared = 0;
+    uint numSkipped  = 0;
+
+    for (uint i = 0; i < compressed.GetSize(); i += stride) {
+        uint entryNum = compressed[i];
+
+        Array<byte> input;
+        if (!datFile.readRawEntry(entryNum, 0, input)) {
+            reportFailure(entryNum, wxT("could not be read"));
+            continue;
+        }
+
+        // Entries gw2DatTools can't inflate have nothing to be compared with
+        uint32 expectedSize = DatInflater::uncompressedSize(input.GetPointer(), input.GetSize());
+        if (expectedSize == std::numeric_limits<uint>::max()) {
+            numSkipped++;
+            continue;
+        }
+
+        Array<byte> expected(expectedSize);
+        try {
+            gw2dt::compression::inflateDatFileBuffer(input.GetSize(), input.GetPointer(), expectedSize, expected.GetPointer());
+        } catch (std::exception&) {
+            numSkipped++;
+            continue;
+        }
+        if (expectedSize != expected.GetSize()) {
+            numSkipped++;
+            continue;
+        }
+
+        numCompared++;
+        if (!inflatesTo(input, input.GetSize(), 0, expected)) {
+            reportFailure(entryNum, wxT("inflated data differs"));
+            continue;
+        }
+        for (uint j = 0; j < sizeof(g_peekSizes) / sizeof(g_peekSizes[0]); j++) {
+            if (g_peekSizes[j] >= expectedSize) { break; }
+            if (!inflatesTo(input, input.GetSize(), g_peekSizes[j], expected)) {
+                reportFailure(entryNum, wxT("peeked data differs"));
+                break;
+            }
+        }
+        // Peeks during scanning only pass the start of the entry
+        if (!inflatesTo(input, input.GetSize() / 2, wxMin(expectedSize, 0x1000u), expected)) {
+            reportFailure(entryNum, wxT("partial input inflated wrong"));
+        }
+    }
+
+    wxPrintf(wxT("%u entries compared, %u skipped, %u failures\n"), numCompared, numSkipped, g_numFailures);
+    return (g_numFailures || !numCompared) ? 1 : 0;
+}
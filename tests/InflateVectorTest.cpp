@@ -0,0 +1,297 @@
+/** \file       InflateVectorTest.cpp
+ *  \brief      Tests DatInflater against compressed vectors with known output.
+ *  \author     Rhoot
+ */
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include <vector>
+#include <wx/crt.h>
+#include <wx/init.h>
+
+#include "DatDeflater.h"
+#include "DatInflater.h"
+
+using namespace gw2b;
+
+namespace
+{
+
+    enum { MAX_REPORTED_FAILURES = 0x20 };
+    enum { CRC_INTERVAL = 0x4000 };
+
+    uint g_numFailures = 0;
+
+    void reportFailure(const wxChar* p_vector, const wxChar* p_what)
+    {
+        if (g_numFailures++ < MAX_REPORTED_FAILURES) {
+            wxPrintf(wxT("%s: %s\n"), p_vector, p_what);
+        }
+    }
+
+    //----------------------------------------------------------------------------
+    //      Expected output
+    //----------------------------------------------------------------------------
+
+    // Few enough different letters for two literal codes to fit in one table
+    // lookup. The odd length leaves the last literal without a pair.
+    const char s_pairLiteralsText[] = "the quick brown fox jumps over the lazy dog";
+
+    void pairLiteralsOutput(std::vector<byte>& po_output)
+    {
+        po_output.assign(s_pairLiteralsText, s_pairLiteralsText + sizeof(s_pairLiteralsText) - 1);
+    }
+
+    // Copies around each copy size and copy offset range boundary
+    void copyEdgesOutput(std::vector<byte>& po_output)
+    {
+        po_output.clear();
+
+        // Repeating patterns are copied from one period back. The first one
+        // copies from the very start of the output.
+        const uint periods[] = { 2, 3, 4, 5, 6, 8, 9, 16, 17, 32, 33 };
+        uint random = 1;
+        for (uint i = 0; i < sizeof(periods) / sizeof(periods[0]); i++) {
+            uint start = po_output.size();
+            for (uint j = 0; j < periods[i]; j++) {
+                random = random * 1103515245u + 12345u;
+                po_output.push_back(static_cast<byte>(0x40 + ((random >> 16) & 0x3f)));
+            }
+            for (uint j = 0; j < 12; j++) {
+                po_output.push_back(po_output[start + j]);
+            }
+        }
+
+        // Runs are copied from one byte back, the first byte of each run
+        // being a literal. Runs longer than the longest copy take several.
+        const uint copySizes[] = { 3, 4, 7, 8, 11, 12, 19, 20, 35, 36, 67, 68, 131, 132, 258, 259, 600 };
+        for (uint i = 0; i < sizeof(copySizes) / sizeof(copySizes[0]); i++) {
+            po_output.insert(po_output.end(), copySizes[i] + 1, static_cast<byte>(0x80 + i));
+        }
+
+        // Markers are copied from far back, over zeroes that copy themselves
+        const uint offsets[] = { 0x8000, 0x8001, 0x10000, 0x10001, 0x20000 };
+        for (uint i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+            const byte marker[] = { 0xf0, static_cast<byte>(i), 0xf1, static_cast<byte>(i), 0xf2, static_cast<byte>(i), 0xf3, static_cast<byte>(i) };
+            po_output.insert(po_output.end(), marker, marker + sizeof(marker));
+            po_output.insert(po_output.end(), offsets[i] - sizeof(marker), 0);
+            po_output.insert(po_output.end(), marker, marker + sizeof(marker));
+        }
+    }
+
+    // Appends the de Bruijn sequence of 4 letter words over 16 letters, which
+    // holds every such word exactly once
+    void deBruijn(uint p_t, uint p_p, uint* pio_word, std::vector<byte>& po_output)
+    {
+        if (p_t > 4) {
+            if (4 % p_p == 0) {
+                for (uint i = 1; i <= p_p; i++) { po_output.push_back(static_cast<byte>('a' + pio_word[i])); }
+            }
+            return;
+        }
+
+        pio_word[p_t] = pio_word[p_t - p_p];
+        deBruijn(p_t + 1, p_p, pio_word, po_output);
+        for (uint i = pio_word[p_t - p_p] + 1; i < 16; i++) {
+            pio_word[p_t] = i;
+            deBruijn(p_t + 1, p_t, pio_word, po_output);
+        }
+    }
+
+    // Nothing repeats, so this compresses into literals only, all with about
+    // the same code length
+    void literalsOutput(uint p_size, std::vector<byte>& po_output)
+    {
+        uint word[5] = { 0, 0, 0, 0, 0 };
+        po_output.clear();
+        deBruijn(1, 1, word, po_output);
+        po_output.resize(p_size);
+    }
+
+    // Noise that hardly compresses at all
+    void noiseOutput(uint p_size, std::vector<byte>& po_output)
+    {
+        po_output.resize(p_size);
+        uint random = p_size;
+        for (uint i = 0; i < p_size; i++) {
+            random = random * 1103515245u + 12345u;
+            po_output[i] = static_cast<byte>(random >> 16);
+        }
+    }
+
+    //----------------------------------------------------------------------------
+    //      Vectors
+    //----------------------------------------------------------------------------
+
+    // Compressed with DatDeflater from the outputs above. They are checked in
+    // so that the inflater is tested against fixed input, rather than against
+    // whatever the compressor writes at the time.
+    const byte s_pairLiterals[] = {
+        0x00, 0x00, 0x00, 0x00, 0x2b, 0x00, 0x00, 0x00, 0x39, 0x01, 0x01, 0x03, 0x84, 0x10, 0x42, 0x08,
+        0x10, 0x42, 0x08, 0x21, 0x01, 0x13, 0x20, 0x84, 0x2c, 0xe0, 0xb1, 0x60, 0x42, 0x08, 0x21, 0x07,
+        0x42, 0x0f, 0x84, 0x10, 0xa0, 0x00, 0x80, 0x10, 0x95, 0x27, 0x12, 0x6d, 0xbf, 0x1b, 0x8d, 0x7a,
+        0x7a, 0x46, 0x3a, 0xe1, 0xd5, 0x0c, 0xfc, 0x68, 0x9e, 0x6a, 0xe9, 0xa3, 0x2f, 0x42, 0x76, 0x0e,
+        0x00, 0x00, 0x98, 0x6d
+    };
+
+    const byte s_copyEdges[] = {
+        0x00, 0x00, 0x00, 0x00, 0xcc, 0x07, 0x05, 0x00, 0x06, 0x1d, 0x01, 0x03, 0xcc, 0x24, 0x93, 0xcc,
+        0x34, 0xaa, 0x59, 0x6e, 0xb9, 0xf1, 0x6a, 0xec, 0xd0, 0x82, 0x51, 0x01, 0x42, 0x08, 0x21, 0x84,
+        0xc0, 0x01, 0x84, 0x10, 0xe1, 0x2f, 0x18, 0x60, 0x22, 0x15, 0x2a, 0x66, 0x9d, 0xc6, 0xc4, 0xd5,
+        0x91, 0x41, 0x63, 0xc3, 0x2e, 0x18, 0x34, 0x84, 0x84, 0xa7, 0x82, 0x70, 0x10, 0x42, 0x78, 0xe7,
+        0x50, 0x01, 0x21, 0x84, 0x08, 0x88, 0x00, 0x48, 0x0b, 0x78, 0x12, 0xa1, 0xc1, 0x8a, 0x0d, 0x18,
+        0x20, 0x5c, 0x81, 0xd7, 0x91, 0x01, 0x3c, 0x16, 0x9a, 0x57, 0x92, 0x31, 0xc2, 0x7c, 0x2e, 0x68,
+        0xad, 0x3c, 0x98, 0x07, 0x4f, 0x84, 0x73, 0x71, 0x75, 0xda, 0x90, 0x32, 0x68, 0x15, 0x22, 0x62,
+        0xa3, 0xea, 0x5c, 0x9e, 0x4a, 0xa4, 0x8e, 0x08, 0x16, 0xca, 0x33, 0x65, 0x94, 0x60, 0x46, 0x9e,
+        0x20, 0x19, 0x3a, 0x90, 0x93, 0x10, 0x8a, 0x11, 0xbc, 0x15, 0xa3, 0x8f, 0xd2, 0x84, 0x4a, 0x9c,
+        0x27, 0x91, 0xe8, 0x83, 0x00, 0xd1, 0x5c, 0x3e, 0x48, 0xa5, 0x30, 0xb4, 0xa4, 0x03, 0xc8, 0xf3,
+        0x14, 0x8b, 0x44, 0x28, 0x94, 0x87, 0x10, 0x20, 0x38, 0x78, 0x48, 0x17, 0xe2, 0x9c, 0x32, 0x27,
+        0xa4, 0xa5, 0xa2, 0x35, 0x3a, 0xa9, 0x12, 0xc8, 0xc9, 0x24, 0x52, 0x65, 0x46, 0x4c, 0x3f, 0x5e,
+        0xd1, 0xd0, 0xf9, 0xb0, 0xc9, 0xa8, 0xc4, 0x3a, 0x0f, 0x22, 0xae, 0x8d, 0x02, 0x71, 0x54, 0x9b,
+        0x0d, 0x87, 0x84, 0x65, 0x1f, 0x9a, 0x14, 0x27, 0xa8, 0x3c, 0x48, 0x23, 0xb1, 0x80, 0xf1, 0x36,
+        0xc0, 0x82, 0xc5, 0x62, 0x0a, 0x0b, 0x54, 0x68, 0x21, 0x81, 0x09, 0x37, 0x1e, 0x10, 0xa1, 0x27,
+        0x7b, 0x10, 0x01, 0x10, 0x10, 0x01, 0x1c, 0x5c, 0x83, 0xc1, 0x03, 0x68, 0x7c, 0x8d, 0x05, 0x81,
+        0x24, 0x08, 0x32, 0x14, 0x07, 0x46, 0xd0, 0x5f, 0x66, 0x95, 0xce, 0xf1, 0xdc, 0xac, 0x9b, 0x51,
+        0xff, 0xff, 0xff, 0x67, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xbf, 0x6c, 0x55, 0xe3, 0xa3, 0xc8, 0x2a, 0xff, 0xc9, 0x38, 0x59, 0x27, 0xff, 0xff, 0xcb, 0xad,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xd9, 0xe2, 0xc6, 0xff,
+        0xc4, 0x2a, 0x00, 0x00, 0xb8, 0x58, 0x17, 0xa3, 0xff, 0xcb, 0xad, 0xc5, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xb6, 0x63, 0xfc, 0xff, 0x56, 0xf9, 0xff, 0xc7,
+        0xc1, 0x3a, 0x18, 0x05, 0x5f, 0x6e, 0x0d, 0xc6, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0x1e, 0xe3, 0xff, 0xff, 0x05, 0x00, 0x20, 0xb6, 0xea, 0x5e, 0x94, 0x57,
+        0xb9, 0xb5, 0x17, 0xf7, 0xff, 0xff, 0xff, 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xe6, 0xe2, 0xff, 0xff, 0xe0, 0xff, 0x1f, 0xb6
+    };
+
+    //----------------------------------------------------------------------------
+    //      Checks
+    //----------------------------------------------------------------------------
+
+    // Inflates the first p_inputSize bytes of p_input, and checks that it gives
+    // the first p_size bytes of p_expected. A p_size of 0 inflates everything.
+    bool inflatesTo(const byte* p_input, uint p_inputSize, bool p_isPartial, uint p_size, const std::vector<byte>& p_expected)
+    {
+        DatInflater inflater;
+        Array<byte> output(p_expected.size());
+        uint outputSize = p_size;
+        auto result = inflater.inflate(p_input, p_inputSize, p_isPartial, output.GetPointer(), outputSize);
+
+        // Running out of a partial input is fine, anything else is not
+        if (p_isPartial && result == DatInflater::IR_NotEnoughData) { return true; }
+        if (result != DatInflater::IR_Success) { return false; }
+
+        uint expectedSize = p_size ? p_size : p_expected.size();
+        if (outputSize != expectedSize) { return false; }
+        return ::memcmp(output.GetPointer(), &p_expected[0], outputSize) == 0;
+    }
+
+    // Inflates the whole vector, the start of it, and the start of it from
+    // the start of the input
+    void checkVector(const wxChar* p_name, const byte* p_input, uint p_inputSize, const std::vector<byte>& p_expected)
+    {
+        uint size = p_expected.size();
+        if (DatInflater::uncompressedSize(p_input, p_inputSize) != size) {
+            reportFailure(p_name, wxT("wrong uncompressed size"));
+        }
+        if (!inflatesTo(p_input, p_inputSize, false, 0, p_expected)) {
+            reportFailure(p_name, wxT("inflated data differs"));
+            return;
+        }
+
+        const uint peekSizes[] = { 1, 2, 3, size / 2, size - 1 };
+        for (uint i = 0; i < sizeof(peekSizes) / sizeof(peekSizes[0]); i++) {
+            if (!peekSizes[i] || peekSizes[i] >= size) { continue; }
+            if (!inflatesTo(p_input, p_inputSize, false, peekSizes[i], p_expected)) {
+                reportFailure(p_name, wxT("peeked data differs"));
+            }
+        }
+
+        for (uint i = 1; i < 8; i++) {
+            if (!inflatesTo(p_input, p_inputSize * i / 8, true, wxMin(size, 0x1000u), p_expected)) {
+                reportFailure(p_name, wxT("partial input inflated wrong"));
+            }
+        }
+    }
+
+    // Checks that the checksum dwords are skipped, by compressing noise to
+    // past a few of them. Junk in them changes nothing, while junk in the
+    // dword before the first one does.
+    void checkChecksums()
+    {
+        std::vector<byte> expected;
+        noiseOutput(0x30000, expected);
+        auto input = DatDeflater::deflate(&expected[0], expected.size(), 0x10000);
+
+        uint numWords = input.GetSize() / sizeof(uint32);
+        if (numWords < CRC_INTERVAL * 3) {
+            reportFailure(wxT("checksums"), wxT("input too small"));
+            return;
+        }
+
+        auto words = reinterpret_cast<uint32*>(input.GetPointer());
+        for (uint i = CRC_INTERVAL - 1; i < numWords; i += CRC_INTERVAL) {
+            words[i] = 0xdeadbeef;
+        }
+        checkVector(wxT("checksums"), input.GetPointer(), input.GetSize(), expected);
+
+        words[CRC_INTERVAL - 2] ^= 0x80000000;
+        if (inflatesTo(input.GetPointer(), input.GetSize(), false, 0, expected)) {
+            reportFailure(wxT("checksums"), wxT("corrupt data inflated fine"));
+        }
+    }
+
+}; // namespace
+
+int main()
+{
+    wxInitializer initializer;
+    std::vector<byte> expected;
+
+    pairLiteralsOutput(expected);
+    checkVector(wxT("pair literals"), s_pairLiterals, sizeof(s_pairLiterals), expected);
+
+    copyEdgesOutput(expected);
+    checkVector(wxT("copy edges"), s_copyEdges, sizeof(s_copyEdges), expected);
+
+    // Small blocks of literals only, so the trees are replaced often and
+    // paired literals run right up to the end of each block
+    literalsOutput(0x3001, expected);
+    auto input = DatDeflater::deflate(&expected[0], expected.size(), 0x1000);
+    checkVector(wxT("block ends"), input.GetPointer(), input.GetSize(), expected);
+
+    checkChecksums();
+
+    wxPrintf(wxT("%u failures\n"), g_numFailures);
+    return g_numFailures ? 1 : 0;
+}
@@ -0,0 +1,168 @@
+/** \file       SyntheticDat.cpp
+ *  \brief      Contains the definition of the synthetic .dat writer used by the tests.
+ *  \author     Rhoot
+ */
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include <vector>
+#include <wx/file.h>
+
+#include "ANetStructs.h"
+#include "DatDeflater.h"
+#include "SyntheticDat.h"
+
+namespace gw2b
+{
+
+namespace
+{
+
+    enum { MFT_FILE_OFFSET = 16 };
+    enum { FILE_ID_TABLE_ENTRY = 2 };
+    enum { WRITE_BUFFER_SIZE = 0x100000 };
+
+}; // namespace
+
+SyntheticDat::SyntheticDat(uint p_numFiles, uint p_maxFileSize, bool p_isCompressed)
+    : m_numFiles(p_numFiles)
+    , m_maxFileSize(wxMax(p_maxFileSize, 1u))
+    , m_isCompressed(p_isCompressed)
+{
+}
+
+uint SyntheticDat::fileSize(uint p_fileNum) const
+{
+    // Spread the sizes out, with plenty of tiny files like the real thing
+    uint hash = p_fileNum * 0x2545f491u;
+    hash ^= hash >> 15;
+    uint size = 1 + (hash % m_maxFileSize);
+    return (hash & 0x10000) ? size : wxMax(size >> 6, 1u);
+}
+
+byte SyntheticDat::fileByte(uint p_fileNum, uint p_offset)
+{
+    uint value = p_fileNum * 0x9e3779b1u + p_offset;
+    if (p_offset & 0x400) {
+        value *= 0x2545f491u;
+        value ^= value >> 15;
+        return static_cast<byte>((value * 0x9e3779b1u) >> 24);
+    }
+    return static_cast<byte>(value >> 3);
+}
+
+bool SyntheticDat::isFileData(uint p_fileNum, const byte* p_data, uint p_size) const
+{
+    if (p_size > this->fileSize(p_fileNum)) { return false; }
+    for (uint i = 0; i < p_size; i++) {
+        if (p_data[i] != fileByte(p_fileNum, i)) { return false; }
+    }
+    return true;
+}
+
+bool SyntheticDat::write(const wxString& p_filename) const
+{
+    wxFile file(p_filename, wxFile::write);
+    if (!file.IsOpened()) { return false; }
+
+    uint numEntries = m_numFiles + MFT_FILE_OFFSET;
+    uint mftSize    = numEntries * sizeof(ANetMftEntry);
+    uint tableSize  = m_numFiles * 2 * sizeof(ANetFileIdEntry);
+
+    // Headers, then the MFT, then the file ID table, then the files
+    ANetDatHeader datHeader;
+    ::memset(&datHeader, 0, sizeof(datHeader));
+    datHeader.version       = 0x97;
+    datHeader.identifier[0] = 'A';
+    datHeader.identifier[1] = 'N';
+    datHeader.identifier[2] = 0x1a;
+    datHeader.headerSize    = sizeof(datHeader);
+    datHeader.chunkSize     = 0x200;
+    datHeader.mftOffset     = sizeof(datHeader);
+    datHeader.mftSize       = mftSize;
+
+    Array<ANetMftEntry> mft(numEntries);
+    ::memset(mft.GetPointer(), 0, mft.GetByteSize());
+
+    // Entry 0 holds the MFT header instead
+    ANetMftHeader mftHeader;
+    ::memset(&mftHeader, 0, sizeof(mftHeader));
+    mftHeader.identifier[0] = 'M';
+    mftHeader.identifier[1] = 'f';
+    mftHeader.identifier[2] = 't';
+    mftHeader.identifier[3] = 0x1a;
+    mftHeader.numEntries    = numEntries;
+    ::memcpy(mft.GetPointer(), &mftHeader, sizeof(mftHeader));
+
+    uint64 offset = datHeader.mftOffset + mftSize;
+    auto& tableEntry = mft[FILE_ID_TABLE_ENTRY];
+    tableEntry.offset       = offset;
+    tableEntry.size         = tableSize;
+    tableEntry.entryFlags   = ANMEF_InUse;
+    offset += tableSize;
+
+    // Compressed files need compressing before their sizes are known
+    std::vector<Array<byte>> compressed(m_numFiles);
+    for (uint i = 0; i < m_numFiles; i++) {
+        if (!this->isCompressed(i)) { continue; }
+
+        Array<byte> contents(this->fileSize(i));
+        for (uint j = 0; j < contents.GetSize(); j++) {
+            contents[j] = fileByte(i, j);
+        }
+        compressed[i] = DatDeflater::deflate(contents.GetPointer(), contents.GetSize());
+    }
+
+    Array<ANetFileIdEntry> table(m_numFiles * 2);
+    for (uint i = 0; i < m_numFiles; i++) {
+        auto& entry = mft[i + MFT_FILE_OFFSET];
+        entry.offset            = offset;
+        entry.size              = this->isCompressed(i) ? compressed[i].GetSize() : this->fileSize(i);
+        entry.compressionFlag   = this->isCompressed(i) ? ANCF_Compressed : ANCF_Uncompressed;
+        entry.entryFlags        = ANMEF_InUse;
+        offset += entry.size;
+
+        table[i * 2].fileId            = baseId(i);
+        table[i * 2].mftEntryIndex     = i + MFT_FILE_OFFSET;
+        table[i * 2 + 1].fileId        = fileId(i);
+        table[i * 2 + 1].mftEntryIndex = i + MFT_FILE_OFFSET;
+    }
+
+    if (file.Write(&datHeader, sizeof(datHeader)) != sizeof(datHeader)) { return false; }
+    if (file.Write(mft.GetPointer(), mft.GetByteSize()) != mft.GetByteSize()) { return false; }
+    if (file.Write(table.GetPointer(), table.GetByteSize()) != table.GetByteSize()) { return false; }
+
+    // Buffer the file contents, as most files are tiny
+    Array<byte> buffer(WRITE_BUFFER_SIZE);
+    uint bufferUsed = 0;
+
+    for (uint i = 0; i < m_numFiles; i++) {
+        uint size = this->isCompressed(i) ? compressed[i].GetSize() : this->fileSize(i);
+        for (uint j = 0; j < size; j++) {
+            if (bufferUsed == WRITE_BUFFER_SIZE) {
+                if (file.Write(buffer.GetPointer(), bufferUsed) != bufferUsed) { return false; }
+                bufferUsed = 0;
+            }
+            buffer[bufferUsed++] = this->isCompressed(i) ? compressed[i][j] : fileByte(i, j);
+        }
+    }
+    return file.Write(buffer.GetPointer(), bufferUsed) == bufferUsed;
+}
+
+}; // namespace gw2b
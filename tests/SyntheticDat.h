@@ -0,0 +1,94 @@
+/** \file       SyntheticDat.h
+ *  \brief      Contains the declaration of the synthetic .dat writer used by the tests.
+ *  \author     Rhoot
+ */
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef SYNTHETICDAT_H_INCLUDED
+#define SYNTHETICDAT_H_INCLUDED
+
+namespace gw2b
+{
+
+/** Generates .dat files for tests and benchmarks that don't need real game
+ *  data. Files are stored in the order of their entries, and their contents,
+ *  sizes and IDs are all derived from their file entry number, so readers can
+ *  check what they get back. Each file has a base ID and a file ID in the
+ *  file ID table.
+ *
+ *  Files are stored uncompressed, unless asked for otherwise. Compressed
+ *  .dat files still store every fourth file uncompressed, like the real thing
+ *  mixes them. */
+class SyntheticDat
+{
+    uint    m_numFiles;
+    uint    m_maxFileSize;
+    bool    m_isCompressed;
+public:
+    /** Constructor.
+     *  \param[in]  p_numFiles       Amount of file entries.
+     *  \param[in]  p_maxFileSize    Max size of each file, in bytes.
+     *  \param[in]  p_isCompressed   true to compress most of the files. */
+    SyntheticDat(uint p_numFiles, uint p_maxFileSize, bool p_isCompressed = false);
+
+    /** Writes the .dat.
+     *  \param[in]  p_filename   File to write to. Overwritten if it exists.
+     *  \return bool    true if successful, false if not. */
+    bool write(const wxString& p_filename) const;
+
+    /** Gets the amount of file entries.
+     *  \return uint    Amount of file entries. */
+    uint numFiles() const               { return m_numFiles; }
+    /** Gets the size of the given file.
+     *  \param[in]  p_fileNum    File entry number.
+     *  \return uint    Size of the file, in bytes. */
+    uint fileSize(uint p_fileNum) const;
+    /** Checks whether the given file is stored compressed.
+     *  \param[in]  p_fileNum    File entry number.
+     *  \return bool    true if compressed, false if not. */
+    bool isCompressed(uint p_fileNum) const { return m_isCompressed && (p_fileNum % 4) != 0; }
+    /** Gets a byte of the given file's contents. Files alternate between
+     *  slowly rising runs, which compress into copies, and noise, which only
+     *  compresses into shorter codes.
+     *  \param[in]  p_fileNum    File entry number.
+     *  \param[in]  p_offset     Offset of the byte in the file.
+     *  \return byte    Value of the byte. */
+    static byte fileByte(uint p_fileNum, uint p_offset);
+    /** Gets the base ID of the given file.
+     *  \param[in]  p_fileNum    File entry number.
+     *  \return uint    Base ID of the file. */
+    static uint baseId(uint p_fileNum)  { return 0x10 + p_fileNum * 3; }
+    /** Gets the file ID of the given file.
+     *  \param[in]  p_fileNum    File entry number.
+     *  \return uint    File ID of the file. */
+    static uint fileId(uint p_fileNum)  { return baseId(p_fileNum) + 1; }
+
+    /** Checks data read from the given file against what was written.
+     *  \param[in]  p_fileNum    File entry number the data was read from.
+     *  \param[in]  p_data       Data read from the start of the file.
+     *  \param[in]  p_size       Amount of bytes read.
+     *  \return bool    true if the data matches, false if not. */
+    bool isFileData(uint p_fileNum, const byte* p_data, uint p_size) const;
+}; // class SyntheticDat
+
+}; // namespace gw2b
+
+#endif // SYNTHETICDAT_H_INCLUDED
@@ -0,0 +1,169 @@
+/** \file       WorkPoolBench.cpp
+ *  \brief      Measures how parallelFor on a WorkPool scales from 1 core up to
+ *              all of them.
+ *  \author     Rhoot
+ */
+/*	Copyright (C) 2012 Rhoot <https://github.com/rhoot>
+
+    This file is part of Gw2Browser.
+
+    Gw2Browser is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdafx.h"
+#include <cstdlib>
+#include <vector>
+#include <wx/crt.h>
+#include <wx/init.h>
+#include <wx/stopwatch.h>
+
+#include "Util/WorkPool.h"
+
+using namespace gw2b;
+
+namespace
+{
+
+    enum { NUM_ITEMS = 0x10000 };
+    enum { ITEM_COST = 0x400 };             // Rounds of work per item, on average
+    enum { NUM_OUTER_ITEMS = 0x40 };
+    enum { NUM_RUNS = 3 };
+
+    // Stands in for decoding a row of pixels or parsing a mesh: a bit of
+    // arithmetic the compiler can't skip
+    uint32 work(uint32 p_seed, uint p_rounds)
+    {
+        uint32 value = p_seed * 2654435761u + 1;
+        for (uint i = 0; i < p_rounds; i++) {
+            value ^= value << 13;
+            value ^= value >> 17;
+            value ^= value << 5;
+        }
+        return value;
+    }
+
+    // Every item costs the same
+    void uniformLoop(WorkPool& p_pool, std::vector<uint32>& po_results)
+    {
+        TaskGroup group(p_pool);
+        group.parallelFor(0, NUM_ITEMS, [&](int i) {
+            po_results[i] = work(i, ITEM_COST);
+        });
+    }
+
+    // Items get more expensive towards the end of the range, so the chunks
+    // are uneven and idle workers have to steal
+    void skewedLoop(WorkPool& p_pool, std::vector<uint32>& po_results)
+    {
+        TaskGroup group(p_pool);
+        group.parallelFor(0, NUM_ITEMS, [&](int i) {
+            po_results[i] = work(i, (2 * ITEM_COST * (uint64)i) / NUM_ITEMS);
+        });
+    }
+
+    // A loop in each item of another, like images decoded while scanning.
+    // Jobs waiting on an inner loop help out rather than block.
+    void nestedLoop(WorkPool& p_pool, std::vector<uint32>& po_results)
+    {
+        const int innerItems = NUM_ITEMS / NUM_OUTER_ITEMS;
+        TaskGroup outer(p_pool);
+        outer.parallelFor(0, NUM_OUTER_ITEMS, [&](int i) {
+            TaskGroup inner(p_pool);
+            inner.parallelFor(0, innerItems, [&](int j) {
+                int item = i * innerItems + j;
+                po_results[item] = work(item, ITEM_COST);
+            });
+        });
+    }
+
+    struct Workload
+    {
+        const wxChar*   name;
+        void            (*run)(WorkPool& p_pool, std::vector<uint32>& po_results);
+    };
+
+    // Runs the workload from one of the pool's workers, so that only the
+    // pool's threads do the work, and returns the fastest of a few runs, in
+    // microseconds
+    int64 timeWorkload(const Workload& p_workload, WorkPool& p_pool, std::vector<uint32>& po_results)
+    {
+        int64 bestTime = -1;
+        for (uint i = 0; i < NUM_RUNS; i++) {
+            wxMutex mutex;
+            wxCondition done(mutex);
+            bool isDone = false;
+
+            wxMutexLocker lock(mutex);
+            wxStopWatch stopWatch;
+            p_pool.post([&] {
+                p_workload.run(p_pool, po_results);
+                wxMutexLocker doneLock(mutex);
+                isDone = true;
+                done.Signal();
+            });
+            while (!isDone) { done.Wait(); }
+
+            int64 time = stopWatch.TimeInMicro().GetValue();
+            if (bestTime < 0 || time < bestTime) { bestTime = time; }
+        }
+        return wxMax(bestTime, (int64)1);
+    }
+
+}; // namespace
+
+int main(int argc, char** argv)
+{
+    wxInitializer initializer;
+
+    uint maxThreads = (argc > 1) ? ::strtoul(argv[1], nullptr, 0) : wxThread::GetCPUCount();
+    maxThreads = wxMax(maxThreads, 1u);
+
+    const Workload workloads[] = {
+        { wxT("uniform"), uniformLoop },
+        { wxT("skewed"),  skewedLoop },
+        { wxT("nested"),  nestedLoop },
+    };
+    const uint numWorkloads = sizeof(workloads) / sizeof(workloads[0]);
+
+    // The results of each workload are the same for any amount of threads
+    std::vector<uint32> expected[numWorkloads];
+    int64 baseTimes[numWorkloads];
+    uint numMismatches = 0;
+
+    wxPrintf(wxT("workload\tthreads\tms\tspeedup\tefficiency\n"));
+    for (uint numThreads = 1; ; numThreads = wxMin(numThreads * 2, maxThreads)) {
+        WorkPool pool(numThreads);
+        for (uint w = 0; w < numWorkloads; w++) {
+            std::vector<uint32> results(NUM_ITEMS, 0);
+            int64 time = timeWorkload(workloads[w], pool, results);
+
+            if (numThreads == 1) {
+                expected[w]  = results;
+                baseTimes[w] = time;
+            } else if (results != expected[w]) {
+                numMismatches++;
+            }
+
+            double speedup = (double)baseTimes[w] / time;
+            wxPrintf(wxT("%s\t%u\t%.2f\t%.2f\t%.0f%%\n"), workloads[w].name, numThreads, time / 1000.0, speedup, 100.0 * speedup / numThreads);
+        }
+        if (numThreads == maxThreads) { break; }
+    }
+
+    if (numMismatches) {
+        wxPrintf(wxT("%u runs gave different results\n"), numMismatches);
+        return 1;
+    }
+    return 0;
+}